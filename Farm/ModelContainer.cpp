@@ -1,6 +1,7 @@
 #include <iostream>
 
 #include "ModelContainer.h"
+#include "render_stats.h"
 
 ModelContainer::~ModelContainer()
 {
@@ -9,15 +10,10 @@ ModelContainer::~ModelContainer()
     if (VBO != 0) glDeleteBuffers(1, &EBO);
 }
 
-bool ModelContainer::CreateModel(const char* path, const GLuint& shader_program, const GLbyte& _stencil_id, const bool& _transform_model, const bool& _glass_mode)
+bool ModelContainer::LoadMeshData(const char* path, MeshData& mesh)
 {
     std::cout << "loading model: " << path << std::endl;
 
-    stencil_id = _stencil_id;
-    transform_model = _transform_model;
-    glass_mode = _glass_mode;
-    time = 0;
-
 	Assimp::Importer importer;
 
     const aiScene* scene = importer.ReadFile(path, 0
@@ -37,27 +33,57 @@ bool ModelContainer::CreateModel(const char* path, const GLuint& shader_program,
         return false;
     }
 
-    const aiMesh* mesh = scene->mMeshes[0];
+    const aiMesh* ai_mesh = scene->mMeshes[0];
 
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    mesh.vertices.reserve(ai_mesh->mNumVertices);
+    mesh.indices.reserve(ai_mesh->mNumFaces * 3);
 
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+    for (unsigned int i = 0; i < ai_mesh->mNumVertices; i++)
     {
         Vertex vertex;
-        vertex.position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
-        vertex.normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
-        vertex.tex_coords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
-        vertices.push_back(vertex);
+        vertex.position = glm::vec3(ai_mesh->mVertices[i].x, ai_mesh->mVertices[i].y, ai_mesh->mVertices[i].z);
+        vertex.normal = glm::vec3(ai_mesh->mNormals[i].x, ai_mesh->mNormals[i].y, ai_mesh->mNormals[i].z);
+        vertex.tex_coords = glm::vec2(ai_mesh->mTextureCoords[0][i].x, ai_mesh->mTextureCoords[0][i].y);
+        mesh.vertices.push_back(vertex);
     }
 
-    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+    for (unsigned int i = 0; i < ai_mesh->mNumFaces; i++)
     {
-        aiFace face = mesh->mFaces[i];
+        aiFace face = ai_mesh->mFaces[i];
         for (unsigned int j = 0; j < face.mNumIndices; j++)
-            indices.push_back(face.mIndices[j]);
+            mesh.indices.push_back(face.mIndices[j]);
     }
 
+    // built here, so they are built in parallel when models are read by jobs. Hierarchy uses the clustered order
+    BuildMeshClusters(glm::value_ptr(mesh.vertices[0].position), sizeof(Vertex) / sizeof(float), (GLuint)mesh.vertices.size(), mesh.indices, mesh.clusters);
+    mesh.bvh.Build(glm::value_ptr(mesh.vertices[0].position), sizeof(Vertex) / sizeof(float), mesh.indices.data(), (GLuint)mesh.indices.size() / 3);
+
+    return true;
+}
+
+bool ModelContainer::CreateModel(const char* path, const GLuint& shader_program, const bool& _transform_model, const bool& _glass_mode)
+{
+    MeshData mesh;
+    if (!LoadMeshData(path, mesh)) return false;
+    CreateModel(mesh, shader_program, _transform_model, _glass_mode);
+	return true;
+}
+
+void ModelContainer::CreateModel(const MeshData& mesh, const GLuint& shader_program, const bool& _transform_model, const bool& _glass_mode)
+{
+    transform_model = _transform_model;
+    glass_mode = _glass_mode;
+    time = 0;
+
+    const std::vector<Vertex>& vertices = mesh.vertices;
+    const std::vector<unsigned int>& indices = mesh.indices;
+    bounding_sphere = ComputeBoundingSphere(glm::value_ptr(vertices[0].position), (GLuint)vertices.size(), sizeof(Vertex) / sizeof(float));
+    bounding_box = ComputeBoundingBox(glm::value_ptr(vertices[0].position), (GLuint)vertices.size(), sizeof(Vertex) / sizeof(float));
+    bvh = mesh.bvh;
+    clusters = mesh.clusters;
+
     EBO_size = indices.size();
     shader.SetProgram(shader_program);
 
@@ -68,10 +94,10 @@ bool ModelContainer::CreateModel(const char* path, const GLuint& shader_program,
     glBindVertexArray(VAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    StatsBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    StatsBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
     GLuint attrib_location;
 
@@ -88,8 +114,6 @@ bool ModelContainer::CreateModel(const char* path, const GLuint& shader_program,
     glEnableVertexAttribArray(attrib_location);
 
     glBindVertexArray(0);
-
-	return true;
 }
 
 bool ModelContainer::SetMaterial(const char* diffuse_texture_path, const char* specular_texture_path, float shininess) {
@@ -116,78 +140,109 @@ void ModelContainer::SetMaterial(const GLuint& diffuse_texture, const GLuint& sp
     material.shininess = shininess;
 }
 
-void ModelContainer::Draw(const glm::mat4& modelMatrix, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, DirectLight direct, PointLight point, SpotLight spot, Camera camera, float dt, bool fog_enabled) {
-
-    shader.UseProgram();
-    glUniformMatrix4fv(shader.GetUniformValue("modelMatrix"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
-    glUniformMatrix4fv(shader.GetUniformValue("viewMatrix"), 1, GL_FALSE, glm::value_ptr(viewMatrix));
-    glUniformMatrix4fv(shader.GetUniformValue("projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-
-    glUniform1i(shader.GetUniformValue("material.diffuse"), 0);
-    glUniform1i(shader.GetUniformValue("material.specular"), 1);
-    glUniform1f(shader.GetUniformValue("material.shininess"), 32);
-
-    glUniform1i(shader.GetUniformValue("fog_texture"), 2);
-    glUniform1i(shader.GetUniformValue("fog"), fog_enabled);
-
-    glUniform3fv(shader.GetUniformValue("point_light.ambient"), 1, glm::value_ptr(point.ambient));
-    glUniform3fv(shader.GetUniformValue("point_light.diffuse"), 1, glm::value_ptr(point.diffuse));
-    glUniform3fv(shader.GetUniformValue("point_light.specular"), 1, glm::value_ptr(point.specular));
-    glUniform1f(shader.GetUniformValue("point_light.linear"), point.linear);
-    glUniform1f(shader.GetUniformValue("point_light.quadratic"), point.quadratic);
-    glUniform3fv(shader.GetUniformValue("point_light.position"), 1, glm::value_ptr(point.position));
-    glUniform1f(shader.GetUniformValue("point_light.intensity"), point.intensity);
-
-    glUniform3fv(shader.GetUniformValue("direct_light.ambient"), 1, glm::value_ptr(direct.ambient));
-    glUniform3fv(shader.GetUniformValue("direct_light.diffuse"), 1, glm::value_ptr(direct.diffuse));
-    glUniform3fv(shader.GetUniformValue("direct_light.specular"), 1, glm::value_ptr(direct.specular));
-    glUniform3fv(shader.GetUniformValue("direct_light.direction"), 1, glm::value_ptr(direct.direction));
-    glUniform1f(shader.GetUniformValue("direct_light.intensity"), direct.intensity);
-
-    glUniform3fv(shader.GetUniformValue("spot_light.point.ambient"), 1, glm::value_ptr(spot.point.ambient));
-    glUniform3fv(shader.GetUniformValue("spot_light.point.diffuse"), 1, glm::value_ptr(spot.point.diffuse));
-    glUniform3fv(shader.GetUniformValue("spot_light.point.specular"), 1, glm::value_ptr(spot.point.specular));
-    glUniform1f(shader.GetUniformValue("spot_light.point.linear"), spot.point.linear);
-    glUniform1f(shader.GetUniformValue("spot_light.point.quadratic"), spot.point.quadratic);
-    glUniform3fv(shader.GetUniformValue("spot_light.point.position"), 1, glm::value_ptr(spot.point.position));
-    glUniform3fv(shader.GetUniformValue("spot_light.direction"), 1, glm::value_ptr(spot.direction));
-    glUniform1f(shader.GetUniformValue("spot_light.cut_off"), glm::cos(glm::radians(spot.cut_off)));
-    glUniform1f(shader.GetUniformValue("spot_light.point.intensity"), spot.point.intensity);
-
-    glUniform3fv(shader.GetUniformValue("viewPos"), 1, glm::value_ptr(camera.position));
-
-    glUniform1i(shader.GetUniformValue("transform_model"), transform_model);
-    if (transform_model) {
-        time += dt;
-        float change_value = cos(time) / 2 + 1.0f;
-        glUniform1f(shader.GetUniformValue("change_val"), change_value);
-    }
+void ModelContainer::WriteObjectBlock(ObjectBlock& block, const glm::mat4& modelMatrix, float animation_time, GLuint object_id) const {
+    block.model_matrix = modelMatrix;
+    block.normal_matrix = glm::transpose(glm::inverse(modelMatrix));
+    block.object_id = object_id;
+    block.transform_model = transform_model;
+    block.change_val = transform_model ? cos(animation_time) / 2 + 1.0f : 1.0f;
+}
+
+void ModelContainer::Draw() {
+    Bind();
+    DrawElements();
+    StatsBindVertexArray(0);
+}
+
+void ModelContainer::Bind() {
+    Bind(shader.GetProgram());
+}
+
+void ModelContainer::Bind(GLuint program) {
+    StatsUseProgram(program);
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, material.diffuse_texture);
+    StatsBindTexture(GL_TEXTURE_2D, material.diffuse_texture);
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, material.specular_texture);
+    StatsBindTexture(GL_TEXTURE_2D, material.specular_texture);
     glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, fog_texture);
+    StatsBindTexture(GL_TEXTURE_2D, fog_texture);
 
-    if (stencil_id != 0) {
-        glEnable(GL_STENCIL_TEST);
-        glEnable(GL_STENCIL_TEST);
-        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-    }
+    StatsBindVertexArray(VAO);
+}
 
-    if (glass_mode) glBlendFunc(GL_SRC_COLOR, GL_ONE_MINUS_SRC_COLOR);
-    else glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+void ModelContainer::DrawElements() {
+    StatsDrawElements(GL_TRIANGLES, EBO_size, GL_UNSIGNED_INT, 0);
+}
+
+void ModelContainer::DrawIndirect(GLintptr command_offset) {
+    StatsDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)command_offset, EBO_size);
+}
+
+void ModelContainer::MultiDrawElements(const GLsizei* counts, const void* const* offsets, GLsizei draw_count) {
+    StatsMultiDrawElements(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets, draw_count);
+}
+
+void ModelContainer::MultiDrawIndirect(GLintptr command_offset, GLsizei draw_count, GLsizei index_count) {
+    StatsMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)command_offset, draw_count, index_count);
+}
 
+void ModelContainer::SetObjectIndexBuffer(GLuint location, GLuint buffer) {
     glBindVertexArray(VAO);
-    if (stencil_id != 0) glStencilFunc(GL_ALWAYS, stencil_id, -1);
-    glDrawElements(GL_TRIANGLES, EBO_size, GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glVertexAttribIPointer(location, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+    glVertexAttribDivisor(location, 1);
+    glEnableVertexAttribArray(location);
     glBindVertexArray(0);
-    if (stencil_id != 0) glDisable(GL_STENCIL_TEST);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+const std::vector<MeshCluster>& ModelContainer::GetClusters() const {
+    return clusters;
+}
+
+GLuint ModelContainer::GetIndexCount() const {
+    return EBO_size;
+}
+
+bool ModelContainer::IsAnimated() const {
+    return transform_model;
+}
+
+bool ModelContainer::IsGlass() const {
+    return glass_mode;
+}
+
+void ModelContainer::Update(float dt) {
+    if (transform_model) time += dt;
+}
+
+float ModelContainer::GetTime() const {
+    return time;
+}
+
+const glm::vec4& ModelContainer::GetBoundingSphere() const {
+    return bounding_sphere;
+}
+
+void ModelContainer::SetBoundingSphere(const glm::vec4& sphere) {
+    bounding_sphere = sphere;
+}
+
+const BoundingBox& ModelContainer::GetBoundingBox() const {
+    return bounding_box;
+}
+
+void ModelContainer::SetBoundingBox(const BoundingBox& box) {
+    bounding_box = box;
+}
+
+const MeshBVH& ModelContainer::GetBVH() const {
+    return bvh;
 }
 
-void ModelContainer::SetStencilId(const GLbyte& _stencil_id) {
-    stencil_id = _stencil_id;
+void ModelContainer::SetBVH(const MeshBVH& _bvh) {
+    bvh = _bvh;
 }
 
 void ModelContainer::SetShaderProgram(GLuint shader_program) {
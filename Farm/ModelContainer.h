@@ -13,22 +13,66 @@
 #include "ShaderContainer.h"
 #include "LightSourses.h"
 #include "CameraContainer.h"
+#include "culling.h"
+#include "raycast.h"
+#include "mesh_clusters.h"
+#include "uniform_blocks.h"
+
+#include <vector>
 
 class ModelContainer 
 {
 public: 
+	/// <summary>
+	/// Defines information about one vertex
+	/// </summary>
+	struct Vertex {
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 tex_coords;
+	};
+	/// <summary>
+	/// Geometry of the model file, read without OpenGL
+	/// </summary>
+	struct MeshData {
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		/// <summary>
+		/// Hierarchy of the triangles for ray casting
+		/// </summary>
+		MeshBVH bvh;
+		/// <summary>
+		/// Clusters of the triangles, indices are ordered by them
+		/// </summary>
+		std::vector<MeshCluster> clusters;
+	};
+
 	/// Destructor
 	~ModelContainer();
 	/// <summary>
+	/// Reads geometry from the model file. Does not use OpenGL, so it can be called from any thread
+	/// </summary>
+	/// <param name="path">Path to model in file system</param>
+	/// <param name="mesh">Returned geometry</param>
+	/// <returns>Returns true if reading was succesful. Otherwise returns false</returns>
+	static bool LoadMeshData(const char* path, MeshData& mesh);
+	/// <summary>
+	/// Initialize model from already read geometry
+	/// </summary>
+	/// <param name="mesh">Geometry of the model</param>
+	/// <param name="shader_program"></param>
+	/// <param name="transform_model">Allows to change model geometry in vertex shader</param>
+	/// <param name="glass_mode">Makes the object transparent</param>
+	void CreateModel(const MeshData& mesh, const GLuint& shader_program, const bool& transform_model = false, const bool& glass_mode = false);
+	/// <summary>
 	/// Initialize model
 	/// </summary>
 	/// <param name="path">Path to model in file system</param>
 	/// <param name="shader_program"></param>
-	/// <param name="stencil_id">Model id</param>
 	/// <param name="transform_model">Allows to change model geometry in vertex shader</param>
 	/// <param name="glass_mode">Makes the object transparent</param>
 	/// <returns>Returns true if loading was succesful. Otherwise returns false</returns>
-	bool CreateModel(const char* path, const GLuint& shader_program, const GLbyte& stencil_id = 0, const bool& transform_model = false, const bool& glass_mode = false);
+	bool CreateModel(const char* path, const GLuint& shader_program, const bool& transform_model = false, const bool& glass_mode = false);
 	/// <summary>
 	/// Sets model material
 	/// </summary>
@@ -75,32 +119,110 @@ public:
 	/// <param name="texture"></param>
 	void SetFogTexture(GLuint texture);
 	/// <summary>
-	/// Sets model id
+	/// Fills uniform block of one drawn object
 	/// </summary>
-	/// <param name="_stencil_id"></param>
-	void SetStencilId(const GLbyte& _stencil_id);
+	/// <param name="block">Returned block</param>
+	/// <param name="modelMatrix"></param>
+	/// <param name="animation_time">Animation time recorded with GetTime, model itself can be already updated by the simulation</param>
+	/// <param name="object_id">Value written into the object ID buffer</param>
+	void WriteObjectBlock(ObjectBlock& block, const glm::mat4& modelMatrix, float animation_time, GLuint object_id) const;
 	/// <summary>
-	/// Draw model on the scene
+	/// Draw model on the scene. Camera, lights and object blocks have to be already bound
 	/// </summary>
-	/// <param name="modelMatrix"></param>
-	/// <param name="viewMatrix"></param>
-	/// <param name="projectionMatrix"></param>
-	/// <param name="direct">Direct light data</param>
-	/// <param name="point">Point light data</param>
-	/// <param name="slot">Spot light data</param>
-	/// <param name="camera">Camera data</param>
-	/// <param name="dt">Delta time</param>
-	/// <param name="fog_enabled">Draw fog texture on the model if fog is enabled</param>
-	void Draw(const glm::mat4& modelMatrix, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, DirectLight direct, PointLight point, SpotLight spot, Camera camera, float dt, bool fog_enabled);
-private:
+	void Draw();
 	/// <summary>
-	/// Defines information about one vertex
+	/// Binds program, textures and VAO of the model, so it can be drawn several times with DrawElements or DrawIndirect.
+	/// Blending is set by the pass
 	/// </summary>
-	struct Vertex {
-		glm::vec3 position;
-		glm::vec3 normal;
-		glm::vec2 tex_coords;
-	};
+	void Bind();
+	/// <summary>
+	/// Binds textures and VAO of the model with another program. Program has to use the attribute locations of the model program
+	/// </summary>
+	/// <param name="program">Program which draws the model</param>
+	void Bind(GLuint program);
+	/// <summary>
+	/// Draws bound model
+	/// </summary>
+	void DrawElements();
+	/// <summary>
+	/// Draws bound model with the command from the bound GL_DRAW_INDIRECT_BUFFER
+	/// </summary>
+	/// <param name="command_offset">Offset of the command in the buffer</param>
+	void DrawIndirect(GLintptr command_offset);
+	/// <summary>
+	/// Returns number of indices of the model
+	/// </summary>
+	GLuint GetIndexCount() const;
+	/// <summary>
+	/// Draws bound model with several index ranges in one call
+	/// </summary>
+	/// <param name="counts">Number of indices of every range</param>
+	/// <param name="offsets">Byte offset of every range in the index buffer</param>
+	/// <param name="draw_count">Number of ranges</param>
+	void MultiDrawElements(const GLsizei* counts, const void* const* offsets, GLsizei draw_count);
+	/// <summary>
+	/// Draws bound model with several commands from the bound GL_DRAW_INDIRECT_BUFFER in one call
+	/// </summary>
+	/// <param name="command_offset">Offset of the first command in the buffer</param>
+	/// <param name="draw_count">Number of commands</param>
+	/// <param name="index_count">Number of indices of all commands, counted by the render stats</param>
+	void MultiDrawIndirect(GLintptr command_offset, GLsizei draw_count, GLsizei index_count);
+	/// <summary>
+	/// Adds instanced attribute with object indices to the VAO of the model. Base instance of the draw command selects
+	/// the index, so every command of one multi-draw call can draw another object
+	/// </summary>
+	/// <param name="location">Attribute location of the index in the drawing program</param>
+	/// <param name="buffer">Buffer of GLuint indices</param>
+	void SetObjectIndexBuffer(GLuint location, GLuint buffer);
+	/// <summary>
+	/// Returns clusters of the model triangles. Empty for models with geometry set by SetVAO
+	/// </summary>
+	const std::vector<MeshCluster>& GetClusters() const;
+	/// <summary>
+	/// Returns true if the model geometry changes with time, so its objects cannot be cached between frames
+	/// </summary>
+	bool IsAnimated() const;
+	/// <summary>
+	/// Returns true if the model is transparent glass, it is drawn by the transparent pass instead of the objects pass
+	/// </summary>
+	bool IsGlass() const;
+	/// <summary>
+	/// Advances model animation by one simulation step
+	/// </summary>
+	/// <param name="dt">Simulation step in seconds</param>
+	void Update(float dt);
+	/// <summary>
+	/// Returns animation time of the model
+	/// </summary>
+	float GetTime() const;
+	/// <summary>
+	/// Returns bounding sphere of the model (x, y, z - center, w - radius)
+	/// </summary>
+	const glm::vec4& GetBoundingSphere() const;
+	/// <summary>
+	/// Sets bounding sphere of the model. Needed for models with geometry set by SetVAO
+	/// </summary>
+	/// <param name="sphere"></param>
+	void SetBoundingSphere(const glm::vec4& sphere);
+	/// <summary>
+	/// Returns axis aligned bounding box of the model
+	/// </summary>
+	const BoundingBox& GetBoundingBox() const;
+	/// <summary>
+	/// Sets bounding box of the model. Needed for models with geometry set by SetVAO
+	/// </summary>
+	/// <param name="box"></param>
+	void SetBoundingBox(const BoundingBox& box);
+	/// <summary>
+	/// Returns hierarchy of the model triangles for ray casting
+	/// </summary>
+	const MeshBVH& GetBVH() const;
+	/// <summary>
+	/// Sets hierarchy of the model triangles. Needed for models with geometry set by SetVAO
+	/// </summary>
+	/// <param name="bvh"></param>
+	void SetBVH(const MeshBVH& bvh);
+private:
 	/// <summary>
 	/// Defines models material
 	/// </summary>
@@ -115,10 +237,14 @@ private:
 	Material material;
 	GLuint fog_texture;
 	ShaderContainer shader;
-	GLbyte stencil_id;
-	bool transform_model;
-	bool glass_mode;
+	// models with geometry set by SetVAO are never animated or glass
+	bool transform_model = false;
+	bool glass_mode = false;
 	float time;
+	glm::vec4 bounding_sphere;
+	BoundingBox bounding_box;
+	MeshBVH bvh;
+	std::vector<MeshCluster> clusters;
 };
 
 #endif
\ No newline at end of file
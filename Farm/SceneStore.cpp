@@ -0,0 +1,361 @@
+#include "SceneStore.h"
+#include "job_system.h"
+#include "simd_kernels.h"
+
+static const GLuint INVALID_INDEX = 0xFFFFFFFF;
+/// <summary>
+/// Number of root subtrees updated by one job
+/// </summary>
+static const GLuint UPDATE_BATCH_SIZE = 256;
+
+glm::quat AxisAngleToQuat(const glm::vec4& rotation)
+{
+	glm::vec3 axis = glm::vec3(rotation);
+	if (rotation.w == 0.0f || glm::dot(axis, axis) == 0.0f) return glm::quat();
+	return glm::angleAxis(glm::radians(rotation.w), glm::normalize(axis));
+}
+
+void SceneStore::Reserve(GLuint count)
+{
+	positions.reserve(count);
+	rotations.reserve(count);
+	scales.reserve(count);
+	world_matrices.reserve(count);
+	model_ids.reserve(count);
+	flags.reserve(count);
+	parents.reserve(count);
+	subtree_ends.reserve(count);
+	index_to_slot.reserve(count);
+	slot_to_index.reserve(count);
+	slot_generations.reserve(count);
+}
+
+ObjectHandle SceneStore::Add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, GLuint model_id, ObjectHandle parent)
+{
+	GLuint parent_index = IsValid(parent) ? GetIndex(parent) : NO_PARENT;
+	GLuint index = parent_index == NO_PARENT ? (GLuint)positions.size() : subtree_ends[parent_index];
+
+	ShiftTail(index, 1, parent_index);
+	positions[index] = position;
+	rotations[index] = rotation;
+	scales[index] = scale;
+	model_ids[index] = model_id;
+	flags[index] = OBJECT_VISIBLE;
+	parents[index] = parent_index;
+	subtree_ends[index] = index + 1;
+
+	GLuint slot;
+	if (!free_slots.empty()) {
+		slot = free_slots.back();
+		free_slots.pop_back();
+		slot_to_index[slot] = index;
+	}
+	else {
+		slot = (GLuint)slot_to_index.size();
+		slot_to_index.push_back(index);
+		slot_generations.push_back(0);
+	}
+	index_to_slot[index] = slot;
+	MarkDirty(index);
+
+	ObjectHandle handle;
+	handle.slot = slot;
+	handle.generation = slot_generations[slot];
+	return handle;
+}
+
+ObjectHandle SceneStore::Append(GLuint count, const glm::vec3* _positions, const glm::vec4* _rotations, const glm::vec3* _scales, const GLuint* _model_ids, const GLuint* _parents)
+{
+	GLuint first = (GLuint)positions.size();
+	GLuint first_slot = (GLuint)slot_to_index.size();
+
+	// depth-first position of every given object: subtree sizes are summed from the last object
+	// to the first one, then every object takes place right after the previous sibling subtree
+	std::vector<GLuint> order(count), sizes(count, 1), cursors(count);
+	if (_parents != nullptr)
+		for (GLuint i = count; i-- > 0; )
+			if (_parents[i] < i) sizes[_parents[i]] += sizes[i];
+	GLuint roots_cursor = first;
+	for (GLuint i = 0; i < count; i++) {
+		bool has_parent = _parents != nullptr && _parents[i] < i;
+		GLuint& cursor = has_parent ? cursors[_parents[i]] : roots_cursor;
+		order[i] = cursor;
+		cursor += sizes[i];
+		cursors[i] = order[i] + 1;
+	}
+
+	GLuint total = first + count;
+	positions.resize(total);
+	rotations.resize(total);
+	scales.resize(total);
+	world_matrices.resize(total);
+	model_ids.resize(total);
+	flags.resize(total, OBJECT_VISIBLE | OBJECT_DIRTY);
+	parents.resize(total);
+	subtree_ends.resize(total);
+	index_to_slot.resize(total);
+	slot_to_index.resize(first_slot + count);
+	slot_generations.resize(first_slot + count, 0);
+	for (GLuint i = 0; i < count; i++)
+	{
+		GLuint index = order[i];
+		positions[index] = _positions[i];
+		rotations[index] = AxisAngleToQuat(_rotations[i]);
+		scales[index] = _scales[i];
+		model_ids[index] = _model_ids[i];
+		parents[index] = _parents != nullptr && _parents[i] < i ? order[_parents[i]] : NO_PARENT;
+		subtree_ends[index] = index + sizes[i];
+		index_to_slot[index] = first_slot + i;
+		slot_to_index[first_slot + i] = index;
+	}
+	any_dirty = any_dirty || count != 0;
+	version++;
+
+	ObjectHandle handle;
+	handle.slot = first_slot;
+	return handle;
+}
+
+void SceneStore::Remove(ObjectHandle handle)
+{
+	if (!IsValid(handle)) return;
+
+	GLuint index = slot_to_index[handle.slot];
+	GLuint end = subtree_ends[index];
+	for (GLuint i = index; i < end; i++) {
+		GLuint slot = index_to_slot[i];
+		slot_to_index[slot] = INVALID_INDEX;
+		slot_generations[slot]++;
+		free_slots.push_back(slot);
+	}
+	ShiftTail(end, -(int)(end - index), parents[index]);
+}
+
+void SceneStore::ShiftTail(GLuint index, int offset, GLuint parent)
+{
+	GLuint count = (GLuint)positions.size();
+	if (offset > 0) {
+		positions.insert(positions.begin() + index, offset, glm::vec3());
+		rotations.insert(rotations.begin() + index, offset, glm::quat());
+		scales.insert(scales.begin() + index, offset, glm::vec3());
+		world_matrices.insert(world_matrices.begin() + index, offset, glm::mat4());
+		model_ids.insert(model_ids.begin() + index, offset, 0);
+		flags.insert(flags.begin() + index, offset, 0);
+		parents.insert(parents.begin() + index, offset, NO_PARENT);
+		subtree_ends.insert(subtree_ends.begin() + index, offset, 0);
+		index_to_slot.insert(index_to_slot.begin() + index, offset, 0);
+	}
+	else if (offset < 0) {
+		GLuint begin = index + offset;
+		positions.erase(positions.begin() + begin, positions.begin() + index);
+		rotations.erase(rotations.begin() + begin, rotations.begin() + index);
+		scales.erase(scales.begin() + begin, scales.begin() + index);
+		world_matrices.erase(world_matrices.begin() + begin, world_matrices.begin() + index);
+		model_ids.erase(model_ids.begin() + begin, model_ids.begin() + index);
+		flags.erase(flags.begin() + begin, flags.begin() + index);
+		parents.erase(parents.begin() + begin, parents.begin() + index);
+		subtree_ends.erase(subtree_ends.begin() + begin, subtree_ends.begin() + index);
+		index_to_slot.erase(index_to_slot.begin() + begin, index_to_slot.begin() + index);
+	}
+	else return;
+	version++;
+
+	// objects before "index" keep their place, only subtrees of the ancestors grow or shrink
+	for (GLuint i = parent; i != NO_PARENT; i = parents[i])
+		subtree_ends[i] += offset;
+	for (GLuint i = index + offset; i < count + offset; i++) {
+		if (parents[i] != NO_PARENT && parents[i] >= index) parents[i] += offset;
+		subtree_ends[i] += offset;
+		slot_to_index[index_to_slot[i]] = i;
+	}
+}
+
+void SceneStore::Clear()
+{
+	positions.clear();
+	rotations.clear();
+	scales.clear();
+	world_matrices.clear();
+	model_ids.clear();
+	flags.clear();
+	parents.clear();
+	subtree_ends.clear();
+	index_to_slot.clear();
+	slot_to_index.clear();
+	slot_generations.clear();
+	free_slots.clear();
+	any_dirty = false;
+	version++;
+}
+
+bool SceneStore::IsValid(ObjectHandle handle) const
+{
+	return handle.slot < slot_to_index.size() &&
+		slot_to_index[handle.slot] != INVALID_INDEX &&
+		slot_generations[handle.slot] == handle.generation;
+}
+
+GLuint SceneStore::GetIndex(ObjectHandle handle) const
+{
+	return slot_to_index[handle.slot];
+}
+
+ObjectHandle SceneStore::GetHandle(GLuint index) const
+{
+	ObjectHandle handle;
+	handle.slot = index_to_slot[index];
+	handle.generation = slot_generations[handle.slot];
+	return handle;
+}
+
+void SceneStore::MarkDirty(GLuint index)
+{
+	flags[index] |= OBJECT_DIRTY;
+	version++;
+	// ancestors which already know about changed child have told it to their ancestors too
+	for (GLuint i = parents[index]; i != NO_PARENT && (flags[i] & OBJECT_CHILD_DIRTY) == 0; i = parents[i])
+		flags[i] |= OBJECT_CHILD_DIRTY;
+	any_dirty = true;
+}
+
+void SceneStore::SetPosition(ObjectHandle handle, const glm::vec3& position)
+{
+	GLuint index = GetIndex(handle);
+	positions[index] = position;
+	MarkDirty(index);
+}
+
+void SceneStore::SetRotation(ObjectHandle handle, const glm::quat& rotation)
+{
+	GLuint index = GetIndex(handle);
+	rotations[index] = rotation;
+	MarkDirty(index);
+}
+
+void SceneStore::SetScale(ObjectHandle handle, const glm::vec3& scale)
+{
+	GLuint index = GetIndex(handle);
+	scales[index] = scale;
+	MarkDirty(index);
+}
+
+void SceneStore::SetVisible(ObjectHandle handle, bool visible)
+{
+	GLuint index = GetIndex(handle);
+	if (visible) flags[index] |= OBJECT_VISIBLE;
+	else flags[index] &= ~OBJECT_VISIBLE;
+	version++;
+}
+
+glm::vec3 SceneStore::GetWorldPosition(ObjectHandle handle) const
+{
+	return glm::vec3(world_matrices[GetIndex(handle)][3]);
+}
+
+void SceneStore::UpdateWorldMatrices()
+{
+	if (!any_dirty) return;
+
+	// subtrees of different roots do not depend on each other, so they are updated in parallel
+	GLuint count = (GLuint)positions.size();
+	roots.clear();
+	for (GLuint i = 0; i < count; i = subtree_ends[i])
+		if (flags[i] & (OBJECT_DIRTY | OBJECT_CHILD_DIRTY)) roots.push_back(i);
+	ParallelFor((GLuint)roots.size(), UPDATE_BATCH_SIZE, [this](GLuint begin, GLuint end) {
+		// neighbouring changed subtrees are rebuilt as one range, so matrices are composed in long SIMD batches
+		GLuint range_begin = 0;
+		GLuint range_end = 0;
+		for (GLuint i = begin; i < end; i++) {
+			GLuint root = roots[i];
+			if (flags[root] & OBJECT_DIRTY) {
+				if (root != range_end) {
+					UpdateRange(range_begin, range_end);
+					range_begin = root;
+				}
+				range_end = subtree_ends[root];
+			}
+			else UpdateSubtree(root);
+		}
+		UpdateRange(range_begin, range_end);
+	});
+	any_dirty = false;
+}
+
+void SceneStore::UpdateSubtree(GLuint root)
+{
+	GLuint count = subtree_ends[root];
+	GLuint i = root;
+	while (i < count)
+	{
+		if (flags[i] & OBJECT_DIRTY) {
+			UpdateRange(i, subtree_ends[i]);
+			i = subtree_ends[i];
+		}
+		else if (flags[i] & OBJECT_CHILD_DIRTY) {
+			flags[i] &= ~OBJECT_CHILD_DIRTY;
+			i++;
+		}
+		else i = subtree_ends[i];
+	}
+}
+
+void SceneStore::UpdateRange(GLuint begin, GLuint end)
+{
+	if (begin == end) return;
+	// local matrices are composed in place, parents stand before children, so their world matrices are ready
+	ComposeMatrices(end - begin, &positions[begin], &rotations[begin], &scales[begin], &world_matrices[begin]);
+	for (GLuint i = begin; i < end; i++) {
+		if (parents[i] != NO_PARENT) world_matrices[i] = world_matrices[parents[i]] * world_matrices[i];
+		flags[i] &= ~(OBJECT_DIRTY | OBJECT_CHILD_DIRTY);
+	}
+}
+
+GLuint SceneStore::Size() const
+{
+	return (GLuint)positions.size();
+}
+
+GLuint SceneStore::GetVersion() const
+{
+	return version;
+}
+
+const glm::vec3* SceneStore::GetPositions() const
+{
+	return positions.data();
+}
+
+const glm::quat* SceneStore::GetRotations() const
+{
+	return rotations.data();
+}
+
+const glm::vec3* SceneStore::GetScales() const
+{
+	return scales.data();
+}
+
+const glm::mat4* SceneStore::GetWorldMatrices() const
+{
+	return world_matrices.data();
+}
+
+const GLuint* SceneStore::GetModelIds() const
+{
+	return model_ids.data();
+}
+
+const GLuint* SceneStore::GetFlags() const
+{
+	return flags.data();
+}
+
+const GLuint* SceneStore::GetParents() const
+{
+	return parents.data();
+}
+
+const GLuint* SceneStore::GetSubtreeEnds() const
+{
+	return subtree_ends.data();
+}
@@ -0,0 +1,210 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       SceneStore.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines class which contains all objects of the scene as separate contiguous arrays
+ *
+ * Objects are kept in depth-first order: every parent stands before its children and
+ * the whole subtree of an object is one contiguous range of the arrays.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef SCENE_STORE_H
+#define SCENE_STORE_H
+
+#include <vector>
+
+#include "pgr.h"
+#include "glm/gtc/quaternion.hpp"
+
+/// <summary>
+/// Stable reference to the object. Stays valid when other objects are added or removed
+/// </summary>
+struct ObjectHandle {
+	GLuint slot = 0xFFFFFFFF;
+	GLuint generation = 0;
+};
+
+/// <summary>
+/// Object flags
+/// </summary>
+enum ObjectFlags {
+	OBJECT_VISIBLE = 1,
+	OBJECT_DIRTY = 2,
+	OBJECT_CHILD_DIRTY = 4
+};
+
+/// <summary>
+/// Index of the parent of root objects
+/// </summary>
+const GLuint NO_PARENT = 0xFFFFFFFF;
+
+/// <summary>
+/// Objects of the scene with their hierarchy. Every property is a separate array indexed by the object index,
+/// which changes when objects are added or removed, handles stay the same
+/// </summary>
+class SceneStore
+{
+public:
+	/// <summary>
+	/// Reserves memory for given number of objects
+	/// </summary>
+	/// <param name="count">Number of objects</param>
+	void Reserve(GLuint count);
+	/// <summary>
+	/// Adds new object to the scene. Root objects are added to the end, children are inserted after the subtree of the parent
+	/// </summary>
+	/// <param name="position">Object position relative to the parent</param>
+	/// <param name="rotation">Object rotation relative to the parent</param>
+	/// <param name="scale">Object scale relative to the parent</param>
+	/// <param name="model_id">Index of the model in models buffer</param>
+	/// <param name="parent">Parent object. Invalid handle makes root object</param>
+	/// <returns>Returns handle of the new object</returns>
+	ObjectHandle Add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, GLuint model_id, ObjectHandle parent = ObjectHandle());
+	/// <summary>
+	/// Adds many objects at once. Rotations are given as axis and angle in degrees (like in configure file).
+	/// Handle of i-th object has slot "first slot + i", so objects can be found in the order they were given
+	/// </summary>
+	/// <param name="count">Number of objects</param>
+	/// <param name="positions">Array of positions</param>
+	/// <param name="rotations">Array of rotations (x, y, z - axis, w - angle)</param>
+	/// <param name="scales">Array of scales</param>
+	/// <param name="model_ids">Array of model indeces</param>
+	/// <param name="parents">Array of parent indeces in given arrays. Parent has to be given before its children. Can be null</param>
+	/// <returns>Returns handle of the first added object</returns>
+	ObjectHandle Append(GLuint count, const glm::vec3* positions, const glm::vec4* rotations, const glm::vec3* scales, const GLuint* model_ids, const GLuint* parents = nullptr);
+	/// <summary>
+	/// Removes object with all its children from the scene
+	/// </summary>
+	/// <param name="handle">Handle of the removed object</param>
+	void Remove(ObjectHandle handle);
+	/// <summary>
+	/// Removes all objects
+	/// </summary>
+	void Clear();
+	/// <summary>
+	/// Returns true if object of the handle was not removed
+	/// </summary>
+	/// <param name="handle">Handle of the object</param>
+	bool IsValid(ObjectHandle handle) const;
+	/// <summary>
+	/// Returns index of the object in arrays
+	/// </summary>
+	/// <param name="handle">Valid handle of the object</param>
+	GLuint GetIndex(ObjectHandle handle) const;
+	/// <summary>
+	/// Returns handle of the object with given index in arrays
+	/// </summary>
+	/// <param name="index">Index of the object, less than Size()</param>
+	ObjectHandle GetHandle(GLuint index) const;
+	/// <summary>
+	/// Sets new object position
+	/// </summary>
+	/// <param name="handle">Handle of the object</param>
+	/// <param name="position">New position relative to the parent</param>
+	void SetPosition(ObjectHandle handle, const glm::vec3& position);
+	/// <summary>
+	/// Sets new object rotation
+	/// </summary>
+	/// <param name="handle">Handle of the object</param>
+	/// <param name="rotation">New rotation relative to the parent</param>
+	void SetRotation(ObjectHandle handle, const glm::quat& rotation);
+	/// <summary>
+	/// Sets new object scale
+	/// </summary>
+	/// <param name="handle">Handle of the object</param>
+	/// <param name="scale">New scale relative to the parent</param>
+	void SetScale(ObjectHandle handle, const glm::vec3& scale);
+	/// <summary>
+	/// Shows or hides object
+	/// </summary>
+	/// <param name="handle">Handle of the object</param>
+	/// <param name="visible">True to show the object, false to hide it</param>
+	void SetVisible(ObjectHandle handle, bool visible);
+	/// <summary>
+	/// Returns object position in world space. Valid after UpdateWorldMatrices
+	/// </summary>
+	/// <param name="handle">Handle of the object</param>
+	glm::vec3 GetWorldPosition(ObjectHandle handle) const;
+	/// <summary>
+	/// Rebuilds world matrices of all changed objects and their children. Unchanged subtrees are skipped,
+	/// subtrees of different roots are updated in parallel
+	/// </summary>
+	void UpdateWorldMatrices();
+	/// <summary>
+	/// Returns number of objects
+	/// </summary>
+	GLuint Size() const;
+	/// <summary>
+	/// Returns number of changes of the scene: added, removed, moved, shown or hidden objects.
+	/// Results computed from the scene can be reused while the version stays the same
+	/// </summary>
+	GLuint GetVersion() const;
+
+	const glm::vec3* GetPositions() const;
+	const glm::quat* GetRotations() const;
+	const glm::vec3* GetScales() const;
+	const glm::mat4* GetWorldMatrices() const;
+	const GLuint* GetModelIds() const;
+	const GLuint* GetFlags() const;
+	const GLuint* GetParents() const;
+	const GLuint* GetSubtreeEnds() const;
+private:
+	/// <summary>
+	/// Marks object as changed and tells its ancestors that they have changed child
+	/// </summary>
+	void MarkDirty(GLuint index);
+	/// <summary>
+	/// Rebuilds changed world matrices of one root subtree
+	/// </summary>
+	void UpdateSubtree(GLuint root);
+	/// <summary>
+	/// Rebuilds world matrices of all objects from begin to end. Range has to consist of whole subtrees
+	/// </summary>
+	void UpdateRange(GLuint begin, GLuint end);
+	/// <summary>
+	/// Moves objects from "index" to the end of arrays by "offset" places. Offset can be negative.
+	/// Subtrees of "parent" and all its ancestors grow (shrink) by the offset
+	/// </summary>
+	void ShiftTail(GLuint index, int offset, GLuint parent);
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<glm::mat4> world_matrices;
+	std::vector<GLuint> model_ids;
+	std::vector<GLuint> flags;
+	std::vector<GLuint> parents;
+	/// <summary>
+	/// Index after the last descendant of every object
+	/// </summary>
+	std::vector<GLuint> subtree_ends;
+
+	/// <summary>
+	/// Handle slot of every object in arrays
+	/// </summary>
+	std::vector<GLuint> index_to_slot;
+	/// <summary>
+	/// Index in arrays and generation of every handle slot
+	/// </summary>
+	std::vector<GLuint> slot_to_index;
+	std::vector<GLuint> slot_generations;
+	std::vector<GLuint> free_slots;
+	/// <summary>
+	/// Changed root subtrees found by the last update
+	/// </summary>
+	std::vector<GLuint> roots;
+	/// <summary>
+	/// True if at least one object has OBJECT_DIRTY flag
+	/// </summary>
+	bool any_dirty = false;
+	GLuint version = 0;
+};
+
+/// <summary>
+/// Converts rotation from axis and angle in degrees to quaternion
+/// </summary>
+/// <param name="rotation">x, y, z - axis, w - angle</param>
+glm::quat AxisAngleToQuat(const glm::vec4& rotation);
+
+#endif // !SCENE_STORE_H
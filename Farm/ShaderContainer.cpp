@@ -1,5 +1,6 @@
 #include<iostream>
 #include "ShaderContainer.h"
+#include "render_stats.h"
 
 ShaderContainer::ShaderContainer() : shader_program(0) {}
 
@@ -29,7 +30,7 @@ void ShaderContainer::SetProgram(const GLuint& program) {
 }
 
 void ShaderContainer::UseProgram(){
-	glUseProgram(shader_program);
+	StatsUseProgram(shader_program);
 }
 
 void ShaderContainer::CreateProgram(const GLuint* shaders) {
@@ -1,20 +1,32 @@
 #version 330 core
 
-out vec4 color;
+// weighted blended transparency outputs, see transparency_weight.glsl
+layout(location = 0) out vec4 accumulation;
+layout(location = 1) out vec4 weight;
 
 in vec2 TexCoords;
 in vec2 FogTexCoords;
 in vec3 FragPos;
 
+layout(std140) uniform CameraBlock {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 viewPos;
+    bool fog;
+};
+
 uniform sampler2D tex;
-uniform vec3 viewPos;
 uniform sampler2D fog_tex;
-uniform bool fog;
+
+// weight of the fragment in the average color, defined in transparency_weight.glsl
+float GetWeight(float alpha, float distance);
 
 void main() {
     vec4 output_color = texture(tex, TexCoords);
     if (output_color.a == 0.0f) discard;
     if (fog) 
         output_color = vec4(mix(vec3(output_color), vec3(texture(fog_tex, FogTexCoords)), min(length(FragPos - viewPos), 10) / 10), output_color.a);
-    color = output_color;
+    float fragment_weight = GetWeight(output_color.a, length(FragPos - viewPos));
+    accumulation = vec4(output_color.rgb * output_color.a * fragment_weight, output_color.a);
+    weight = vec4(output_color.a * fragment_weight);
 };
\ No newline at end of file
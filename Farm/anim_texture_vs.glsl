@@ -7,24 +7,36 @@ out vec2 TexCoords;
 out vec2 FogTexCoords;
 out vec3 FragPos;
 
-uniform mat4 projectionMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 modelMatrix;
-uniform int size_x;
-uniform int size_y;
-uniform float offset_x;
-uniform float offset_y;
-uniform int index;
+layout(std140) uniform CameraBlock {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 viewPos;
+    bool fog;
+};
+
+struct Sprite {
+    mat4 modelMatrix;
+    int size_x;
+    int size_y;
+    int index;
+};
+// one instance for every sprite of the batch, size is MAX_SPRITE_BATCH
+layout(std140) uniform SpriteBlock {
+    Sprite sprites[128];
+};
 
 void main() {
-    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(position, 1.0f);
+    Sprite sprite = sprites[gl_InstanceID];
+    gl_Position = projectionMatrix * viewMatrix * sprite.modelMatrix * vec4(position, 1.0f);
     vec3 ndcSpacePos;
     if (gl_Position.w != 0)
         ndcSpacePos = gl_Position.xyz / gl_Position.w;
     FogTexCoords = (ndcSpacePos.xy + 1.0f) / 2.0f;
-    FragPos = vec3(modelMatrix * vec4(position, 1.0));
-    float tex_x = ((index % size_x) * offset_x) + (texCoords.x * offset_x);
-    float tex_y = (((index / size_x) % size_y) * offset_y) + (texCoords.y * offset_y);
+    FragPos = vec3(sprite.modelMatrix * vec4(position, 1.0));
+    float offset_x = 1.0f / sprite.size_x;
+    float offset_y = 1.0f / sprite.size_y;
+    float tex_x = ((sprite.index % sprite.size_x) * offset_x) + (texCoords.x * offset_x);
+    float tex_y = (((sprite.index / sprite.size_x) % sprite.size_y) * offset_y) + (texCoords.y * offset_y);
 
     TexCoords = vec2(tex_x, tex_y);
-};
\ No newline at end of file
+};
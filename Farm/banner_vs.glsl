@@ -7,10 +7,16 @@ out vec2 TexCoords;
 out vec2 FogTexCoords;
 out vec3 FragPos;
 
-uniform mat4 projectionMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 modelMatrix;
-uniform mat4 texModelMatrix;
+layout(std140) uniform CameraBlock {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 viewPos;
+    bool fog;
+};
+layout(std140) uniform BannerBlock {
+    mat4 modelMatrix;
+    mat4 texModelMatrix;
+};
 
 void main() {
     gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(position, 1.0f);
@@ -0,0 +1,592 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <random>
+
+#include "benchmark.h"
+#include "render_stats.h"
+#include "job_system.h"
+#include "culling.h"
+#include "scene_snapshot.h"
+#include "SceneStore.h"
+#include "collision.h"
+#include "raycast.h"
+#include "simd_kernels.h"
+#include "occlusion_culler.h"
+#include "ModelContainer.h"
+
+#ifdef FARM_HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+static EGLDisplay egl_display = EGL_NO_DISPLAY;
+static EGLContext egl_context = EGL_NO_CONTEXT;
+#endif
+
+/// <summary>
+/// Catmull-Rom interpolation between p1 and p2
+/// </summary>
+static glm::vec3 CatmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t)
+{
+	float t2 = t * t;
+	float t3 = t2 * t;
+	return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+Camera GetSplineCamera(const Camera* keyframes, GLuint count, float t)
+{
+	if (count == 1) return keyframes[0];
+
+	float position = (t - std::floor(t)) * count;
+	GLuint segment = (GLuint)position % count;
+	float local_t = position - std::floor(position);
+	const Camera& c0 = keyframes[(segment + count - 1) % count];
+	const Camera& c1 = keyframes[segment];
+	const Camera& c2 = keyframes[(segment + 1) % count];
+	const Camera& c3 = keyframes[(segment + 2) % count];
+
+	Camera camera;
+	camera.position = CatmullRom(c0.position, c1.position, c2.position, c3.position, local_t);
+	camera.direction = glm::normalize(CatmullRom(c0.direction, c1.direction, c2.direction, c3.direction, local_t));
+	camera.camera_up = c1.camera_up;
+	return camera;
+}
+
+bool CreateHeadlessContext()
+{
+#ifdef FARM_HEADLESS_EGL
+	// surfaceless platform does not need any display server, default display is used when it is missing
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (get_platform_display != nullptr)
+		egl_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (egl_display == EGL_NO_DISPLAY)
+		egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, &major, &minor)) {
+		std::cout << "failed to initialize EGL display" << std::endl;
+		return false;
+	}
+
+	const EGLint config_attributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config = nullptr;
+	EGLint configs_count = 0;
+	eglChooseConfig(egl_display, config_attributes, &config, 1, &configs_count);
+
+	const EGLint context_attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, pgr::OGL_VER_MAJOR,
+		EGL_CONTEXT_MINOR_VERSION, pgr::OGL_VER_MINOR,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	eglBindAPI(EGL_OPENGL_API);
+	egl_context = eglCreateContext(egl_display, configs_count > 0 ? config : nullptr, EGL_NO_CONTEXT, context_attributes);
+	if (egl_context == EGL_NO_CONTEXT || !eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl_context)) {
+		std::cout << "failed to create EGL context" << std::endl;
+		DestroyHeadlessContext();
+		return false;
+	}
+	std::cout << "EGL " << major << "." << minor << ": " << glGetString(GL_RENDERER) << std::endl;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void DestroyHeadlessContext()
+{
+#ifdef FARM_HEADLESS_EGL
+	if (egl_display == EGL_NO_DISPLAY) return;
+	eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (egl_context != EGL_NO_CONTEXT) eglDestroyContext(egl_display, egl_context);
+	eglTerminate(egl_display);
+	egl_context = EGL_NO_CONTEXT;
+	egl_display = EGL_NO_DISPLAY;
+#endif
+}
+
+/// <summary>
+/// Returns value of the sorted array below which given part of values lies (nearest rank)
+/// </summary>
+static double GetPercentile(const std::vector<double>& sorted, double part)
+{
+	size_t rank = (size_t)std::ceil(part * sorted.size());
+	return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+/// <summary>
+/// Saves color buffer of currently bound framebuffer as binary PPM image
+/// </summary>
+static bool SaveFramebufferImage(const std::string& path, GLuint width, GLuint height)
+{
+	std::vector<unsigned char> pixels(width * height * 3);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+	std::ofstream ofs(path, std::ios::binary);
+	if (!ofs.is_open()) return false;
+	ofs << "P6\n" << width << " " << height << "\n255\n";
+	// OpenGL rows go from the bottom, image rows go from the top
+	for (GLuint row = height; row-- > 0; )
+		ofs.write((const char*)&pixels[row * width * 3], width * 3);
+	return ofs.good();
+}
+
+static bool WriteBenchmarkReport(const BenchmarkSettings& settings, const BenchmarkResult& result)
+{
+	std::ofstream ofs(settings.output_path + ".txt");
+	if (!ofs.is_open()) return false;
+	ofs << "renderer: " << glGetString(GL_RENDERER) << "\n";
+	ofs << "resolution: " << settings.width << "x" << settings.height << "\n";
+	ofs << "frames: " << result.frames << "\n";
+	ofs << "total_ms: " << result.total_time << "\n";
+	ofs << "fps: " << result.frames * 1000.0 / result.total_time << "\n";
+	ofs << "p50_ms: " << result.p50 << "\n";
+	ofs << "p95_ms: " << result.p95 << "\n";
+	ofs << "p99_ms: " << result.p99 << "\n";
+	ofs << "max_ms: " << result.max << "\n";
+	ofs << "draw_calls_per_frame: " << result.draw_calls_per_frame << "\n";
+	return ofs.good();
+}
+
+bool RunBenchmark(const BenchmarkSettings& settings, const Camera* keyframes, GLuint count, BenchmarkDrawFunc draw_frame, BenchmarkResult& result)
+{
+	if (count == 0 || settings.frames == 0) return false;
+
+	GLuint framebuffer, color_buffer, depth_buffer;
+	glGenRenderbuffers(1, &color_buffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, color_buffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, settings.width, settings.height);
+	glGenRenderbuffers(1, &depth_buffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, settings.width, settings.height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_buffer);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	if (complete) {
+		glViewport(0, 0, settings.width, settings.height);
+
+		std::vector<double> frame_times(settings.frames);
+		GLuint draw_calls = 0;
+		for (GLuint frame = 0; frame < settings.frames; frame++)
+		{
+			Camera camera = GetSplineCamera(keyframes, count, (float)frame / settings.frames);
+			int time = (int)(frame * settings.frame_time * 1000.0f);
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			draw_frame(camera, time, settings.frame_time);
+			// frame is finished only when GPU has done all the work
+			glFinish();
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+			frame_times[frame] = std::chrono::duration<double, std::milli>(end - start).count();
+			draw_calls += GetRenderStats().draw_calls;
+		}
+
+		result.frames = settings.frames;
+		result.total_time = 0.0;
+		for (double time : frame_times) result.total_time += time;
+		std::sort(frame_times.begin(), frame_times.end());
+		result.p50 = GetPercentile(frame_times, 0.50);
+		result.p95 = GetPercentile(frame_times, 0.95);
+		result.p99 = GetPercentile(frame_times, 0.99);
+		result.max = frame_times.back();
+		result.draw_calls_per_frame = (double)draw_calls / settings.frames;
+
+		if (!SaveFramebufferImage(settings.output_path + ".ppm", settings.width, settings.height))
+			std::cout << "failed to save benchmark image: " << settings.output_path << ".ppm" << std::endl;
+		if (!WriteBenchmarkReport(settings, result))
+			std::cout << "failed to save benchmark report: " << settings.output_path << ".txt" << std::endl;
+	}
+	else std::cout << "failed to create benchmark framebuffer" << std::endl;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &color_buffer);
+	glDeleteRenderbuffers(1, &depth_buffer);
+	CHECK_GL_ERROR();
+	return complete;
+}
+
+bool RunJobBenchmark(const std::string& scene_path, GLuint frames, GLuint max_threads)
+{
+	SceneSnapshot snapshot;
+	if (!OpenSceneSnapshot(scene_path, snapshot)) {
+		std::cout << "failed to load scene: " << scene_path << std::endl;
+		return false;
+	}
+	if (max_threads == 0) max_threads = std::max(1u, std::thread::hardware_concurrency());
+	if (frames == 0) frames = 1;
+
+	SceneStore scene;
+	GLuint objects_count = snapshot.GetObjectsCount();
+	scene.Reserve(objects_count);
+	scene.Append(objects_count, snapshot.GetPositions(), snapshot.GetRotations(), snapshot.GetScales(), snapshot.GetModelIds(), snapshot.GetParents());
+
+	// models are not loaded, every model is a unit sphere
+	std::vector<glm::vec4> model_spheres(snapshot.GetModelsCount(), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 20.0f, 60.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(45.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+	Frustum frustum = GetFrustum(projection * view);
+
+	std::vector<GLuint> visible;
+	std::vector<GLuint64> keys;
+	double single_thread_time = 0.0;
+	std::cout << "objects: " << objects_count << ", frames: " << frames << std::endl;
+	for (GLuint threads_count = 1; threads_count <= max_threads; threads_count++)
+	{
+		InitJobSystem(threads_count);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (GLuint frame = 0; frame < frames; frame++)
+		{
+			// every root is changed, so all world matrices are rebuilt
+			const GLuint* parents = scene.GetParents();
+			const glm::quat* rotations = scene.GetRotations();
+			for (GLuint i = 0; i < scene.Size(); i++)
+				if (parents[i] == NO_PARENT) scene.SetRotation(scene.GetHandle(i), rotations[i]);
+			scene.UpdateWorldMatrices();
+
+			CullObjects(frustum, scene.Size(), scene.GetWorldMatrices(), scene.GetModelIds(), scene.GetFlags(), model_spheres.data(), visible);
+			BuildSortKeys(visible, scene.GetWorldMatrices(), scene.GetModelIds(), nullptr, glm::vec3(0.0f, 20.0f, 60.0f), 100.0f, keys);
+			std::sort(keys.begin(), keys.end());
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		double frame_time = std::chrono::duration<double, std::milli>(end - start).count() / frames;
+		if (threads_count == 1) single_thread_time = frame_time;
+		std::cout << "threads: " << threads_count << ", frame: " << frame_time << " ms, speedup: " << single_thread_time / frame_time
+			<< ", visible: " << visible.size() << std::endl;
+	}
+	ShutdownJobSystem();
+	return true;
+}
+
+bool RunCollisionBenchmark(GLuint colliders_count, GLuint queries_count, GLuint seed)
+{
+	// density does not depend on the number of colliders, one collider on 16 square meters
+	std::mt19937 random(seed);
+	float area_size = std::sqrt((float)colliders_count) * 4.0f;
+	std::uniform_real_distribution<float> position(0.0f, area_size);
+	std::uniform_real_distribution<float> size(0.3f, 2.0f);
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+	std::uniform_real_distribution<float> distance(0.0f, 2.0f);
+
+	std::vector<Collider2D> colliders(colliders_count);
+	for (Collider2D& collider : colliders) {
+		collider.min = glm::vec2(position(random), position(random));
+		collider.max = collider.min + glm::vec2(size(random), size(random));
+	}
+	std::vector<glm::vec2> starts(queries_count), targets(queries_count);
+	for (GLuint i = 0; i < queries_count; i++) {
+		float direction = angle(random);
+		starts[i] = glm::vec2(position(random), position(random));
+		targets[i] = starts[i] + glm::vec2(std::cos(direction), std::sin(direction)) * distance(random);
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	ColliderGrid grid;
+	grid.Build(colliders);
+	std::chrono::steady_clock::time_point built = std::chrono::steady_clock::now();
+	std::vector<glm::vec2> results(queries_count);
+	for (GLuint i = 0; i < queries_count; i++)
+		results[i] = grid.Move(starts[i], targets[i], 0.25f);
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	GLuint brute_force_count = std::min(queries_count, 1000u);
+	GLuint mismatches = 0;
+	std::chrono::steady_clock::time_point brute_force_start = std::chrono::steady_clock::now();
+	for (GLuint i = 0; i < brute_force_count; i++)
+		if (glm::length(MoveBruteForce(colliders, starts[i], targets[i], 0.25f) - results[i]) > 0.001f) mismatches++;
+	std::chrono::steady_clock::time_point brute_force_end = std::chrono::steady_clock::now();
+
+	double build_time = std::chrono::duration<double, std::milli>(built - start).count();
+	double grid_time = queries_count > 0 ? std::chrono::duration<double, std::micro>(end - built).count() / queries_count : 0.0;
+	double brute_force_time = brute_force_count > 0 ? std::chrono::duration<double, std::micro>(brute_force_end - brute_force_start).count() / brute_force_count : 0.0;
+	std::cout << "colliders: " << colliders_count << ", build: " << build_time << " ms" << std::endl;
+	std::cout << "spatial hash: " << grid_time << " us per query (" << queries_count << " queries)" << std::endl;
+	std::cout << "brute force: " << brute_force_time << " us per query (" << brute_force_count << " queries)" << std::endl;
+	std::cout << "mismatches: " << mismatches << std::endl;
+	return mismatches == 0;
+}
+
+bool RunPickBenchmark(const std::string& scene_path, GLuint picks_count, GLuint seed)
+{
+	SceneSnapshot snapshot;
+	if (!OpenSceneSnapshot(scene_path, snapshot)) {
+		std::cout << "failed to load scene: " << scene_path << std::endl;
+		return false;
+	}
+
+	std::chrono::steady_clock::time_point load_start = std::chrono::steady_clock::now();
+	std::vector<MeshBVH> bvhs(snapshot.GetModelsCount());
+	std::vector<const MeshBVH*> model_bvhs(snapshot.GetModelsCount());
+	GLuint triangles_count = 0;
+	for (GLuint i = 0; i < snapshot.GetModelsCount(); i++) {
+		// models which cannot be read are not hit by rays
+		ModelContainer::MeshData mesh;
+		if (ModelContainer::LoadMeshData(snapshot.GetModelPath(i), mesh)) {
+			bvhs[i] = mesh.bvh;
+			triangles_count += (GLuint)mesh.indices.size() / 3;
+		}
+		model_bvhs[i] = &bvhs[i];
+	}
+	std::chrono::steady_clock::time_point load_end = std::chrono::steady_clock::now();
+
+	SceneStore scene;
+	GLuint objects_count = snapshot.GetObjectsCount();
+	scene.Reserve(objects_count);
+	scene.Append(objects_count, snapshot.GetPositions(), snapshot.GetRotations(), snapshot.GetScales(), snapshot.GetModelIds(), snapshot.GetParents());
+	scene.UpdateWorldMatrices();
+	std::chrono::steady_clock::time_point build_start = std::chrono::steady_clock::now();
+	SceneRaycaster raycaster;
+	raycaster.Build(objects_count, scene.GetWorldMatrices(), scene.GetModelIds(), scene.GetFlags(), model_bvhs);
+	std::chrono::steady_clock::time_point build_end = std::chrono::steady_clock::now();
+	if (objects_count == 0) {
+		std::cout << "scene has no objects" << std::endl;
+		return false;
+	}
+
+	// rays go from random points above the scene to random objects, so most of them hit something
+	std::mt19937 random(seed);
+	std::uniform_int_distribution<GLuint> object(0, objects_count - 1);
+	std::uniform_real_distribution<float> offset(-30.0f, 30.0f);
+	std::uniform_real_distribution<float> height(1.0f, 20.0f);
+	const glm::mat4* world_matrices = scene.GetWorldMatrices();
+	const GLuint* model_ids = scene.GetModelIds();
+	std::vector<Ray> rays(picks_count);
+	for (Ray& ray : rays) {
+		GLuint target_object = object(random);
+		BoundingBox box = GetWorldBox(world_matrices[target_object], bvhs[model_ids[target_object]].GetBounds());
+		glm::vec3 target = (box.min + box.max) * 0.5f;
+		ray.origin = target + glm::vec3(offset(random), height(random), offset(random));
+		ray.direction = glm::normalize(target - ray.origin);
+	}
+
+	std::vector<RayHit> hits(picks_count);
+	std::vector<bool> found(picks_count);
+	GLuint hits_count = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (GLuint i = 0; i < picks_count; i++) {
+		found[i] = raycaster.Raycast(rays[i], 1000.0f, hits[i]);
+		if (found[i]) hits_count++;
+	}
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	GLuint brute_force_count = std::min(picks_count, 100u);
+	GLuint mismatches = 0;
+	std::chrono::steady_clock::time_point brute_force_start = std::chrono::steady_clock::now();
+	for (GLuint i = 0; i < brute_force_count; i++) {
+		RayHit hit;
+		bool brute_force_found = raycaster.RaycastBruteForce(rays[i], 1000.0f, hit);
+		// objects can differ only when two triangles are hit at the same distance
+		if (brute_force_found != found[i] || (found[i] && std::abs(hit.distance - hits[i].distance) > 0.001f)) mismatches++;
+	}
+	std::chrono::steady_clock::time_point brute_force_end = std::chrono::steady_clock::now();
+
+	double load_time = std::chrono::duration<double, std::milli>(load_end - load_start).count();
+	double build_time = std::chrono::duration<double, std::milli>(build_end - build_start).count();
+	double pick_time = picks_count > 0 ? std::chrono::duration<double, std::micro>(end - start).count() / picks_count : 0.0;
+	double brute_force_time = brute_force_count > 0 ? std::chrono::duration<double, std::micro>(brute_force_end - brute_force_start).count() / brute_force_count : 0.0;
+	std::cout << "objects: " << objects_count << ", model triangles: " << triangles_count << ", models with BVH: " << load_time << " ms" << std::endl;
+	std::cout << "scene BVH: " << build_time << " ms" << std::endl;
+	std::cout << "BVH: " << pick_time << " us per pick (" << picks_count << " picks, " << hits_count << " hits)" << std::endl;
+	std::cout << "brute force: " << brute_force_time << " us per pick (" << brute_force_count << " picks)" << std::endl;
+	std::cout << "mismatches: " << mismatches << std::endl;
+	return mismatches == 0;
+}
+
+/// <summary>
+/// Runs the function given number of times and returns millions of objects per second
+/// </summary>
+template <typename Kernel>
+static double MeasureThroughput(GLuint objects_count, GLuint iterations, Kernel kernel)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (GLuint i = 0; i < iterations; i++) kernel();
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(end - start).count();
+	return seconds > 0.0 ? (double)objects_count * iterations / seconds / 1e6 : 0.0;
+}
+
+bool RunSimdBenchmark(GLuint objects_count, GLuint iterations)
+{
+	if (objects_count == 0) objects_count = 1;
+	if (iterations == 0) iterations = 1;
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> size(0.2f, 3.0f);
+	std::vector<glm::vec3> positions(objects_count), scales(objects_count);
+	std::vector<glm::quat> rotations(objects_count);
+	std::vector<glm::vec4> spheres(objects_count);
+	std::vector<BoundingBox> boxes(objects_count);
+	for (GLuint i = 0; i < objects_count; i++) {
+		positions[i] = glm::vec3(position(random), position(random) * 0.1f, position(random));
+		scales[i] = glm::vec3(size(random), size(random), size(random));
+		rotations[i] = AxisAngleToQuat(glm::vec4(unit(random), unit(random), unit(random), unit(random) * 180.0f));
+		spheres[i] = glm::vec4(positions[i], size(random));
+		boxes[i].min = positions[i] - scales[i];
+		boxes[i].max = positions[i] + scales[i];
+	}
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 20.0f, 60.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(45.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+	Frustum frustum = GetFrustum(projection * view);
+
+	std::vector<glm::mat4> scalar_matrices(objects_count), simd_matrices(objects_count);
+	std::vector<GLuint> scalar_visible(objects_count), simd_visible(objects_count);
+	GLuint scalar_count = 0, simd_count = 0;
+
+	std::cout << "objects: " << objects_count << ", iterations: " << iterations << ", kernels: " << GetSimdName() << std::endl;
+	std::cout << "throughput on one core in millions of objects per second (scalar / SIMD)" << std::endl;
+
+	double scalar = MeasureThroughput(objects_count, iterations, [&] {
+		ComposeMatricesScalar(objects_count, positions.data(), rotations.data(), scales.data(), scalar_matrices.data());
+	});
+	double simd = MeasureThroughput(objects_count, iterations, [&] {
+		ComposeMatrices(objects_count, positions.data(), rotations.data(), scales.data(), simd_matrices.data());
+	});
+	float max_error = 0.0f;
+	for (GLuint i = 0; i < objects_count; i++)
+		for (int column = 0; column < 4; column++)
+			max_error = std::max(max_error, glm::length(scalar_matrices[i][column] - simd_matrices[i][column]));
+	std::cout << "compose matrices: " << scalar << " / " << simd << ", max difference: " << max_error << std::endl;
+	bool success = max_error < 1e-4f;
+
+	scalar = MeasureThroughput(objects_count, iterations, [&] {
+		scalar_count = TestSpheresScalar(frustum, objects_count, spheres.data(), scalar_visible.data());
+	});
+	simd = MeasureThroughput(objects_count, iterations, [&] {
+		simd_count = TestSpheres(frustum, objects_count, spheres.data(), simd_visible.data());
+	});
+	bool same = scalar_count == simd_count && std::equal(scalar_visible.begin(), scalar_visible.begin() + scalar_count, simd_visible.begin());
+	std::cout << "sphere frustum test: " << scalar << " / " << simd << ", visible: " << simd_count << (same ? "" : ", results differ") << std::endl;
+	success = success && same;
+
+	scalar = MeasureThroughput(objects_count, iterations, [&] {
+		scalar_count = TestBoxesScalar(frustum, objects_count, boxes.data(), scalar_visible.data());
+	});
+	simd = MeasureThroughput(objects_count, iterations, [&] {
+		simd_count = TestBoxes(frustum, objects_count, boxes.data(), simd_visible.data());
+	});
+	same = scalar_count == simd_count && std::equal(scalar_visible.begin(), scalar_visible.begin() + scalar_count, simd_visible.begin());
+	std::cout << "box frustum test: " << scalar << " / " << simd << ", visible: " << simd_count << (same ? "" : ", results differ") << std::endl;
+	return success && same;
+}
+
+/// <summary>
+/// Returns true if the segment from the start to the end goes through the box
+/// </summary>
+static bool SegmentHitsBox(const glm::vec3& start, const glm::vec3& end, const BoundingBox& box)
+{
+	float enter = 0.0f, leave = 1.0f;
+	glm::vec3 direction = end - start;
+	for (int axis = 0; axis < 3; axis++) {
+		if (std::abs(direction[axis]) < 1e-8f) {
+			if (start[axis] < box.min[axis] || start[axis] > box.max[axis]) return false;
+			continue;
+		}
+		float t0 = (box.min[axis] - start[axis]) / direction[axis];
+		float t1 = (box.max[axis] - start[axis]) / direction[axis];
+		enter = std::max(enter, std::min(t0, t1));
+		leave = std::min(leave, std::max(t0, t1));
+	}
+	return enter <= leave;
+}
+
+bool RunOcclusionBenchmark(GLuint objects_count, GLuint iterations, GLuint max_threads)
+{
+	if (objects_count == 0) objects_count = 1;
+	if (iterations == 0) iterations = 1;
+	if (max_threads == 0) max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	// model 0 is a unit box used as occluder (walls), model 1 is the same box used for the other objects
+	const float box_positions[] = { 0, 0, 0,  1, 0, 0,  1, 1, 0,  0, 1, 0,  0, 0, 1,  1, 0, 1,  1, 1, 1,  0, 1, 1 };
+	const GLuint box_indices[] = { 0, 1, 2, 0, 2, 3,  4, 6, 5, 4, 7, 6,  0, 4, 5, 0, 5, 1,  3, 2, 6, 3, 6, 7,  0, 3, 7, 0, 7, 4,  1, 5, 6, 1, 6, 2 };
+	BoundingBox model_boxes[2] = { { glm::vec3(0.0f), glm::vec3(1.0f) }, { glm::vec3(0.0f), glm::vec3(1.0f) } };
+	glm::vec4 model_spheres[2] = { glm::vec4(0.5f, 0.5f, 0.5f, 0.87f), glm::vec4(0.5f, 0.5f, 0.5f, 0.87f) };
+	OcclusionCuller culler;
+	culler.SetOccluder(0, box_positions, 3, box_indices, 12);
+
+	// walls between the walking camera and the field, small objects all over the field
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> size(0.2f, 2.0f);
+	const GLuint walls_count = 24;
+	GLuint count = walls_count + objects_count;
+	std::vector<glm::mat4> world_matrices(count);
+	std::vector<GLuint> model_ids(count, 1);
+	std::vector<GLuint> flags(count, OBJECT_VISIBLE);
+	std::vector<BoundingBox> world_boxes(count);
+	for (GLuint i = 0; i < count; i++) {
+		glm::vec3 scale = i < walls_count ? glm::vec3(8.0f, 4.0f, 0.5f) : glm::vec3(size(random));
+		glm::vec3 origin = i < walls_count ? glm::vec3(position(random) * 0.5f, 0.0f, 20.0f + position(random) * 0.3f) : glm::vec3(position(random), 0.0f, position(random));
+		world_matrices[i] = glm::scale(glm::translate(glm::mat4(1.0f), origin), scale);
+		world_boxes[i].min = origin;
+		world_boxes[i].max = origin + scale;
+		if (i < walls_count) model_ids[i] = 0;
+	}
+	glm::vec3 camera_position = glm::vec3(0.0f, 1.7f, 60.0f);
+	glm::mat4 view = glm::lookAt(camera_position, glm::vec3(0.0f, 1.7f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(45.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+	glm::mat4 view_projection = projection * view;
+
+	std::vector<GLuint> frustum_visible, visible;
+	CullObjects(GetFrustum(view_projection), count, world_matrices.data(), model_ids.data(), flags.data(), model_spheres, frustum_visible);
+	std::cout << "objects: " << count << ", in frustum: " << frustum_visible.size() << ", iterations: " << iterations << std::endl;
+
+	double single_thread_time = 0.0;
+	for (GLuint threads_count = 1; threads_count <= max_threads; threads_count++)
+	{
+		InitJobSystem(threads_count);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (GLuint i = 0; i < iterations; i++) {
+			visible = frustum_visible;
+			culler.Cull(view_projection, camera_position, world_matrices.data(), model_ids.data(), model_boxes, visible);
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		ShutdownJobSystem();
+
+		double time = std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+		if (threads_count == 1) single_thread_time = time;
+		std::cout << "threads: " << threads_count << ", cull: " << time << " ms, speedup: " << single_thread_time / time
+			<< ", occluders: " << culler.GetOccludersCount() << ", occluded: " << culler.GetOccludedCount() << std::endl;
+	}
+
+	// every culled box has to be hidden at its corners and center, otherwise the culling is not conservative
+	std::vector<bool> kept(count, false);
+	for (GLuint i : visible) kept[i] = true;
+	GLuint errors = 0;
+	for (GLuint i : frustum_visible)
+	{
+		if (kept[i]) continue;
+		glm::vec3 points[9];
+		for (GLuint corner = 0; corner < 8; corner++)
+			points[corner] = glm::vec3(corner & 1 ? world_boxes[i].max.x : world_boxes[i].min.x, corner & 2 ? world_boxes[i].max.y : world_boxes[i].min.y,
+				corner & 4 ? world_boxes[i].max.z : world_boxes[i].min.z);
+		points[8] = (world_boxes[i].min + world_boxes[i].max) * 0.5f;
+		for (const glm::vec3& point : points) {
+			bool hidden = false;
+			for (GLuint wall = 0; wall < walls_count && !hidden; wall++)
+				hidden = SegmentHitsBox(camera_position, point, world_boxes[wall]);
+			if (!hidden) {
+				errors++;
+				break;
+			}
+		}
+	}
+	std::cout << "culled objects with a visible point: " << errors << std::endl;
+	return errors == 0;
+}
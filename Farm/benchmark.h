@@ -0,0 +1,127 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       benchmark.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines offscreen benchmark which renders frames along scripted camera path
+*/
+//----------------------------------------------------------------------------------------
+#ifndef BENCHMARK
+#define BENCHMARK
+
+#include <string>
+
+#include "pgr.h"
+#include "CameraContainer.h"
+
+/// <summary>
+/// Parameters of the benchmark run
+/// </summary>
+struct BenchmarkSettings {
+	GLuint frames = 600;
+	GLuint width = 1280;
+	GLuint height = 720;
+	/// <summary>
+	/// Simulated time step in seconds. Animations do not depend on real frame time, so the final image is always the same
+	/// </summary>
+	float frame_time = 1.0f / 60.0f;
+	/// <summary>
+	/// Path without extension. Report is saved to "output_path.txt", final image to "output_path.ppm"
+	/// </summary>
+	std::string output_path = "benchmark";
+};
+
+/// <summary>
+/// Measured values of the benchmark run. Times are in milliseconds
+/// </summary>
+struct BenchmarkResult {
+	GLuint frames = 0;
+	double total_time = 0.0;
+	double p50 = 0.0;
+	double p95 = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+	double draw_calls_per_frame = 0.0;
+};
+
+/// <summary>
+/// Draws one frame of the scene into currently bound framebuffer. Has to finish the frame of render statistics
+/// </summary>
+/// <param name="camera">Camera of the frame</param>
+/// <param name="time">Simulated time from the start in milliseconds</param>
+/// <param name="dt">Simulated time step in seconds</param>
+typedef void (*BenchmarkDrawFunc)(const Camera& camera, int time, float dt);
+
+/// <summary>
+/// Returns camera on closed Catmull-Rom spline which goes through all keyframes
+/// </summary>
+/// <param name="keyframes">Cameras the spline goes through</param>
+/// <param name="count">Number of keyframes</param>
+/// <param name="t">Position on the spline from 0 to 1</param>
+Camera GetSplineCamera(const Camera* keyframes, GLuint count, float t);
+/// <summary>
+/// Creates OpenGL context without window. Works only when the program is built with FARM_HEADLESS_EGL
+/// </summary>
+/// <returns>Returns true if context was created. Otherwise returns false</returns>
+bool CreateHeadlessContext();
+/// <summary>
+/// Destroys context created by CreateHeadlessContext
+/// </summary>
+void DestroyHeadlessContext();
+/// <summary>
+/// Renders frames uncapped into offscreen framebuffer, saves report and the last frame.
+/// OpenGL context has to be current and the scene has to be loaded
+/// </summary>
+/// <param name="settings">Parameters of the run</param>
+/// <param name="keyframes">Keyframes of the camera path</param>
+/// <param name="count">Number of keyframes</param>
+/// <param name="draw_frame">Function which draws one frame</param>
+/// <param name="result">Returned measured values</param>
+/// <returns>Returns true if benchmark was succesful. Otherwise returns false</returns>
+bool RunBenchmark(const BenchmarkSettings& settings, const Camera* keyframes, GLuint count, BenchmarkDrawFunc draw_frame, BenchmarkResult& result);
+/// <summary>
+/// Measures CPU part of the frame (world matrices, culling, sort keys) with 1 to max_threads job threads
+/// and prints average frame time of every run. Does not need OpenGL context
+/// </summary>
+/// <param name="scene_path">Configure file or binary scene file</param>
+/// <param name="frames">Number of frames of one run</param>
+/// <param name="max_threads">Maximal number of threads. 0 means all hardware threads</param>
+/// <returns>Returns true if the scene was loaded. Otherwise returns false</returns>
+bool RunJobBenchmark(const std::string& scene_path, GLuint frames, GLuint max_threads);
+/// <summary>
+/// Measures swept movement against random colliders with spatial hash and with testing of all colliders,
+/// checks that both give the same positions and prints times of one query
+/// </summary>
+/// <param name="colliders_count">Number of colliders</param>
+/// <param name="queries_count">Number of movements tested with spatial hash. Brute force tests at most 1000 of them</param>
+/// <param name="seed">Seed of random colliders and movements</param>
+/// <returns>Returns true if both methods gave the same results. Otherwise returns false</returns>
+bool RunCollisionBenchmark(GLuint colliders_count, GLuint queries_count, GLuint seed);
+/// <summary>
+/// Reads models of the scene, builds their BVHs and measures CPU picking with random rays.
+/// Checks hits against testing of all triangles. Does not need OpenGL context
+/// </summary>
+/// <param name="scene_path">Configure file or binary scene file</param>
+/// <param name="picks_count">Number of rays. Brute force tests at most 100 of them</param>
+/// <param name="seed">Seed of random rays</param>
+/// <returns>Returns true if the scene was loaded and both methods gave the same hits. Otherwise returns false</returns>
+bool RunPickBenchmark(const std::string& scene_path, GLuint picks_count, GLuint seed);
+/// <summary>
+/// Measures throughput of matrix composition and frustum test kernels on one core, scalar and SIMD versions,
+/// and checks that both versions give the same results
+/// </summary>
+/// <param name="objects_count">Number of random objects</param>
+/// <param name="iterations">Number of runs of every kernel</param>
+/// <returns>Returns true if scalar and SIMD results are the same. Otherwise returns false</returns>
+bool RunSimdBenchmark(GLuint objects_count, GLuint iterations);
+/// <summary>
+/// Measures software occlusion culling of random boxes behind random walls with different numbers of worker threads,
+/// and checks that no culled box has a corner or center visible from the camera
+/// </summary>
+/// <param name="objects_count">Number of random boxes</param>
+/// <param name="iterations">Number of culling runs for every number of threads</param>
+/// <param name="max_threads">Maximum number of worker threads, zero uses all hardware threads</param>
+/// <returns>Returns true if the culling was conservative. Otherwise returns false</returns>
+bool RunOcclusionBenchmark(GLuint objects_count, GLuint iterations, GLuint max_threads);
+
+#endif // !BENCHMARK
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cmath>
+
+#include "collision.h"
+
+/// <summary>
+/// Distance kept between the moving circle and the collider it has hit
+/// </summary>
+static const float COLLISION_SKIN = 0.0001f;
+/// <summary>
+/// Maximal number of colliders the circle can slide along during one movement
+/// </summary>
+static const int MAX_SLIDES = 3;
+
+/// <summary>
+/// Finds when the segment from start to start + delta enters the box. Segments starting inside the box
+/// do not hit it, so the circle can always leave the collider it is stuck in
+/// </summary>
+/// <param name="toi">Returned time of impact from 0 to 1</param>
+/// <param name="axis">Returned axis of the hit side (0 - x, 1 - z)</param>
+/// <returns>Returns true if the segment hits the box</returns>
+static bool SweepBox(const glm::vec2& min, const glm::vec2& max, const glm::vec2& start, const glm::vec2& delta, float& toi, int& axis)
+{
+	float t_near = -1.0f;
+	float t_far = 2.0f;
+	int near_axis = -1;
+	for (int i = 0; i < 2; i++)
+	{
+		if (std::abs(delta[i]) < 1e-8f) {
+			if (start[i] <= min[i] || start[i] >= max[i]) return false;
+			continue;
+		}
+		float t1 = (min[i] - start[i]) / delta[i];
+		float t2 = (max[i] - start[i]) / delta[i];
+		if (t1 > t2) std::swap(t1, t2);
+		if (t1 > t_near) {
+			t_near = t1;
+			near_axis = i;
+		}
+		t_far = std::min(t_far, t2);
+	}
+	if (near_axis < 0 || t_near < 0.0f || t_near >= 1.0f || t_near > t_far) return false;
+	toi = t_near;
+	axis = near_axis;
+	return true;
+}
+
+/// <summary>
+/// Moves circle against given colliders
+/// </summary>
+/// <param name="colliders">All colliders</param>
+/// <param name="indices">Indices of tested colliders. Null means all colliders</param>
+/// <param name="count">Number of tested colliders</param>
+static glm::vec2 SweepMove(const std::vector<Collider2D>& colliders, const GLuint* indices, GLuint count, const glm::vec2& from, const glm::vec2& to, float radius)
+{
+	glm::vec2 position = from;
+	glm::vec2 delta = to - from;
+	for (int slide = 0; slide < MAX_SLIDES; slide++)
+	{
+		if (glm::dot(delta, delta) < 1e-12f) break;
+
+		float first_toi = 1.0f;
+		int first_axis = -1;
+		for (GLuint i = 0; i < count; i++) {
+			const Collider2D& collider = colliders[indices != nullptr ? indices[i] : i];
+			float toi;
+			int axis;
+			if (SweepBox(collider.min - radius, collider.max + radius, position, delta, toi, axis) && toi < first_toi) {
+				first_toi = toi;
+				first_axis = axis;
+			}
+		}
+		if (first_axis < 0) {
+			position += delta;
+			break;
+		}
+
+		// stop in front of the collider and slide along it with the rest of the movement
+		position += delta * first_toi;
+		position[first_axis] -= delta[first_axis] > 0.0f ? COLLISION_SKIN : -COLLISION_SKIN;
+		delta *= 1.0f - first_toi;
+		delta[first_axis] = 0.0f;
+	}
+	return position;
+}
+
+static bool Overlaps(const Collider2D& a, const Collider2D& b)
+{
+	return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y;
+}
+
+void ColliderGrid::Build(const std::vector<Collider2D>& _colliders, float _cell_size)
+{
+	colliders = _colliders;
+	cell_size = std::max(_cell_size, 0.01f);
+
+	// every collider is counted in every cell it overlaps
+	GLuint entries_count = 0;
+	for (const Collider2D& collider : colliders) {
+		int x_count = (int)std::floor(collider.max.x / cell_size) - (int)std::floor(collider.min.x / cell_size) + 1;
+		int z_count = (int)std::floor(collider.max.y / cell_size) - (int)std::floor(collider.min.y / cell_size) + 1;
+		entries_count += x_count * z_count;
+	}
+	GLuint buckets_count = 1;
+	while (buckets_count < entries_count * 2) buckets_count <<= 1;
+
+	bucket_starts.assign(buckets_count + 1, 0);
+	bucket_items.resize(entries_count);
+	for (int pass = 0; pass < 2; pass++)
+	{
+		// first pass counts items of the buckets, second pass places them
+		std::vector<GLuint> fill;
+		if (pass == 1) {
+			for (GLuint i = 0; i < buckets_count; i++) bucket_starts[i + 1] += bucket_starts[i];
+			fill.assign(bucket_starts.begin(), bucket_starts.end() - 1);
+		}
+		for (GLuint i = 0; i < colliders.size(); i++) {
+			const Collider2D& collider = colliders[i];
+			for (int x = (int)std::floor(collider.min.x / cell_size); x <= (int)std::floor(collider.max.x / cell_size); x++)
+				for (int z = (int)std::floor(collider.min.y / cell_size); z <= (int)std::floor(collider.max.y / cell_size); z++) {
+					GLuint bucket = GetBucket(x, z);
+					if (pass == 0) bucket_starts[bucket + 1]++;
+					else bucket_items[fill[bucket]++] = i;
+				}
+		}
+	}
+
+	query_marks.assign(colliders.size(), 0);
+	query_number = 0;
+}
+
+void ColliderGrid::Clear()
+{
+	colliders.clear();
+	bucket_starts.clear();
+	bucket_items.clear();
+	query_marks.clear();
+	candidates.clear();
+	query_number = 0;
+}
+
+GLuint ColliderGrid::GetBucket(int x, int z) const
+{
+	GLuint hash = ((GLuint)x * 73856093u) ^ ((GLuint)z * 19349663u);
+	return hash & (GLuint)(bucket_starts.size() - 2);
+}
+
+void ColliderGrid::Query(const Collider2D& area, std::vector<GLuint>& result) const
+{
+	result.clear();
+	if (colliders.empty()) return;
+	if (++query_number == 0) {
+		std::fill(query_marks.begin(), query_marks.end(), 0);
+		query_number = 1;
+	}
+
+	for (int x = (int)std::floor(area.min.x / cell_size); x <= (int)std::floor(area.max.x / cell_size); x++)
+		for (int z = (int)std::floor(area.min.y / cell_size); z <= (int)std::floor(area.max.y / cell_size); z++) {
+			GLuint bucket = GetBucket(x, z);
+			for (GLuint i = bucket_starts[bucket]; i < bucket_starts[bucket + 1]; i++) {
+				GLuint index = bucket_items[i];
+				if (query_marks[index] == query_number) continue;
+				query_marks[index] = query_number;
+				if (Overlaps(colliders[index], area)) result.push_back(index);
+			}
+		}
+}
+
+glm::vec2 ColliderGrid::Move(const glm::vec2& from, const glm::vec2& to, float radius) const
+{
+	// sliding never leaves the box of the whole movement
+	Collider2D area;
+	area.min = glm::min(from, to) - (radius + COLLISION_SKIN);
+	area.max = glm::max(from, to) + (radius + COLLISION_SKIN);
+	Query(area, candidates);
+	return SweepMove(colliders, candidates.data(), (GLuint)candidates.size(), from, to, radius);
+}
+
+GLuint ColliderGrid::Size() const
+{
+	return (GLuint)colliders.size();
+}
+
+const Collider2D& ColliderGrid::Get(GLuint index) const
+{
+	return colliders[index];
+}
+
+glm::vec2 MoveBruteForce(const std::vector<Collider2D>& colliders, const glm::vec2& from, const glm::vec2& to, float radius)
+{
+	return SweepMove(colliders, nullptr, (GLuint)colliders.size(), from, to, radius);
+}
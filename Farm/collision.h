@@ -0,0 +1,98 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       collision.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines 2D colliders on XZ plane and spatial hash for fast collision queries
+ *
+ * Every collider is stored in all cells of the uniform grid it overlaps. Cells are hashed
+ * into fixed number of buckets, buckets are kept as one contiguous array of collider indices.
+ * Movement is swept: moving circle is tested against colliders expanded by its radius,
+ * so fast movement cannot jump over thin colliders.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <vector>
+
+#include "pgr.h"
+
+/// <summary>
+/// Axis aligned box on XZ plane. x of the vectors is world x, y is world z
+/// </summary>
+struct Collider2D {
+	glm::vec2 min;
+	glm::vec2 max;
+};
+
+class ColliderGrid
+{
+public:
+	/// <summary>
+	/// Builds spatial hash of the colliders
+	/// </summary>
+	/// <param name="colliders">Colliders, they are copied</param>
+	/// <param name="cell_size">Size of one grid cell. Should be close to the size of common collider</param>
+	void Build(const std::vector<Collider2D>& colliders, float cell_size = 2.0f);
+	/// <summary>
+	/// Removes all colliders
+	/// </summary>
+	void Clear();
+	/// <summary>
+	/// Returns indices of all colliders which overlap the area. Every collider is returned once.
+	/// Queries are not thread-safe
+	/// </summary>
+	/// <param name="area">Queried area</param>
+	/// <param name="result">Returned indices</param>
+	void Query(const Collider2D& area, std::vector<GLuint>& result) const;
+	/// <summary>
+	/// Moves circle from one position to another. Circle stops at the first collider on the way
+	/// and slides along it with the rest of the movement
+	/// </summary>
+	/// <param name="from">Start position</param>
+	/// <param name="to">Target position</param>
+	/// <param name="radius">Radius of the circle</param>
+	/// <returns>Returns reached position</returns>
+	glm::vec2 Move(const glm::vec2& from, const glm::vec2& to, float radius) const;
+	/// <summary>
+	/// Returns number of colliders
+	/// </summary>
+	GLuint Size() const;
+	/// <summary>
+	/// Returns collider with given index
+	/// </summary>
+	/// <param name="index">Index of the collider, less than Size()</param>
+	const Collider2D& Get(GLuint index) const;
+private:
+	/// <summary>
+	/// Returns bucket of the grid cell
+	/// </summary>
+	GLuint GetBucket(int x, int z) const;
+
+	float cell_size = 1.0f;
+	std::vector<Collider2D> colliders;
+	/// <summary>
+	/// Colliders of bucket i are bucket_items[bucket_starts[i]] .. bucket_items[bucket_starts[i + 1] - 1]
+	/// </summary>
+	std::vector<GLuint> bucket_starts;
+	std::vector<GLuint> bucket_items;
+	/// <summary>
+	/// Number of the last query which returned every collider, so one collider from many cells is returned once
+	/// </summary>
+	mutable std::vector<GLuint> query_marks;
+	mutable GLuint query_number = 0;
+	mutable std::vector<GLuint> candidates;
+};
+
+/// <summary>
+/// Moves circle like ColliderGrid::Move, but tests all colliders. Used to check and compare the spatial hash
+/// </summary>
+/// <param name="colliders">All colliders</param>
+/// <param name="from">Start position</param>
+/// <param name="to">Target position</param>
+/// <param name="radius">Radius of the circle</param>
+/// <returns>Returns reached position</returns>
+glm::vec2 MoveBruteForce(const std::vector<Collider2D>& colliders, const glm::vec2& from, const glm::vec2& to, float radius);
+
+#endif // !COLLISION_H
@@ -0,0 +1,77 @@
+#version 430 core
+
+layout(local_size_x = 64) in;
+
+struct CullObject {
+    vec4 sphere;
+    uint batch;
+};
+struct DrawCommand {
+    uint count;
+    uint instance_count;
+    uint first_index;
+    int base_vertex;
+    uint base_instance;
+};
+layout(std430, binding = 0) readonly buffer CullObjects {
+    CullObject cull_objects[];
+};
+layout(std430, binding = 1) buffer DrawCommands {
+    DrawCommand commands[];
+};
+layout(std430, binding = 2) writeonly buffer VisibleInstances {
+    uint instances[];
+};
+
+uniform uint object_count;
+// frustum of the current frame, normals look inside
+uniform vec4 frustum_planes[6];
+// depth of the previous frame, every texel keeps the farthest depth of its area
+uniform bool occlusion;
+uniform sampler2D depth_pyramid;
+// size of the first level, powers of two
+uniform vec2 pyramid_size;
+uniform float pyramid_levels;
+uniform mat4 previous_view_projection;
+
+// returns true if the box around the sphere is behind the depth of the previous frame
+bool IsOccluded(vec4 sphere) {
+    vec2 uv_min = vec2(1.0f);
+    vec2 uv_max = vec2(0.0f);
+    float nearest = 1.0f;
+    for (int i = 0; i < 8; i++) {
+        vec3 corner = sphere.xyz + sphere.w * vec3((i & 1) != 0 ? 1.0f : -1.0f, (i & 2) != 0 ? 1.0f : -1.0f, (i & 4) != 0 ? 1.0f : -1.0f);
+        vec4 clip = previous_view_projection * vec4(corner, 1.0f);
+        // box crosses the near plane and can cover the whole screen
+        if (clip.w <= 0.0f) return false;
+        vec3 ndc = clip.xyz / clip.w;
+        uv_min = min(uv_min, ndc.xy * 0.5f + 0.5f);
+        uv_max = max(uv_max, ndc.xy * 0.5f + 0.5f);
+        nearest = min(nearest, ndc.z * 0.5f + 0.5f);
+    }
+    // previous frame did not see the whole box, its hidden part can be visible now
+    if (any(lessThan(uv_min, vec2(0.0f))) || any(greaterThan(uv_max, vec2(1.0f)))) return false;
+
+    // every level halves the power of two size, so on this level the box covers 2x2 texels at most
+    vec2 size = (uv_max - uv_min) * pyramid_size;
+    float level = clamp(ceil(log2(max(max(size.x, size.y), 1.0f))), 0.0f, pyramid_levels - 1.0f);
+    float farthest = max(
+        max(textureLod(depth_pyramid, uv_min, level).r, textureLod(depth_pyramid, vec2(uv_max.x, uv_min.y), level).r),
+        max(textureLod(depth_pyramid, vec2(uv_min.x, uv_max.y), level).r, textureLod(depth_pyramid, uv_max, level).r));
+    return nearest > farthest;
+}
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= object_count) return;
+
+    vec4 sphere = cull_objects[i].sphere;
+    for (int p = 0; p < 6; p++)
+        if (dot(frustum_planes[p].xyz, sphere.xyz) + frustum_planes[p].w < -sphere.w) return;
+    if (occlusion && IsOccluded(sphere)) return;
+
+    // instances of the model are written into its range, command draws as many as were written
+    uint batch = cull_objects[i].batch;
+    uint slot = atomicAdd(commands[batch].instance_count, 1u);
+    instances[commands[batch].base_instance + slot] = i;
+}
@@ -0,0 +1,144 @@
+#include <algorithm>
+
+#include "culling.h"
+#include "job_system.h"
+#include "SceneStore.h"
+#include "simd_kernels.h"
+
+/// <summary>
+/// Number of objects tested by one job
+/// </summary>
+static const GLuint CULLING_BATCH_SIZE = 1024;
+/// <summary>
+/// Bits of the sort key: glass (1) | model id (11) | depth (20) | object index (32)
+/// </summary>
+static const GLuint SORT_KEY_DEPTH_BITS = 20;
+static const GLuint SORT_KEY_MAX_MODEL = (1 << 11) - 1;
+static const GLuint64 SORT_KEY_GLASS = (GLuint64)1 << 63;
+
+Frustum GetFrustum(const glm::mat4& view_projection)
+{
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];
+	frustum.planes[1] = rows[3] - rows[0];
+	frustum.planes[2] = rows[3] + rows[1];
+	frustum.planes[3] = rows[3] - rows[1];
+	frustum.planes[4] = rows[3] + rows[2];
+	frustum.planes[5] = rows[3] - rows[2];
+	for (int i = 0; i < 6; i++)
+		frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+	return frustum;
+}
+
+BoundingBox ComputeBoundingBox(const float* positions, GLuint count, GLuint stride)
+{
+	BoundingBox box;
+	box.min = box.max = glm::vec3(0.0f);
+	if (count == 0) return box;
+
+	box.min = glm::vec3(positions[0], positions[1], positions[2]);
+	box.max = box.min;
+	for (GLuint i = 1; i < count; i++) {
+		const float* position = positions + i * stride;
+		box.min = glm::min(box.min, glm::vec3(position[0], position[1], position[2]));
+		box.max = glm::max(box.max, glm::vec3(position[0], position[1], position[2]));
+	}
+	return box;
+}
+
+BoundingBox GetWorldBox(const glm::mat4& world_matrix, const BoundingBox& box)
+{
+	// transformed box is center and half size, half size is summed over absolute values of the matrix
+	glm::vec3 center = glm::vec3(world_matrix * glm::vec4((box.min + box.max) / 2.0f, 1.0f));
+	glm::vec3 extent = (box.max - box.min) / 2.0f;
+	glm::vec3 world_extent = glm::abs(glm::vec3(world_matrix[0])) * extent.x + glm::abs(glm::vec3(world_matrix[1])) * extent.y + glm::abs(glm::vec3(world_matrix[2])) * extent.z;
+	BoundingBox world_box;
+	world_box.min = center - world_extent;
+	world_box.max = center + world_extent;
+	return world_box;
+}
+
+glm::vec4 ComputeBoundingSphere(const float* positions, GLuint count, GLuint stride)
+{
+	if (count == 0) return glm::vec4(0.0f);
+
+	BoundingBox box = ComputeBoundingBox(positions, count, stride);
+	glm::vec3 center = (box.min + box.max) / 2.0f;
+	float radius = 0.0f;
+	for (GLuint i = 0; i < count; i++) {
+		const float* position = positions + i * stride;
+		radius = std::max(radius, glm::length(glm::vec3(position[0], position[1], position[2]) - center));
+	}
+	return glm::vec4(center, radius);
+}
+
+glm::vec4 GetWorldSphere(const glm::mat4& world_matrix, const glm::vec4& model_sphere)
+{
+	glm::vec3 center = glm::vec3(world_matrix * glm::vec4(glm::vec3(model_sphere), 1.0f));
+	float scale = std::max(glm::length(glm::vec3(world_matrix[0])), std::max(glm::length(glm::vec3(world_matrix[1])), glm::length(glm::vec3(world_matrix[2]))));
+	return glm::vec4(center, model_sphere.w * scale);
+}
+
+bool IsSphereVisible(const Frustum& frustum, const glm::vec4& sphere)
+{
+	for (int i = 0; i < 6; i++)
+		if (glm::dot(glm::vec3(frustum.planes[i]), glm::vec3(sphere)) + frustum.planes[i].w < -sphere.w) return false;
+	return true;
+}
+
+void CullObjects(const Frustum& frustum, GLuint count, const glm::mat4* world_matrices, const GLuint* model_ids, const GLuint* flags, const glm::vec4* model_spheres, std::vector<GLuint>& visible)
+{
+	// every batch writes visible objects to the beginning of its own range, then ranges are joined
+	visible.resize(count);
+	GLuint batches_count = (count + CULLING_BATCH_SIZE - 1) / CULLING_BATCH_SIZE;
+	std::vector<GLuint> batch_sizes(batches_count);
+	ParallelFor(count, CULLING_BATCH_SIZE, [&](GLuint begin, GLuint end) {
+		// world spheres are tested eight at a time. Range is longer than one batch when there are no job threads
+		glm::vec4 spheres[CULLING_BATCH_SIZE];
+		GLuint visible_count = 0;
+		for (GLuint first = begin; first < end; first += CULLING_BATCH_SIZE) {
+			GLuint spheres_count = std::min(CULLING_BATCH_SIZE, end - first);
+			for (GLuint i = 0; i < spheres_count; i++) {
+				spheres[i] = GetWorldSphere(world_matrices[first + i], model_spheres[model_ids[first + i]]);
+				if ((flags[first + i] & OBJECT_VISIBLE) == 0) spheres[i].w = HIDDEN_SPHERE_RADIUS;
+			}
+			GLuint* result = &visible[begin + visible_count];
+			GLuint result_count = TestSpheres(frustum, spheres_count, spheres, result);
+			for (GLuint i = 0; i < result_count; i++) result[i] += first;
+			visible_count += result_count;
+		}
+		batch_sizes[begin / CULLING_BATCH_SIZE] = visible_count;
+	});
+
+	GLuint visible_count = 0;
+	for (GLuint batch = 0; batch < batches_count; batch++) {
+		GLuint begin = batch * CULLING_BATCH_SIZE;
+		std::copy(visible.begin() + begin, visible.begin() + begin + batch_sizes[batch], visible.begin() + visible_count);
+		visible_count += batch_sizes[batch];
+	}
+	visible.resize(visible_count);
+}
+
+void BuildSortKeys(const std::vector<GLuint>& visible, const glm::mat4* world_matrices, const GLuint* model_ids, const GLubyte* glass_models, const glm::vec3& camera_position, float far_plane, std::vector<GLuint64>& keys)
+{
+	keys.resize(visible.size());
+	const GLuint max_depth = (1 << SORT_KEY_DEPTH_BITS) - 1;
+	ParallelFor((GLuint)visible.size(), CULLING_BATCH_SIZE, [&](GLuint begin, GLuint end) {
+		for (GLuint i = begin; i < end; i++) {
+			GLuint index = visible[i];
+			float distance = glm::length(glm::vec3(world_matrices[index][3]) - camera_position);
+			GLuint64 depth = (GLuint64)(glm::clamp(distance / far_plane, 0.0f, 1.0f) * max_depth);
+			// glass is blended, so it goes after all opaque objects and back to front regardless of the model
+			if (glass_models != nullptr && glass_models[model_ids[index]]) {
+				keys[i] = SORT_KEY_GLASS | ((max_depth - depth) << 32) | index;
+				continue;
+			}
+			GLuint64 model = std::min(model_ids[index], (GLuint)SORT_KEY_MAX_MODEL);
+			keys[i] = (model << (32 + SORT_KEY_DEPTH_BITS)) | (depth << 32) | index;
+		}
+	});
+}
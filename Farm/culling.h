@@ -0,0 +1,91 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       culling.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines frustum culling of scene objects and building of draw sort keys
+*/
+//----------------------------------------------------------------------------------------
+#ifndef CULLING
+#define CULLING
+
+#include <vector>
+
+#include "pgr.h"
+
+/// <summary>
+/// Six planes of the view frustum. Plane is (normal, distance), normals look inside
+/// </summary>
+struct Frustum {
+	glm::vec4 planes[6];
+};
+
+/// <summary>
+/// Axis aligned bounding box
+/// </summary>
+struct BoundingBox {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+/// <summary>
+/// Extracts frustum planes from projection * view matrix
+/// </summary>
+/// <param name="view_projection">Projection matrix multiplied by view matrix</param>
+Frustum GetFrustum(const glm::mat4& view_projection);
+/// <summary>
+/// Returns bounding sphere of the vertices
+/// </summary>
+/// <param name="positions">Pointer to the position of the first vertex</param>
+/// <param name="count">Number of vertices</param>
+/// <param name="stride">Number of floats between positions of two vertices</param>
+/// <returns>x, y, z - center, w - radius</returns>
+glm::vec4 ComputeBoundingSphere(const float* positions, GLuint count, GLuint stride);
+/// <summary>
+/// Returns axis aligned bounding box of the vertices
+/// </summary>
+/// <param name="positions">Pointer to the position of the first vertex</param>
+/// <param name="count">Number of vertices</param>
+/// <param name="stride">Number of floats between positions of two vertices</param>
+BoundingBox ComputeBoundingBox(const float* positions, GLuint count, GLuint stride);
+/// <summary>
+/// Returns axis aligned box which contains the transformed box
+/// </summary>
+/// <param name="world_matrix">Object world matrix</param>
+/// <param name="box">Bounding box of the model</param>
+BoundingBox GetWorldBox(const glm::mat4& world_matrix, const BoundingBox& box);
+/// <summary>
+/// Returns bounding sphere of the object in world space
+/// </summary>
+/// <param name="world_matrix">Object world matrix</param>
+/// <param name="model_sphere">Bounding sphere of the model</param>
+glm::vec4 GetWorldSphere(const glm::mat4& world_matrix, const glm::vec4& model_sphere);
+/// <summary>
+/// Returns true if the sphere is at least partly inside the frustum
+/// </summary>
+bool IsSphereVisible(const Frustum& frustum, const glm::vec4& sphere);
+/// <summary>
+/// Tests bounding spheres of all visible objects against the frustum in parallel
+/// </summary>
+/// <param name="frustum">View frustum</param>
+/// <param name="count">Number of objects</param>
+/// <param name="world_matrices">Array of object world matrices</param>
+/// <param name="model_ids">Array of object model indeces</param>
+/// <param name="flags">Array of object flags. Objects without OBJECT_VISIBLE flag are skipped</param>
+/// <param name="model_spheres">Bounding spheres of the models</param>
+/// <param name="visible">Returned indeces of objects inside the frustum in ascending order</param>
+void CullObjects(const Frustum& frustum, GLuint count, const glm::mat4* world_matrices, const GLuint* model_ids, const GLuint* flags, const glm::vec4* model_spheres, std::vector<GLuint>& visible);
+/// <summary>
+/// Builds draw sort keys in parallel. Opaque objects are sorted by model (so the state changes less), then front to back.
+/// Glass objects are sorted after all opaque objects, back to front. Low 32 bits of the key contain object index
+/// </summary>
+/// <param name="visible">Indeces of visible objects</param>
+/// <param name="world_matrices">Array of object world matrices</param>
+/// <param name="model_ids">Array of object model indeces</param>
+/// <param name="glass_models">Nonzero for glass models, index is model id. Can be null when there is no glass</param>
+/// <param name="camera_position">Camera position</param>
+/// <param name="far_plane">Distance of the far plane</param>
+/// <param name="keys">Returned keys</param>
+void BuildSortKeys(const std::vector<GLuint>& visible, const glm::mat4* world_matrices, const GLuint* model_ids, const GLubyte* glass_models, const glm::vec3& camera_position, float far_plane, std::vector<GLuint64>& keys);
+
+#endif // !CULLING
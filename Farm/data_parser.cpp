@@ -1,3 +1,5 @@
+#include <cstdlib>
+
 #include "data_parser.h"
 
 bool ReadDataFromFile(const std::string& path, std::vector<std::string>& data) 
@@ -92,3 +94,154 @@ bool GetVector4f(std::string data, glm::vec4& vector)
 }
 
 
+/// <summary>
+/// Reads section header from the line with given index and moves index to the next line
+/// </summary>
+static bool ReadSectionSize(const std::vector<std::string>& data, size_t& line, size_t record_size, size_t& size)
+{
+    if (line >= data.size()) return false;
+    int res;
+    try
+    {
+        res = std::stoi(data[line]);
+    }
+    catch (const std::exception& ex)
+    {
+        std::cout << "failed to read header: " << ex.what() << std::endl;
+        return false;
+    }
+    line++;
+    if (res < 0 || line + res > data.size()) return false;
+    size = res / record_size;
+    return true;
+}
+
+/// <summary>
+/// Reads "count" floats from string. Faster than stream reading for big configure files
+/// </summary>
+static bool ReadFloats(const std::string& data, float* numbers, int count)
+{
+    const char* begin = data.c_str();
+    for (int i = 0; i < count; i++)
+    {
+        char* end;
+        numbers[i] = std::strtof(begin, &end);
+        if (end == begin) {
+            std::cout << "failed to convert data to floats: " << data << std::endl;
+            return false;
+        }
+        begin = end;
+    }
+    return true;
+}
+
+bool ParseSceneConfig(const std::string& path, SceneDescription& scene)
+{
+    std::vector<std::string> data;
+    if (!ReadDataFromFile(path, data)) return false;
+
+    size_t line = 0;
+    size_t size;
+
+    if (!ReadSectionSize(data, line, 1, size)) return false;
+    scene.diffuse_textures.assign(data.begin() + line, data.begin() + line + size);
+    line += size;
+
+    if (!ReadSectionSize(data, line, 1, size)) return false;
+    scene.specular_textures.assign(data.begin() + line, data.begin() + line + size);
+    line += size;
+
+    if (!ReadSectionSize(data, line, 3, size)) return false;
+    scene.models.resize(size);
+    for (size_t i = 0; i < size; i++, line += 3)
+    {
+        ModelRecord& model = scene.models[i];
+        model.path = data[line];
+        try
+        {
+            model.diffuse_id = (GLuint)std::stoi(data[line + 1]);
+            model.specular_id = (GLuint)std::stoi(data[line + 2]);
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+        if (model.diffuse_id >= scene.diffuse_textures.size() || model.specular_id >= scene.specular_textures.size())
+        {
+            std::cout << "texture id out of range. model id: " << i << std::endl;
+            return false;
+        }
+    }
+
+    if (!ReadSectionSize(data, line, 4, size)) return false;
+    scene.positions.resize(size);
+    scene.rotations.resize(size);
+    scene.scales.resize(size);
+    scene.model_ids.resize(size);
+    scene.parents.resize(size);
+    for (size_t i = 0; i < size; i++, line += 4)
+    {
+        const char* begin = data[line].c_str();
+        char* end;
+        long model_id = std::strtol(begin, &end, 10);
+        if (end == begin || model_id < 0 || model_id >= (long)scene.models.size())
+        {
+            std::cout << "model id out of range. object id: " << i << std::endl;
+            return false;
+        }
+        scene.model_ids[i] = (GLuint)model_id;
+        // optional second number is index of the parent object, it has to be defined earlier
+        begin = end;
+        long parent = std::strtol(begin, &end, 10);
+        if (end == begin || parent < 0) scene.parents[i] = NO_PARENT;
+        else if (parent < (long)i) scene.parents[i] = (GLuint)parent;
+        else
+        {
+            std::cout << "parent has to be defined before its children. object id: " << i << std::endl;
+            return false;
+        }
+        if (!ReadFloats(data[line + 1], glm::value_ptr(scene.positions[i]), 3)) return false;
+        if (!ReadFloats(data[line + 2], glm::value_ptr(scene.rotations[i]), 4)) return false;
+        if (!ReadFloats(data[line + 3], glm::value_ptr(scene.scales[i]), 3)) return false;
+    }
+
+    return true;
+}
+
+bool WriteSceneConfig(const std::string& path, const SceneDescription& scene)
+{
+    std::ofstream ofs(path);
+    if (!ofs.is_open()) {
+        std::cout << "failed to open file for writing: " << path << std::endl;
+        return false;
+    }
+
+    ofs << scene.diffuse_textures.size() << '\n';
+    for (const std::string& texture : scene.diffuse_textures) ofs << texture << '\n';
+    ofs << scene.specular_textures.size() << '\n';
+    for (const std::string& texture : scene.specular_textures) ofs << texture << '\n';
+    ofs << scene.models.size() * 3 << '\n';
+    for (const ModelRecord& model : scene.models)
+        ofs << model.path << '\n' << model.diffuse_id << '\n' << model.specular_id << '\n';
+
+    size_t count = scene.model_ids.size();
+    ofs << count * 4;
+    for (size_t i = 0; i < count; i++)
+    {
+        const glm::vec3& position = scene.positions[i];
+        const glm::vec4& rotation = scene.rotations[i];
+        const glm::vec3& scale = scene.scales[i];
+        ofs << '\n' << scene.model_ids[i];
+        if (i < scene.parents.size() && scene.parents[i] != NO_PARENT) ofs << ' ' << scene.parents[i];
+        ofs << '\n' << position.x << ' ' << position.y << ' ' << position.z;
+        ofs << '\n' << rotation.x << ' ' << rotation.y << ' ' << rotation.z << ' ' << rotation.w;
+        ofs << '\n' << scale.x << ' ' << scale.y << ' ' << scale.z;
+    }
+
+    ofs.close();
+    if (ofs.fail()) {
+        std::cout << "failed to write configure file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
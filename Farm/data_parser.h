@@ -17,6 +17,7 @@
 #include <string>
 
 #include "pgr.h"
+#include "scene_snapshot.h"
 /// <summary>
 /// Reads data from file and returns buffer with lines
 /// </summary>
@@ -52,5 +53,21 @@ bool GetVector3f(std::string data, glm::vec3& vector);
 /// <param name="vector">Returned vector of 4 floats</param>
 /// <returns>Returns true if converting was succesfull</returns>
 bool GetVector4f(std::string data, glm::vec4& vector);
+/// <summary>
+/// Reads configure file and converts it to the scene description.
+/// First line of the object is model id, optionally followed by index of the parent object.
+/// Position, rotation and scale of the child are relative to its parent
+/// </summary>
+/// <param name="path">Path to the configure file</param>
+/// <param name="scene">Returned scene description</param>
+/// <returns>Returns true if parsing was succesful. Otherwise returns false</returns>
+bool ParseSceneConfig(const std::string& path, SceneDescription& scene);
+/// <summary>
+/// Writes scene description as configure file which can be read by ParseSceneConfig
+/// </summary>
+/// <param name="path">Path to the configure file</param>
+/// <param name="scene">Scene description</param>
+/// <returns>Returns true if writing was succesful. Otherwise returns false</returns>
+bool WriteSceneConfig(const std::string& path, const SceneDescription& scene);
 
 #endif // !DATA_PARSER
\ No newline at end of file
@@ -0,0 +1,26 @@
+#version 430 core
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// depth texture for the first level, previous level of the pyramid for the others
+uniform sampler2D source;
+uniform int source_level;
+uniform ivec2 source_size;
+uniform ivec2 destination_size;
+layout(r32f, binding = 0) writeonly uniform image2D destination;
+
+void main() {
+    ivec2 position = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(position, destination_size))) return;
+
+    // farthest depth of all source texels under the texel. Power of two levels take 2x2 texels,
+    // the first level takes up to 3x3 texels of the depth, which is not a power of two
+    ivec2 first = position * source_size / destination_size;
+    ivec2 last = ((position + 1) * source_size + destination_size - 1) / destination_size - 1;
+    last = clamp(last, first, source_size - 1);
+    float depth = 0.0f;
+    for (int y = first.y; y <= last.y; y++)
+        for (int x = first.x; x <= last.x; x++)
+            depth = max(depth, texelFetch(source, ivec2(x, y), source_level).r);
+    imageStore(destination, position, vec4(depth));
+}
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cmath>
+
+#include "dynamic_resolution.h"
+
+/// <summary>
+/// Lowest scale of the scene resolution
+/// </summary>
+static const float MIN_SCALE = 0.5f;
+/// <summary>
+/// Scale changes in steps of this size, so only a few target sizes are pooled
+/// </summary>
+static const float SCALE_STEP = 1.0f / 16.0f;
+/// <summary>
+/// Scale is kept while the time is within this fraction of the target
+/// </summary>
+static const float TARGET_BAND = 0.1f;
+/// <summary>
+/// Weight of the new time in the average
+/// </summary>
+static const float AVERAGE_FACTOR = 0.2f;
+/// <summary>
+/// Number of frames after the change of the scale during which the scale is kept
+/// </summary>
+static const GLuint CHANGE_COOLDOWN_FRAMES = 15;
+
+void DynamicResolution::SetTargetFrameTime(float milliseconds)
+{
+	milliseconds = std::max(milliseconds, 0.0f);
+	if (milliseconds == target_time) return;
+	target_time = milliseconds;
+	if (target_time == 0.0f) scale = 1.0f;
+	cooldown = 0;
+}
+
+void DynamicResolution::BeginFrame()
+{
+	if (queries[0][0] == 0) glGenQueries(RESOLUTION_QUERY_FRAMES * 2, &queries[0][0]);
+
+	// from the oldest frame to the newest one, results come in the same order
+	for (GLuint i = 0; i < RESOLUTION_QUERY_FRAMES; i++)
+	{
+		GLuint slot = (frame + i) % RESOLUTION_QUERY_FRAMES;
+		if (!issued[slot]) continue;
+		GLint available = 0;
+		glGetQueryObjectiv(queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) break;
+		GLuint64 start = 0, end = 0;
+		glGetQueryObjectui64v(queries[slot][0], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(queries[slot][1], GL_QUERY_RESULT, &end);
+		issued[slot] = false;
+		float time = (end - start) / 1000000.0f;
+		average_time = average_time == 0.0f ? time : average_time + (time - average_time) * AVERAGE_FACTOR;
+		UpdateScale();
+	}
+
+	// the oldest result is dropped rather than waited for
+	GLuint slot = frame % RESOLUTION_QUERY_FRAMES;
+	issued[slot] = false;
+	glQueryCounter(queries[slot][0], GL_TIMESTAMP);
+}
+
+void DynamicResolution::EndFrame()
+{
+	GLuint slot = frame % RESOLUTION_QUERY_FRAMES;
+	glQueryCounter(queries[slot][1], GL_TIMESTAMP);
+	issued[slot] = true;
+	frame++;
+}
+
+void DynamicResolution::Release()
+{
+	if (queries[0][0] != 0) glDeleteQueries(RESOLUTION_QUERY_FRAMES * 2, &queries[0][0]);
+	for (GLuint i = 0; i < RESOLUTION_QUERY_FRAMES; i++) {
+		queries[i][0] = queries[i][1] = 0;
+		issued[i] = false;
+	}
+	average_time = 0.0f;
+	scale = 1.0f;
+	cooldown = 0;
+}
+
+void DynamicResolution::UpdateScale()
+{
+	if (target_time == 0.0f) return;
+	if (cooldown > 0) {
+		cooldown--;
+		return;
+	}
+	if (std::abs(average_time - target_time) <= target_time * TARGET_BAND) return;
+
+	// rounded down, so the scale grows only when there is time for the whole step
+	float desired = scale * std::sqrt(target_time / average_time);
+	float stepped = std::floor(desired / SCALE_STEP) * SCALE_STEP;
+	stepped = std::min(std::max(stepped, MIN_SCALE), 1.0f);
+	if (stepped == scale) return;
+	scale = stepped;
+	cooldown = CHANGE_COOLDOWN_FRAMES;
+}
+
+float DynamicResolution::GetScale() const
+{
+	return scale;
+}
+
+GLsizei DynamicResolution::GetScaledSize(GLsizei size) const
+{
+	return std::max((GLsizei)(size * scale + 0.5f), 1);
+}
+
+float DynamicResolution::GetAverageFrameTime() const
+{
+	return average_time;
+}
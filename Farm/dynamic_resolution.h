@@ -0,0 +1,79 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       dynamic_resolution.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines controller of the scene resolution driven by GPU frame time
+ *
+ * GPU time of every frame is measured with two timestamp queries. Results are read a few
+ * frames later, only when they are available, so the controller never stalls the pipeline.
+ * Pixel cost grows with the square of the scale, so the scale follows square root of the
+ * ratio of the target and the measured time. Scale changes in fixed steps and only when
+ * the time leaves the band around the target, so transient targets of the same size are
+ * reused from the pool instead of being created every frame.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include "pgr.h"
+
+/// <summary>
+/// Number of frames whose queries can wait for the result at the same time
+/// </summary>
+const GLuint RESOLUTION_QUERY_FRAMES = 4;
+
+class DynamicResolution
+{
+public:
+	/// <summary>
+	/// Sets target GPU time of the frame. Zero disables the scaling and renders at native resolution
+	/// </summary>
+	/// <param name="milliseconds">Target time in milliseconds</param>
+	void SetTargetFrameTime(float milliseconds);
+	/// <summary>
+	/// Reads finished queries, updates the scale and starts measuring the frame
+	/// </summary>
+	void BeginFrame();
+	/// <summary>
+	/// Stops measuring the frame
+	/// </summary>
+	void EndFrame();
+	/// <summary>
+	/// Deletes the queries
+	/// </summary>
+	void Release();
+	/// <summary>
+	/// Returns scale of the scene resolution, from MIN_SCALE to 1
+	/// </summary>
+	float GetScale() const;
+	/// <summary>
+	/// Returns scaled size, at least one pixel
+	/// </summary>
+	GLsizei GetScaledSize(GLsizei size) const;
+	/// <summary>
+	/// Returns average GPU time of the frame in milliseconds
+	/// </summary>
+	float GetAverageFrameTime() const;
+private:
+	/// <summary>
+	/// Changes the scale if the average time is out of the band around the target
+	/// </summary>
+	void UpdateScale();
+
+	float target_time = 0.0f;
+	float average_time = 0.0f;
+	float scale = 1.0f;
+	/// <summary>
+	/// Frames left until the next change of the scale, new time has to get into the average first
+	/// </summary>
+	GLuint cooldown = 0;
+	/// <summary>
+	/// Start and end timestamps of the frames
+	/// </summary>
+	GLuint queries[RESOLUTION_QUERY_FRAMES][2] = {};
+	bool issued[RESOLUTION_QUERY_FRAMES] = {};
+	GLuint frame = 0;
+};
+
+#endif // !DYNAMIC_RESOLUTION_H
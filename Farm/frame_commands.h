@@ -0,0 +1,176 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       frame_commands.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines recorded frame: everything the render thread needs to draw one frame
+ *
+ * Frame is recorded on the main thread from the simulation state and executed on the thread
+ * which owns GL context. Execution reads only the frame and loaded GL resources, so the main
+ * thread can already simulate the next frame. Arrays keep their memory between frames,
+ * so recording does not allocate after the first few frames.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef FRAME_COMMANDS
+#define FRAME_COMMANDS
+
+#include <vector>
+#include <memory>
+
+#include "pgr.h"
+#include "LightSourses.h"
+#include "CameraContainer.h"
+
+/// <summary>
+/// One object of the scene
+/// </summary>
+struct DrawItem {
+	glm::mat4 world_matrix;
+	GLuint model_id;
+	/// <summary>
+	/// Value written into the object ID buffer
+	/// </summary>
+	GLuint object_id;
+	/// <summary>
+	/// Animation time of the model at the moment of recording
+	/// </summary>
+	float time;
+	/// <summary>
+	/// Visible clusters of the model, ranges_count ranges from first_range in StaticDrawList::ranges. Zero count draws the whole model
+	/// </summary>
+	GLuint first_range = 0;
+	GLuint ranges_count = 0;
+};
+
+/// <summary>
+/// Range of the model indices drawn by one command
+/// </summary>
+struct ClusterRange {
+	GLuint first_index;
+	GLuint index_count;
+};
+
+/// <summary>
+/// Static objects visible from the camera. List is immutable and shared by all frames recorded
+/// while the camera, window and scene do not change, render thread keeps its GPU copy until the version changes
+/// </summary>
+struct StaticDrawList {
+	GLuint version = 0;
+	std::vector<DrawItem> items;
+	/// <summary>
+	/// Index ranges of the visible clusters of all items
+	/// </summary>
+	std::vector<ClusterRange> ranges;
+	/// <summary>
+	/// Distant static objects drawn as impostors instead of their meshes
+	/// </summary>
+	std::vector<DrawItem> impostors;
+};
+
+/// <summary>
+/// One quad with animated texture
+/// </summary>
+struct BillboardItem {
+	glm::mat4 model_matrix;
+	/// <summary>
+	/// Type(index) of animated texture
+	/// </summary>
+	GLuint type;
+	GLint size_x;
+	GLint size_y;
+	GLint index;
+};
+
+/// <summary>
+/// Vertex of the terrain chunk in world space
+/// </summary>
+struct TerrainVertex {
+	glm::vec3 position;
+	glm::vec3 normal;
+};
+
+/// <summary>
+/// One terrain chunk drawn with the chosen level of detail
+/// </summary>
+struct TerrainChunkDraw {
+	/// <summary>
+	/// Place of the chunk vertices in the vertex pool
+	/// </summary>
+	GLuint slot;
+	GLuint level;
+	/// <summary>
+	/// Edges whose neighbours are one level coarser, TERRAIN_STITCH_* bits
+	/// </summary>
+	GLuint stitch_mask;
+};
+
+/// <summary>
+/// Frame state and draw lists
+/// </summary>
+struct FrameCommands {
+	// state
+	GLsizei width = 0;
+	GLsizei height = 0;
+	GLenum polygon_mode = GL_FILL;
+	bool fog_enabled = false;
+	float night_value = 0.0f;
+	/// <summary>
+	/// Target GPU time of the frame in milliseconds for dynamic resolution. Zero renders the scene at native resolution
+	/// </summary>
+	float target_frame_time = 0.0f;
+
+	// uniforms shared by all objects
+	glm::mat4 view_matrix;
+	glm::mat4 projection_matrix;
+	Camera camera;
+	DirectLight direct_light;
+	PointLight point_light;
+	SpotLight spot_light;
+
+	// draw lists
+	std::shared_ptr<const StaticDrawList> static_objects;
+	/// <summary>
+	/// Static objects contain the whole scene and are culled by the compute pass of the frame
+	/// </summary>
+	bool gpu_culling = false;
+	/// <summary>
+	/// Visible objects of animated models, recorded every frame and drawn after the static objects
+	/// </summary>
+	std::vector<DrawItem> objects;
+	bool anim_object_enabled = false;
+	DrawItem anim_object;
+	bool banner_enabled = false;
+	glm::mat4 banner_matrix;
+	glm::mat4 banner_texture_matrix;
+	std::vector<BillboardItem> billboards;
+	/// <summary>
+	/// Terrain chunks streamed in by this frame: slot in the vertex pool and TERRAIN_CHUNK_VERTICES vertices for each of them
+	/// </summary>
+	std::vector<GLuint> terrain_upload_slots;
+	std::vector<TerrainVertex> terrain_vertices;
+	std::vector<TerrainChunkDraw> terrain_chunks;
+
+	/// <summary>
+	/// Object ID under the pixel is copied after the frame is drawn and read a few frames later
+	/// </summary>
+	bool pick_requested = false;
+	GLint pick_x = 0;
+	GLint pick_y = 0;
+
+	/// <summary>
+	/// Clears draw lists, keeps their memory
+	/// </summary>
+	void Clear() {
+		static_objects.reset();
+		objects.clear();
+		billboards.clear();
+		terrain_upload_slots.clear();
+		terrain_vertices.clear();
+		terrain_chunks.clear();
+		anim_object_enabled = false;
+		banner_enabled = false;
+		pick_requested = false;
+	}
+};
+
+#endif // !FRAME_COMMANDS
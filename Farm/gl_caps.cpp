@@ -0,0 +1,24 @@
+#include <cstring>
+
+#include "gl_caps.h"
+
+bool HasGLVersion(GLint major, GLint minor)
+{
+	GLint context_major = 0;
+	GLint context_minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &context_major);
+	glGetIntegerv(GL_MINOR_VERSION, &context_minor);
+	return context_major > major || (context_major == major && context_minor >= minor);
+}
+
+bool HasGLExtension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension != nullptr && std::strcmp(extension, name) == 0) return true;
+	}
+	return false;
+}
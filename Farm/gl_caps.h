@@ -0,0 +1,26 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       gl_caps.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines queries of the OpenGL version and extensions of the current context
+*/
+//----------------------------------------------------------------------------------------
+#ifndef GL_CAPS_H
+#define GL_CAPS_H
+
+#include "pgr.h"
+
+/// <summary>
+/// Returns true if the context version is at least major.minor. Needs current GL context
+/// </summary>
+/// <param name="major">Major version</param>
+/// <param name="minor">Minor version</param>
+bool HasGLVersion(GLint major, GLint minor);
+/// <summary>
+/// Returns true if the context supports the extension. Needs current GL context
+/// </summary>
+/// <param name="name">Name of the extension, for example "GL_ARB_buffer_storage"</param>
+bool HasGLExtension(const char* name);
+
+#endif // !GL_CAPS_H
@@ -0,0 +1,230 @@
+#include <iostream>
+#include <algorithm>
+
+#include "gpu_culling.h"
+#include "gl_caps.h"
+#include "culling.h"
+#include "render_stats.h"
+#include "uniform_blocks.h"
+
+/// <summary>
+/// Work group sizes, they are fixed in the shaders
+/// </summary>
+static const GLuint CULL_GROUP_SIZE = 64;
+static const GLuint PYRAMID_GROUP_SIZE = 8;
+
+/// <summary>
+/// Creates the buffer if needed and fills it with the data
+/// </summary>
+static void UploadBuffer(GLuint& buffer, GLenum target, GLsizeiptr size, const void* data)
+{
+	if (buffer == 0) glGenBuffers(1, &buffer);
+	glBindBuffer(target, buffer);
+	StatsBufferData(target, size, data, GL_STATIC_DRAW);
+	glBindBuffer(target, 0);
+}
+
+bool GpuCulling::IsSupported()
+{
+	return HasGLVersion(4, 3);
+}
+
+GLuint GpuCulling::CreateComputeProgram(const char* path)
+{
+	GLuint shaders[] = { pgr::createShaderFromFile(GL_COMPUTE_SHADER, path), 0 };
+	if (shaders[0] == 0) {
+		std::cout << "failed to create compute shader from file " << path << std::endl;
+		return 0;
+	}
+	GLuint program = pgr::createProgram(shaders);
+	if (program == 0) {
+		std::cout << "failed to create compute program from shader " << path << std::endl;
+		glDeleteShader(shaders[0]);
+	}
+	return program;
+}
+
+bool GpuCulling::Create(GLuint _draw_program)
+{
+	Release();
+	cull_program = CreateComputeProgram("cull_cs.glsl");
+	pyramid_program = CreateComputeProgram("depth_pyramid_cs.glsl");
+	if (cull_program == 0 || pyramid_program == 0) {
+		Release();
+		return false;
+	}
+
+	draw_program = _draw_program;
+	instance_offset_location = glGetUniformLocation(draw_program, "instance_offset");
+	cull_locations.object_count = glGetUniformLocation(cull_program, "object_count");
+	cull_locations.frustum_planes = glGetUniformLocation(cull_program, "frustum_planes");
+	cull_locations.occlusion = glGetUniformLocation(cull_program, "occlusion");
+	cull_locations.pyramid_size = glGetUniformLocation(cull_program, "pyramid_size");
+	cull_locations.pyramid_levels = glGetUniformLocation(cull_program, "pyramid_levels");
+	cull_locations.previous_view_projection = glGetUniformLocation(cull_program, "previous_view_projection");
+	pyramid_locations.source_level = glGetUniformLocation(pyramid_program, "source_level");
+	pyramid_locations.source_size = glGetUniformLocation(pyramid_program, "source_size");
+	pyramid_locations.destination_size = glGetUniformLocation(pyramid_program, "destination_size");
+
+	// both programs sample from the texture unit 0
+	glUseProgram(cull_program);
+	glUniform1i(glGetUniformLocation(cull_program, "depth_pyramid"), 0);
+	glUseProgram(pyramid_program);
+	glUniform1i(glGetUniformLocation(pyramid_program, "source"), 0);
+	glUseProgram(0);
+	return true;
+}
+
+void GpuCulling::Update(const StaticDrawList& list, const std::vector<ModelContainer*>& models, const std::vector<glm::vec4>& model_spheres)
+{
+	if (list.version == list_version) return;
+	list_version = list.version;
+	objects_count = (GLuint)list.items.size();
+	batches.clear();
+	if (objects_count == 0) return;
+
+	// items are sorted by model, every model gets one batch and one command
+	std::vector<ObjectBlock> blocks(objects_count);
+	std::vector<CullObject> cull_objects(objects_count);
+	for (GLuint i = 0; i < objects_count; i++)
+	{
+		const DrawItem& item = list.items[i];
+		if (batches.empty() || batches.back().model_id != item.model_id) {
+			Batch batch;
+			batch.model_id = item.model_id;
+			batch.first = i;
+			batch.count = 0;
+			batches.push_back(batch);
+		}
+		batches.back().count++;
+		models[item.model_id]->WriteObjectBlock(blocks[i], item.world_matrix, item.time, item.object_id);
+		cull_objects[i].sphere = GetWorldSphere(item.world_matrix, model_spheres[item.model_id]);
+		cull_objects[i].batch = (GLuint)batches.size() - 1;
+	}
+	std::vector<DrawElementsIndirectCommand> commands(batches.size());
+	for (GLuint i = 0; i < batches.size(); i++)
+	{
+		commands[i].count = models[batches[i].model_id]->GetIndexCount();
+		commands[i].instance_count = 0;
+		commands[i].first_index = 0;
+		commands[i].base_vertex = 0;
+		commands[i].base_instance = batches[i].first;
+	}
+
+	UploadBuffer(object_buffer, GL_SHADER_STORAGE_BUFFER, blocks.size() * sizeof(ObjectBlock), blocks.data());
+	UploadBuffer(cull_buffer, GL_SHADER_STORAGE_BUFFER, cull_objects.size() * sizeof(CullObject), cull_objects.data());
+	UploadBuffer(instance_buffer, GL_SHADER_STORAGE_BUFFER, objects_count * sizeof(GLuint), nullptr);
+	UploadBuffer(command_template_buffer, GL_COPY_READ_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+	UploadBuffer(command_buffer, GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+}
+
+void GpuCulling::Cull(const glm::mat4& view_projection)
+{
+	if (batches.empty()) return;
+
+	// instance counts start from zero, the shader appends visible objects
+	glBindBuffer(GL_COPY_READ_BUFFER, command_template_buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, command_buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, batches.size() * sizeof(DrawElementsIndirectCommand));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	Frustum frustum = GetFrustum(view_projection);
+	StatsUseProgram(cull_program);
+	StatsUniform(cull_locations.object_count, objects_count);
+	glUniform4fv(cull_locations.frustum_planes, 6, &frustum.planes[0].x);
+	StatsUniform(cull_locations.occlusion, (GLint)pyramid_valid);
+	if (pyramid_valid) {
+		glActiveTexture(GL_TEXTURE0);
+		StatsBindTexture(GL_TEXTURE_2D, pyramid_texture);
+		glUniform2f(cull_locations.pyramid_size, (GLfloat)pyramid_width, (GLfloat)pyramid_height);
+		StatsUniform(cull_locations.pyramid_levels, (GLfloat)pyramid_levels);
+		StatsUniform(cull_locations.previous_view_projection, pyramid_view_projection);
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_OBJECTS_BINDING, cull_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_COMMANDS_BINDING, command_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_INSTANCES_BINDING, instance_buffer);
+	glDispatchCompute((objects_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	// commands are read by the indirect draws, instances by the vertex shader
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void GpuCulling::Draw(const std::vector<ModelContainer*>& models)
+{
+	if (batches.empty()) return;
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_INSTANCES_BINDING, instance_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_DATA_BINDING, object_buffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+	for (GLuint i = 0; i < batches.size(); i++)
+	{
+		ModelContainer* model = models[batches[i].model_id];
+		model->Bind(draw_program);
+		StatsUniform(instance_offset_location, batches[i].first);
+		model->DrawIndirect(i * sizeof(DrawElementsIndirectCommand));
+	}
+	StatsBindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void GpuCulling::BuildDepthPyramid(GLuint depth_texture, GLsizei width, GLsizei height, const glm::mat4& view_projection)
+{
+	if (pyramid_program == 0) return;
+
+	if (width != depth_width || height != depth_height) {
+		if (pyramid_texture != 0) glDeleteTextures(1, &pyramid_texture);
+		depth_width = width;
+		depth_height = height;
+		// the largest powers of two not bigger than the depth, so every level is exactly half of the previous one
+		pyramid_width = 1;
+		pyramid_height = 1;
+		while (pyramid_width * 2 <= width) pyramid_width *= 2;
+		while (pyramid_height * 2 <= height) pyramid_height *= 2;
+		pyramid_levels = 1;
+		while ((std::max(pyramid_width, pyramid_height) >> pyramid_levels) > 0) pyramid_levels++;
+		glGenTextures(1, &pyramid_texture);
+		glBindTexture(GL_TEXTURE_2D, pyramid_texture);
+		glTexStorage2D(GL_TEXTURE_2D, pyramid_levels, GL_R32F, pyramid_width, pyramid_height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	// first level reduces the depth, every next one keeps the farthest depth of the previous level
+	StatsUseProgram(pyramid_program);
+	glActiveTexture(GL_TEXTURE0);
+	GLsizei source_width = width;
+	GLsizei source_height = height;
+	for (GLint level = 0; level < pyramid_levels; level++)
+	{
+		GLsizei level_width = std::max(pyramid_width >> level, 1);
+		GLsizei level_height = std::max(pyramid_height >> level, 1);
+		StatsBindTexture(GL_TEXTURE_2D, level == 0 ? depth_texture : pyramid_texture);
+		StatsUniform(pyramid_locations.source_level, std::max(level - 1, 0));
+		glUniform2i(pyramid_locations.source_size, source_width, source_height);
+		glUniform2i(pyramid_locations.destination_size, level_width, level_height);
+		glBindImageTexture(0, pyramid_texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((level_width + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, (level_height + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		source_width = level_width;
+		source_height = level_height;
+	}
+	glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	StatsBindTexture(GL_TEXTURE_2D, 0);
+
+	pyramid_view_projection = view_projection;
+	pyramid_valid = true;
+}
+
+void GpuCulling::Release()
+{
+	if (cull_program != 0) pgr::deleteProgramAndShaders(cull_program);
+	if (pyramid_program != 0) pgr::deleteProgramAndShaders(pyramid_program);
+	GLuint buffers[] = { cull_buffer, object_buffer, instance_buffer, command_template_buffer, command_buffer };
+	for (GLuint buffer : buffers)
+		if (buffer != 0) glDeleteBuffers(1, &buffer);
+	if (pyramid_texture != 0) glDeleteTextures(1, &pyramid_texture);
+	*this = GpuCulling();
+}
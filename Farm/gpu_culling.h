@@ -0,0 +1,149 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       gpu_culling.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines culling of the static objects by compute shaders
+ *
+ * Static draw list with all static objects is uploaded into storage buffers once per
+ * version: object blocks, world bounding spheres and one indirect command for every model.
+ * Every frame a compute pass tests the spheres against the frustum and against the depth
+ * pyramid of the previous frame, appends visible objects into the instance range of their
+ * model and counts them in the command. Objects are then drawn with one indirect instanced
+ * draw per model, CPU work does not depend on the number of objects. Needs OpenGL 4.3.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include <vector>
+
+#include "pgr.h"
+#include "frame_commands.h"
+#include "ModelContainer.h"
+
+/// <summary>
+/// Binding points of the storage buffers, they are fixed in the shaders
+/// </summary>
+enum StorageBufferBinding {
+	CULL_OBJECTS_BINDING = 0,
+	DRAW_COMMANDS_BINDING = 1,
+	VISIBLE_INSTANCES_BINDING = 2,
+	OBJECT_DATA_BINDING = 3
+};
+
+/// <summary>
+/// Bounding sphere of the object in world space and its model batch, std430 layout
+/// </summary>
+struct CullObject {
+	glm::vec4 sphere;
+	GLuint batch;
+	GLuint padding[3];
+};
+
+class GpuCulling
+{
+public:
+	/// <summary>
+	/// Returns true if the context supports compute shaders and storage buffers. Needs current GL context
+	/// </summary>
+	static bool IsSupported();
+	/// <summary>
+	/// Creates compute programs. Needs current GL context
+	/// </summary>
+	/// <param name="draw_program">Program which draws the visible instances, object_instanced_vs.glsl</param>
+	/// <returns>Returns true if the programs were created. Otherwise returns false</returns>
+	bool Create(GLuint draw_program);
+	/// <summary>
+	/// Uploads objects of the list if its version differs from the uploaded one
+	/// </summary>
+	/// <param name="list">All static objects sorted by model</param>
+	/// <param name="models">Models of the scene</param>
+	/// <param name="model_spheres">Bounding spheres of the models, index is model id</param>
+	void Update(const StaticDrawList& list, const std::vector<ModelContainer*>& models, const std::vector<glm::vec4>& model_spheres);
+	/// <summary>
+	/// Writes commands of the objects visible from the camera
+	/// </summary>
+	/// <param name="view_projection">Projection matrix multiplied by view matrix of the frame</param>
+	void Cull(const glm::mat4& view_projection);
+	/// <summary>
+	/// Draws visible objects with the commands written by Cull. Camera and lights blocks have to be already bound
+	/// </summary>
+	void Draw(const std::vector<ModelContainer*>& models);
+	/// <summary>
+	/// Builds depth pyramid from the depth of the frame, next frame tests the objects against it
+	/// </summary>
+	/// <param name="depth_texture">Depth texture of the drawn scene</param>
+	/// <param name="width">Width of the depth texture</param>
+	/// <param name="height">Height of the depth texture</param>
+	/// <param name="view_projection">Projection matrix multiplied by view matrix the depth was drawn with</param>
+	void BuildDepthPyramid(GLuint depth_texture, GLsizei width, GLsizei height, const glm::mat4& view_projection);
+	/// <summary>
+	/// Deletes programs, buffers and the pyramid
+	/// </summary>
+	void Release();
+private:
+	/// <summary>
+	/// Objects of one model: range in the instance list and index of the command
+	/// </summary>
+	struct Batch {
+		GLuint model_id;
+		GLuint first;
+		GLuint count;
+	};
+
+	/// <summary>
+	/// Creates program from one compute shader
+	/// </summary>
+	static GLuint CreateComputeProgram(const char* path);
+
+	GLuint list_version = 0;
+	GLuint objects_count = 0;
+	std::vector<Batch> batches;
+
+	// GL objects, used only by the thread which owns GL context
+	GLuint cull_program = 0;
+	GLuint pyramid_program = 0;
+	GLuint draw_program = 0;
+	GLint instance_offset_location = -1;
+	/// <summary>
+	/// Uniform locations of the compute programs
+	/// </summary>
+	struct CullLocations {
+		GLint object_count = -1;
+		GLint frustum_planes = -1;
+		GLint occlusion = -1;
+		GLint pyramid_size = -1;
+		GLint pyramid_levels = -1;
+		GLint previous_view_projection = -1;
+	}cull_locations;
+	struct PyramidLocations {
+		GLint source_level = -1;
+		GLint source_size = -1;
+		GLint destination_size = -1;
+	}pyramid_locations;
+	GLuint cull_buffer = 0;
+	GLuint object_buffer = 0;
+	GLuint instance_buffer = 0;
+	/// <summary>
+	/// Commands with zero instances copied into the command buffer before every culling
+	/// </summary>
+	GLuint command_template_buffer = 0;
+	GLuint command_buffer = 0;
+	/// <summary>
+	/// R32F texture with mipmaps, every texel keeps the farthest depth of its area. Size of the first level is power of two
+	/// </summary>
+	GLuint pyramid_texture = 0;
+	GLsizei pyramid_width = 0;
+	GLsizei pyramid_height = 0;
+	/// <summary>
+	/// Size of the depth the pyramid was created for
+	/// </summary>
+	GLsizei depth_width = 0;
+	GLsizei depth_height = 0;
+	GLint pyramid_levels = 0;
+	bool pyramid_valid = false;
+	glm::mat4 pyramid_view_projection;
+};
+
+#endif // !GPU_CULLING_H
@@ -0,0 +1,22 @@
+#version 330 core
+
+in vec3 Normal;
+in vec2 TexCoords;
+in float Depth;
+
+layout(location = 0) out vec4 color;
+layout(location = 1) out vec4 normal_depth;
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+};
+
+uniform Material material;
+
+void main() {
+    // alpha marks covered texels, normal is in model space
+    color = vec4(texture(material.diffuse, TexCoords).rgb, 1.0f);
+    normal_depth = vec4(normalize(Normal) * 0.5f + 0.5f, Depth);
+}
@@ -0,0 +1,20 @@
+#version 330 core
+
+in vec3 position;
+in vec3 normal;
+in vec2 texCoords;
+
+out vec3 Normal;
+out vec2 TexCoords;
+out float Depth;
+
+// orthographic view of the model bounding sphere from one direction of the octahedral map
+uniform mat4 bake_matrix;
+
+void main() {
+    gl_Position = bake_matrix * vec4(position, 1.0f);
+    // 0 at the front of the sphere, 1 at its back
+    Depth = gl_Position.z * 0.5f + 0.5f;
+    Normal = normal;
+    TexCoords = texCoords;
+};
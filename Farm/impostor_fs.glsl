@@ -0,0 +1,154 @@
+#version 330 core
+
+in vec3 QuadPos;
+in vec2 FogTexCoords;
+in vec2 FrameUV[3];
+flat in vec2 FrameOrigins[3];
+flat in vec3 FrameWeights;
+flat in uint Layer;
+flat in uint ObjectId;
+flat in mat3 NormalMatrix;
+flat in vec3 ToCamera;
+flat in float WorldRadius;
+
+layout(location = 0) out vec4 color;
+// id of the object for picking, written only while the scene pass enables the second draw buffer
+layout(location = 1) out uint object_id_color;
+
+struct DirectLight{
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float intensity;
+    vec3 direction;
+};
+
+struct PointLight {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    float intensity;
+    vec3 position;
+    float linear;
+    float quadratic;
+};
+
+struct SpotLight {
+    PointLight point;
+
+    vec3 direction;
+    float cut_off;
+};
+
+layout(std140) uniform CameraBlock {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 viewPos;
+    bool fog;
+};
+layout(std140) uniform LightsBlock {
+    DirectLight direct_light;
+    PointLight point_light;
+    SpotLight spot_light;
+};
+
+uniform sampler2DArray color_atlas;
+uniform sampler2DArray normal_depth_atlas;
+uniform sampler2D fog_texture;
+
+// views along one side of the octahedral map, IMPOSTOR_FRAMES
+const float FRAMES = 8.0f;
+// side of one view in pixels, IMPOSTOR_FRAME_SIZE
+const float FRAME_SIZE = 64.0f;
+
+// position of the surface restored from the baked depth
+vec3 FragPos;
+
+// lighting is the same as in object_fs.glsl, specular maps are not baked into the impostors
+
+vec3 CalculateDiffuse(vec3 material_diffuse, vec3 light_diffuse, vec3 light_direction, vec3 normal){
+    float diffuse_value = max(dot(normal, light_direction), 0.0);
+    return diffuse_value * material_diffuse * light_diffuse;
+}
+
+vec3 CalculateAmbient(vec3 material_ambient, vec3 light_ambient){
+    return material_ambient * light_ambient;
+}
+
+vec3 CalculateDirectLight(vec3 material_diffuse, vec3 normal){
+    vec3 light_direction = normalize(-direct_light.direction);
+    
+    vec3 ambient = CalculateAmbient(material_diffuse, direct_light.ambient);
+
+    vec3 diffuse = CalculateDiffuse(material_diffuse, direct_light.diffuse, light_direction, normal);
+
+    return direct_light.intensity * (ambient + diffuse);
+}
+
+vec3 CalculatePointLight(vec3 material_diffuse, vec3 normal, PointLight point){
+    float distance = length(point.position - FragPos);
+    float attenuation = 1.0f / (1.0f + point.linear * distance + point.quadratic * (distance * distance));
+
+    vec3 light_direction = normalize(point.position - FragPos);
+
+    vec3 ambient = CalculateAmbient(material_diffuse, point.ambient);
+
+    vec3 diffuse = CalculateDiffuse(material_diffuse, point.diffuse, light_direction, normal);
+
+    return point.intensity * attenuation * (ambient + diffuse);
+}
+
+vec3 CalculateSpotLight(vec3 material_diffuse, vec3 normal){
+    vec3 light_direction = normalize(spot_light.point.position - FragPos);
+    float theta = dot(light_direction, normalize(-spot_light.direction));
+    vec3 ambient = CalculateAmbient(material_diffuse, spot_light.point.ambient);
+    if (theta > spot_light.cut_off){
+        return max(CalculatePointLight(material_diffuse, normal, spot_light.point), ambient);
+    }
+    else{
+        return ambient;
+    }
+}
+
+void main() {
+    // blends three nearest views, texels outside of the model have zero coverage
+    float coverage = 0.0f;
+    vec3 material_diffuse = vec3(0.0f);
+    vec4 normal_depth = vec4(0.0f);
+    for (int i = 0; i < 3; i++) {
+        if (FrameWeights[i] <= 0.0f || any(lessThan(FrameUV[i], vec2(0.0f))) || any(greaterThan(FrameUV[i], vec2(1.0f))))
+            continue;
+        // half texel inside the frame, so the neighbouring frame does not bleed in
+        vec2 frame_uv = clamp(FrameUV[i], 0.5f / FRAME_SIZE, 1.0f - 0.5f / FRAME_SIZE);
+        vec3 atlas_uv = vec3(FrameOrigins[i] + frame_uv / FRAMES, float(Layer));
+        vec4 frame_color = texture(color_atlas, atlas_uv);
+        float weight = FrameWeights[i] * frame_color.a;
+        coverage += weight;
+        material_diffuse += weight * frame_color.rgb;
+        normal_depth += weight * texture(normal_depth_atlas, atlas_uv);
+    }
+    if (coverage < 0.5f)
+        discard;
+    material_diffuse /= coverage;
+    normal_depth /= coverage;
+    vec3 normal = normalize(NormalMatrix * (normal_depth.xyz * 2.0f - 1.0f));
+
+    // depth 0 is the front of the bounding sphere, 1 is its back
+    FragPos = QuadPos + ToCamera * (0.5f - normal_depth.w) * 2.0f * WorldRadius;
+    vec4 clip_position = projectionMatrix * viewMatrix * vec4(FragPos, 1.0f);
+    gl_FragDepth = clip_position.z / clip_position.w * 0.5f + 0.5f;
+
+    vec3 direct_color = CalculateDirectLight(material_diffuse, normal);
+
+    vec3 point_color = CalculatePointLight(material_diffuse, normal, point_light);
+
+    vec3 spot_color = CalculateSpotLight(material_diffuse, normal);
+    
+    vec4 output_color = vec4(direct_color + point_color + spot_color, 1.0f);
+
+    if (fog) 
+        output_color = mix(output_color, texture(fog_texture, FogTexCoords), min(length(FragPos - viewPos), 10) / 10);
+    color = output_color;
+    object_id_color = ObjectId;
+}
@@ -0,0 +1,110 @@
+#version 330 core
+
+// corner of the quad in [-1, 1]
+in vec2 corner;
+// per instance
+in mat4 world_matrix;
+// x - texture layer of the model, y - object id
+in uvec2 instance_data;
+
+out vec3 QuadPos;
+out vec2 FogTexCoords;
+// where the view ray crosses the plane of every blended frame, in [0, 1] inside the frame
+out vec2 FrameUV[3];
+flat out vec2 FrameOrigins[3];
+flat out vec3 FrameWeights;
+flat out uint Layer;
+flat out uint ObjectId;
+flat out mat3 NormalMatrix;
+flat out vec3 ToCamera;
+flat out float WorldRadius;
+
+layout(std140) uniform CameraBlock {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 viewPos;
+    bool fog;
+};
+
+// bounding spheres of the models in model space, index is texture layer. Size is MAX_IMPOSTOR_MODELS
+uniform vec4 model_spheres[32];
+
+// views along one side of the octahedral map, IMPOSTOR_FRAMES
+const float FRAMES = 8.0f;
+
+// same mapping as DecodeOctahedral in impostors.cpp
+vec3 DecodeOctahedral(vec2 uv) {
+    vec2 point = uv * 2.0f - 1.0f;
+    vec3 direction = vec3(point.x, 1.0f - abs(point.x) - abs(point.y), point.y);
+    if (direction.y < 0.0f)
+        direction.xz = (1.0f - abs(direction.zx)) * vec2(direction.x >= 0.0f ? 1.0f : -1.0f, direction.z >= 0.0f ? 1.0f : -1.0f);
+    return normalize(direction);
+}
+
+vec2 EncodeOctahedral(vec3 direction) {
+    direction /= abs(direction.x) + abs(direction.y) + abs(direction.z);
+    vec2 point = direction.xz;
+    if (direction.y < 0.0f)
+        point = (1.0f - abs(direction.zx)) * vec2(direction.x >= 0.0f ? 1.0f : -1.0f, direction.z >= 0.0f ? 1.0f : -1.0f);
+    return point * 0.5f + 0.5f;
+}
+
+void main() {
+    vec4 sphere = model_spheres[instance_data.x];
+    mat3 linear = mat3(world_matrix);
+    vec3 center = vec3(world_matrix * vec4(sphere.xyz, 1.0f));
+    WorldRadius = sphere.w * max(length(linear[0]), max(length(linear[1]), length(linear[2])));
+
+    // quad faces the camera and covers the silhouette of the sphere
+    vec3 to_camera = viewPos - center;
+    float distance = length(to_camera);
+    ToCamera = to_camera / distance;
+    vec3 up_reference = abs(ToCamera.y) > 0.999f ? vec3(0.0f, 0.0f, 1.0f) : vec3(0.0f, 1.0f, 0.0f);
+    vec3 right = normalize(cross(up_reference, ToCamera));
+    vec3 up = cross(ToCamera, right);
+    float half_size = WorldRadius * distance / sqrt(max(distance * distance - WorldRadius * WorldRadius, 1e-4f));
+    QuadPos = center + (corner.x * right + corner.y * up) * half_size;
+
+    gl_Position = projectionMatrix * viewMatrix * vec4(QuadPos, 1.0f);
+    vec3 ndcSpacePos;
+    if (gl_Position.w != 0)
+        ndcSpacePos = gl_Position.xyz / gl_Position.w;
+    FogTexCoords = (ndcSpacePos.xy + 1.0f) / 2.0f;
+
+    // view direction in model space chooses three nearest frames of the map
+    mat4 inverse_world = inverse(world_matrix);
+    vec3 camera_model = vec3(inverse_world * vec4(viewPos, 1.0f));
+    vec3 ray = vec3(inverse_world * vec4(QuadPos, 1.0f)) - camera_model;
+    vec2 grid = EncodeOctahedral(normalize(camera_model - sphere.xyz)) * (FRAMES - 1.0f);
+    vec2 cell = min(floor(grid), vec2(FRAMES - 2.0f));
+    vec2 fraction = grid - cell;
+    vec2 frames[3];
+    if (fraction.x + fraction.y <= 1.0f) {
+        frames[0] = cell;
+        frames[1] = cell + vec2(1.0f, 0.0f);
+        frames[2] = cell + vec2(0.0f, 1.0f);
+        FrameWeights = vec3(1.0f - fraction.x - fraction.y, fraction.x, fraction.y);
+    }
+    else {
+        frames[0] = cell + vec2(1.0f, 1.0f);
+        frames[1] = cell + vec2(0.0f, 1.0f);
+        frames[2] = cell + vec2(1.0f, 0.0f);
+        FrameWeights = vec3(fraction.x + fraction.y - 1.0f, 1.0f - fraction.x, 1.0f - fraction.y);
+    }
+
+    // frames were drawn by orthographic cameras, same basis as glm::lookAt in Impostors::Bake
+    for (int i = 0; i < 3; i++) {
+        vec3 direction = DecodeOctahedral(frames[i] / (FRAMES - 1.0f));
+        vec3 frame_up_reference = abs(direction.y) > 0.999f ? vec3(0.0f, 0.0f, 1.0f) : vec3(0.0f, 1.0f, 0.0f);
+        vec3 frame_right = normalize(cross(frame_up_reference, direction));
+        vec3 frame_up = cross(direction, frame_right);
+        float t = dot(sphere.xyz - camera_model, direction) / dot(ray, direction);
+        vec3 local = camera_model + ray * t - sphere.xyz;
+        FrameUV[i] = vec2(dot(local, frame_right), dot(local, frame_up)) / (2.0f * sphere.w) + 0.5f;
+        FrameOrigins[i] = frames[i] / FRAMES;
+    }
+
+    Layer = instance_data.x;
+    ObjectId = instance_data.y;
+    NormalMatrix = transpose(inverse(linear));
+};
@@ -0,0 +1,212 @@
+#include <iostream>
+#include <algorithm>
+
+#include "impostors.h"
+#include "render_stats.h"
+
+/// <summary>
+/// Layer of the models without impostor
+/// </summary>
+static const GLuint NO_LAYER = 0xFFFFFFFF;
+/// <summary>
+/// Impostor is drawn until its frame is magnified this many times on the screen
+/// </summary>
+static const float IMPOSTOR_MAX_MAGNIFICATION = 2.0f;
+
+glm::vec3 DecodeOctahedral(const glm::vec2& uv)
+{
+	// upper half of the octahedron is in the middle of the map, lower half is folded over the corners
+	glm::vec2 point = uv * 2.0f - 1.0f;
+	glm::vec3 direction = glm::vec3(point.x, 1.0f - std::abs(point.x) - std::abs(point.y), point.y);
+	if (direction.y < 0.0f) {
+		float x = (1.0f - std::abs(direction.z)) * (direction.x >= 0.0f ? 1.0f : -1.0f);
+		float z = (1.0f - std::abs(direction.x)) * (direction.z >= 0.0f ? 1.0f : -1.0f);
+		direction.x = x;
+		direction.z = z;
+	}
+	return glm::normalize(direction);
+}
+
+bool Impostors::Bake(const std::vector<ModelContainer*>& models, const std::vector<glm::vec4>& model_spheres, const std::vector<GLuint>& model_ids,
+	GLuint bake_program, GLuint _draw_program)
+{
+	Release();
+	GLsizei layers_count = (GLsizei)std::min((GLuint)model_ids.size(), MAX_IMPOSTOR_MODELS);
+	if (layers_count == 0) return true;
+	GLsizei atlas_size = IMPOSTOR_FRAMES * IMPOSTOR_FRAME_SIZE;
+
+	// color with coverage in alpha, normal in model space with depth in alpha
+	GLuint* textures[] = { &color_texture, &normal_depth_texture };
+	for (GLuint* texture : textures) {
+		glGenTextures(1, texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, *texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, atlas_size, atlas_size, layers_count, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	GLuint depth_buffer, framebuffer;
+	glGenRenderbuffers(1, &depth_buffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlas_size, atlas_size);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer);
+	GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, draw_buffers);
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean blend = glIsEnabled(GL_BLEND);
+	GLfloat clear_color[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+	glEnable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+	glDepthMask(GL_TRUE);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+	GLint bake_matrix_location = glGetUniformLocation(bake_program, "bake_matrix");
+	std::vector<glm::vec4> layer_spheres(MAX_IMPOSTOR_MODELS, glm::vec4(0.0f));
+	bool complete = true;
+	for (GLsizei layer = 0; layer < layers_count && complete; layer++)
+	{
+		GLuint model_id = model_ids[layer];
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, color_texture, 0, layer);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, normal_depth_texture, 0, layer);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "impostor framebuffer is not complete" << std::endl;
+			complete = false;
+			break;
+		}
+		glViewport(0, 0, atlas_size, atlas_size);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// orthographic views of the bounding sphere, depth goes from the front of the sphere to its back
+		glm::vec3 center = glm::vec3(model_spheres[model_id]);
+		float radius = model_spheres[model_id].w;
+		layer_spheres[layer] = model_spheres[model_id];
+		glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius);
+		models[model_id]->Bind(bake_program);
+		for (GLuint y = 0; y < IMPOSTOR_FRAMES; y++)
+			for (GLuint x = 0; x < IMPOSTOR_FRAMES; x++)
+			{
+				glm::vec3 direction = DecodeOctahedral(glm::vec2((float)x, (float)y) / (float)(IMPOSTOR_FRAMES - 1));
+				glm::vec3 up = std::abs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+				glm::mat4 view = glm::lookAt(center + direction * radius, center, up);
+				glViewport(x * IMPOSTOR_FRAME_SIZE, y * IMPOSTOR_FRAME_SIZE, IMPOSTOR_FRAME_SIZE, IMPOSTOR_FRAME_SIZE);
+				StatsUniform(bake_matrix_location, projection * view);
+				models[model_id]->DrawElements();
+			}
+		model_layers.resize(std::max((GLuint)model_layers.size(), model_id + 1), NO_LAYER);
+		model_layers[model_id] = layer;
+	}
+
+	StatsBindVertexArray(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &depth_buffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	if (!depth_test) glDisable(GL_DEPTH_TEST);
+	if (blend) glEnable(GL_BLEND);
+	glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+	if (!complete) {
+		Release();
+		return false;
+	}
+	for (GLuint* texture : textures) {
+		glBindTexture(GL_TEXTURE_2D_ARRAY, *texture);
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	// one quad, every instance takes its world matrix, layer and object id from the instance buffer
+	draw_program = _draw_program;
+	glUseProgram(draw_program);
+	glUniform1i(glGetUniformLocation(draw_program, "color_atlas"), 0);
+	glUniform1i(glGetUniformLocation(draw_program, "normal_depth_atlas"), 1);
+	glUniform1i(glGetUniformLocation(draw_program, "fog_texture"), 2);
+	glUniform4fv(glGetUniformLocation(draw_program, "model_spheres"), MAX_IMPOSTOR_MODELS, &layer_spheres[0].x);
+	glUseProgram(0);
+
+	const float corners[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glGenBuffers(1, &quad_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, quad_buffer);
+	StatsBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	GLint location = glGetAttribLocation(draw_program, "corner");
+	glVertexAttribPointer(location, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	glEnableVertexAttribArray(location);
+
+	glGenBuffers(1, &instance_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+	location = glGetAttribLocation(draw_program, "world_matrix");
+	for (GLint column = 0; column < 4; column++) {
+		glVertexAttribPointer(location + column, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offsetof(Instance, world_matrix) + column * sizeof(glm::vec4)));
+		glEnableVertexAttribArray(location + column);
+		glVertexAttribDivisor(location + column, 1);
+	}
+	location = glGetAttribLocation(draw_program, "instance_data");
+	glVertexAttribIPointer(location, 2, GL_UNSIGNED_INT, sizeof(Instance), (void*)offsetof(Instance, layer));
+	glEnableVertexAttribArray(location);
+	glVertexAttribDivisor(location, 1);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return true;
+}
+
+bool Impostors::HasImpostor(GLuint model_id) const
+{
+	return model_id < model_layers.size() && model_layers[model_id] != NO_LAYER;
+}
+
+float Impostors::GetImpostorDistance(float world_radius, float projection_scale)
+{
+	// diameter of the object on the screen is at most the magnified frame
+	return 2.0f * world_radius * projection_scale / (IMPOSTOR_FRAME_SIZE * IMPOSTOR_MAX_MAGNIFICATION);
+}
+
+void Impostors::Draw(const StaticDrawList& list, GLuint fog_texture)
+{
+	if (vao == 0) return;
+	if (list.version != list_version) {
+		list_version = list.version;
+		std::vector<Instance> instances(list.impostors.size());
+		for (GLuint i = 0; i < list.impostors.size(); i++) {
+			instances[i].world_matrix = list.impostors[i].world_matrix;
+			instances[i].layer = model_layers[list.impostors[i].model_id];
+			instances[i].object_id = list.impostors[i].object_id;
+		}
+		instances_count = (GLsizei)instances.size();
+		glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+		StatsBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	if (instances_count == 0) return;
+
+	StatsUseProgram(draw_program);
+	glActiveTexture(GL_TEXTURE0);
+	StatsBindTexture(GL_TEXTURE_2D_ARRAY, color_texture);
+	glActiveTexture(GL_TEXTURE1);
+	StatsBindTexture(GL_TEXTURE_2D_ARRAY, normal_depth_texture);
+	glActiveTexture(GL_TEXTURE2);
+	StatsBindTexture(GL_TEXTURE_2D, fog_texture);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	StatsBindVertexArray(vao);
+	StatsDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instances_count);
+	StatsBindVertexArray(0);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void Impostors::Release()
+{
+	if (color_texture != 0) glDeleteTextures(1, &color_texture);
+	if (normal_depth_texture != 0) glDeleteTextures(1, &normal_depth_texture);
+	if (vao != 0) glDeleteVertexArrays(1, &vao);
+	if (quad_buffer != 0) glDeleteBuffers(1, &quad_buffer);
+	if (instance_buffer != 0) glDeleteBuffers(1, &instance_buffer);
+	*this = Impostors();
+}
@@ -0,0 +1,106 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       impostors.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines octahedral impostors which replace distant static objects
+ *
+ * At load time every static model is drawn from IMPOSTOR_FRAMES x IMPOSTOR_FRAMES directions
+ * placed on an octahedral map of the sphere. Every view is one frame of the model layer in
+ * two texture arrays: diffuse color with coverage and model space normal with depth. Object
+ * whose bounding sphere is smaller on the screen than two frames is drawn as one quad facing
+ * the camera. The quad blends the three frames nearest to the view direction, every frame
+ * is sampled where the view ray crosses its plane, and the baked depth moves the fragment
+ * back onto the surface, so the impostor is lit and intersects the terrain like the mesh.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef IMPOSTORS_H
+#define IMPOSTORS_H
+
+#include <vector>
+
+#include "pgr.h"
+#include "frame_commands.h"
+#include "ModelContainer.h"
+
+/// <summary>
+/// Number of views along one side of the octahedral map
+/// </summary>
+const GLuint IMPOSTOR_FRAMES = 8;
+/// <summary>
+/// Side of one view in pixels
+/// </summary>
+const GLuint IMPOSTOR_FRAME_SIZE = 64;
+/// <summary>
+/// Maximum number of models with impostors, one texture layer each. Fixed in impostor_vs.glsl
+/// </summary>
+const GLuint MAX_IMPOSTOR_MODELS = 32;
+
+/// <summary>
+/// Returns direction of the view from the point of the octahedral map
+/// </summary>
+/// <param name="uv">Point of the map in [0, 1]</param>
+glm::vec3 DecodeOctahedral(const glm::vec2& uv);
+
+class Impostors
+{
+public:
+	/// <summary>
+	/// Draws views of the models into the texture arrays. Needs current GL context
+	/// </summary>
+	/// <param name="models">Models of the scene</param>
+	/// <param name="model_spheres">Bounding spheres of the models, index is model id</param>
+	/// <param name="model_ids">Models which get impostors, at most MAX_IMPOSTOR_MODELS</param>
+	/// <param name="bake_program">Program which writes color, normal and depth of the model, impostor_bake_fs.glsl</param>
+	/// <param name="draw_program">Program which draws the quads, impostor_vs.glsl</param>
+	/// <returns>Returns true if the views were drawn. Otherwise returns false</returns>
+	bool Bake(const std::vector<ModelContainer*>& models, const std::vector<glm::vec4>& model_spheres, const std::vector<GLuint>& model_ids,
+		GLuint bake_program, GLuint draw_program);
+	/// <summary>
+	/// Returns true if the model has impostor
+	/// </summary>
+	bool HasImpostor(GLuint model_id) const;
+	/// <summary>
+	/// Returns distance from the camera beyond which the object is drawn as impostor
+	/// </summary>
+	/// <param name="world_radius">Radius of the object bounding sphere in world space</param>
+	/// <param name="projection_scale">Height of the viewport divided by 2 * tan(fov / 2), converts size at distance 1 to pixels</param>
+	static float GetImpostorDistance(float world_radius, float projection_scale);
+	/// <summary>
+	/// Uploads impostors of the list if its version differs from the uploaded one and draws them.
+	/// Camera and lights blocks have to be already bound
+	/// </summary>
+	/// <param name="list">Static draw list of the frame</param>
+	/// <param name="fog_texture">Texture of the fog</param>
+	void Draw(const StaticDrawList& list, GLuint fog_texture);
+	/// <summary>
+	/// Deletes textures, buffers and framebuffer
+	/// </summary>
+	void Release();
+private:
+	/// <summary>
+	/// Per instance attributes of one quad
+	/// </summary>
+	struct Instance {
+		glm::mat4 world_matrix;
+		GLuint layer;
+		GLuint object_id;
+	};
+
+	/// <summary>
+	/// Texture layer of every model, NO_LAYER for models without impostor
+	/// </summary>
+	std::vector<GLuint> model_layers;
+	GLuint list_version = 0;
+	GLsizei instances_count = 0;
+
+	// GL objects, used only by the thread which owns GL context
+	GLuint draw_program = 0;
+	GLuint color_texture = 0;
+	GLuint normal_depth_texture = 0;
+	GLuint vao = 0;
+	GLuint quad_buffer = 0;
+	GLuint instance_buffer = 0;
+};
+
+#endif // !IMPOSTORS_H
@@ -0,0 +1,226 @@
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+#include <algorithm>
+
+#include "job_system.h"
+
+/// <summary>
+/// Job in the queue
+/// </summary>
+struct Task {
+	Job job;
+	JobCounter* counter = nullptr;
+	bool continuation = false;
+};
+
+/// <summary>
+/// Queue of one thread. Owner works with the back, thieves with the front
+/// </summary>
+struct Worker {
+	std::mutex mutex;
+	std::deque<Task> tasks;
+};
+
+static std::vector<std::unique_ptr<Worker>> workers;
+static std::vector<std::thread> threads;
+static std::atomic<bool> running(false);
+/// <summary>
+/// Number of tasks in all queues. Signed, because a thief can take a task before its push is counted
+/// </summary>
+static std::atomic<int> queued_tasks(0);
+static std::mutex sleep_mutex;
+static std::condition_variable wake_up;
+/// <summary>
+/// Index of the queue of the current thread. Main thread and other threads which are not workers use queue 0
+/// </summary>
+static thread_local GLuint worker_index = 0;
+
+static void Execute(Task& task);
+
+static void PushTask(Task&& task)
+{
+	if (threads.empty()) {
+		Execute(task);
+		return;
+	}
+
+	Worker& worker = *workers[worker_index];
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.tasks.push_back(std::move(task));
+	}
+	queued_tasks++;
+	// taking the lock guarantees that sleeping thread either sees the new task or gets the notification
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	wake_up.notify_one();
+}
+
+/// <summary>
+/// Takes the newest task of the own queue or steals the oldest task of other queues
+/// </summary>
+static bool TakeTask(Task& task)
+{
+	GLuint count = (GLuint)workers.size();
+	for (GLuint i = 0; i < count; i++)
+	{
+		Worker& worker = *workers[(worker_index + i) % count];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		if (worker.tasks.empty()) continue;
+		if (i == 0) {
+			task = std::move(worker.tasks.back());
+			worker.tasks.pop_back();
+		}
+		else {
+			task = std::move(worker.tasks.front());
+			worker.tasks.pop_front();
+		}
+		queued_tasks--;
+		return true;
+	}
+	return false;
+}
+
+static void Execute(Task& task)
+{
+	task.job();
+
+	JobCounter* counter = task.counter;
+	if (counter == nullptr) return;
+	// counter is alive until remaining reaches zero, continuation is counted there too, so it keeps the counter alive
+	// the job which finishes the group last starts the continuation, before it releases its own count
+	bool last_job = !task.continuation && counter->jobs_left.fetch_sub(1) == 1;
+	if (last_job && counter->continuation && !counter->continuation_started.exchange(true)) {
+		Task continuation;
+		continuation.job = counter->continuation;
+		continuation.counter = counter;
+		continuation.continuation = true;
+		PushTask(std::move(continuation));
+	}
+	counter->remaining--;
+}
+
+static void WorkerLoop(GLuint index)
+{
+	worker_index = index;
+	while (true)
+	{
+		Task task;
+		if (TakeTask(task)) {
+			Execute(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wake_up.wait(lock, [] { return queued_tasks > 0 || !running; });
+		if (!running && queued_tasks <= 0) return;
+	}
+}
+
+void InitJobSystem(GLuint threads_count)
+{
+	ShutdownJobSystem();
+	if (threads_count == 0) threads_count = std::max(1u, std::thread::hardware_concurrency());
+
+	for (GLuint i = 0; i < threads_count; i++)
+		workers.emplace_back(new Worker());
+	running = true;
+	for (GLuint i = 1; i < threads_count; i++)
+		threads.emplace_back(WorkerLoop, i);
+}
+
+void ShutdownJobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		running = false;
+	}
+	wake_up.notify_all();
+	for (std::thread& thread : threads)
+		thread.join();
+	threads.clear();
+	workers.clear();
+	queued_tasks = 0;
+}
+
+GLuint GetJobThreadsCount()
+{
+	return std::max(1u, (GLuint)workers.size());
+}
+
+/// <summary>
+/// Adds jobs to the counter. Continuation is counted with the first group of jobs
+/// </summary>
+static void CountJobs(JobCounter& counter, GLuint count)
+{
+	GLuint counted = count;
+	if (counter.continuation && !counter.continuation_started && counter.remaining == 0) counted++;
+	counter.remaining += counted;
+	counter.jobs_left += count;
+}
+
+void RunJob(const Job& job, JobCounter* counter)
+{
+	if (counter != nullptr) CountJobs(*counter, 1);
+	Task task;
+	task.job = job;
+	task.counter = counter;
+	PushTask(std::move(task));
+}
+
+void RunJobs(const std::vector<Job>& jobs, JobCounter& counter)
+{
+	if (jobs.empty()) {
+		if (counter.continuation && !counter.continuation_started.exchange(true)) {
+			counter.remaining++;
+			Task continuation;
+			continuation.job = counter.continuation;
+			continuation.counter = &counter;
+			continuation.continuation = true;
+			PushTask(std::move(continuation));
+		}
+		return;
+	}
+
+	CountJobs(counter, (GLuint)jobs.size());
+	for (const Job& job : jobs) {
+		Task task;
+		task.job = job;
+		task.counter = &counter;
+		PushTask(std::move(task));
+	}
+}
+
+void WaitForCounter(JobCounter& counter)
+{
+	while (counter.remaining > 0)
+	{
+		Task task;
+		if (TakeTask(task)) Execute(task);
+		else std::this_thread::yield();
+	}
+}
+
+void ParallelFor(GLuint count, GLuint batch_size, const std::function<void(GLuint begin, GLuint end)>& body)
+{
+	if (count == 0) return;
+	if (batch_size == 0) batch_size = 1;
+	if (threads.empty() || count <= batch_size) {
+		body(0, count);
+		return;
+	}
+
+	std::vector<Job> jobs;
+	for (GLuint begin = batch_size; begin < count; begin += batch_size) {
+		GLuint end = std::min(count, begin + batch_size);
+		jobs.push_back([&body, begin, end] { body(begin, end); });
+	}
+	JobCounter counter;
+	RunJobs(jobs, counter);
+	// calling thread takes the first batch itself
+	body(0, batch_size);
+	WaitForCounter(counter);
+}
@@ -0,0 +1,77 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       job_system.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines work-stealing job system
+ *
+ * Every thread has its own job queue. Thread takes the newest job from its own queue,
+ * when the queue is empty it steals the oldest job from other threads. Main thread is
+ * worker 0 and helps with the jobs while it waits for them.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef JOB_SYSTEM
+#define JOB_SYSTEM
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "pgr.h"
+
+typedef std::function<void()> Job;
+
+/// <summary>
+/// Counts unfinished jobs of one group. Continuation is started after the last job of the group has finished
+/// and it is counted in remaining, so waiting for the counter also waits for the continuation
+/// </summary>
+struct JobCounter {
+	std::atomic<GLuint> remaining;
+	std::atomic<GLuint> jobs_left;
+	std::atomic<bool> continuation_started;
+	Job continuation;
+
+	JobCounter() : remaining(0), jobs_left(0), continuation_started(false) {}
+	JobCounter(const Job& _continuation) : remaining(0), jobs_left(0), continuation_started(false), continuation(_continuation) {}
+};
+
+/// <summary>
+/// Starts worker threads
+/// </summary>
+/// <param name="threads_count">Number of threads including the main thread. 0 means all hardware threads</param>
+void InitJobSystem(GLuint threads_count = 0);
+/// <summary>
+/// Finishes all jobs and stops worker threads
+/// </summary>
+void ShutdownJobSystem();
+/// <summary>
+/// Returns number of threads including the main thread
+/// </summary>
+GLuint GetJobThreadsCount();
+/// <summary>
+/// Starts one job. Without worker threads the job is done immediately
+/// </summary>
+/// <param name="job">Job function</param>
+/// <param name="counter">Counter of the job group. Can be null</param>
+void RunJob(const Job& job, JobCounter* counter = nullptr);
+/// <summary>
+/// Starts group of jobs. All jobs are counted before the first one starts, so continuation of the counter
+/// cannot start before the whole group is finished
+/// </summary>
+/// <param name="jobs">Job functions</param>
+/// <param name="counter">Counter of the job group</param>
+void RunJobs(const std::vector<Job>& jobs, JobCounter& counter);
+/// <summary>
+/// Waits until all jobs of the counter (and its continuation) are finished. Calling thread does jobs while waiting
+/// </summary>
+/// <param name="counter"></param>
+void WaitForCounter(JobCounter& counter);
+/// <summary>
+/// Calls body for all ranges [begin, end) of [0, count) in parallel and waits for them
+/// </summary>
+/// <param name="count">Number of elements</param>
+/// <param name="batch_size">Number of elements in one job</param>
+/// <param name="body">Function which processes one range</param>
+void ParallelFor(GLuint count, GLuint batch_size, const std::function<void(GLuint begin, GLuint end)>& body);
+
+#endif // !JOB_SYSTEM
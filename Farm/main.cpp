@@ -1,9 +1,18 @@
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <thread>
 #include "pgr.h"
 #include "render.h"
 #include "ModelContainer.h"
 #include "ShaderContainer.h"
+#include "scene_generator.h"
+#include "benchmark.h"
+#include "profiler.h"
+#include "render_stats.h"
+#include "job_system.h"
+#include "render_thread.h"
+#include "picking.h"
 
 
 int main(int argc, char** argv);
@@ -36,16 +45,17 @@ int camera_mode = 0;
 glm::vec3 movingDirection = glm::vec3(0.0f, 0.0f, -1.0f);
 GLfloat movingSpeed = 0.3f;
 
-/// <summary>
-/// Defines borders of simple 2d collider
-/// </summary>
-struct Collider2D {
-    glm::vec2 left_back_corner;
-    glm::vec2 right_forward_corner;
-};
 glm::vec2 walk_area_LB = glm::vec2(- 10.25f, 5.5f);
 glm::vec2 walk_area_RF = glm::vec2(4.75f, -13.5f);
-std::vector<Collider2D> colliders;
+/// <summary>
+/// Colliders are footprints of the scene objects between COLLIDER_MIN_HEIGHT and COLLIDER_MAX_HEIGHT,
+/// objects larger than COLLIDER_MAX_SIZE (terrain) are skipped
+/// </summary>
+ColliderGrid colliders;
+const float CAMERA_RADIUS = 0.25f;
+const float COLLIDER_MIN_HEIGHT = 0.2f;
+const float COLLIDER_MAX_HEIGHT = 2.0f;
+const float COLLIDER_MAX_SIZE = 30.0f;
 
 bool keys[1024];
 bool lockCursor = false;
@@ -57,7 +67,98 @@ enum SpecialKeys {
     KEY_DOWN_ARROW
 };
 
-int last_time;
+/// <summary>
+/// Simulation runs with fixed step, rendering interpolates between the last two simulation states
+/// </summary>
+const float SIMULATION_STEP = 1.0f / 30.0f;
+/// <summary>
+/// Longer frames are cut, so the simulation does not try to catch up after a freeze
+/// </summary>
+const float MAX_FRAME_TIME = 0.25f;
+std::chrono::steady_clock::time_point last_frame_time;
+float simulation_accumulator = 0.0f;
+/// <summary>
+/// Simulated time from the start in seconds
+/// </summary>
+double simulation_time = 0.0;
+glm::vec3 previous_walk_position;
+
+/// <summary>
+/// State which is passed to the drawing thread with every recorded frame
+/// </summary>
+GLenum polygon_mode = GL_FILL;
+bool pick_requested = false;
+GLint pick_x = 0;
+GLint pick_y = 0;
+/// <summary>
+/// Pick objects by ray casting on CPU instead of reading the object ID buffer, switched by 'k'
+/// </summary>
+bool cpu_picking = false;
+/// <summary>
+/// Draw frames only when something has changed, enabled by --on-demand and switched by 'o'.
+/// Input, camera movement, switched lights and pick requests draw the next frame, running animations
+/// draw at most animation_fps frames per second
+/// </summary>
+bool on_demand_rendering = false;
+/// <summary>
+/// Frame rate of the animations in on-demand mode, set by --animation-fps
+/// </summary>
+GLuint animation_fps = 30;
+/// <summary>
+/// Animations and time of day are frozen, switched by 'p'. Paused scene in on-demand mode draws only after input
+/// </summary>
+bool animations_paused = false;
+/// <summary>
+/// Something has changed since the last drawn frame
+/// </summary>
+bool redraw_needed = true;
+/// <summary>
+/// Object ID buffer is read a few frames after the click, so frames are drawn until the result comes
+/// </summary>
+bool pick_waiting = false;
+/// <summary>
+/// Walking camera has moved in the last simulation step
+/// </summary>
+bool walk_camera_moved = false;
+std::chrono::steady_clock::time_point last_draw_time;
+/// <summary>
+/// Scene resolution follows GPU time of the frames to hold target_fps, enabled by --dynamic-resolution and switched by 'v'
+/// </summary>
+bool dynamic_resolution_enabled = false;
+/// <summary>
+/// Frame rate held by dynamic resolution, set by --target-fps
+/// </summary>
+GLuint target_fps = 30;
+/// <summary>
+/// Sleep of the idle loop when no frame is needed
+/// </summary>
+const int ON_DEMAND_SLEEP_MS = 5;
+/// <summary>
+/// Frame recorded and drawn on the main thread when the render thread is not running
+/// </summary>
+FrameCommands main_thread_frame;
+/// <summary>
+/// Draw on the separate render thread, enabled by --render-thread
+/// </summary>
+bool use_render_thread = false;
+
+#ifdef FARM_PROFILER_ENABLED
+const char* TRACE_FILE_PATH = "trace.json";
+/// <summary>
+/// Profiler summary is shown in the window title every TITLE_UPDATE_TICKS simulation steps
+/// </summary>
+const int TITLE_UPDATE_TICKS = 15;
+int title_update_timer = 0;
+#endif
+
+/// <summary>
+/// Builds colliders from the loaded scene
+/// </summary>
+void BuildColliders() {
+  std::vector<Collider2D> footprints;
+  GetObjectFootprints(COLLIDER_MIN_HEIGHT, COLLIDER_MAX_HEIGHT, COLLIDER_MAX_SIZE, footprints);
+  colliders.Build(footprints);
+}
 
 /// <summary>
 /// Initialize main parameters of the program
@@ -66,18 +167,10 @@ void init() {
   glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
   glEnable(GL_DEPTH_TEST);
   glEnable(GL_BLEND);
-  glViewport(0, 0, glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
-
-  last_time = glutGet(GLUT_ELAPSED_TIME);
+  glViewport(0, 0, WIN_WIDTH, WIN_HEIGHT);
 
   LoadData(CONFIG_FILE_PATH);
-
-  glm::vec3 campfire_position;
-  GetCampfireData(campfire_position);
-  Collider2D collider;
-  collider.left_back_corner = glm::vec2(campfire_position.x - 1.0f, campfire_position.z + 1.0f);
-  collider.right_forward_corner = glm::vec2(campfire_position.x + 1.0f, campfire_position.z - 1.0f);
-  colliders.push_back(collider);
+  BuildColliders();
 
   camera_walk.position = glm::vec3(0.0f, 1.5f, 3.0f);
   camera_walk.direction = glm::vec3(0.0f, 0.0f, -1.0f);
@@ -116,49 +209,134 @@ void init() {
   spot_light.point.intensity = 0.0f;
 }
 
-void FollowAnimatedObject() 
+void FollowAnimatedObject(float alpha) 
 {
     glm::vec3 anim_obj_position, anim_obj_direction;
-    GetAnimObjectData(anim_obj_position, anim_obj_direction);
+    GetAnimObjectData(anim_obj_position, anim_obj_direction, alpha);
     camera_anim_obj.camera_up = glm::vec3(0.0f, 1.0f, 0.0f);
     camera_anim_obj.position = anim_obj_position - anim_obj_direction + glm::vec3(0.0f, 0.5f, 0.0f);
     camera_anim_obj.direction = glm::normalize(anim_obj_position - camera_anim_obj.position);
 }
 
-void draw() {
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-  glClearStencil(0);
-  Camera camera;
+/// <summary>
+/// Records one frame on the main thread
+/// </summary>
+/// <param name="frame">Cleared frame</param>
+/// <param name="camera"></param>
+/// <param name="current_time">Time from the start in milliseconds, defines time of day</param>
+/// <param name="alpha">Interpolation factor between the previous and the last simulation state</param>
+void PrepareFrame(FrameCommands& frame, const Camera& camera, int current_time, float alpha) {
+  float cos_val = glm::cos(current_time / 10000.0f);
+  SetNightValue((cos_val + 1) / 2);
+  direct_light.intensity = (-cos_val + 1) / 2;
+
+  frame.width = WIN_WIDTH;
+  frame.height = WIN_HEIGHT;
+  frame.polygon_mode = polygon_mode;
+  frame.target_frame_time = dynamic_resolution_enabled && target_fps > 0 ? 1000.0f / target_fps : 0.0f;
+  if (pick_requested) {
+      frame.pick_requested = true;
+      frame.pick_x = pick_x;
+      frame.pick_y = pick_y;
+      pick_requested = false;
+  }
+
+  RecordFrame(frame, direct_light, point_light, spot_light, camera, (GLfloat)WIN_WIDTH, (GLfloat)WIN_HEIGHT, alpha);
+}
+
+/// <summary>
+/// Draws recorded frame into currently bound framebuffer. Called on the thread which owns GL context
+/// </summary>
+/// <param name="frame"></param>
+void DrawFrame(const FrameCommands& frame) {
+  PROFILE_BEGIN_FRAME();
+  Draw(frame);
+  UpdatePicking();
+  RenderStatsEndFrame();
+  PROFILE_END_FRAME();
+}
+
+/// <summary>
+/// Frame of the benchmark: every frame is one simulation step with given length
+/// </summary>
+void BenchmarkFrame(const Camera& camera, int current_time, float dt) {
+  Simulate(dt);
+  main_thread_frame.Clear();
+  PrepareFrame(main_thread_frame, camera, current_time, 1.0f);
+  DrawFrame(main_thread_frame);
+}
+
+/// <summary>
+/// Returns camera of the current camera mode
+/// </summary>
+/// <param name="alpha">Interpolation factor between the last two simulation states</param>
+Camera GetCurrentCamera(float alpha) {
+  Camera walk = camera_walk;
+  walk.position = glm::mix(previous_walk_position, camera_walk.position, alpha);
+
   switch (camera_mode) {
-  case 0:
-      camera = camera_walk;
-      break;
   case 1:
-      camera = camera_1;
-      break;
+      return camera_1;
   case 2:
-      camera = camera_2;
-      break;
+      return camera_2;
   case 3:
-      camera = camera_anim_obj;
-      break;
+      return camera_anim_obj;
+  default:
+      return walk;
   }
+}
 
-  int current_time = glutGet(GLUT_ELAPSED_TIME);
-  float dt = (current_time - last_time) / 1000.0f;
-  last_time = current_time;
+/// <summary>
+/// Records frame of the current camera interpolated between the last two simulation states
+/// </summary>
+/// <param name="frame">Cleared frame</param>
+void RecordCurrentFrame(FrameCommands& frame) {
+  float alpha = simulation_accumulator / SIMULATION_STEP;
+  spot_light.point.position = glm::mix(previous_walk_position, camera_walk.position, alpha);
+  if (camera_mode == 3) FollowAnimatedObject(alpha);
+  Camera camera = GetCurrentCamera(alpha);
+
+  int current_time = (int)((simulation_time + alpha * SIMULATION_STEP) * 1000.0);
+  PrepareFrame(frame, camera, current_time, alpha);
+}
 
-  float cos_val = glm::cos(current_time / 10000.0f);
-  SetNightValue((cos_val + 1) / 2);
-  direct_light.intensity = (-cos_val + 1) / 2;
+void draw() {
+  // frames are drawn by the render thread
+  if (IsRenderThreadRunning()) return;
 
-  Draw(direct_light, point_light, spot_light, camera, (GLfloat)WIN_WIDTH, (GLfloat)WIN_HEIGHT, dt);
+  main_thread_frame.Clear();
+  RecordCurrentFrame(main_thread_frame);
+  DrawFrame(main_thread_frame);
 
   glutSwapBuffers();
 }
 
 /// <summary>
-/// Processes new position depending on the scene and colliders borders
+/// Reacts on the object clicked by mouse
+/// </summary>
+/// <param name="object_id">Object ID of the clicked pixel, NO_OBJECT_ID is background</param>
+void OnObjectPicked(GLuint object_id) {
+    if (object_id == NO_OBJECT_ID) std::cout << "clicked on background" << std::endl;
+    else std::cout << "clicked on object with ID: " << object_id << std::endl;
+
+    switch (GetPickAction(object_id)) {
+    case PICK_SWITCH_CAMPFIRE:
+        point_light.intensity = SwitchCampfire() ? 1.0f : 0.0f;
+        break;
+    case PICK_SWITCH_FOG:
+        SwitchFog();
+        break;
+    case PICK_SWITCH_ANIM_OBJECT:
+        SwitchAnimObject();
+        break;
+    default:
+        break;
+    }
+}
+
+/// <summary>
+/// Processes new position depending on the scene and colliders borders. Movement is swept,
+/// so the camera stops at the first collider on the way and slides along it
 /// </summary>
 /// <param name="old_position"></param>
 /// <param name="new_position"></param>
@@ -167,19 +345,19 @@ void ProcessNewPosition(const glm::vec3& old_position, glm::vec3& new_position)
     new_position.x = glm::clamp(new_position.x, walk_area_LB.x, walk_area_RF.x);
     new_position.z = glm::clamp(new_position.z, walk_area_RF.y, walk_area_LB.y);
 
-    for (GLuint i = 0; i < colliders.size(); i++) 
-        if (new_position.x > colliders[i].left_back_corner.x && new_position.x < colliders[i].right_forward_corner.x &&
-            new_position.z > colliders[i].right_forward_corner.y && new_position.z < colliders[i].left_back_corner.y) {
-            if (old_position.x > colliders[i].left_back_corner.x && old_position.x < colliders[i].right_forward_corner.x)
-                new_position.z = old_position.z;
-            else if (old_position.z > colliders[i].right_forward_corner.y && old_position.z < colliders[i].left_back_corner.y)
-                new_position.x = old_position.x;
-            else new_position = old_position;
-        }
+    glm::vec2 reached = colliders.Move(glm::vec2(old_position.x, old_position.z), glm::vec2(new_position.x, new_position.z), CAMERA_RADIUS);
+    new_position.x = reached.x;
+    new_position.z = reached.y;
 }
 
-void timerCallback(int)
+/// <summary>
+/// One fixed step of the simulation: moves the walking camera and advances animations
+/// </summary>
+void SimulationTick()
 {
+    PROFILE_SCOPE("Simulation");
+    previous_walk_position = camera_walk.position;
+
     glm::vec3 new_camera_pos = camera_walk.position;
     if (keys[KEY_UP_ARROW])
         new_camera_pos += movingDirection * movingSpeed;
@@ -192,20 +370,87 @@ void timerCallback(int)
 
     ProcessNewPosition(camera_walk.position, new_camera_pos);
     camera_walk.position = new_camera_pos;
+    // one more frame after the camera stops, so the last drawn position is not interpolated
+    if (walk_camera_moved) redraw_needed = true;
+    walk_camera_moved = previous_walk_position != camera_walk.position;
+    if (walk_camera_moved) redraw_needed = true;
 
-    spot_light.point.position = camera_walk.position;
-
-    if (camera_mode == 3) FollowAnimatedObject();
+    if (animations_paused) return;
+    Simulate(SIMULATION_STEP);
+    simulation_time += SIMULATION_STEP;
 
     //std::cout << "position: (" << camera_walk.position.x << ", " << camera_walk.position.y << ", " << camera_walk.position.z << ")" << std::endl;
 
-    glutTimerFunc(33, timerCallback, 0);
+#ifdef FARM_PROFILER_ENABLED
+    if (++title_update_timer >= TITLE_UPDATE_TICKS) {
+        glutSetWindowTitle(ProfilerGetSummary().c_str());
+        title_update_timer = 0;
+    }
+#endif
+}
+
+/// <summary>
+/// Returns true if on-demand mode has to draw a frame now
+/// </summary>
+/// <param name="now">Current time</param>
+bool IsFrameNeeded(std::chrono::steady_clock::time_point now)
+{
+    if (redraw_needed || pick_waiting) return true;
+    if (animations_paused || animation_fps == 0) return false;
+    return std::chrono::duration<float>(now - last_draw_time).count() >= 1.0f / animation_fps;
+}
+
+/// <summary>
+/// Runs as many simulation steps as the real time requires and redraws the scene without waiting.
+/// In on-demand mode the scene is redrawn only when IsFrameNeeded.
+/// With the render thread the frame is recorded here, while the previous frame is still being drawn
+/// </summary>
+void idleCallback()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    float frame_time = std::chrono::duration<float>(now - last_frame_time).count();
+    last_frame_time = now;
+
+    simulation_accumulator += glm::min(frame_time, MAX_FRAME_TIME);
+    while (simulation_accumulator >= SIMULATION_STEP) {
+        SimulationTick();
+        simulation_accumulator -= SIMULATION_STEP;
+    }
+
+    GLuint picked_id;
+    if (TakePickResult(picked_id)) {
+        OnObjectPicked(picked_id);
+        pick_waiting = false;
+        redraw_needed = true;
+    }
+    if (TakeSceneChanged()) redraw_needed = true;
 
-    glutPostRedisplay();
+    if (on_demand_rendering && !IsFrameNeeded(now)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ON_DEMAND_SLEEP_MS));
+        return;
+    }
+
+    if (!IsRenderThreadRunning()) {
+        glutPostRedisplay();
+        redraw_needed = false;
+        last_draw_time = now;
+        return;
+    }
+    FrameCommands* frame = BeginFrameRecording();
+    if (frame == nullptr) {
+        // render thread has not taken the previous frame yet
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return;
+    }
+    RecordCurrentFrame(*frame);
+    SubmitFrame();
+    redraw_needed = false;
+    last_draw_time = now;
 }
 
 void specialKeyboardCallback(int specKeyPressed, int mouseX, int mouseY) 
 {
+    redraw_needed = true;
     switch (specKeyPressed) {
     case GLUT_KEY_RIGHT:
         keys[KEY_RIGHT_ARROW] = true;
@@ -226,6 +471,7 @@ void specialKeyboardCallback(int specKeyPressed, int mouseX, int mouseY)
 
 void specialKeyboardUpCallback(int specKeyReleased, int mouseX, int mouseY) 
 {
+    redraw_needed = true;
     switch (specKeyReleased) {
     case GLUT_KEY_RIGHT:
         keys[KEY_RIGHT_ARROW] = false;
@@ -247,6 +493,7 @@ void specialKeyboardUpCallback(int specKeyReleased, int mouseX, int mouseY)
 void mouseMove(int x, int y) {
 
     if (camera_mode != 0) return;
+    redraw_needed = true;
 
     yaw+= ((GLfloat)x - xOrigin) * 0.1f;
     pitch -= ((GLfloat)y - yOrigin) * 0.1f;
@@ -274,10 +521,16 @@ void mouseMove(int x, int y) {
 
 void keyboardCallback(unsigned char keyPressed, int mouseX, int mouseY) 
 {
+    redraw_needed = true;
     switch (keyPressed)
     {
     case 27:
+        StopRenderThread();
+#ifdef FARM_PROFILER_ENABLED
+        ProfilerRelease();
+#endif
         ClearData();
+        ShutdownJobSystem();
 #ifndef __APPLE__
         glutLeaveMainLoop();
 #else
@@ -296,8 +549,11 @@ void keyboardCallback(unsigned char keyPressed, int mouseX, int mouseY)
         lockCursor = !lockCursor;
         break;
     case 'r':
+        StopRenderThread();
         ClearData();
         LoadData(CONFIG_FILE_PATH);
+        BuildColliders();
+        if (use_render_thread) StartRenderThread(DrawFrame);
         break;
     case 'w':
         keys[KEY_UP_ARROW] = true;
@@ -319,15 +575,15 @@ void keyboardCallback(unsigned char keyPressed, int mouseX, int mouseY)
         break;
     case '1':
         if (keys['c']) camera_mode = 0;
-        if (keys['m']) glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        if (keys['m']) polygon_mode = GL_FILL;
         break;
     case '2':
         if (keys['c']) camera_mode = 1;
-        if (keys['m']) glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        if (keys['m']) polygon_mode = GL_LINE;
         break;
     case '3':
         if (keys['c']) camera_mode = 2;
-        if (keys['m']) glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
+        if (keys['m']) polygon_mode = GL_POINT;
         break;
     case '4':
         if (keys['c']) camera_mode = 3;
@@ -335,10 +591,47 @@ void keyboardCallback(unsigned char keyPressed, int mouseX, int mouseY)
     case 'g':
         SwitchFog();
         break;
+    case 'k':
+        cpu_picking = !cpu_picking;
+        std::cout << (cpu_picking ? "picking: CPU ray casting" : "picking: object ID buffer") << std::endl;
+        break;
     case 'l':
         spot_light.point.intensity += 1.0;
         if (spot_light.point.intensity > 10) spot_light.point.intensity = 0;
         break;
+    case 'v':
+        dynamic_resolution_enabled = !dynamic_resolution_enabled;
+        // render scale is chosen by the next frame, so it is drawn even in on-demand mode
+        redraw_needed = true;
+        std::cout << (dynamic_resolution_enabled ? "dynamic resolution: on" : "dynamic resolution: off") << std::endl;
+        break;
+    case 'o':
+        on_demand_rendering = !on_demand_rendering;
+        std::cout << (on_demand_rendering ? "rendering: on demand" : "rendering: continuous") << std::endl;
+        break;
+    case 'u':
+        SwitchOcclusionCulling();
+        break;
+    case 'i':
+        SwitchImpostors();
+        // views are baked when impostors are enabled for the first time, baking needs GL context on this thread
+        if (NeedsImpostors()) {
+            StopRenderThread();
+            std::cout << "baking impostors" << std::endl;
+            if (!LoadImpostors())
+                std::cout << "failed bake impostors" << std::endl;
+            if (use_render_thread) StartRenderThread(DrawFrame);
+        }
+        break;
+    case 'p':
+        animations_paused = !animations_paused;
+        std::cout << (animations_paused ? "animations paused" : "animations resumed") << std::endl;
+        break;
+#ifdef FARM_PROFILER_ENABLED
+    case 't':
+        ProfilerToggleCapture(TRACE_FILE_PATH);
+        break;
+#endif
     default:
         break;
     }    
@@ -346,6 +639,7 @@ void keyboardCallback(unsigned char keyPressed, int mouseX, int mouseY)
 
 void keyboardUpCallback(unsigned char keyReleased, int mouseX, int mouseY)
 {
+    redraw_needed = true;
     switch (keyReleased)
     {
     case 'w':
@@ -373,40 +667,225 @@ void keyboardUpCallback(unsigned char keyReleased, int mouseX, int mouseY)
 
 void reshapeCallback(int newWidth, int newHeight) {
 
+    // viewport is set by the frame
     WIN_WIDTH = newWidth;
     WIN_HEIGHT = newHeight;
-
-    glViewport(0, 0, (GLsizei)newWidth, (GLsizei)newHeight);
+    redraw_needed = true;
 }
 
 void mouseCallback(int button, int state, int x, int y) {
-    // do picking only on mouse down
-    if (state == GLUT_DOWN) {
-        unsigned char pixelID;
-        glReadPixels(x, WIN_HEIGHT - 1 - y, 1, 1, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, &pixelID);
-
-        if (pixelID == 0) std::cout << "clicked on background" << std::endl;
-        else std::cout << "clicked on object with ID: " << (int)pixelID << std::endl;
-
-        switch (pixelID) {
-        case 1:
-            point_light.intensity = SwitchCampfire() ? 1.0f : 0.0f;
-            break;
-        case 2:
-            SwitchFog();
-            break;
-        case 3:
-            SwitchAnimObject();
-            break;
-        default:
-            break;
+    if (state != GLUT_DOWN) return;
+    redraw_needed = true;
+
+    if (cpu_picking) {
+        // ray casting gives the result immediately, the camera is the one of the last recorded frame
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        RayHit hit;
+        bool found = RaycastScene(GetCurrentCamera(simulation_accumulator / SIMULATION_STEP), WIN_WIDTH, WIN_HEIGHT, x, WIN_HEIGHT - 1 - y, hit);
+        double time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        if (found) {
+            std::cout << "ray hit: point (" << hit.point.x << ", " << hit.point.y << ", " << hit.point.z << "), normal ("
+                << hit.normal.x << ", " << hit.normal.y << ", " << hit.normal.z << "), " << time << " us" << std::endl;
         }
+        OnObjectPicked(found ? hit.object + 1 : NO_OBJECT_ID);
+        return;
+    }
 
+    // object ID is copied after the next frame is drawn and read a few frames later
+    pick_requested = true;
+    pick_waiting = true;
+    pick_x = x;
+    pick_y = WIN_HEIGHT - 1 - y;
+}
+
+/// <summary>
+/// Returns value of the command line option or nullptr if the option is missing
+/// </summary>
+/// <param name="name">Name of the option</param>
+const char* GetOption(int argc, char** argv, const char* name) {
+    for (int i = 1; i + 1 < argc; i++)
+        if (std::string(argv[i]) == name)
+            return argv[i + 1];
+    return nullptr;
+}
+
+/// <summary>
+/// Returns true if the command line contains the flag
+/// </summary>
+/// <param name="name">Name of the flag</param>
+bool HasOption(int argc, char** argv, const char* name) {
+    for (int i = 1; i < argc; i++)
+        if (std::string(argv[i]) == name)
+            return true;
+    return false;
+}
+
+/// <summary>
+/// Returns value of the command line option as unsigned number
+/// </summary>
+/// <param name="name">Name of the option</param>
+/// <param name="value">Returned value. Stays unchanged if the option is missing</param>
+void GetOption(int argc, char** argv, const char* name, GLuint& value) {
+    const char* option = GetOption(argc, argv, name);
+    if (option != nullptr) value = (GLuint)std::strtoul(option, nullptr, 10);
+}
+
+/// <summary>
+/// Renders frames offscreen along the path through all fixed cameras and saves the results.
+/// Uses EGL context without window if it is available, otherwise hidden GLUT window
+/// </summary>
+/// <returns>Returns exit code of the program</returns>
+int RunBenchmarkMode(int argc, char** argv) {
+    BenchmarkSettings settings;
+    GetOption(argc, argv, "--frames", settings.frames);
+    GetOption(argc, argv, "--width", settings.width);
+    GetOption(argc, argv, "--height", settings.height);
+    const char* output_path = GetOption(argc, argv, "--output");
+    if (output_path != nullptr) settings.output_path = output_path;
+    WIN_WIDTH = settings.width;
+    WIN_HEIGHT = settings.height;
+
+    bool headless = CreateHeadlessContext();
+    if (!headless) {
+        glutInit(&argc, argv);
+        glutInitContextVersion(pgr::OGL_VER_MAJOR, pgr::OGL_VER_MINOR);
+        glutInitContextFlags(GLUT_FORWARD_COMPATIBLE);
+        glutInitDisplayMode(GLUT_RGB | GLUT_DEPTH);
+        glutCreateWindow(WIN_TITLE);
+        glutHideWindow();
     }
+
+    if (!pgr::initialize(pgr::OGL_VER_MAJOR, pgr::OGL_VER_MINOR))
+        pgr::dieWithError("pgr init failed, required OpenGL not supported?");
+
+    InitJobSystem();
+    init();
+
+    Camera keyframes[] = { camera_walk, camera_1, camera_2 };
+    BenchmarkResult result;
+    bool succeeded = RunBenchmark(settings, keyframes, 3, BenchmarkFrame, result);
+    if (succeeded)
+        std::cout << "frames: " << result.frames << ", p50: " << result.p50 << " ms, p95: " << result.p95
+            << " ms, p99: " << result.p99 << " ms, draw calls: " << result.draw_calls_per_frame << std::endl;
+#ifdef FARM_PROFILER_ENABLED
+    std::cout << ProfilerGetSummary() << std::endl;
+    ProfilerRelease();
+#endif
+
+    ClearData();
+    ShutdownJobSystem();
+    if (headless) DestroyHeadlessContext();
+    return succeeded ? 0 : 1;
 }
 
 int main(int argc, char** argv) {
+
+    // Farm.exe --generate <output file> [--seed N] [--crops N] [--fence-rings N] [--props N] [--lights N]
+    if (argc >= 3 && std::string(argv[1]) == "--generate") {
+        GeneratorSettings settings;
+        GetOption(argc, argv, "--seed", settings.seed);
+        GetOption(argc, argv, "--crops", settings.crops);
+        GetOption(argc, argv, "--fence-rings", settings.fence_rings);
+        GetOption(argc, argv, "--props", settings.props);
+        GetOption(argc, argv, "--lights", settings.lights);
+        if (!GenerateSceneFile(settings, argv[2])) return 1;
+        std::cout << "generated scene saved: " << argv[2] << std::endl;
+        return 0;
+    }
+
+    // Farm.exe [--scene <configure file or binary scene file>]
+    const char* scene_path = GetOption(argc, argv, "--scene");
+    if (scene_path != nullptr) CONFIG_FILE_PATH = scene_path;
+
+    // Farm.exe --job-bench <configure file or binary scene file> [--frames N] [--threads N]
+    if (argc >= 3 && std::string(argv[1]) == "--job-bench") {
+        GLuint frames = 100;
+        GLuint threads = 0;
+        GetOption(argc, argv, "--frames", frames);
+        GetOption(argc, argv, "--threads", threads);
+        return RunJobBenchmark(argv[2], frames, threads) ? 0 : 1;
+    }
+
+    // Farm.exe --collision-bench [--colliders N] [--queries N] [--seed N]
+    if (argc >= 2 && std::string(argv[1]) == "--collision-bench") {
+        GLuint colliders_count = 100000;
+        GLuint queries_count = 100000;
+        GLuint seed = 1;
+        GetOption(argc, argv, "--colliders", colliders_count);
+        GetOption(argc, argv, "--queries", queries_count);
+        GetOption(argc, argv, "--seed", seed);
+        return RunCollisionBenchmark(colliders_count, queries_count, seed) ? 0 : 1;
+    }
+
+    // Farm.exe --pick-bench <configure file or binary scene file> [--picks N] [--seed N]
+    if (argc >= 3 && std::string(argv[1]) == "--pick-bench") {
+        GLuint picks_count = 10000;
+        GLuint seed = 1;
+        GetOption(argc, argv, "--picks", picks_count);
+        GetOption(argc, argv, "--seed", seed);
+        return RunPickBenchmark(argv[2], picks_count, seed) ? 0 : 1;
+    }
+
+    // Farm.exe --simd-bench [--objects N] [--iterations N]
+    if (argc >= 2 && std::string(argv[1]) == "--simd-bench") {
+        GLuint objects_count = 100000;
+        GLuint iterations = 100;
+        GetOption(argc, argv, "--objects", objects_count);
+        GetOption(argc, argv, "--iterations", iterations);
+        return RunSimdBenchmark(objects_count, iterations) ? 0 : 1;
+    }
+
+    // Farm.exe --occlusion-bench [--objects N] [--iterations N] [--threads N]
+    if (argc >= 2 && std::string(argv[1]) == "--occlusion-bench") {
+        GLuint objects_count = 10000;
+        GLuint iterations = 100;
+        GLuint threads = 0;
+        GetOption(argc, argv, "--objects", objects_count);
+        GetOption(argc, argv, "--iterations", iterations);
+        GetOption(argc, argv, "--threads", threads);
+        return RunOcclusionBenchmark(objects_count, iterations, threads) ? 0 : 1;
+    }
+
+    // Farm.exe --benchmark [--frames N] [--width N] [--height N] [--output path without extension]
+    if (argc >= 2 && std::string(argv[1]) == "--benchmark")
+        return RunBenchmarkMode(argc, argv);
+
+    // Farm.exe --convert <config file> [binary scene file]
+    if (argc >= 3 && std::string(argv[1]) == "--convert") {
+        std::string snapshot_path = argc >= 4 ? argv[3] : GetSnapshotPath(argv[2]);
+        if (!ConvertConfigToSnapshot(argv[2], snapshot_path)) return 1;
+        std::cout << "binary scene saved: " << snapshot_path << std::endl;
+        return 0;
+    }
     
+    // Farm.exe [--stats <frames between dumps> [--stats-csv <file>]]
+    GLuint stats_interval = 0;
+    GetOption(argc, argv, "--stats", stats_interval);
+    const char* stats_path = GetOption(argc, argv, "--stats-csv");
+    SetRenderStatsDump(stats_interval, stats_path != nullptr ? stats_path : "");
+
+    // Farm.exe [--render-thread]
+    use_render_thread = HasOption(argc, argv, "--render-thread");
+
+    // Farm.exe [--on-demand [--animation-fps N]]
+    on_demand_rendering = HasOption(argc, argv, "--on-demand");
+    GetOption(argc, argv, "--animation-fps", animation_fps);
+
+    // Farm.exe [--dynamic-resolution [--target-fps N]]
+    dynamic_resolution_enabled = HasOption(argc, argv, "--dynamic-resolution");
+    GetOption(argc, argv, "--target-fps", target_fps);
+
+    // Farm.exe [--gpu-culling]
+    SetGpuCulling(HasOption(argc, argv, "--gpu-culling"));
+
+    // Farm.exe [--occlusion-culling]
+    SetOcclusionCulling(HasOption(argc, argv, "--occlusion-culling"));
+
+    // Farm.exe [--impostors [--impostor-distance N]]
+    GLuint impostor_distance = 0;
+    GetOption(argc, argv, "--impostor-distance", impostor_distance);
+    SetImpostors(HasOption(argc, argv, "--impostors"), (float)impostor_distance);
+
     glutInit(&argc, argv);
 
     glutInitContextVersion(pgr::OGL_VER_MAJOR, pgr::OGL_VER_MINOR);
@@ -424,12 +903,16 @@ int main(int argc, char** argv) {
     glutReshapeFunc(reshapeCallback);
     glutMouseFunc(mouseCallback);
     
-    glutTimerFunc(33, timerCallback, 0);
+    glutIdleFunc(idleCallback);
 
     if(!pgr::initialize(pgr::OGL_VER_MAJOR, pgr::OGL_VER_MINOR))
       pgr::dieWithError("pgr init failed, required OpenGL not supported?");
 
+    InitJobSystem();
     init();
+    previous_walk_position = camera_walk.position;
+    last_frame_time = std::chrono::steady_clock::now();
+    if (use_render_thread && !StartRenderThread(DrawFrame)) use_render_thread = false;
 
     glutMainLoop();
 
@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+#include "mesh_clusters.h"
+
+/// <summary>
+/// Triangle joins the cluster only if its normal is closer to the cluster normal than this cosine, so the normal cone stays narrow
+/// </summary>
+static const float CLUSTER_NORMAL_COS = 0.7f;
+/// <summary>
+/// Small cluster takes triangles which do not touch it up to this part of the model radius from its first triangle
+/// </summary>
+static const float CLUSTER_GATHER_RADIUS = 0.25f;
+/// <summary>
+/// Cone cutoff of the clusters which are never back-facing
+/// </summary>
+static const float CONE_DISABLED = 2.0f;
+
+/// <summary>
+/// Returns position of the vertex from the array of vertices
+/// </summary>
+static glm::vec3 GetPosition(const float* positions, GLuint stride, GLuint index)
+{
+	const float* position = positions + index * stride;
+	return glm::vec3(position[0], position[1], position[2]);
+}
+
+/// <summary>
+/// Maps every vertex to the first vertex with the same position. Vertices are split on normal and texture seams,
+/// the welded ones show which triangles really touch
+/// </summary>
+static void WeldVertices(const float* positions, GLuint stride, GLuint vertices_count, std::vector<GLuint>& welded)
+{
+	std::vector<GLuint> order(vertices_count);
+	for (GLuint i = 0; i < vertices_count; i++) order[i] = i;
+	auto less = [positions, stride](GLuint a, GLuint b) {
+		const float* pa = positions + a * stride;
+		const float* pb = positions + b * stride;
+		if (pa[0] != pb[0]) return pa[0] < pb[0];
+		if (pa[1] != pb[1]) return pa[1] < pb[1];
+		if (pa[2] != pb[2]) return pa[2] < pb[2];
+		return a < b;
+	};
+	std::sort(order.begin(), order.end(), less);
+
+	welded.resize(vertices_count);
+	for (GLuint i = 0; i < vertices_count; i++) {
+		const float* current = positions + order[i] * stride;
+		const float* first = i > 0 ? positions + welded[order[i - 1]] * stride : nullptr;
+		bool same = first != nullptr && current[0] == first[0] && current[1] == first[1] && current[2] == first[2];
+		welded[order[i]] = same ? welded[order[i - 1]] : order[i];
+	}
+}
+
+/// <summary>
+/// Finds parts of the mesh connected by vertices and returns orientation of every part: 1 if the part is closed and
+/// its normals point outside, -1 if they point inside, 0 if the part is open or its triangles are not oriented the same way
+/// </summary>
+static void GetPartOrientations(const float* positions, GLuint stride, const std::vector<GLuint>& welded, const std::vector<GLuint>& indices,
+	std::vector<GLuint>& triangle_parts, std::vector<int>& orientations)
+{
+	GLuint triangles_count = (GLuint)indices.size() / 3;
+	// parts of the welded vertices, joined by every triangle
+	std::vector<GLuint> parents(welded.size());
+	for (GLuint i = 0; i < parents.size(); i++) parents[i] = i;
+	auto find = [&parents](GLuint vertex) {
+		while (parents[vertex] != vertex) vertex = parents[vertex] = parents[parents[vertex]];
+		return vertex;
+	};
+	for (GLuint i = 0; i < triangles_count; i++) {
+		GLuint root = find(welded[indices[i * 3]]);
+		for (GLuint vertex = 1; vertex < 3; vertex++) parents[find(welded[indices[i * 3 + vertex]])] = root;
+	}
+	std::vector<GLuint> part_ids(welded.size(), 0xFFFFFFFF);
+	triangle_parts.resize(triangles_count);
+	GLuint parts_count = 0;
+	for (GLuint i = 0; i < triangles_count; i++) {
+		GLuint root = find(welded[indices[i * 3]]);
+		if (part_ids[root] == 0xFFFFFFFF) part_ids[root] = parts_count++;
+		triangle_parts[i] = part_ids[root];
+	}
+
+	// closed part has as many opposite edges as the edges, touching closed parts share edges but stay closed
+	std::vector<double> volumes(parts_count, 0.0);
+	std::vector<bool> closed(parts_count, true);
+	std::vector<GLuint64> edges;
+	edges.reserve(triangles_count * 3);
+	for (GLuint i = 0; i < triangles_count; i++)
+	{
+		GLuint vertices[3] = { welded[indices[i * 3]], welded[indices[i * 3 + 1]], welded[indices[i * 3 + 2]] };
+		for (GLuint edge = 0; edge < 3; edge++)
+			edges.push_back(((GLuint64)vertices[edge] << 32) | vertices[(edge + 1) % 3]);
+		glm::vec3 a = GetPosition(positions, stride, vertices[0]);
+		glm::vec3 b = GetPosition(positions, stride, vertices[1]);
+		glm::vec3 c = GetPosition(positions, stride, vertices[2]);
+		volumes[triangle_parts[i]] += glm::dot(a, glm::cross(b, c));
+	}
+	std::sort(edges.begin(), edges.end());
+	for (GLuint i = 0; i < edges.size();) {
+		GLuint end = i + 1;
+		while (end < edges.size() && edges[end] == edges[i]) end++;
+		GLuint64 opposite = (edges[i] << 32) | (edges[i] >> 32);
+		auto opposites = std::equal_range(edges.begin(), edges.end(), opposite);
+		if (opposites.second - opposites.first != end - i) closed[part_ids[find((GLuint)(edges[i] >> 32))]] = false;
+		i = end;
+	}
+
+	orientations.resize(parts_count);
+	for (GLuint i = 0; i < parts_count; i++)
+		orientations[i] = !closed[i] || volumes[i] == 0.0 ? 0 : (volumes[i] > 0.0 ? 1 : -1);
+}
+
+void BuildMeshClusters(const float* positions, GLuint stride, GLuint vertices_count, std::vector<GLuint>& indices, std::vector<MeshCluster>& clusters)
+{
+	clusters.clear();
+	GLuint triangles_count = (GLuint)indices.size() / 3;
+	if (triangles_count < CLUSTER_MESH_MIN_TRIANGLES) return;
+
+	std::vector<GLuint> welded;
+	WeldVertices(positions, stride, vertices_count, welded);
+	// back faces are hidden only inside of closed parts, and only the outer side of the triangles is the front
+	std::vector<GLuint> triangle_parts;
+	std::vector<int> orientations;
+	GetPartOrientations(positions, stride, welded, indices, triangle_parts, orientations);
+
+	std::vector<glm::vec3> normals(triangles_count);
+	for (GLuint i = 0; i < triangles_count; i++)
+	{
+		glm::vec3 a = GetPosition(positions, stride, indices[i * 3]);
+		glm::vec3 b = GetPosition(positions, stride, indices[i * 3 + 1]);
+		glm::vec3 c = GetPosition(positions, stride, indices[i * 3 + 2]);
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		float length = glm::length(normal);
+		normals[i] = length > 0.0f ? normal * ((float)(orientations[triangle_parts[i]] < 0 ? -1 : 1) / length) : glm::vec3(0.0f);
+	}
+
+	std::vector<glm::vec3> centroids(triangles_count);
+	glm::vec3 model_min = glm::vec3(FLT_MAX), model_max = glm::vec3(-FLT_MAX);
+	for (GLuint i = 0; i < triangles_count; i++)
+	{
+		glm::vec3 a = GetPosition(positions, stride, indices[i * 3]);
+		glm::vec3 b = GetPosition(positions, stride, indices[i * 3 + 1]);
+		glm::vec3 c = GetPosition(positions, stride, indices[i * 3 + 2]);
+		centroids[i] = (a + b + c) / 3.0f;
+		model_min = glm::min(model_min, glm::min(a, glm::min(b, c)));
+		model_max = glm::max(model_max, glm::max(a, glm::max(b, c)));
+	}
+	float gather_distance = glm::length(model_max - model_min) * 0.5f * CLUSTER_GATHER_RADIUS;
+
+	// triangles of every welded vertex
+	std::vector<GLuint> vertex_offsets(vertices_count + 1, 0);
+	for (GLuint index : indices) vertex_offsets[welded[index] + 1]++;
+	for (GLuint i = 0; i < vertices_count; i++) vertex_offsets[i + 1] += vertex_offsets[i];
+	std::vector<GLuint> vertex_triangles(indices.size());
+	std::vector<GLuint> fill(vertex_offsets.begin(), vertex_offsets.end() - 1);
+	for (GLuint i = 0; i < indices.size(); i++) vertex_triangles[fill[welded[indices[i]]]++] = i / 3;
+
+	// clusters grow from the first free triangle over shared vertices. Boxy models have small flat areas,
+	// so a small cluster also takes the nearest free triangle with similar normal and grows from it
+	std::vector<bool> assigned(triangles_count, false);
+	std::vector<GLuint> cluster_triangles;
+	std::vector<GLuint> reordered;
+	reordered.reserve(indices.size());
+	for (GLuint seed = 0; seed < triangles_count; seed++)
+	{
+		if (assigned[seed]) continue;
+		cluster_triangles.clear();
+		cluster_triangles.push_back(seed);
+		assigned[seed] = true;
+		glm::vec3 normal_sum = normals[seed];
+		GLuint next = 0;
+		while (cluster_triangles.size() < CLUSTER_MAX_TRIANGLES)
+		{
+			glm::vec3 axis = glm::length(normal_sum) > 0.0f ? glm::normalize(normal_sum) : glm::vec3(0.0f);
+			if (next == cluster_triangles.size()) {
+				if (cluster_triangles.size() >= CLUSTER_MIN_TRIANGLES) break;
+				GLuint nearest = triangles_count;
+				float nearest_distance = gather_distance;
+				for (GLuint i = seed + 1; i < triangles_count; i++) {
+					if (assigned[i] || glm::dot(normals[i], axis) < CLUSTER_NORMAL_COS) continue;
+					float distance = glm::length(centroids[i] - centroids[seed]);
+					if (distance <= nearest_distance) {
+						nearest = i;
+						nearest_distance = distance;
+					}
+				}
+				if (nearest == triangles_count) break;
+				assigned[nearest] = true;
+				cluster_triangles.push_back(nearest);
+				normal_sum += normals[nearest];
+				continue;
+			}
+			GLuint triangle = cluster_triangles[next++];
+			for (GLuint vertex = 0; vertex < 3 && cluster_triangles.size() < CLUSTER_MAX_TRIANGLES; vertex++) {
+				GLuint welded_vertex = welded[indices[triangle * 3 + vertex]];
+				for (GLuint i = vertex_offsets[welded_vertex]; i < vertex_offsets[welded_vertex + 1] && cluster_triangles.size() < CLUSTER_MAX_TRIANGLES; i++) {
+					GLuint neighbour = vertex_triangles[i];
+					if (assigned[neighbour] || glm::dot(normals[neighbour], axis) < CLUSTER_NORMAL_COS) continue;
+					assigned[neighbour] = true;
+					cluster_triangles.push_back(neighbour);
+					normal_sum += normals[neighbour];
+				}
+			}
+		}
+
+		MeshCluster cluster;
+		cluster.first_index = (GLuint)reordered.size();
+		cluster.index_count = (GLuint)cluster_triangles.size() * 3;
+		BoundingBox box = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+		for (GLuint triangle : cluster_triangles)
+			for (GLuint vertex = 0; vertex < 3; vertex++) {
+				GLuint index = indices[triangle * 3 + vertex];
+				reordered.push_back(index);
+				glm::vec3 position = GetPosition(positions, stride, index);
+				box.min = glm::min(box.min, position);
+				box.max = glm::max(box.max, position);
+			}
+		glm::vec3 center = (box.min + box.max) * 0.5f;
+		float radius = 0.0f;
+		for (GLuint i = cluster.first_index; i < reordered.size(); i++)
+			radius = std::max(radius, glm::length(GetPosition(positions, stride, reordered[i]) - center));
+		cluster.sphere = glm::vec4(center, radius);
+
+		// cone has to contain every normal, degenerate triangles are not drawn anyway
+		cluster.cone_axis = glm::length(normal_sum) > 0.0f ? glm::normalize(normal_sum) : glm::vec3(0.0f, 1.0f, 0.0f);
+		float min_cos = 1.0f;
+		bool closed = true;
+		for (GLuint triangle : cluster_triangles) {
+			if (normals[triangle] != glm::vec3(0.0f)) min_cos = std::min(min_cos, glm::dot(normals[triangle], cluster.cone_axis));
+			closed = closed && orientations[triangle_parts[triangle]] != 0;
+		}
+		cluster.cone_cutoff = closed && min_cos > 0.0f ? std::sqrt(1.0f - min_cos * min_cos) : CONE_DISABLED;
+		clusters.push_back(cluster);
+	}
+	indices.swap(reordered);
+}
+
+GLuint CullMeshClusters(const std::vector<MeshCluster>& clusters, const glm::mat4& world_matrix, const Frustum& frustum, const glm::vec3& camera_position,
+	std::vector<ClusterRange>& ranges)
+{
+	// tests run in model space, planes are not normalized there, so the distances are scaled by the normal length
+	glm::mat4 transposed = glm::transpose(world_matrix);
+	glm::vec4 planes[6];
+	float plane_scales[6];
+	for (int i = 0; i < 6; i++) {
+		planes[i] = transposed * frustum.planes[i];
+		plane_scales[i] = glm::length(glm::vec3(planes[i]));
+	}
+	glm::vec3 camera = glm::vec3(glm::inverse(world_matrix) * glm::vec4(camera_position, 1.0f));
+	// non-uniform scale bends the normals, so the cones of model space normals do not hold in world space
+	float scale_x = glm::length(glm::vec3(world_matrix[0]));
+	float scale_y = glm::length(glm::vec3(world_matrix[1]));
+	float scale_z = glm::length(glm::vec3(world_matrix[2]));
+	float max_scale = std::max(scale_x, std::max(scale_y, scale_z));
+	float min_scale = std::min(scale_x, std::min(scale_y, scale_z));
+	bool cone_test = max_scale - min_scale <= max_scale * 1e-3f;
+
+	GLuint appended = 0;
+	for (const MeshCluster& cluster : clusters)
+	{
+		glm::vec3 center = glm::vec3(cluster.sphere);
+		bool visible = true;
+		for (int i = 0; i < 6 && visible; i++)
+			visible = glm::dot(glm::vec3(planes[i]), center) + planes[i].w >= -cluster.sphere.w * plane_scales[i];
+		// every point of the sphere sees the cluster from behind
+		if (visible && cone_test && cluster.cone_cutoff <= 1.0f) {
+			glm::vec3 direction = center - camera;
+			visible = glm::dot(direction, cluster.cone_axis) < cluster.cone_cutoff * glm::length(direction) + cluster.sphere.w;
+		}
+		if (!visible) continue;
+
+		if (appended > 0 && ranges.back().first_index + ranges.back().index_count == cluster.first_index) {
+			ranges.back().index_count += cluster.index_count;
+			continue;
+		}
+		ClusterRange range;
+		range.first_index = cluster.first_index;
+		range.index_count = cluster.index_count;
+		ranges.push_back(range);
+		appended++;
+	}
+	return appended;
+}
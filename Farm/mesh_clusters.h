@@ -0,0 +1,78 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       mesh_clusters.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines splitting of the meshes into clusters and culling of the clusters
+ *
+ * Triangles of the mesh are grouped into clusters of CLUSTER_MIN_TRIANGLES to
+ * CLUSTER_MAX_TRIANGLES connected triangles with similar normals, and the index buffer is
+ * reordered, so every cluster is one range of indices. Every cluster keeps its bounding
+ * sphere and the cone of its normals in model space. Clusters outside the frustum are
+ * dropped, clusters of closed parts of the meshes are also dropped when all their triangles face away
+ * from the camera. Objects are drawn without face culling, so back faces of open parts
+ * can be seen and their clusters are never dropped as back-facing.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef MESH_CLUSTERS_H
+#define MESH_CLUSTERS_H
+
+#include <vector>
+
+#include "pgr.h"
+#include "culling.h"
+#include "frame_commands.h"
+
+/// <summary>
+/// Size of one cluster in triangles. Smaller clusters are made only from the parts of the mesh which are not connected
+/// </summary>
+const GLuint CLUSTER_MIN_TRIANGLES = 64;
+const GLuint CLUSTER_MAX_TRIANGLES = 128;
+/// <summary>
+/// Smaller meshes are not split, testing their clusters costs more than drawing them whole
+/// </summary>
+const GLuint CLUSTER_MESH_MIN_TRIANGLES = 4 * CLUSTER_MAX_TRIANGLES;
+
+/// <summary>
+/// Range of the mesh indices with its bounds in model space
+/// </summary>
+struct MeshCluster {
+	/// <summary>
+	/// Bounding sphere (x, y, z - center, w - radius)
+	/// </summary>
+	glm::vec4 sphere;
+	/// <summary>
+	/// Average normal of the triangles
+	/// </summary>
+	glm::vec3 cone_axis;
+	/// <summary>
+	/// Sine of the largest angle between the axis and the normals. Greater than one if the cluster is never back-facing
+	/// </summary>
+	float cone_cutoff;
+	GLuint first_index;
+	GLuint index_count;
+};
+
+/// <summary>
+/// Groups triangles into clusters and reorders the indices, so every cluster is one range
+/// </summary>
+/// <param name="positions">Positions of the vertices in model space</param>
+/// <param name="stride">Number of floats between two positions</param>
+/// <param name="vertices_count">Number of vertices</param>
+/// <param name="indices">Three indices for every triangle, reordered by clusters</param>
+/// <param name="clusters">Returned clusters in the order of their ranges. Empty if the mesh is too small to be split</param>
+void BuildMeshClusters(const float* positions, GLuint stride, GLuint vertices_count, std::vector<GLuint>& indices, std::vector<MeshCluster>& clusters);
+/// <summary>
+/// Appends index ranges of the clusters visible from the camera. Neighbouring visible clusters are merged into one range.
+/// Back-facing clusters are culled only when the world matrix scales uniformly
+/// </summary>
+/// <param name="clusters">Clusters of the model</param>
+/// <param name="world_matrix">World matrix of the object</param>
+/// <param name="frustum">View frustum in world space</param>
+/// <param name="camera_position">Position of the camera in world space</param>
+/// <param name="ranges">Ranges of the visible indices are appended</param>
+/// <returns>Returns number of the appended ranges</returns>
+GLuint CullMeshClusters(const std::vector<MeshCluster>& clusters, const glm::mat4& world_matrix, const Frustum& frustum, const glm::vec3& camera_position,
+	std::vector<ClusterRange>& ranges);
+
+#endif // !MESH_CLUSTERS_H
@@ -4,8 +4,11 @@ in vec3 Normal;
 in vec3 FragPos;
 in vec2 TexCoords;
 in vec2 FogTexCoords;
+flat in uint ObjectId;
 
-out vec4 color;
+layout(location = 0) out vec4 color;
+// id of the object for picking, written only while the scene pass enables the second draw buffer
+layout(location = 1) out uint object_id_color;
 
 struct Material {
     sampler2D diffuse;
@@ -39,13 +42,20 @@ struct SpotLight {
     float cut_off;
 };
 
+layout(std140) uniform CameraBlock {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 viewPos;
+    bool fog;
+};
+layout(std140) uniform LightsBlock {
+    DirectLight direct_light;
+    PointLight point_light;
+    SpotLight spot_light;
+};
+
 uniform Material material;
-uniform DirectLight direct_light;
-uniform PointLight point_light;
-uniform SpotLight spot_light;
-uniform vec3 viewPos;
 uniform sampler2D fog_texture;
-uniform bool fog;
 
 vec3 CalculateDiffuse(vec3 material_diffuse, vec3 light_diffuse, vec3 light_direction, vec3 normal){
     float diffuse_value = max(dot(normal, light_direction), 0.0);
@@ -121,4 +131,5 @@ void main() {
     if (fog) 
         output_color = mix(output_color, texture(fog_texture, FogTexCoords), min(length(FragPos - viewPos), 10) / 10);
     color = output_color;
+    object_id_color = ObjectId;
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+#version 430 core
+
+in vec3 position;
+in vec3 normal;
+in vec2 texCoords;
+
+out vec3 Normal;
+out vec3 FragPos;
+out vec2 TexCoords;
+out vec2 FogTexCoords;
+flat out uint ObjectId;
+
+layout(std140) uniform CameraBlock {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 viewPos;
+    bool fog;
+};
+
+// same layout as ObjectBlock
+struct ObjectData {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    uint object_id;
+    int transform_model;
+    float change_val;
+};
+layout(std430, binding = 2) readonly buffer VisibleInstances {
+    uint instances[];
+};
+layout(std430, binding = 3) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+// first instance of the drawn model in the visible instances
+uniform uint instance_offset;
+
+void main() {
+    ObjectData object = objects[instances[instance_offset + gl_InstanceID]];
+
+    gl_Position = projectionMatrix * viewMatrix * object.modelMatrix * vec4(position, 1.0f);
+    vec3 ndcSpacePos;
+    if (gl_Position.w != 0)
+        ndcSpacePos = gl_Position.xyz / gl_Position.w;
+    FogTexCoords = (ndcSpacePos.xy + 1.0f) / 2.0f;
+    FragPos = vec3(object.modelMatrix * vec4(position, 1.0));
+    Normal = mat3(object.normalMatrix) * normal;
+    TexCoords = texCoords;
+    ObjectId = object.object_id;
+};
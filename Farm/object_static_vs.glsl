@@ -0,0 +1,46 @@
+#version 430 core
+
+in vec3 position;
+in vec3 normal;
+in vec2 texCoords;
+// index of the object in the static list, instanced attribute which starts at the base instance of the command
+in uint object_index;
+
+out vec3 Normal;
+out vec3 FragPos;
+out vec2 TexCoords;
+out vec2 FogTexCoords;
+flat out uint ObjectId;
+
+layout(std140) uniform CameraBlock {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 viewPos;
+    bool fog;
+};
+
+// same layout as ObjectBlock
+struct ObjectData {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    uint object_id;
+    int transform_model;
+    float change_val;
+};
+layout(std430, binding = 3) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+void main() {
+    ObjectData object = objects[object_index];
+
+    gl_Position = projectionMatrix * viewMatrix * object.modelMatrix * vec4(position, 1.0f);
+    vec3 ndcSpacePos;
+    if (gl_Position.w != 0)
+        ndcSpacePos = gl_Position.xyz / gl_Position.w;
+    FogTexCoords = (ndcSpacePos.xy + 1.0f) / 2.0f;
+    FragPos = vec3(object.modelMatrix * vec4(position, 1.0));
+    Normal = mat3(object.normalMatrix) * normal;
+    TexCoords = texCoords;
+    ObjectId = object.object_id;
+};
@@ -8,12 +8,21 @@ out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoords;
 out vec2 FogTexCoords;
+flat out uint ObjectId;
 
-uniform mat4 projectionMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 modelMatrix;
-uniform bool transform_model;
-uniform float change_val;
+layout(std140) uniform CameraBlock {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 viewPos;
+    bool fog;
+};
+layout(std140) uniform ObjectBlock {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    uint object_id;
+    bool transform_model;
+    float change_val;
+};
 
 void main() {
     vec3 new_pos = position;
@@ -27,6 +36,7 @@ void main() {
         ndcSpacePos = gl_Position.xyz / gl_Position.w;
     FogTexCoords = (ndcSpacePos.xy + 1.0f) / 2.0f;
     FragPos = vec3(modelMatrix * vec4(position, 1.0));
-    Normal = mat3(transpose(inverse(modelMatrix))) * normal;
+    Normal = mat3(normalMatrix) * normal;
     TexCoords = texCoords; 
+    ObjectId = object_id;
 };
\ No newline at end of file
@@ -0,0 +1,387 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cfloat>
+
+#include "occlusion_culler.h"
+#include "job_system.h"
+#include "profiler.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OCCLUSION_SSE
+#endif
+
+/// <summary>
+/// Vertices closer than the near plane are not projected. Occluder triangle with such vertex is skipped,
+/// object box with such corner is visible
+/// </summary>
+static const float OCCLUSION_NEAR = 0.1f;
+/// <summary>
+/// Triangles with smaller area in pixels are skipped
+/// </summary>
+static const float MIN_TRIANGLE_AREA = 1e-6f;
+static const GLuint TILES_X = OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH;
+static const GLuint TILES_Y = OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT;
+/// <summary>
+/// Value of the occluded flag of the chosen occluders, they are never tested
+/// </summary>
+static const GLubyte OCCLUDER_FLAG = 2;
+
+/// <summary>
+/// Returns position of the vertex from the array of vertices
+/// </summary>
+static glm::vec3 GetPosition(const float* positions, GLuint stride, GLuint index)
+{
+	const float* position = positions + index * stride;
+	return glm::vec3(position[0], position[1], position[2]);
+}
+
+void OcclusionCuller::SetOccluder(GLuint model_id, const float* positions, GLuint stride, const GLuint* indices, GLuint triangles_count)
+{
+	if (occluder_meshes.size() <= model_id) occluder_meshes.resize(model_id + 1);
+	std::vector<glm::vec3>& mesh = occluder_meshes[model_id];
+	mesh.clear();
+
+	// big triangles (walls, roof, planks) hide the most, small details are dropped
+	std::vector<std::pair<float, GLuint>> areas;
+	areas.reserve(triangles_count);
+	for (GLuint i = 0; i < triangles_count; i++)
+	{
+		glm::vec3 a = GetPosition(positions, stride, indices[i * 3]);
+		glm::vec3 b = GetPosition(positions, stride, indices[i * 3 + 1]);
+		glm::vec3 c = GetPosition(positions, stride, indices[i * 3 + 2]);
+		float area = glm::length(glm::cross(b - a, c - a));
+		if (area > 0.0f) areas.push_back(std::make_pair(area, i));
+	}
+	GLuint count = std::min((GLuint)areas.size(), OCCLUDER_MAX_TRIANGLES);
+	std::partial_sort(areas.begin(), areas.begin() + count, areas.end(), [](const std::pair<float, GLuint>& a, const std::pair<float, GLuint>& b) {
+		return a.first > b.first;
+	});
+	mesh.reserve(count * 3);
+	for (GLuint i = 0; i < count; i++)
+		for (GLuint vertex = 0; vertex < 3; vertex++)
+			mesh.push_back(GetPosition(positions, stride, indices[areas[i].second * 3 + vertex]));
+}
+
+bool OcclusionCuller::IsOccluder(GLuint model_id) const
+{
+	return model_id < occluder_meshes.size() && !occluder_meshes[model_id].empty();
+}
+
+void OcclusionCuller::Cull(const glm::mat4& view_projection, const glm::vec3& camera_position, const glm::mat4* world_matrices, const GLuint* model_ids,
+	const BoundingBox* model_boxes, std::vector<GLuint>& visible)
+{
+	PROFILE_SCOPE("OcclusionCulling");
+	occluded_count = 0;
+	occluders.clear();
+
+	// the nearest occluders cover the most of the screen. Distances are positive, so their bits sort like the floats
+	occluder_keys.clear();
+	for (GLuint i = 0; i < visible.size(); i++)
+	{
+		GLuint object = visible[i];
+		if (!IsOccluder(model_ids[object])) continue;
+		float distance = glm::length(glm::vec3(world_matrices[object][3]) - camera_position);
+		GLuint bits;
+		std::memcpy(&bits, &distance, sizeof(bits));
+		occluder_keys.push_back(((GLuint64)bits << 32) | i);
+	}
+	if (occluder_keys.empty()) return;
+	if (occluder_keys.size() > MAX_OCCLUDERS) {
+		std::nth_element(occluder_keys.begin(), occluder_keys.begin() + MAX_OCCLUDERS, occluder_keys.end());
+		occluder_keys.resize(MAX_OCCLUDERS);
+	}
+	triangle_offsets.assign(1, 0);
+	for (GLuint64 key : occluder_keys) {
+		GLuint position = (GLuint)(key & 0xFFFFFFFF);
+		occluders.push_back(position);
+		triangle_offsets.push_back(triangle_offsets.back() + (GLuint)occluder_meshes[model_ids[visible[position]]].size() / 3);
+	}
+
+	{
+		PROFILE_SCOPE("RasterizeOccluders");
+		triangles.resize(triangle_offsets.back());
+		ParallelFor((GLuint)occluders.size(), 1, [&](GLuint begin, GLuint end) {
+			for (GLuint i = begin; i < end; i++) {
+				GLuint object = visible[occluders[i]];
+				SetupTriangles(occluder_meshes[model_ids[object]], view_projection * world_matrices[object], triangles.data() + triangle_offsets[i]);
+			}
+		});
+		depth.assign(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f);
+		tile_max_depth.resize(TILES_X * TILES_Y);
+		ParallelFor(TILES_X * TILES_Y, 4, [this](GLuint begin, GLuint end) {
+			for (GLuint tile = begin; tile < end; tile++) RasterizeTile(tile);
+		});
+	}
+
+	{
+		PROFILE_SCOPE("TestOccludees");
+		occluded.assign(visible.size(), 0);
+		for (GLuint position : occluders) occluded[position] = OCCLUDER_FLAG;
+		ParallelFor((GLuint)visible.size(), 256, [&](GLuint begin, GLuint end) {
+			for (GLuint i = begin; i < end; i++) {
+				if (occluded[i] == OCCLUDER_FLAG) continue;
+				GLuint object = visible[i];
+				occluded[i] = IsBoxVisible(view_projection, world_matrices[object], model_boxes[model_ids[object]]) ? 0 : 1;
+			}
+		});
+	}
+
+	// order of the visible objects is kept
+	GLuint kept = 0;
+	for (GLuint i = 0; i < visible.size(); i++)
+		if (occluded[i] != 1) visible[kept++] = visible[i];
+	occluded_count = (GLuint)visible.size() - kept;
+	visible.resize(kept);
+}
+
+void OcclusionCuller::SetupTriangles(const std::vector<glm::vec3>& mesh, const glm::mat4& matrix, ScreenTriangle* output)
+{
+	GLuint count = (GLuint)mesh.size() / 3;
+	for (GLuint i = 0; i < count; i++)
+	{
+		ScreenTriangle& triangle = output[i];
+		triangle.min_x = triangle.min_y = 1;
+		triangle.max_x = triangle.max_y = 0;
+
+		// x, y in pixels, z in normalized device coordinates
+		glm::vec3 screen[3];
+		bool clipped = false;
+		for (GLuint vertex = 0; vertex < 3; vertex++) {
+			glm::vec4 clip = matrix * glm::vec4(mesh[i * 3 + vertex], 1.0f);
+			if (clip.w < OCCLUSION_NEAR) {
+				clipped = true;
+				break;
+			}
+			screen[vertex] = glm::vec3((clip.x / clip.w * 0.5f + 0.5f) * OCCLUSION_WIDTH, (clip.y / clip.w * 0.5f + 0.5f) * OCCLUSION_HEIGHT, clip.z / clip.w);
+		}
+		if (clipped) continue;
+
+		// both sides are drawn, the vertices are ordered so that the area is positive
+		float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+		if (std::abs(area) < MIN_TRIANGLE_AREA) continue;
+		if (area < 0.0f) {
+			std::swap(screen[1], screen[2]);
+			area = -area;
+		}
+
+		// pixels whose centers are inside the box of the triangle
+		float min_x = std::min(std::min(screen[0].x, screen[1].x), screen[2].x);
+		float max_x = std::max(std::max(screen[0].x, screen[1].x), screen[2].x);
+		float min_y = std::min(std::min(screen[0].y, screen[1].y), screen[2].y);
+		float max_y = std::max(std::max(screen[0].y, screen[1].y), screen[2].y);
+		if (max_x < 0.0f || max_y < 0.0f || min_x > OCCLUSION_WIDTH || min_y > OCCLUSION_HEIGHT) continue;
+		triangle.min_x = std::max((int)std::ceil(min_x - 0.5f), 0);
+		triangle.min_y = std::max((int)std::ceil(min_y - 0.5f), 0);
+		triangle.max_x = std::min((int)std::floor(max_x - 0.5f), (int)OCCLUSION_WIDTH - 1);
+		triangle.max_y = std::min((int)std::floor(max_y - 0.5f), (int)OCCLUSION_HEIGHT - 1);
+
+		for (GLuint edge = 0; edge < 3; edge++) {
+			const glm::vec3& from = screen[edge];
+			const glm::vec3& to = screen[(edge + 1) % 3];
+			triangle.edge_a[edge] = from.y - to.y;
+			triangle.edge_b[edge] = to.x - from.x;
+			// the whole pixel has to be inside, edges of the occluder do not cover what they only touch
+			triangle.edge_c[edge] = -(triangle.edge_a[edge] * from.x + triangle.edge_b[edge] * from.y) -
+				0.5f * (std::abs(triangle.edge_a[edge]) + std::abs(triangle.edge_b[edge]));
+		}
+
+		// depth is taken at the farthest point of the pixel, so the occluder never looks closer than it is
+		glm::vec3 first = screen[1] - screen[0];
+		glm::vec3 second = screen[2] - screen[0];
+		triangle.depth_a = (first.z * second.y - second.z * first.y) / area;
+		triangle.depth_b = (second.z * first.x - first.z * second.x) / area;
+		triangle.depth_c = screen[0].z - triangle.depth_a * screen[0].x - triangle.depth_b * screen[0].y +
+			0.5f * (std::abs(triangle.depth_a) + std::abs(triangle.depth_b));
+	}
+}
+
+void OcclusionCuller::RasterizeTile(GLuint tile)
+{
+	int tile_min_x = (int)((tile % TILES_X) * OCCLUSION_TILE_WIDTH);
+	int tile_min_y = (int)((tile / TILES_X) * OCCLUSION_TILE_HEIGHT);
+	int tile_max_x = tile_min_x + (int)OCCLUSION_TILE_WIDTH - 1;
+	int tile_max_y = tile_min_y + (int)OCCLUSION_TILE_HEIGHT - 1;
+
+	for (const ScreenTriangle& triangle : triangles)
+	{
+		if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y) continue;
+		if (triangle.max_x < tile_min_x || triangle.min_x > tile_max_x || triangle.max_y < tile_min_y || triangle.min_y > tile_max_y) continue;
+		// rows start at multiple of four, pixels outside of the triangle fail the edge test
+		int min_x = std::max(triangle.min_x, tile_min_x) & ~3;
+		int max_x = std::min(triangle.max_x, tile_max_x);
+		int min_y = std::max(triangle.min_y, tile_min_y);
+		int max_y = std::min(triangle.max_y, tile_max_y);
+
+		for (int y = min_y; y <= max_y; y++)
+		{
+			float* row = depth.data() + y * OCCLUSION_WIDTH;
+			float center_y = y + 0.5f;
+			float edge_row[3];
+			for (GLuint edge = 0; edge < 3; edge++) edge_row[edge] = triangle.edge_b[edge] * center_y + triangle.edge_c[edge];
+			float depth_row = triangle.depth_b * center_y + triangle.depth_c;
+#ifdef OCCLUSION_SSE
+			const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+			const __m128 zero = _mm_setzero_ps();
+			for (int x = min_x; x <= max_x; x += 4)
+			{
+				__m128 center_x = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+				__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edge_a[0]), center_x), _mm_set1_ps(edge_row[0])), zero);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edge_a[1]), center_x), _mm_set1_ps(edge_row[1])), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edge_a[2]), center_x), _mm_set1_ps(edge_row[2])), zero));
+				if (_mm_movemask_ps(inside) == 0) continue;
+				__m128 old_depth = _mm_loadu_ps(row + x);
+				__m128 new_depth = _mm_min_ps(old_depth, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depth_a), center_x), _mm_set1_ps(depth_row)));
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, new_depth), _mm_andnot_ps(inside, old_depth)));
+			}
+#else
+			for (int x = min_x; x <= max_x; x++)
+			{
+				float center_x = x + 0.5f;
+				if (triangle.edge_a[0] * center_x + edge_row[0] < 0.0f || triangle.edge_a[1] * center_x + edge_row[1] < 0.0f ||
+					triangle.edge_a[2] * center_x + edge_row[2] < 0.0f) continue;
+				row[x] = std::min(row[x], triangle.depth_a * center_x + depth_row);
+			}
+#endif
+		}
+	}
+
+	float max_depth = -FLT_MAX;
+	for (int y = tile_min_y; y <= tile_max_y; y++)
+		for (int x = tile_min_x; x <= tile_max_x; x++)
+			max_depth = std::max(max_depth, depth[y * OCCLUSION_WIDTH + x]);
+	tile_max_depth[tile] = max_depth;
+}
+
+bool OcclusionCuller::ProjectBox(const glm::mat4& view_projection, const glm::mat4& world_matrix, const BoundingBox& box, glm::vec3& screen_min, glm::vec3& screen_max)
+{
+	// corners are the first corner plus the transformed edges
+#ifdef OCCLUSION_SSE
+	__m128 columns[4];
+	for (int column = 0; column < 4; column++) {
+		__m128 result = _mm_mul_ps(_mm_loadu_ps(&view_projection[0][0]), _mm_set1_ps(world_matrix[column][0]));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(&view_projection[1][0]), _mm_set1_ps(world_matrix[column][1])));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(&view_projection[2][0]), _mm_set1_ps(world_matrix[column][2])));
+		columns[column] = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(&view_projection[3][0]), _mm_set1_ps(world_matrix[column][3])));
+	}
+	__m128 origin = _mm_add_ps(_mm_add_ps(_mm_mul_ps(columns[0], _mm_set1_ps(box.min.x)), _mm_mul_ps(columns[1], _mm_set1_ps(box.min.y))),
+		_mm_add_ps(_mm_mul_ps(columns[2], _mm_set1_ps(box.min.z)), columns[3]));
+	__m128 edge_x = _mm_mul_ps(columns[0], _mm_set1_ps(box.max.x - box.min.x));
+	__m128 edge_y = _mm_mul_ps(columns[1], _mm_set1_ps(box.max.y - box.min.y));
+	__m128 edge_z = _mm_mul_ps(columns[2], _mm_set1_ps(box.max.z - box.min.z));
+
+	// four corners in one register: lanes are corners, registers are x, y, z, w. Second four corners add the z edge
+	__m128 corners[4];
+	corners[0] = origin;
+	corners[1] = _mm_add_ps(origin, edge_x);
+	corners[2] = _mm_add_ps(origin, edge_y);
+	corners[3] = _mm_add_ps(corners[1], edge_y);
+	_MM_TRANSPOSE4_PS(corners[0], corners[1], corners[2], corners[3]);
+	__m128 far_x = _mm_set1_ps(((const float*)&edge_z)[0]);
+	__m128 far_y = _mm_set1_ps(((const float*)&edge_z)[1]);
+	__m128 far_z = _mm_set1_ps(((const float*)&edge_z)[2]);
+	__m128 far_w = _mm_set1_ps(((const float*)&edge_z)[3]);
+	__m128 near_plane = _mm_set1_ps(OCCLUSION_NEAR);
+	__m128 w_far = _mm_add_ps(corners[3], far_w);
+	if (_mm_movemask_ps(_mm_or_ps(_mm_cmplt_ps(corners[3], near_plane), _mm_cmplt_ps(w_far, near_plane))) != 0) return false;
+
+	__m128 inverse_near = _mm_div_ps(_mm_set1_ps(1.0f), corners[3]);
+	__m128 inverse_far = _mm_div_ps(_mm_set1_ps(1.0f), w_far);
+	__m128 x_near = _mm_mul_ps(corners[0], inverse_near), x_far = _mm_mul_ps(_mm_add_ps(corners[0], far_x), inverse_far);
+	__m128 y_near = _mm_mul_ps(corners[1], inverse_near), y_far = _mm_mul_ps(_mm_add_ps(corners[1], far_y), inverse_far);
+	__m128 z_near = _mm_mul_ps(corners[2], inverse_near), z_far = _mm_mul_ps(_mm_add_ps(corners[2], far_z), inverse_far);
+	__m128 min_x = _mm_min_ps(x_near, x_far), max_x = _mm_max_ps(x_near, x_far);
+	__m128 min_y = _mm_min_ps(y_near, y_far), max_y = _mm_max_ps(y_near, y_far);
+	__m128 min_z = _mm_min_ps(z_near, z_far);
+	// horizontal minimum and maximum of the lanes
+	__m128 mins = _mm_setr_ps(0.0f, 0.0f, 0.0f, 0.0f);
+	_MM_TRANSPOSE4_PS(min_x, min_y, min_z, mins);
+	mins = _mm_min_ps(_mm_min_ps(min_x, min_y), _mm_min_ps(min_z, mins));
+	__m128 maxs = _mm_setr_ps(0.0f, 0.0f, 0.0f, 0.0f);
+	__m128 unused = maxs;
+	_MM_TRANSPOSE4_PS(max_x, max_y, maxs, unused);
+	maxs = _mm_max_ps(_mm_max_ps(max_x, max_y), _mm_max_ps(maxs, unused));
+	float lanes[4];
+	_mm_storeu_ps(lanes, mins);
+	screen_min = glm::vec3(lanes[0], lanes[1], lanes[2]);
+	_mm_storeu_ps(lanes, maxs);
+	screen_max = glm::vec3(lanes[0], lanes[1], lanes[2]);
+#else
+	glm::mat4 matrix = view_projection * world_matrix;
+	glm::vec4 origin = matrix * glm::vec4(box.min, 1.0f);
+	glm::vec3 size = box.max - box.min;
+	glm::vec4 edges[3] = { matrix[0] * size.x, matrix[1] * size.y, matrix[2] * size.z };
+	screen_min = glm::vec3(FLT_MAX);
+	screen_max = glm::vec3(-FLT_MAX);
+	for (GLuint i = 0; i < 8; i++)
+	{
+		glm::vec4 corner = origin;
+		if (i & 1) corner += edges[0];
+		if (i & 2) corner += edges[1];
+		if (i & 4) corner += edges[2];
+		if (corner.w < OCCLUSION_NEAR) return false;
+		glm::vec3 projected = glm::vec3(corner) / corner.w;
+		screen_min = glm::min(screen_min, projected);
+		screen_max = glm::max(screen_max, projected);
+	}
+#endif
+	return true;
+}
+
+bool OcclusionCuller::IsBoxVisible(const glm::mat4& view_projection, const glm::mat4& world_matrix, const BoundingBox& box) const
+{
+	glm::vec3 screen_min, screen_max;
+	if (!ProjectBox(view_projection, world_matrix, box, screen_min, screen_max)) return true;
+	float min_x = screen_min.x, min_y = screen_min.y, min_z = screen_min.z;
+	float max_x = screen_max.x, max_y = screen_max.y;
+
+	// all pixels the box touches. Box out of the buffer has nothing to test against
+	int first_x = std::max((int)std::floor((min_x * 0.5f + 0.5f) * OCCLUSION_WIDTH), 0);
+	int first_y = std::max((int)std::floor((min_y * 0.5f + 0.5f) * OCCLUSION_HEIGHT), 0);
+	int last_x = std::min((int)std::ceil((max_x * 0.5f + 0.5f) * OCCLUSION_WIDTH), (int)OCCLUSION_WIDTH) - 1;
+	int last_y = std::min((int)std::ceil((max_y * 0.5f + 0.5f) * OCCLUSION_HEIGHT), (int)OCCLUSION_HEIGHT) - 1;
+	if (first_x > last_x || first_y > last_y) return true;
+
+	for (int tile_y = first_y / (int)OCCLUSION_TILE_HEIGHT; tile_y <= last_y / (int)OCCLUSION_TILE_HEIGHT; tile_y++)
+		for (int tile_x = first_x / (int)OCCLUSION_TILE_WIDTH; tile_x <= last_x / (int)OCCLUSION_TILE_WIDTH; tile_x++)
+		{
+			// whole tile is nearer than the box
+			if (tile_max_depth[tile_y * TILES_X + tile_x] <= min_z) continue;
+			// rows start at multiple of four, extra pixels can only make the box visible
+			int min_x = std::max(first_x, tile_x * (int)OCCLUSION_TILE_WIDTH) & ~3;
+			int max_x = std::min(last_x, (tile_x + 1) * (int)OCCLUSION_TILE_WIDTH - 1);
+			int min_y = std::max(first_y, tile_y * (int)OCCLUSION_TILE_HEIGHT);
+			int max_y = std::min(last_y, (tile_y + 1) * (int)OCCLUSION_TILE_HEIGHT - 1);
+			for (int y = min_y; y <= max_y; y++)
+			{
+				const float* row = depth.data() + y * OCCLUSION_WIDTH;
+#ifdef OCCLUSION_SSE
+				__m128 box_depth = _mm_set1_ps(min_z);
+				for (int x = min_x; x <= max_x; x += 4)
+					if (_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(row + x), box_depth)) != 0) return true;
+#else
+				for (int x = min_x; x <= max_x; x++)
+					if (row[x] > min_z) return true;
+#endif
+			}
+		}
+	return false;
+}
+
+GLuint OcclusionCuller::GetOccludersCount() const
+{
+	return (GLuint)occluders.size();
+}
+
+GLuint OcclusionCuller::GetOccludedCount() const
+{
+	return occluded_count;
+}
+
+void OcclusionCuller::Clear()
+{
+	occluder_meshes.clear();
+	occluders.clear();
+	occluded_count = 0;
+}
@@ -0,0 +1,158 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       occlusion_culler.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines software occlusion culling of the objects on the CPU
+ *
+ * Large models (house, trailer, fences) are marked as occluders. Their occluder mesh keeps
+ * only the biggest triangles of the model, so it covers less than the model and never hides
+ * what the model does not hide. Nearest visible occluders are rasterized into a small depth
+ * buffer split into tiles, every tile is filled by one job with SSE edge functions, four
+ * pixels at a time. Every other visible object projects its bounding box and is culled if
+ * all pixels under the box are nearer than the nearest corner of the box. Tiles keep their
+ * farthest depth, so most of the tests do not have to read the pixels.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <vector>
+
+#include "pgr.h"
+#include "culling.h"
+
+/// <summary>
+/// Size of the depth buffer in pixels, multiple of the tile size
+/// </summary>
+const GLuint OCCLUSION_WIDTH = 256;
+const GLuint OCCLUSION_HEIGHT = 128;
+/// <summary>
+/// Size of one tile in pixels, width is multiple of four
+/// </summary>
+const GLuint OCCLUSION_TILE_WIDTH = 32;
+const GLuint OCCLUSION_TILE_HEIGHT = 16;
+/// <summary>
+/// Maximum number of triangles in the occluder mesh of one model
+/// </summary>
+const GLuint OCCLUDER_MAX_TRIANGLES = 256;
+/// <summary>
+/// Maximum number of occluders rasterized in one view, the nearest ones are chosen
+/// </summary>
+const GLuint MAX_OCCLUDERS = 32;
+
+class OcclusionCuller
+{
+public:
+	/// <summary>
+	/// Marks the model as occluder and creates its occluder mesh from the biggest triangles of the model
+	/// </summary>
+	/// <param name="model_id">Index of the model</param>
+	/// <param name="positions">Positions of the vertices in model space</param>
+	/// <param name="stride">Number of floats between two positions</param>
+	/// <param name="indices">Three indices for every triangle</param>
+	/// <param name="triangles_count">Number of triangles</param>
+	void SetOccluder(GLuint model_id, const float* positions, GLuint stride, const GLuint* indices, GLuint triangles_count);
+	/// <summary>
+	/// Returns true if the model is occluder
+	/// </summary>
+	bool IsOccluder(GLuint model_id) const;
+	/// <summary>
+	/// Rasterizes the nearest occluders from the visible objects and removes objects hidden behind them
+	/// </summary>
+	/// <param name="view_projection">Projection * view matrix of the camera</param>
+	/// <param name="camera_position">Position of the camera</param>
+	/// <param name="world_matrices">Array of object world matrices</param>
+	/// <param name="model_ids">Array of object model indeces</param>
+	/// <param name="model_boxes">Bounding boxes of the models, index is model id</param>
+	/// <param name="visible">Objects which passed frustum culling. Occluded objects are removed, the order is kept</param>
+	void Cull(const glm::mat4& view_projection, const glm::vec3& camera_position, const glm::mat4* world_matrices, const GLuint* model_ids,
+		const BoundingBox* model_boxes, std::vector<GLuint>& visible);
+	/// <summary>
+	/// Returns number of occluders rasterized by the last Cull
+	/// </summary>
+	GLuint GetOccludersCount() const;
+	/// <summary>
+	/// Returns number of objects removed by the last Cull
+	/// </summary>
+	GLuint GetOccludedCount() const;
+	/// <summary>
+	/// Forgets all occluder meshes
+	/// </summary>
+	void Clear();
+private:
+	/// <summary>
+	/// Triangle prepared for rasterization in pixel coordinates
+	/// </summary>
+	struct ScreenTriangle {
+		/// <summary>
+		/// Edge functions a * x + b * y + c, not negative if the whole pixel is inside the triangle
+		/// </summary>
+		float edge_a[3];
+		float edge_b[3];
+		float edge_c[3];
+		/// <summary>
+		/// Depth plane, already moved to the farthest depth of the pixel
+		/// </summary>
+		float depth_a;
+		float depth_b;
+		float depth_c;
+		/// <summary>
+		/// Pixels whose centers can be inside, empty if the triangle is not drawn
+		/// </summary>
+		int min_x;
+		int min_y;
+		int max_x;
+		int max_y;
+	};
+
+	/// <summary>
+	/// Transforms triangles of the occluder mesh into pixel coordinates
+	/// </summary>
+	/// <param name="mesh">Occluder mesh of the model</param>
+	/// <param name="matrix">Projection * view * world matrix of the occluder</param>
+	/// <param name="output">Returned triangles, one for every triangle of the mesh</param>
+	static void SetupTriangles(const std::vector<glm::vec3>& mesh, const glm::mat4& matrix, ScreenTriangle* output);
+	/// <summary>
+	/// Rasterizes all triangles which overlap the tile and computes farthest depth of the tile
+	/// </summary>
+	void RasterizeTile(GLuint tile);
+	/// <summary>
+	/// Projects corners of the box into normalized device coordinates
+	/// </summary>
+	/// <param name="view_projection">Projection * view matrix of the camera</param>
+	/// <param name="world_matrix">World matrix of the object</param>
+	/// <param name="box">Box of the model</param>
+	/// <param name="screen_min">Returned minimum x, y and z of the corners</param>
+	/// <param name="screen_max">Returned maximum x, y and z of the corners</param>
+	/// <returns>Returns false if some corner is closer than the near plane</returns>
+	static bool ProjectBox(const glm::mat4& view_projection, const glm::mat4& world_matrix, const BoundingBox& box, glm::vec3& screen_min, glm::vec3& screen_max);
+	/// <summary>
+	/// Returns true if some pixel under the projected box is farther than the box
+	/// </summary>
+	bool IsBoxVisible(const glm::mat4& view_projection, const glm::mat4& world_matrix, const BoundingBox& box) const;
+
+	/// <summary>
+	/// Three vertices of every triangle, index is model id. Empty for models which are not occluders
+	/// </summary>
+	std::vector<std::vector<glm::vec3>> occluder_meshes;
+	/// <summary>
+	/// Positions of the chosen occluders in the visible objects
+	/// </summary>
+	std::vector<GLuint> occluders;
+	/// <summary>
+	/// Distance of the occluder in high 32 bits, its position in the visible objects in low 32 bits
+	/// </summary>
+	std::vector<GLuint64> occluder_keys;
+	std::vector<GLuint> triangle_offsets;
+	std::vector<ScreenTriangle> triangles;
+	/// <summary>
+	/// Depth in normalized device coordinates, rows go from the bottom of the screen
+	/// </summary>
+	std::vector<float> depth;
+	std::vector<float> tile_max_depth;
+	std::vector<GLubyte> occluded;
+	GLuint occluded_count = 0;
+};
+
+#endif // !OCCLUSION_CULLER_H
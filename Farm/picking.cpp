@@ -0,0 +1,87 @@
+#include <iostream>
+#include <atomic>
+
+#include "picking.h"
+
+/// <summary>
+/// Number of pick requests which can wait for GPU at the same time
+/// </summary>
+static const GLuint PICK_BUFFERS_COUNT = 4;
+
+/// <summary>
+/// One pick request: pixel buffer with the copied ID and fence of the copy
+/// </summary>
+struct PickRequest {
+	GLuint buffer = 0;
+	GLsync fence = 0;
+};
+
+static PickRequest requests[PICK_BUFFERS_COUNT];
+/// <summary>
+/// Index of the next request slot. Requests are finished in the order they were started
+/// </summary>
+static GLuint next_request = 0;
+static std::atomic<long long> pick_result(-1);
+
+void RequestPick(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (x < 0 || y < 0 || x >= width || y >= height) {
+		pick_result = NO_OBJECT_ID;
+		return;
+	}
+
+	PickRequest& request = requests[next_request];
+	next_request = (next_request + 1) % PICK_BUFFERS_COUNT;
+	if (request.buffer == 0) {
+		glGenBuffers(1, &request.buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, request.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(GLuint), nullptr, GL_STREAM_READ);
+	}
+	// the oldest request is dropped if all of them are still waiting
+	if (request.fence != 0) glDeleteSync(request.fence);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, request.buffer);
+	glReadPixels(x, y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	request.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void UpdatePicking()
+{
+	for (GLuint i = 0; i < PICK_BUFFERS_COUNT; i++)
+	{
+		// from the oldest request to the newest one
+		PickRequest& request = requests[(next_request + i) % PICK_BUFFERS_COUNT];
+		if (request.fence == 0) continue;
+		GLenum status = glClientWaitSync(request.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+
+		glDeleteSync(request.fence);
+		request.fence = 0;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, request.buffer);
+		GLuint* object_id = (GLuint*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(GLuint), GL_MAP_READ_BIT);
+		if (object_id != nullptr) {
+			pick_result = *object_id;
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+}
+
+bool TakePickResult(GLuint& object_id)
+{
+	long long result = pick_result.exchange(-1);
+	if (result < 0) return false;
+	object_id = (GLuint)result;
+	return true;
+}
+
+void ReleasePicking()
+{
+	for (PickRequest& request : requests) {
+		if (request.fence != 0) glDeleteSync(request.fence);
+		if (request.buffer != 0) glDeleteBuffers(1, &request.buffer);
+		request = PickRequest();
+	}
+	next_request = 0;
+}
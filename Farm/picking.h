@@ -0,0 +1,47 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       picking.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines asynchronous picking from the object ID buffer
+ *
+ * Objects write 32-bit object ID (R32UI) into the second color output. The ID buffer is
+ * a render graph target which exists only in the frames with pick request. Clicked pixel
+ * of the ID buffer is copied into pixel buffer object and read when its fence is signaled,
+ * usually one or two frames later, so picking never waits for GPU.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef PICKING_H
+#define PICKING_H
+
+#include "pgr.h"
+
+/// <summary>
+/// Object ID of the pixels without object
+/// </summary>
+const GLuint NO_OBJECT_ID = 0;
+
+/// <summary>
+/// Starts copying of the object ID under the pixel from the read buffer of the bound read framebuffer
+/// </summary>
+/// <param name="x">Pixel x from the left</param>
+/// <param name="y">Pixel y from the bottom</param>
+/// <param name="width">Width of the ID buffer</param>
+/// <param name="height">Height of the ID buffer</param>
+void RequestPick(GLint x, GLint y, GLsizei width, GLsizei height);
+/// <summary>
+/// Reads results of finished pick requests. Has to be called every frame on the thread which owns GL context
+/// </summary>
+void UpdatePicking();
+/// <summary>
+/// Returns the result of the last finished pick request, once for every request. Can be called from any thread
+/// </summary>
+/// <param name="object_id">Returned object ID, NO_OBJECT_ID for background</param>
+/// <returns>Returns true if there is new result</returns>
+bool TakePickResult(GLuint& object_id);
+/// <summary>
+/// Deletes pixel buffers
+/// </summary>
+void ReleasePicking();
+
+#endif // !PICKING_H
@@ -0,0 +1,209 @@
+#include "profiler.h"
+
+#ifdef FARM_PROFILER_ENABLED
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <mutex>
+
+/// <summary>
+/// Weight of the new value in rolling averages
+/// </summary>
+static const double AVERAGE_FACTOR = 0.05;
+
+/// <summary>
+/// Timers of one profiled scope. Every scope has two GPU queries: while one is issued in the current frame,
+/// result of the other one (issued two frames ago) is read, so reading never waits for GPU
+/// </summary>
+struct ScopeTimer {
+	const char* name;
+	double cpu_time = 0.0;
+	double cpu_average = 0.0;
+	double gpu_average = 0.0;
+	GLuint queries[2] = { 0, 0 };
+	bool query_issued[2] = { false, false };
+	long long query_start[2] = { 0, 0 };
+};
+
+/// <summary>
+/// One event of Chrome trace. Times are in microseconds
+/// </summary>
+struct TraceEvent {
+	const char* name;
+	long long start;
+	long long duration;
+	int thread;
+};
+
+static std::vector<ScopeTimer> scopes;
+static std::vector<TraceEvent> trace_events;
+static GLuint frame_index = 0;
+static long long frame_start = 0;
+static double frame_average = 0.0;
+static bool gpu_query_active = false;
+static bool capturing = false;
+static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+/// <summary>
+/// Guards all profiler data, scopes are measured on the main thread and the render thread
+/// </summary>
+static std::mutex profiler_mutex;
+
+static const char* FRAME_EVENT_NAME = "Frame";
+static const int CPU_THREAD = 0;
+static const int GPU_THREAD = 1;
+static const int RENDER_THREAD = 2;
+/// <summary>
+/// Track of the trace for the events of the calling thread
+/// </summary>
+static thread_local int trace_thread = CPU_THREAD;
+
+/// <summary>
+/// Returns time from the program start in microseconds
+/// </summary>
+static long long Now()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+static GLuint GetScopeId(const char* name)
+{
+	for (GLuint i = 0; i < scopes.size(); i++)
+		if (scopes[i].name == name) return i;
+	ScopeTimer scope;
+	scope.name = name;
+	scopes.push_back(scope);
+	return (GLuint)scopes.size() - 1;
+}
+
+ProfileScope::ProfileScope(const char* name, bool gpu)
+{
+	std::lock_guard<std::mutex> lock(profiler_mutex);
+	scope_id = GetScopeId(name);
+	start = Now();
+	ScopeTimer& scope = scopes[scope_id];
+	GLuint slot = frame_index % 2;
+	// only the first entry of the scope in the frame is measured on GPU
+	gpu_query = gpu && !gpu_query_active && !scope.query_issued[slot];
+	if (gpu_query) {
+		if (scope.queries[slot] == 0) glGenQueries(2, scope.queries);
+		glBeginQuery(GL_TIME_ELAPSED, scope.queries[slot]);
+		scope.query_issued[slot] = true;
+		scope.query_start[slot] = start;
+		gpu_query_active = true;
+	}
+}
+
+ProfileScope::~ProfileScope()
+{
+	std::lock_guard<std::mutex> lock(profiler_mutex);
+	if (gpu_query) {
+		glEndQuery(GL_TIME_ELAPSED);
+		gpu_query_active = false;
+	}
+	long long end = Now();
+	scopes[scope_id].cpu_time += (end - start) / 1000.0;
+	if (capturing) trace_events.push_back({ scopes[scope_id].name, start, end - start, trace_thread });
+}
+
+void ProfilerBeginFrame()
+{
+	std::lock_guard<std::mutex> lock(profiler_mutex);
+	frame_index++;
+	frame_start = Now();
+
+	// queries of this slot were issued two frames ago. Query which is not finished yet stays pending,
+	// so reading never waits for the GPU, and the scope is not measured again until the result is read
+	GLuint slot = frame_index % 2;
+	for (ScopeTimer& scope : scopes)
+	{
+		if (!scope.query_issued[slot]) continue;
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(scope.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE) continue;
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(scope.queries[slot], GL_QUERY_RESULT, &elapsed);
+		scope.query_issued[slot] = false;
+		scope.gpu_average += (elapsed / 1000000.0 - scope.gpu_average) * AVERAGE_FACTOR;
+		if (capturing) trace_events.push_back({ scope.name, scope.query_start[slot], (long long)(elapsed / 1000), GPU_THREAD });
+	}
+}
+
+void ProfilerEndFrame()
+{
+	std::lock_guard<std::mutex> lock(profiler_mutex);
+	long long end = Now();
+	frame_average += ((end - frame_start) / 1000.0 - frame_average) * AVERAGE_FACTOR;
+	for (ScopeTimer& scope : scopes) {
+		scope.cpu_average += (scope.cpu_time - scope.cpu_average) * AVERAGE_FACTOR;
+		scope.cpu_time = 0.0;
+	}
+	if (capturing) trace_events.push_back({ FRAME_EVENT_NAME, frame_start, end - frame_start, trace_thread });
+}
+
+std::string ProfilerGetSummary()
+{
+	std::lock_guard<std::mutex> lock(profiler_mutex);
+	std::ostringstream oss;
+	oss << std::fixed << std::setprecision(2) << "frame " << frame_average;
+	for (const ScopeTimer& scope : scopes) {
+		oss << " | " << scope.name << " " << scope.cpu_average;
+		if (scope.queries[0] != 0) oss << "/" << scope.gpu_average;
+	}
+	return oss.str();
+}
+
+/// <summary>
+/// Saves recorded events in Chrome trace event format
+/// </summary>
+static bool SaveTrace(const std::string& path)
+{
+	std::ofstream ofs(path);
+	if (!ofs.is_open()) return false;
+	ofs << "{\"traceEvents\":[\n";
+	ofs << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << CPU_THREAD << ",\"args\":{\"name\":\"CPU\"}},\n";
+	ofs << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << GPU_THREAD << ",\"args\":{\"name\":\"GPU\"}},\n";
+	ofs << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << RENDER_THREAD << ",\"args\":{\"name\":\"Render\"}}";
+	for (const TraceEvent& event : trace_events)
+		ofs << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"ts\":" << event.start << ",\"dur\":" << event.duration
+			<< ",\"pid\":0,\"tid\":" << event.thread << "}";
+	ofs << "\n]}\n";
+	return ofs.good();
+}
+
+bool ProfilerToggleCapture(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(profiler_mutex);
+	if (!capturing) {
+		trace_events.clear();
+		capturing = true;
+		std::cout << "profiler capture started" << std::endl;
+		return true;
+	}
+
+	capturing = false;
+	if (SaveTrace(path)) std::cout << "profiler trace saved: " << path << std::endl;
+	else std::cout << "failed to save profiler trace: " << path << std::endl;
+	trace_events.clear();
+	return false;
+}
+
+void ProfilerSetRenderThread()
+{
+	trace_thread = RENDER_THREAD;
+}
+
+void ProfilerRelease()
+{
+	std::lock_guard<std::mutex> lock(profiler_mutex);
+	for (ScopeTimer& scope : scopes)
+		if (scope.queries[0] != 0) glDeleteQueries(2, scope.queries);
+	scopes.clear();
+	trace_events.clear();
+	capturing = false;
+}
+
+#endif // FARM_PROFILER_ENABLED
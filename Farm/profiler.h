@@ -0,0 +1,94 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       profiler.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines frame profiler with CPU scopes, GPU timer queries and Chrome trace export
+ *
+ * Profiler is compiled only in debug builds or when FARM_PROFILE is defined.
+ * Otherwise all PROFILE_* macros expand to nothing. CPU scopes can be used from the main
+ * thread and the render thread, GPU scopes and frames only from the thread which owns GL context.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef PROFILER
+#define PROFILER
+
+#if !defined(NDEBUG) || defined(FARM_PROFILE)
+#define FARM_PROFILER_ENABLED
+#endif
+
+#ifdef FARM_PROFILER_ENABLED
+
+#include <string>
+
+#include "pgr.h"
+
+/// <summary>
+/// Measures CPU time of the scope. GPU scopes also measure GPU time of the commands issued inside the scope.
+/// GPU scopes cannot be nested (GL allows only one active GL_TIME_ELAPSED query), inner GPU scope measures only CPU time
+/// </summary>
+class ProfileScope
+{
+public:
+	/// <summary>
+	/// Starts measuring
+	/// </summary>
+	/// <param name="name">Name of the scope. Has to be string literal, pointer is used as identifier</param>
+	/// <param name="gpu">Also measure GPU time</param>
+	ProfileScope(const char* name, bool gpu = false);
+	/// <summary>
+	/// Stops measuring
+	/// </summary>
+	~ProfileScope();
+private:
+	GLuint scope_id;
+	long long start;
+	bool gpu_query;
+};
+
+/// <summary>
+/// Starts new frame. Reads results of GPU queries issued in the previous frame
+/// </summary>
+void ProfilerBeginFrame();
+/// <summary>
+/// Finishes the frame
+/// </summary>
+void ProfilerEndFrame();
+/// <summary>
+/// Returns short summary of average CPU and GPU times of all scopes in milliseconds
+/// </summary>
+std::string ProfilerGetSummary();
+/// <summary>
+/// Starts recording trace events or stops recording and saves them as Chrome/Perfetto trace JSON
+/// </summary>
+/// <param name="path">Path to the trace file</param>
+/// <returns>Returns true if recording is running after the call</returns>
+bool ProfilerToggleCapture(const std::string& path);
+/// <summary>
+/// Marks the calling thread as the render thread, its scopes are shown on separate track of the trace
+/// </summary>
+void ProfilerSetRenderThread();
+/// <summary>
+/// Deletes all GPU queries. Has to be called while GL context exists
+/// </summary>
+void ProfilerRelease();
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name, true)
+#define PROFILE_BEGIN_FRAME() ProfilerBeginFrame()
+#define PROFILE_END_FRAME() ProfilerEndFrame()
+#define PROFILE_SET_RENDER_THREAD() ProfilerSetRenderThread()
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#define PROFILE_BEGIN_FRAME()
+#define PROFILE_END_FRAME()
+#define PROFILE_SET_RENDER_THREAD()
+
+#endif // FARM_PROFILER_ENABLED
+
+#endif // !PROFILER
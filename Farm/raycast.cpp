@@ -0,0 +1,528 @@
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+#include "raycast.h"
+#include "SceneStore.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RAYCAST_SSE
+#endif
+
+/// <summary>
+/// Maximal number of triangles in the leaf of mesh hierarchy, one packet
+/// </summary>
+static const GLuint MESH_LEAF_SIZE = 4;
+/// <summary>
+/// Maximal number of objects in the leaf of scene hierarchy
+/// </summary>
+static const GLuint SCENE_LEAF_SIZE = 2;
+/// <summary>
+/// Number of bins of the surface area heuristic
+/// </summary>
+static const int SAH_BINS = 12;
+/// <summary>
+/// Nodes deeper than this are split in the middle, so the traversal stack cannot overflow
+/// </summary>
+static const GLuint MAX_SAH_DEPTH = 40;
+/// <summary>
+/// Stack holds at most one node more than the tree depth. Middle splits deeper than MAX_SAH_DEPTH halve 32 bit counts,
+/// so no tree is deeper than MAX_SAH_DEPTH + 32
+/// </summary>
+static const int TRAVERSAL_STACK_SIZE = MAX_SAH_DEPTH + 32 + 1;
+static const float RAY_EPSILON = 1e-7f;
+
+/// <summary>
+/// Returns half of the surface area of the box
+/// </summary>
+static float GetHalfArea(const BoundingBox& box)
+{
+	glm::vec3 size = box.max - box.min;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+static void ExpandBox(BoundingBox& box, const BoundingBox& other)
+{
+	box.min = glm::min(box.min, other.min);
+	box.max = glm::max(box.max, other.max);
+}
+
+static BoundingBox EmptyBox()
+{
+	BoundingBox box;
+	box.min = glm::vec3(1e30f);
+	box.max = glm::vec3(-1e30f);
+	return box;
+}
+
+/// <summary>
+/// Builds hierarchy of the boxes with binned surface area heuristic
+/// </summary>
+/// <param name="boxes">Boxes of the items</param>
+/// <param name="max_leaf_size">Maximal number of items in one leaf</param>
+/// <param name="nodes">Returned nodes, the root is the first one</param>
+/// <param name="order">Returned item indices in the order of leaves</param>
+static void BuildTree(const std::vector<BoundingBox>& boxes, GLuint max_leaf_size, std::vector<BVHNode>& nodes, std::vector<GLuint>& order)
+{
+	nodes.clear();
+	order.resize(boxes.size());
+	for (GLuint i = 0; i < order.size(); i++) order[i] = i;
+	if (boxes.empty()) return;
+
+	std::vector<glm::vec3> centers(boxes.size());
+	for (GLuint i = 0; i < boxes.size(); i++) centers[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+
+	BVHNode root;
+	root.first = 0;
+	root.count = (GLuint)boxes.size();
+	nodes.push_back(root);
+	// node index and its depth
+	std::vector<std::pair<GLuint, GLuint>> tasks(1, std::make_pair(0u, 0u));
+	while (!tasks.empty())
+	{
+		GLuint node_index = tasks.back().first;
+		GLuint depth = tasks.back().second;
+		tasks.pop_back();
+		GLuint first = nodes[node_index].first;
+		GLuint count = nodes[node_index].count;
+
+		BoundingBox bounds = EmptyBox();
+		BoundingBox center_bounds = EmptyBox();
+		for (GLuint i = first; i < first + count; i++) {
+			ExpandBox(bounds, boxes[order[i]]);
+			center_bounds.min = glm::min(center_bounds.min, centers[order[i]]);
+			center_bounds.max = glm::max(center_bounds.max, centers[order[i]]);
+		}
+		nodes[node_index].min = bounds.min;
+		nodes[node_index].max = bounds.max;
+		if (count <= max_leaf_size) continue;
+
+		glm::vec3 extent = center_bounds.max - center_bounds.min;
+		int axis = 0;
+		if (extent.y > extent[axis]) axis = 1;
+		if (extent.z > extent[axis]) axis = 2;
+
+		GLuint middle = first + count / 2;
+		if (extent[axis] > 1e-6f && depth < MAX_SAH_DEPTH) {
+			// sorts centers into bins and finds the cheapest split between two bins
+			float bin_scale = SAH_BINS / extent[axis];
+			GLuint bin_counts[SAH_BINS] = {};
+			BoundingBox bin_boxes[SAH_BINS];
+			for (int b = 0; b < SAH_BINS; b++) bin_boxes[b] = EmptyBox();
+			for (GLuint i = first; i < first + count; i++) {
+				int bin = std::min(SAH_BINS - 1, (int)((centers[order[i]][axis] - center_bounds.min[axis]) * bin_scale));
+				bin_counts[bin]++;
+				ExpandBox(bin_boxes[bin], boxes[order[i]]);
+			}
+
+			float right_costs[SAH_BINS];
+			BoundingBox right_box = EmptyBox();
+			GLuint right_count = 0;
+			for (int b = SAH_BINS - 1; b > 0; b--) {
+				ExpandBox(right_box, bin_boxes[b]);
+				right_count += bin_counts[b];
+				right_costs[b] = right_count > 0 ? right_count * GetHalfArea(right_box) : 0.0f;
+			}
+			BoundingBox left_box = EmptyBox();
+			GLuint left_count = 0;
+			float best_cost = 1e30f;
+			int best_split = -1;
+			for (int b = 1; b < SAH_BINS; b++) {
+				ExpandBox(left_box, bin_boxes[b - 1]);
+				left_count += bin_counts[b - 1];
+				if (left_count == 0 || left_count == count) continue;
+				float cost = left_count * GetHalfArea(left_box) + right_costs[b];
+				if (cost < best_cost) {
+					best_cost = cost;
+					best_split = b;
+				}
+			}
+
+			if (best_split > 0) {
+				float min = center_bounds.min[axis];
+				GLuint* split = std::partition(order.data() + first, order.data() + first + count, [&](GLuint item) {
+					return std::min(SAH_BINS - 1, (int)((centers[item][axis] - min) * bin_scale)) < best_split;
+				});
+				middle = (GLuint)(split - order.data());
+			}
+		}
+		else {
+			std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + first + count, [&](GLuint a, GLuint b) {
+				return centers[a][axis] < centers[b][axis];
+			});
+		}
+
+		GLuint left = (GLuint)nodes.size();
+		BVHNode child;
+		child.first = first;
+		child.count = middle - first;
+		nodes.push_back(child);
+		child.first = middle;
+		child.count = first + count - middle;
+		nodes.push_back(child);
+		nodes[node_index].first = left;
+		nodes[node_index].count = 0;
+		tasks.push_back(std::make_pair(left, depth + 1));
+		tasks.push_back(std::make_pair(left + 1, depth + 1));
+	}
+}
+
+/// <summary>
+/// Returns distance where the ray enters the box, negative if the ray misses it
+/// </summary>
+static float IntersectBox(const BVHNode& node, const glm::vec3& origin, const glm::vec3& inverse_direction, float max_distance)
+{
+	glm::vec3 t1 = (node.min - origin) * inverse_direction;
+	glm::vec3 t2 = (node.max - origin) * inverse_direction;
+	glm::vec3 t_min = glm::min(t1, t2);
+	glm::vec3 t_max = glm::max(t1, t2);
+	float entry = std::max(std::max(t_min.x, t_min.y), std::max(t_min.z, 0.0f));
+	float exit = std::min(std::min(t_max.x, t_max.y), std::min(t_max.z, max_distance));
+	return entry <= exit ? entry : -1.0f;
+}
+
+static glm::vec3 GetInverseDirection(const glm::vec3& direction)
+{
+	glm::vec3 inverse;
+	for (int i = 0; i < 3; i++)
+		inverse[i] = 1.0f / (std::abs(direction[i]) > 1e-20f ? direction[i] : (direction[i] < 0.0f ? -1e-20f : 1e-20f));
+	return inverse;
+}
+
+/// <summary>
+/// Traverses the hierarchy from the nearest nodes, calls leaf test for every reached leaf
+/// </summary>
+/// <param name="leaf_test">Function (const BVHNode&amp; leaf, float&amp; distance) which tests items of the leaf and shortens the distance</param>
+template <typename LeafTest>
+static void TraverseTree(const std::vector<BVHNode>& nodes, const Ray& ray, float& distance, LeafTest leaf_test)
+{
+	if (nodes.empty()) return;
+	glm::vec3 inverse_direction = GetInverseDirection(ray.direction);
+	if (IntersectBox(nodes[0], ray.origin, inverse_direction, distance) < 0.0f) return;
+
+	GLuint stack[TRAVERSAL_STACK_SIZE];
+	float entries[TRAVERSAL_STACK_SIZE];
+	int stack_size = 1;
+	stack[0] = 0;
+	entries[0] = 0.0f;
+	while (stack_size > 0)
+	{
+		stack_size--;
+		// node could be reached only behind the hit found after it was pushed
+		if (entries[stack_size] > distance) continue;
+		const BVHNode& node = nodes[stack[stack_size]];
+		if (node.count > 0) {
+			leaf_test(node, distance);
+			continue;
+		}
+
+		float left = IntersectBox(nodes[node.first], ray.origin, inverse_direction, distance);
+		float right = IntersectBox(nodes[node.first + 1], ray.origin, inverse_direction, distance);
+		GLuint near_node = node.first;
+		GLuint far_node = node.first + 1;
+		if (right >= 0.0f && (left < 0.0f || right < left)) {
+			std::swap(left, right);
+			std::swap(near_node, far_node);
+		}
+		// far node is pushed first, so the near one is popped first
+		assert(stack_size + 2 <= TRAVERSAL_STACK_SIZE && "BVH is deeper than the traversal stack");
+		if (right >= 0.0f) {
+			stack[stack_size] = far_node;
+			entries[stack_size++] = right;
+		}
+		if (left >= 0.0f) {
+			stack[stack_size] = near_node;
+			entries[stack_size++] = left;
+		}
+	}
+}
+
+/// <summary>
+/// Tests the ray against four triangles of the packet
+/// </summary>
+/// <param name="distance">Maximal distance, returned distance of the hit</param>
+/// <returns>Returns lane of the nearest hit triangle or -1</returns>
+static int IntersectPacket(const MeshBVH::TrianglePacket& packet, const Ray& ray, float& distance)
+{
+#ifdef RAYCAST_SSE
+	// Moller-Trumbore test of four triangles at once, both sides of triangles are hit
+	__m128 dx = _mm_set1_ps(ray.direction.x);
+	__m128 dy = _mm_set1_ps(ray.direction.y);
+	__m128 dz = _mm_set1_ps(ray.direction.z);
+	__m128 e1x = _mm_loadu_ps(packet.edge1[0]);
+	__m128 e1y = _mm_loadu_ps(packet.edge1[1]);
+	__m128 e1z = _mm_loadu_ps(packet.edge1[2]);
+	__m128 e2x = _mm_loadu_ps(packet.edge2[0]);
+	__m128 e2y = _mm_loadu_ps(packet.edge2[1]);
+	__m128 e2z = _mm_loadu_ps(packet.edge2[2]);
+
+	__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	__m128 inverse_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+	__m128 tx = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_loadu_ps(packet.v0[0]));
+	__m128 ty = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_loadu_ps(packet.v0[1]));
+	__m128 tz = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_loadu_ps(packet.v0[2]));
+	__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), inverse_det);
+
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+	__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverse_det);
+	__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverse_det);
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 abs_det = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+	__m128 mask = _mm_cmpgt_ps(abs_det, _mm_set1_ps(RAY_EPSILON));
+	mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+	mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+	mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+	mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, zero));
+	mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(distance)));
+	int hits = _mm_movemask_ps(mask);
+	if (hits == 0) return -1;
+
+	float distances[4];
+	_mm_storeu_ps(distances, t);
+	int lane = -1;
+	for (int i = 0; i < 4; i++)
+		if ((hits & (1 << i)) && distances[i] < distance) {
+			distance = distances[i];
+			lane = i;
+		}
+	return lane;
+#else
+	int lane = -1;
+	for (int i = 0; i < 4; i++) {
+		glm::vec3 edge1(packet.edge1[0][i], packet.edge1[1][i], packet.edge1[2][i]);
+		glm::vec3 edge2(packet.edge2[0][i], packet.edge2[1][i], packet.edge2[2][i]);
+		glm::vec3 p = glm::cross(ray.direction, edge2);
+		float det = glm::dot(edge1, p);
+		if (std::abs(det) <= RAY_EPSILON) continue;
+		glm::vec3 to_origin = ray.origin - glm::vec3(packet.v0[0][i], packet.v0[1][i], packet.v0[2][i]);
+		float u = glm::dot(to_origin, p) / det;
+		glm::vec3 q = glm::cross(to_origin, edge1);
+		float v = glm::dot(ray.direction, q) / det;
+		float t = glm::dot(edge2, q) / det;
+		if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > 0.0f && t < distance) {
+			distance = t;
+			lane = i;
+		}
+	}
+	return lane;
+#endif
+}
+
+/// <summary>
+/// Tests the ray against one triangle without SIMD
+/// </summary>
+static bool IntersectTriangle(const glm::vec3& v0, const glm::vec3& edge1, const glm::vec3& edge2, const Ray& ray, float& distance)
+{
+	glm::vec3 p = glm::cross(ray.direction, edge2);
+	float det = glm::dot(edge1, p);
+	if (std::abs(det) <= RAY_EPSILON) return false;
+	float inverse_det = 1.0f / det;
+	glm::vec3 to_origin = ray.origin - v0;
+	float u = glm::dot(to_origin, p) * inverse_det;
+	if (u < 0.0f || u > 1.0f) return false;
+	glm::vec3 q = glm::cross(to_origin, edge1);
+	float v = glm::dot(ray.direction, q) * inverse_det;
+	if (v < 0.0f || u + v > 1.0f) return false;
+	float t = glm::dot(edge2, q) * inverse_det;
+	if (t <= 0.0f || t >= distance) return false;
+	distance = t;
+	return true;
+}
+
+static glm::vec3 GetPacketNormal(const MeshBVH::TrianglePacket& packet, int lane)
+{
+	glm::vec3 edge1(packet.edge1[0][lane], packet.edge1[1][lane], packet.edge1[2][lane]);
+	glm::vec3 edge2(packet.edge2[0][lane], packet.edge2[1][lane], packet.edge2[2][lane]);
+	return glm::cross(edge1, edge2);
+}
+
+Ray GetPixelRay(const glm::mat4& view, const glm::mat4& projection, GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	glm::mat4 inverse_view_projection = glm::inverse(projection * view);
+	glm::vec2 ndc((x + 0.5f) / std::max(width, 1) * 2.0f - 1.0f, (y + 0.5f) / std::max(height, 1) * 2.0f - 1.0f);
+	glm::vec4 near_point = inverse_view_projection * glm::vec4(ndc.x, ndc.y, -1.0f, 1.0f);
+	glm::vec4 far_point = inverse_view_projection * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+
+	Ray ray;
+	ray.origin = glm::vec3(near_point) / near_point.w;
+	ray.direction = glm::normalize(glm::vec3(far_point) / far_point.w - ray.origin);
+	return ray;
+}
+
+void MeshBVH::Build(const float* positions, GLuint stride, const GLuint* indices, GLuint triangles_count)
+{
+	Clear();
+	if (triangles_count == 0) return;
+
+	std::vector<BoundingBox> boxes(triangles_count);
+	for (GLuint i = 0; i < triangles_count; i++) {
+		BoundingBox& box = boxes[i];
+		box.min = glm::vec3(1e30f);
+		box.max = glm::vec3(-1e30f);
+		for (GLuint j = 0; j < 3; j++) {
+			const float* position = positions + indices[i * 3 + j] * stride;
+			glm::vec3 vertex(position[0], position[1], position[2]);
+			box.min = glm::min(box.min, vertex);
+			box.max = glm::max(box.max, vertex);
+		}
+	}
+	std::vector<GLuint> order;
+	BuildTree(boxes, MESH_LEAF_SIZE, nodes, order);
+
+	// every leaf becomes one packet, unused lanes stay zero
+	for (BVHNode& node : nodes)
+	{
+		if (node.count == 0) continue;
+		TrianglePacket packet = {};
+		for (GLuint lane = 0; lane < node.count; lane++) {
+			const GLuint* triangle = indices + order[node.first + lane] * 3;
+			const float* p0 = positions + triangle[0] * stride;
+			const float* p1 = positions + triangle[1] * stride;
+			const float* p2 = positions + triangle[2] * stride;
+			for (int axis = 0; axis < 3; axis++) {
+				packet.v0[axis][lane] = p0[axis];
+				packet.edge1[axis][lane] = p1[axis] - p0[axis];
+				packet.edge2[axis][lane] = p2[axis] - p0[axis];
+			}
+		}
+		node.first = (GLuint)packets.size();
+		packets.push_back(packet);
+	}
+	bounds.min = nodes[0].min;
+	bounds.max = nodes[0].max;
+}
+
+void MeshBVH::Clear()
+{
+	nodes.clear();
+	packets.clear();
+	bounds.min = bounds.max = glm::vec3(0.0f);
+}
+
+bool MeshBVH::Empty() const
+{
+	return nodes.empty();
+}
+
+bool MeshBVH::Intersect(const Ray& ray, float& distance, glm::vec3& normal) const
+{
+	const TrianglePacket* hit_packet = nullptr;
+	int hit_lane = -1;
+	TraverseTree(nodes, ray, distance, [&](const BVHNode& leaf, float& leaf_distance) {
+		int lane = IntersectPacket(packets[leaf.first], ray, leaf_distance);
+		if (lane >= 0) {
+			hit_packet = &packets[leaf.first];
+			hit_lane = lane;
+		}
+	});
+	if (hit_packet == nullptr) return false;
+	normal = GetPacketNormal(*hit_packet, hit_lane);
+	return true;
+}
+
+bool MeshBVH::IntersectBruteForce(const Ray& ray, float& distance, glm::vec3& normal) const
+{
+	bool hit = false;
+	for (const BVHNode& node : nodes)
+	{
+		if (node.count == 0) continue;
+		const TrianglePacket& packet = packets[node.first];
+		for (GLuint lane = 0; lane < node.count; lane++) {
+			glm::vec3 v0(packet.v0[0][lane], packet.v0[1][lane], packet.v0[2][lane]);
+			glm::vec3 edge1(packet.edge1[0][lane], packet.edge1[1][lane], packet.edge1[2][lane]);
+			glm::vec3 edge2(packet.edge2[0][lane], packet.edge2[1][lane], packet.edge2[2][lane]);
+			if (IntersectTriangle(v0, edge1, edge2, ray, distance)) {
+				normal = glm::cross(edge1, edge2);
+				hit = true;
+			}
+		}
+	}
+	return hit;
+}
+
+const BoundingBox& MeshBVH::GetBounds() const
+{
+	return bounds;
+}
+
+void SceneRaycaster::Build(GLuint count, const glm::mat4* world_matrices, const GLuint* model_ids, const GLuint* flags, const std::vector<const MeshBVH*>& model_bvhs)
+{
+	Clear();
+	std::vector<Instance> objects;
+	std::vector<BoundingBox> boxes;
+	for (GLuint i = 0; i < count; i++)
+	{
+		if (!(flags[i] & OBJECT_VISIBLE) || model_ids[i] >= model_bvhs.size()) continue;
+		const MeshBVH* mesh = model_bvhs[model_ids[i]];
+		if (mesh == nullptr || mesh->Empty()) continue;
+
+		Instance instance;
+		instance.inverse_matrix = glm::inverse(world_matrices[i]);
+		instance.mesh = mesh;
+		instance.object = i;
+		objects.push_back(instance);
+		boxes.push_back(GetWorldBox(world_matrices[i], mesh->GetBounds()));
+	}
+
+	std::vector<GLuint> order;
+	BuildTree(boxes, SCENE_LEAF_SIZE, nodes, order);
+	instances.reserve(order.size());
+	for (GLuint index : order) instances.push_back(objects[index]);
+}
+
+void SceneRaycaster::Clear()
+{
+	nodes.clear();
+	instances.clear();
+}
+
+bool SceneRaycaster::IntersectInstance(const Instance& instance, const Ray& ray, bool brute_force, RayHit& hit) const
+{
+	// direction is not normalized, so distances in model space are the same as in world space
+	Ray model_ray;
+	model_ray.origin = glm::vec3(instance.inverse_matrix * glm::vec4(ray.origin, 1.0f));
+	model_ray.direction = glm::mat3(instance.inverse_matrix) * ray.direction;
+
+	float distance = hit.distance;
+	glm::vec3 normal;
+	bool found = brute_force ? instance.mesh->IntersectBruteForce(model_ray, distance, normal) : instance.mesh->Intersect(model_ray, distance, normal);
+	if (!found) return false;
+
+	// normals are transformed by inverse transpose of the world matrix
+	normal = glm::normalize(glm::transpose(glm::mat3(instance.inverse_matrix)) * normal);
+	if (glm::dot(normal, ray.direction) > 0.0f) normal = -normal;
+	hit.object = instance.object;
+	hit.distance = distance;
+	hit.point = ray.origin + ray.direction * distance;
+	hit.normal = normal;
+	return true;
+}
+
+bool SceneRaycaster::Raycast(const Ray& ray, float max_distance, RayHit& hit) const
+{
+	hit.distance = max_distance;
+	bool found = false;
+	TraverseTree(nodes, ray, hit.distance, [&](const BVHNode& leaf, float& distance) {
+		for (GLuint i = leaf.first; i < leaf.first + leaf.count; i++)
+			if (IntersectInstance(instances[i], ray, false, hit)) found = true;
+		distance = hit.distance;
+	});
+	return found;
+}
+
+bool SceneRaycaster::RaycastBruteForce(const Ray& ray, float max_distance, RayHit& hit) const
+{
+	hit.distance = max_distance;
+	bool found = false;
+	for (const Instance& instance : instances)
+		if (IntersectInstance(instance, ray, true, hit)) found = true;
+	return found;
+}
@@ -0,0 +1,180 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       raycast.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines CPU ray casting against the scene: mesh BVHs and BVH of scene objects
+ *
+ * Every model has bounding volume hierarchy of its triangles built when the model is read.
+ * Leaves hold up to four triangles stored as one packet, so one SSE test checks the whole leaf.
+ * Scene objects have their own hierarchy of world boxes. Ray is transformed into model space
+ * of every object it reaches, so mesh hierarchies are shared by all objects of the model.
+ * Nothing here uses OpenGL, so picking works without window and framebuffer.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+#include <vector>
+
+#include "pgr.h"
+#include "culling.h"
+
+/// <summary>
+/// Ray. Distances along the ray are measured in lengths of the direction
+/// </summary>
+struct Ray {
+	glm::vec3 origin;
+	glm::vec3 direction;
+};
+
+/// <summary>
+/// Nearest hit of the ray
+/// </summary>
+struct RayHit {
+	/// <summary>
+	/// Index of the object in the scene
+	/// </summary>
+	GLuint object;
+	float distance;
+	glm::vec3 point;
+	/// <summary>
+	/// Normal of the hit triangle, looks against the ray
+	/// </summary>
+	glm::vec3 normal;
+};
+
+/// <summary>
+/// Node of bounding volume hierarchy. Inner node has count 0 and children first and first + 1,
+/// leaf has items first .. first + count - 1
+/// </summary>
+struct BVHNode {
+	glm::vec3 min;
+	GLuint first;
+	glm::vec3 max;
+	GLuint count;
+};
+
+/// <summary>
+/// Returns ray from the camera through the center of the pixel
+/// </summary>
+/// <param name="view">View matrix</param>
+/// <param name="projection">Projection matrix</param>
+/// <param name="x">Pixel x from the left</param>
+/// <param name="y">Pixel y from the bottom</param>
+/// <param name="width">Width of the viewport</param>
+/// <param name="height">Height of the viewport</param>
+/// <returns>Ray from the near plane with normalized direction</returns>
+Ray GetPixelRay(const glm::mat4& view, const glm::mat4& projection, GLint x, GLint y, GLsizei width, GLsizei height);
+
+/// <summary>
+/// Bounding volume hierarchy of triangles of one model
+/// </summary>
+class MeshBVH
+{
+public:
+	/// <summary>
+	/// Builds hierarchy of the triangles
+	/// </summary>
+	/// <param name="positions">Pointer to the position of the first vertex</param>
+	/// <param name="stride">Number of floats between positions of two vertices</param>
+	/// <param name="indices">Three vertex indices of every triangle</param>
+	/// <param name="triangles_count">Number of triangles</param>
+	void Build(const float* positions, GLuint stride, const GLuint* indices, GLuint triangles_count);
+	/// <summary>
+	/// Removes all triangles
+	/// </summary>
+	void Clear();
+	/// <summary>
+	/// Returns true if there are no triangles
+	/// </summary>
+	bool Empty() const;
+	/// <summary>
+	/// Finds the nearest triangle hit by the ray
+	/// </summary>
+	/// <param name="ray">Ray in model space</param>
+	/// <param name="distance">Maximal distance, returned distance of the hit</param>
+	/// <param name="normal">Returned normal of the triangle in model space, not normalized</param>
+	/// <returns>Returns true if the ray hits a triangle closer than the maximal distance</returns>
+	bool Intersect(const Ray& ray, float& distance, glm::vec3& normal) const;
+	/// <summary>
+	/// Like Intersect, but tests all triangles one by one without SIMD. Used to check the hierarchy
+	/// </summary>
+	bool IntersectBruteForce(const Ray& ray, float& distance, glm::vec3& normal) const;
+	/// <summary>
+	/// Returns box of all triangles
+	/// </summary>
+	const BoundingBox& GetBounds() const;
+	/// <summary>
+	/// Four triangles: first vertex and two edges, lanes are x, y, z components of the four triangles.
+	/// Unused lanes contain degenerate triangles
+	/// </summary>
+	struct TrianglePacket {
+		float v0[3][4];
+		float edge1[3][4];
+		float edge2[3][4];
+	};
+private:
+	std::vector<BVHNode> nodes;
+	/// <summary>
+	/// Triangles of leaf are packets[first], count is the number of used lanes
+	/// </summary>
+	std::vector<TrianglePacket> packets;
+	BoundingBox bounds;
+};
+
+/// <summary>
+/// Bounding volume hierarchy of scene objects
+/// </summary>
+class SceneRaycaster
+{
+public:
+	/// <summary>
+	/// Builds hierarchy of world boxes of the objects. Has to be built again when objects move
+	/// </summary>
+	/// <param name="count">Number of objects</param>
+	/// <param name="world_matrices">Array of object world matrices</param>
+	/// <param name="model_ids">Array of object model indeces</param>
+	/// <param name="flags">Array of object flags. Objects without OBJECT_VISIBLE flag are skipped</param>
+	/// <param name="model_bvhs">Hierarchies of the models, index is model id. Models without triangles are skipped.
+	/// Hierarchies are not copied, they have to live while the raycaster is used</param>
+	void Build(GLuint count, const glm::mat4* world_matrices, const GLuint* model_ids, const GLuint* flags, const std::vector<const MeshBVH*>& model_bvhs);
+	/// <summary>
+	/// Removes all objects
+	/// </summary>
+	void Clear();
+	/// <summary>
+	/// Finds the nearest object hit by the ray. Can be called from many threads at once
+	/// </summary>
+	/// <param name="ray">Ray in world space</param>
+	/// <param name="max_distance">Maximal distance of the hit</param>
+	/// <param name="hit">Returned hit</param>
+	/// <returns>Returns true if the ray hits an object</returns>
+	bool Raycast(const Ray& ray, float max_distance, RayHit& hit) const;
+	/// <summary>
+	/// Like Raycast, but tests all triangles of all objects. Used to check the hierarchies
+	/// </summary>
+	bool RaycastBruteForce(const Ray& ray, float max_distance, RayHit& hit) const;
+private:
+	/// <summary>
+	/// One object of the scene
+	/// </summary>
+	struct Instance {
+		glm::mat4 inverse_matrix;
+		const MeshBVH* mesh;
+		GLuint object;
+	};
+
+	/// <summary>
+	/// Tests the ray against one object and updates the hit if the object is closer
+	/// </summary>
+	bool IntersectInstance(const Instance& instance, const Ray& ray, bool brute_force, RayHit& hit) const;
+
+	std::vector<BVHNode> nodes;
+	/// <summary>
+	/// Objects in the order of leaves
+	/// </summary>
+	std::vector<Instance> instances;
+};
+
+#endif // !RAYCAST_H
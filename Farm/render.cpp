@@ -1,11 +1,188 @@
+#include <algorithm>
+#include <memory>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
 #include "render.h"
 #include "campfire.h"
+#include "profiler.h"
+#include "render_stats.h"
+#include "job_system.h"
+#include "culling.h"
+#include "picking.h"
+#include "stream_buffer.h"
+#include "dynamic_resolution.h"
+#include "terrain.h"
+#include "gpu_culling.h"
+#include "occlusion_culler.h"
+#include "mesh_clusters.h"
+#include "impostors.h"
+#include "gl_caps.h"
 
 std::vector<GLuint> shader_programs;
 std::vector<ModelContainer*> models;
 std::vector<GLuint> diffuse_textures;
 std::vector<GLuint> specular_textures;
-std::vector<std::pair<Transform, GLuint>> objects;
+SceneStore scene;
+/// <summary>
+/// Bounding spheres of the models, index is model id
+/// </summary>
+std::vector<glm::vec4> model_spheres;
+/// <summary>
+/// Bounding boxes of the models, index is model id
+/// </summary>
+std::vector<BoundingBox> model_boxes;
+/// <summary>
+/// Nonzero for glass models, index is model id
+/// </summary>
+std::vector<GLubyte> model_glass;
+/// <summary>
+/// Objects which passed frustum culling and their draw sort keys, reused every frame
+/// </summary>
+std::vector<GLuint> visible_objects;
+std::vector<GLuint64> draw_keys;
+/// <summary>
+/// What happens when object of the model is clicked, index is model id
+/// </summary>
+std::vector<PickAction> model_actions;
+/// <summary>
+/// Hierarchy of scene objects for CPU picking. Objects do not move, so it is built once after loading
+/// </summary>
+SceneRaycaster scene_raycaster;
+/// <summary>
+/// Uniform blocks of the drawn frames. Used only by the thread which owns GL context
+/// </summary>
+StreamBuffer stream_buffer;
+/// <summary>
+/// Static objects recorded for the last view. Reused while the camera, window size and scene do not change
+/// </summary>
+struct StaticObjectsCache {
+	Camera camera;
+	GLfloat width = 0.0f;
+	GLfloat height = 0.0f;
+	GLuint scene_version = 0;
+	std::shared_ptr<const StaticDrawList> list;
+	/// <summary>
+	/// Visible objects of animated and glass models, they are recorded every frame
+	/// </summary>
+	std::vector<GLuint> animated_objects;
+	/// <summary>
+	/// Version of the last recorded list
+	/// </summary>
+	GLuint last_version = 0;
+}static_cache;
+/// <summary>
+/// GPU copy of the static draw list: object blocks and indirect commands. Used only by the thread which owns GL context
+/// </summary>
+struct StaticCommands {
+	GLuint version = 0;
+	GLuint block_buffer = 0;
+	GLuint indirect_buffer = 0;
+	GLsizeiptr block_stride = 0;
+	/// <summary>
+	/// Program which reads object blocks from the storage buffer, object_static_vs.glsl. Zero if the context does not support
+	/// glMultiDrawElementsIndirect, then every item binds its uniform block and is drawn with glMultiDrawElements
+	/// </summary>
+	GLuint program = 0;
+	GLint object_index_location = -1;
+	/// <summary>
+	/// Indices 0, 1, 2, ... read by the object_index attribute, base instance of the command selects the item
+	/// </summary>
+	GLuint index_buffer = 0;
+	GLuint index_capacity = 0;
+	/// <summary>
+	/// One command for every index range, item i uses commands from item_commands[i] to item_commands[i + 1]
+	/// </summary>
+	std::vector<GLuint> item_commands;
+	std::vector<GLsizei> counts;
+	std::vector<const void*> offsets;
+	/// <summary>
+	/// Number of indices drawn by every item
+	/// </summary>
+	std::vector<GLsizei> item_index_counts;
+	/// <summary>
+	/// Runs of items with the same model, run i uses commands from run_commands[i] to run_commands[i + 1]
+	/// </summary>
+	std::vector<GLuint> run_models;
+	std::vector<GLuint> run_commands;
+	std::vector<GLsizei> run_index_counts;
+}static_commands;
+/// <summary>
+/// Passes of the drawn frame and pool of their render targets. Used only by the thread which owns GL context
+/// </summary>
+RenderGraph frame_graph;
+/// <summary>
+/// Scale of the scene resolution driven by GPU time of the frames. Used only by the thread which owns GL context
+/// </summary>
+DynamicResolution resolution_scaler;
+/// <summary>
+/// Ground of the scene. Covers the objects with the margin of the stream radius
+/// </summary>
+Terrain terrain;
+TerrainSettings terrain_settings;
+/// <summary>
+/// Culling of the static objects by compute shaders. Requested before loading, enabled only if the context supports it
+/// </summary>
+GpuCulling gpu_culling;
+bool gpu_culling_requested = false;
+bool gpu_culling_enabled = false;
+/// <summary>
+/// Culling of the static objects hidden behind the house, trailers and fences. Used only with culling on CPU
+/// </summary>
+OcclusionCuller occlusion_culler;
+bool occlusion_culling_enabled = false;
+/// <summary>
+/// Distant static objects drawn as quads with baked views. Used only with culling on CPU
+/// </summary>
+Impostors impostors;
+bool impostors_enabled = false;
+/// <summary>
+/// True after the views of the loaded models were baked (or baking failed), so they are baked at most once
+/// </summary>
+bool impostors_loaded = false;
+/// <summary>
+/// Fixed distance from the camera beyond which objects become impostors. If zero, it depends on the size of the object on the screen
+/// </summary>
+float impostor_distance = 0.0f;
+/// <summary>
+/// Vertical field of view of the camera in degrees
+/// </summary>
+const float CAMERA_FOV = 45.0f;
+/// <summary>
+/// Offsets of the current frame blocks in the stream buffer
+/// </summary>
+struct FrameBlocks {
+	GLintptr camera;
+	GLintptr lights;
+	/// <summary>
+	/// First object block, anim object block follows the scene objects
+	/// </summary>
+	GLintptr objects;
+	GLsizeiptr object_stride;
+	GLintptr banner;
+	/// <summary>
+	/// First sprite batch, every batch is an array of MAX_SPRITE_BATCH sprite blocks
+	/// </summary>
+	GLintptr sprites;
+	GLsizeiptr sprite_batch_stride;
+	/// <summary>
+	/// Billboards of the frame drawn by one batch, all of them have the same texture
+	/// </summary>
+	struct SpriteBatch {
+		GLuint first;
+		GLuint count;
+	};
+	std::vector<SpriteBatch> sprite_batches;
+}frame_blocks;
+
+/// <summary>
+/// Composite of the weighted blended transparency over the scene: program and empty VAO of the screen triangle
+/// </summary>
+struct TransparencyComposite {
+	GLuint program = 0;
+	GLuint vao = 0;
+}transparency_composite;
 
 const char* fog_texture_path = "Resources/Textures/fog.png";
 GLuint fog_texture;
@@ -29,7 +206,8 @@ struct FireInfo {
 	float fire_timer = 0;
 	float fire_timeout = 0.05f;
 	bool fire_enabled = true;
-	GLuint campfire_id;
+	GLuint campfire_id = 0xFFFFFFFF;
+	ObjectHandle campfire_object;
 }fire_info;
 
 /// <summary>
@@ -44,6 +222,7 @@ std::string banner_texture_path = "Resources/Textures/cow_diffuse.png";
 /// </summary>
 struct BannerInfo {
 	float timer = 0.0f;
+	float previous_timer = 0.0f;
 	float timeout = 3.0f;
 	glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f);
 	glm::vec3 target_scale = glm::vec3(3.0f, 1.0f, 1.0f);
@@ -62,6 +241,10 @@ struct Skybox {
 	float night_control_val;
 }skybox;
 const char* SKYBOX_CUBE_TEXTURE_FILE_PREFIX = "Resources/Textures/Skybox/skybox";
+/// <summary>
+/// Weight function of the weighted blended transparency, compiled with the fragment shaders of all transparent programs
+/// </summary>
+const char* TRANSPARENCY_WEIGHT_PATH = "transparency_weight.glsl";
 
 /// <summary>
 /// Defines the basic parameters required for rendering an animated object
@@ -73,7 +256,19 @@ struct AnimatedObjectInfo {
 	GLuint diffuse_texture, specular_texture;
 	glm::vec3 way_center = glm::vec3(-4.48f, 0.5f, - 13.0f);
 	glm::vec3 last_position = glm::vec3(-4.48f, 0.5f, -13.0f);
-	glm::vec3 last_direction;
+	/// <summary>
+	/// If object with this model is on the scene, way center is placed relatively to it
+	/// </summary>
+	std::string parent_model_path = "Resources/Models/trough.obj";
+	GLuint parent_model_id = 0xFFFFFFFF;
+	ObjectHandle parent_object;
+	glm::vec3 way_offset = glm::vec3(0.0f, 0.5f, 0.0f);
+	glm::vec3 last_direction = glm::vec3(0.0f, 0.0f, -1.0f);
+	/// <summary>
+	/// State before the last simulation step, drawing interpolates between it and the last state
+	/// </summary>
+	glm::vec3 previous_position = glm::vec3(-4.48f, 0.5f, -13.0f);
+	glm::vec3 previous_direction = glm::vec3(0.0f, 0.0f, -1.0f);
 	float time = 0;
 	float speed = 0.03f;
 	bool enabled = true;
@@ -82,6 +277,10 @@ struct AnimatedObjectInfo {
 std::string message = "Hello there";
 
 bool data_loaded = false;
+/// <summary>
+/// Fog, campfire or animated object was switched since the last TakeSceneChanged
+/// </summary>
+bool scene_changed = true;
 
 void LoadData(const std::string& config_file_path) 
 {
@@ -103,76 +302,64 @@ void LoadData(const std::string& config_file_path)
 	// Loading data for banner
 	LoadBanner();
 
-	// loading data from file
-	std::cout << "reading data from file" << std::endl;
-	std::vector<std::string> data;
-	ReadDataFromFile(config_file_path, data);
+	// Loading composite of the transparent passes
+	LoadTransparencyComposite();
 
-	// loading diffuse textures
-	std::cout << "loading diffuse textures" << std::endl;
-	GLuint textures_size = ReadHeader(data);
-	if (textures_size < 0) {
-		LoadFail("failed load diffuse textures.");
+	// loading binary scene, it is rebuilt from the configure file if needed
+	std::cout << "reading binary scene" << std::endl;
+	SceneSnapshot snapshot;
+	if (!OpenSceneSnapshot(config_file_path, snapshot)) {
+		LoadFail("failed load scene.");
 		return;
 	}
-	std::vector<std::string> textures_data;
-	if (!ReplaceData(textures_size, data, textures_data)) {
-		LoadFail("failed load diffuse textures.");
-		return;
-	}
-	if (!LoadTextures(textures_data, true)) {
+
+	// loading diffuse textures
+	std::cout << "loading diffuse textures" << std::endl;
+	if (!LoadTextures(snapshot, true)) {
 		LoadFail("failed load diffuse textures.");
 		return;
 	}
 	// loading specular textures
 	std::cout << "loading specular textures" << std::endl;
-	textures_size = ReadHeader(data);
-	if (textures_size < 0) {
-		LoadFail("failed load specular textures.");
-		return;
-	}
-	textures_data.clear();
-	if (!ReplaceData(textures_size, data, textures_data)) {
-		LoadFail("failed load specular textures.");
-		return;
-	}
-	if (!LoadTextures(textures_data, false)) {
+	if (!LoadTextures(snapshot, false)) {
 		LoadFail("failed load specular textures.");
 		return;
 	}
 	// Loading models
 	std::cout << "loading models" << std::endl;
-	GLuint models_size = ReadHeader(data);
-	if (models_size < 0) {
-		LoadFail("failed load models.");
-		return;
-	}
-	std::vector<std::string> models_data;
-	if (!ReplaceData(models_size, data, models_data)) {
-		LoadFail("failed load models.");
-		return;
-	}
-	if (!LoadModels(models_data)) {
+	if (!LoadModels(snapshot)) {
 		LoadFail("failed load models.");
 		return;
 	}
 	// loading objects
 	std::cout << "loading objects" << std::endl;
-	GLuint objects_size = ReadHeader(data);
-	if (objects_size < 0) {
+	if (!LoadObjects(snapshot)) {
 		LoadFail("failed load objects.");
 		return;
 	}
-	std::vector<std::string> objects_data;
-	if (!ReplaceData(objects_size, data, objects_data)) {
-		LoadFail("failed load objects.");
+
+	// loading terrain around the objects
+	std::cout << "loading terrain" << std::endl;
+	if (!LoadTerrain()) {
+		LoadFail("failed load terrain.");
 		return;
 	}
-	if (!LoadObjects(objects_data)) {
-		LoadFail("failed load objects.");
-		return;
+
+	// impostors are optional, without them distant objects are drawn as meshes. Views are baked only when they are used
+	if (impostors_enabled) {
+		std::cout << "baking impostors" << std::endl;
+		if (!LoadImpostors())
+			std::cout << "failed bake impostors" << std::endl;
 	}
 
+	// multi-draw is optional, without it static objects are drawn item by item
+	if (!LoadStaticObjectsProgram())
+		std::cout << "static objects are drawn without glMultiDrawElementsIndirect" << std::endl;
+
+	// GPU culling is optional, static objects fall back to the CPU culling
+	if (gpu_culling_requested && !LoadGpuCulling())
+		std::cout << "static objects are culled on CPU" << std::endl;
+
 	LoadAnimatedObject();
 
 	data_loaded = true;
@@ -186,19 +373,78 @@ bool LoadShaders()
 	shader_programs.push_back(program);
 	if (!LoadSingleShaderProgram("skybox_vs.glsl", "skybox_fs.glsl", program)) return false;
 	shader_programs.push_back(program);
-	if (!LoadSingleShaderProgram("anim_texture_vs.glsl", "anim_texture_fs.glsl", program)) return false;
+	if (!LoadSingleShaderProgram("anim_texture_vs.glsl", "anim_texture_fs.glsl", program, 0, TRANSPARENCY_WEIGHT_PATH)) return false;
 	shader_programs.push_back(program);
-	if (!LoadSingleShaderProgram("banner_vs.glsl", "banner_fs.glsl", program)) return false;
+	if (!LoadSingleShaderProgram("banner_vs.glsl", "banner_fs.glsl", program, 0, TRANSPARENCY_WEIGHT_PATH)) return false;
 	shader_programs.push_back(program);
+	// terrain is lit by the object fragment shader
+	if (!LoadSingleShaderProgram("terrain_vs.glsl", "object_fs.glsl", program)) return false;
+	shader_programs.push_back(program);
+	if (!LoadSingleShaderProgram("transparency_composite_vs.glsl", "transparency_composite_fs.glsl", program)) return false;
+	shader_programs.push_back(program);
+	if (!LoadSingleShaderProgram("object_vs.glsl", "object_glass_fs.glsl", program, shader_programs[0], TRANSPARENCY_WEIGHT_PATH)) return false;
+	shader_programs.push_back(program);
+
+	// samplers and material do not change, everything else comes from uniform blocks
+	for (GLuint i : { 0, 4, 6 }) SetObjectMaterialUniforms(shader_programs[i]);
+	for (GLuint i = 2; i < 4; i++) {
+		glUseProgram(shader_programs[i]);
+		glUniform1i(glGetUniformLocation(shader_programs[i], "tex"), 0);
+		glUniform1i(glGetUniformLocation(shader_programs[i], "fog_tex"), 1);
+	}
+	glUseProgram(0);
 
 	return true;
 }
 
-bool LoadSingleShaderProgram(const char* vs_path, const char* fs_path, GLuint& program)
+void SetObjectMaterialUniforms(GLuint program)
+{
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "material.diffuse"), 0);
+	glUniform1i(glGetUniformLocation(program, "material.specular"), 1);
+	glUniform1f(glGetUniformLocation(program, "material.shininess"), 32.0f);
+	glUniform1i(glGetUniformLocation(program, "fog_texture"), 2);
+}
+
+GLuint CreateShaderWithLibrary(GLenum type, const char* path, const char* library_path)
+{
+	// shader declares functions of the library, so the library is compiled after it as the second source string
+	std::string texts[2];
+	const char* paths[] = { path, library_path };
+	for (int i = 0; i < 2; i++) {
+		std::ifstream ifs(paths[i]);
+		if (!ifs.is_open()) {
+			std::cout << "failed to open shader file: " << paths[i] << std::endl;
+			return 0;
+		}
+		std::stringstream ss;
+		ss << ifs.rdbuf();
+		texts[i] = ss.str();
+	}
+	const char* sources[] = { texts[0].c_str(), texts[1].c_str() };
+
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 2, sources, nullptr);
+	glCompileShader(shader);
+	GLint status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status != GL_TRUE) {
+		GLint log_length = 0;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_length);
+		std::string log(std::max(log_length, 1), '\0');
+		glGetShaderInfoLog(shader, log_length, nullptr, &log[0]);
+		std::cout << "failed to compile shader " << path << " with " << library_path << ": " << log << std::endl;
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+bool LoadSingleShaderProgram(const char* vs_path, const char* fs_path, GLuint& program, GLuint attribute_program, const char* fs_library_path)
 {
 	GLuint shaders[] = {
 	pgr::createShaderFromFile(GL_VERTEX_SHADER, vs_path),
-	pgr::createShaderFromFile(GL_FRAGMENT_SHADER, fs_path),
+	fs_library_path != nullptr ? CreateShaderWithLibrary(GL_FRAGMENT_SHADER, fs_path, fs_library_path) : pgr::createShaderFromFile(GL_FRAGMENT_SHADER, fs_path),
 	0
 	};
 	if (shaders[0] == 0 || shaders[1] == 0) {
@@ -215,6 +461,30 @@ bool LoadSingleShaderProgram(const char* vs_path, const char* fs_path, GLuint& p
 		return false;
 	}
 
+	if (attribute_program != 0) {
+		const char* attribute_names[] = { "position", "normal", "texCoords" };
+		for (const char* name : attribute_names) {
+			GLint location = glGetAttribLocation(attribute_program, name);
+			if (location >= 0) glBindAttribLocation(program, location, name);
+		}
+		glLinkProgram(program);
+		GLint status = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &status);
+		if (status != GL_TRUE) {
+			std::cout << "failed to link program with the attribute locations. VS: " << vs_path << std::endl;
+			pgr::deleteProgramAndShaders(program);
+			return false;
+		}
+	}
+
+	// blocks which the program does not declare are skipped
+	const char* block_names[] = { "CameraBlock", "LightsBlock", "ObjectBlock", "BannerBlock", "SpriteBlock" };
+	const GLuint block_bindings[] = { CAMERA_BLOCK_BINDING, LIGHTS_BLOCK_BINDING, DRAW_BLOCK_BINDING, DRAW_BLOCK_BINDING, DRAW_BLOCK_BINDING };
+	for (GLuint i = 0; i < 5; i++) {
+		GLuint block_index = glGetUniformBlockIndex(program, block_names[i]);
+		if (block_index != GL_INVALID_INDEX) glUniformBlockBinding(program, block_index, block_bindings[i]);
+	}
+
 	return true;
 }
 
@@ -236,7 +506,7 @@ void initSkyboxGeometry() {
 	// buffer for far plane rendering
 	glGenBuffers(1, &skybox.VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, skybox.VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(screenCoords), screenCoords, GL_STATIC_DRAW);
+	StatsBufferData(GL_ARRAY_BUFFER, sizeof(screenCoords), screenCoords, GL_STATIC_DRAW);
 
 	//glUseProgram(farplaneShaderProgram);
 
@@ -289,6 +559,18 @@ void LoadFogTexture() {
 	CHECK_GL_ERROR();
 }
 
+void LoadTransparencyComposite()
+{
+	transparency_composite.program = shader_programs[5];
+	glUseProgram(transparency_composite.program);
+	glUniform1i(glGetUniformLocation(transparency_composite.program, "accumulation_texture"), 0);
+	glUniform1i(glGetUniformLocation(transparency_composite.program, "weight_texture"), 1);
+	glUseProgram(0);
+	// the triangle is made from gl_VertexID, but core profile does not draw without VAO
+	glGenVertexArrays(1, &transparency_composite.vao);
+	CHECK_GL_ERROR();
+}
+
 void LoadAnimTextures()
 {
 	float texture_verts[] =
@@ -348,10 +630,10 @@ void LoadGeometry(Geometry& model_geometry, float* verts, GLuint* indexes, GLuin
 	glBindVertexArray(model_geometry.VAO);
 
 	glBindBuffer(GL_ARRAY_BUFFER, model_geometry.VBO);
-	glBufferData(GL_ARRAY_BUFFER, 20 * sizeof(float), verts, GL_STATIC_DRAW);
+	StatsBufferData(GL_ARRAY_BUFFER, 20 * sizeof(float), verts, GL_STATIC_DRAW);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model_geometry.EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(GLuint), indexes, GL_STATIC_DRAW);
+	StatsBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(GLuint), indexes, GL_STATIC_DRAW);
 
 	GLuint attrib_location;
 	attrib_location = model_geometry.shader.GetAttribValue("position");
@@ -367,11 +649,12 @@ void LoadGeometry(Geometry& model_geometry, float* verts, GLuint* indexes, GLuin
 	CHECK_GL_ERROR();
 }
 
-bool LoadTextures(const std::vector<std::string>& textures_data, bool diffuse)
+bool LoadTextures(const SceneSnapshot& snapshot, bool diffuse)
 {
-	for (int i = 0; i < textures_data.size(); i++) 
+	GLuint textures_count = diffuse ? snapshot.GetDiffuseTexturesCount() : snapshot.GetSpecularTexturesCount();
+	for (GLuint i = 0; i < textures_count; i++) 
 	{
-		GLuint texture = pgr::createTexture(textures_data[i]);
+		GLuint texture = pgr::createTexture(diffuse ? snapshot.GetDiffuseTexturePath(i) : snapshot.GetSpecularTexturePath(i));
 		if (texture == 0) return false;
 		if (diffuse) diffuse_textures.push_back(texture);
 		else specular_textures.push_back(texture);
@@ -379,36 +662,68 @@ bool LoadTextures(const std::vector<std::string>& textures_data, bool diffuse)
 	return true;
 }
 
-bool LoadModels(const std::vector<std::string>& models_data) 
+bool LoadModels(const SceneSnapshot& snapshot) 
 {
-	for (GLuint i = 0; i < models_data.size() / 3; i++) {
+	// model files are read in parallel, OpenGL objects are created on this thread
+	GLuint models_count = snapshot.GetModelsCount();
+	std::vector<ModelContainer::MeshData> meshes(models_count);
+	std::unique_ptr<bool[]> meshes_loaded(new bool[models_count]());
+	JobCounter counter;
+	for (GLuint i = 0; i < models_count; i++) {
+		if (std::string(snapshot.GetModelPath(i)) == "Resources/Models/campfire.obj") continue;
+		RunJob([&snapshot, &meshes, &meshes_loaded, i] {
+			meshes_loaded[i] = ModelContainer::LoadMeshData(snapshot.GetModelPath(i), meshes[i]);
+		}, &counter);
+	}
+	WaitForCounter(counter);
+
+	for (GLuint i = 0; i < models_count; i++) {
 		ModelContainer * model = new ModelContainer();
-		GLbyte stencil_id = 0;
-		if (models_data[i * 3] == "Resources/Models/tractor.obj") stencil_id = 2;
-		else if (models_data[i * 3] == "Resources/Models/trough.obj") stencil_id = 3;
-		if (models_data[i * 3] == "Resources/Models/campfire.obj") {
+		std::string model_path = snapshot.GetModelPath(i);
+		PickAction action = PICK_NOTHING;
+		if (model_path == "Resources/Models/tractor.obj") action = PICK_SWITCH_FOG;
+		else if (model_path == "Resources/Models/trough.obj") action = PICK_SWITCH_ANIM_OBJECT;
+		else if (model_path == "Resources/Models/campfire.obj") action = PICK_SWITCH_CAMPFIRE;
+		model_actions.push_back(action);
+		if (model_path == anim_obj_info.parent_model_path) anim_obj_info.parent_model_id = i;
+		if (model_path == "Resources/Models/campfire.obj") {
 			LoadCampfire(&model);
 			fire_info.campfire_id = i;
 		}
-		else if (!model->CreateModel(models_data[i * 3].c_str(), shader_programs[0], stencil_id)) {
-			std::cout << "failed to create model. model id: " << i * 3 << std::endl;
+		else if (meshes_loaded[i]) {
+			model->CreateModel(meshes[i], shader_programs[0]);
+			if (IsOccluderModel(model_path) && !meshes[i].vertices.empty())
+				occlusion_culler.SetOccluder(i, glm::value_ptr(meshes[i].vertices[0].position), sizeof(ModelContainer::Vertex) / sizeof(float),
+					meshes[i].indices.data(), (GLuint)meshes[i].indices.size() / 3);
+			meshes[i] = ModelContainer::MeshData();
+		}
+		else {
+			std::cout << "failed to create model. model id: " << i << std::endl;
 			delete model;
 			return false;
 		}
-		GLuint diffuse_texture = diffuse_textures[std::stoi(models_data[i * 3 + 1])];
-		GLuint specular_texture = specular_textures[std::stoi(models_data[i * 3 + 2])];
+		GLuint diffuse_texture = diffuse_textures[snapshot.GetModelDiffuseId(i)];
+		GLuint specular_texture = specular_textures[snapshot.GetModelSpecularId(i)];
 		model->SetMaterial(diffuse_texture, specular_texture, 32);
 		model->SetFogTexture(fog_texture);
 		models.push_back(model);
+		model_spheres.push_back(model->GetBoundingSphere());
+		model_boxes.push_back(model->GetBoundingBox());
+		model_glass.push_back(model->IsGlass() ? 1 : 0);
 	}
 
 	return true;
 }
 
+bool IsOccluderModel(const std::string& model_path)
+{
+	return model_path == "Resources/Models/house.obj" || model_path == "Resources/Models/trailer.obj" ||
+		model_path == "Resources/Models/fence.obj" || model_path == "Resources/Models/gate.obj";
+}
+
 void LoadCampfire(ModelContainer** model) {
 
 	(*model)->SetShaderProgram(shader_programs[0]);
-	(*model)->SetStencilId((GLbyte)1);
 
 	GLuint VAO, VBO, EBO;
 
@@ -419,10 +734,10 @@ void LoadCampfire(ModelContainer** model) {
 	glBindVertexArray(VAO);
 
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, planeNVertices * planeNAttribsPerVertex * sizeof(float), planeVertices, GL_STATIC_DRAW);
+	StatsBufferData(GL_ARRAY_BUFFER, planeNVertices * planeNAttribsPerVertex * sizeof(float), planeVertices, GL_STATIC_DRAW);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, planeNTriangles * 3 * sizeof(GLuint), planeTriangles, GL_STATIC_DRAW);
+	StatsBufferData(GL_ELEMENT_ARRAY_BUFFER, planeNTriangles * 3 * sizeof(GLuint), planeTriangles, GL_STATIC_DRAW);
 
 	GLuint attrib_location;
 
@@ -445,299 +760,1012 @@ void LoadCampfire(ModelContainer** model) {
 	(*model)->SetVAO(VAO);
 	(*model)->SetVBO(VBO);
 	(*model)->SetEBO(EBO, planeNTriangles * 3);
+	(*model)->SetBoundingSphere(ComputeBoundingSphere(planeVertices, planeNVertices, planeNAttribsPerVertex));
+	(*model)->SetBoundingBox(ComputeBoundingBox(planeVertices, planeNVertices, planeNAttribsPerVertex));
+	MeshBVH bvh;
+	bvh.Build(planeVertices, planeNAttribsPerVertex, planeTriangles, planeNTriangles);
+	(*model)->SetBVH(bvh);
 }
 
-bool LoadObjects(const std::vector<std::string>& objects_data) 
+bool LoadObjects(const SceneSnapshot& snapshot) 
 {
-	for (GLuint i = 0; i < objects_data.size() / 4; i++) 
-	{
-		GLuint model_id;
-		try
-		{
-			model_id = (GLuint)std::stoi(objects_data[i * 4]);
-		}
-		catch (const std::exception&)
-		{
-			return false;
-		}
-		if (model_id < 0 || model_id >= models.size())
-		{
-			std::cout << "model id out of range. object id: " << i * 4 << std::endl;
-			return false;
-		}
-		Transform transform;
-		if(!GetVector3f(objects_data[i * 4 + 1], transform.position)) return false;
-		if(!GetVector4f(objects_data[i * 4 + 2], transform.rotation)) return false;
-		if(!GetVector3f(objects_data[i * 4 + 3], transform.scale)) return false;
+	// all the data was checked when binary scene was opened, so arrays are copied as they are
+	GLuint objects_count = snapshot.GetObjectsCount();
+	scene.Reserve(objects_count);
+	scene.Append(objects_count, snapshot.GetPositions(), snapshot.GetRotations(), snapshot.GetScales(), snapshot.GetModelIds(), snapshot.GetParents());
+	scene.UpdateWorldMatrices();
+
+	const GLuint* model_ids = scene.GetModelIds();
+	for (GLuint i = 0; i < objects_count; i++) {
+		if (model_ids[i] == fire_info.campfire_id && !scene.IsValid(fire_info.campfire_object))
+			fire_info.campfire_object = scene.GetHandle(i);
+		if (model_ids[i] == anim_obj_info.parent_model_id && !scene.IsValid(anim_obj_info.parent_object))
+			anim_obj_info.parent_object = scene.GetHandle(i);
+	}
+
+	std::vector<const MeshBVH*> model_bvhs;
+	for (ModelContainer* model : models) model_bvhs.push_back(&model->GetBVH());
+	scene_raycaster.Build(objects_count, scene.GetWorldMatrices(), model_ids, scene.GetFlags(), model_bvhs);
 
-		objects.push_back(std::make_pair(transform, model_id));
+	return true;
+}
+
+bool LoadTerrain()
+{
+	// terrain reaches the stream radius beyond the outermost objects, so the camera at the border still sees the ground
+	glm::vec2 area_min = glm::vec2(0.0f);
+	glm::vec2 area_max = glm::vec2(0.0f);
+	const glm::mat4* world_matrices = scene.GetWorldMatrices();
+	for (GLuint i = 0; i < scene.Size(); i++) {
+		glm::vec2 position = glm::vec2(world_matrices[i][3].x, world_matrices[i][3].z);
+		area_min = glm::min(area_min, position);
+		area_max = glm::max(area_max, position);
+	}
+	area_min -= glm::vec2(terrain_settings.stream_radius);
+	area_max += glm::vec2(terrain_settings.stream_radius);
+	return terrain.Load(terrain_settings, area_min, area_max, shader_programs[4], fog_texture);
+}
+
+void SetGpuCulling(bool enabled)
+{
+	gpu_culling_requested = enabled;
+}
+
+bool LoadGpuCulling()
+{
+	gpu_culling_enabled = false;
+	if (!GpuCulling::IsSupported()) {
+		std::cout << "GPU culling needs OpenGL 4.3" << std::endl;
+		return false;
 	}
 
+	GLuint program;
+	if (!LoadSingleShaderProgram("object_instanced_vs.glsl", "object_fs.glsl", program, shader_programs[0])) return false;
+	shader_programs.push_back(program);
+	SetObjectMaterialUniforms(program);
+	glUseProgram(0);
+
+	if (!gpu_culling.Create(program)) return false;
+	gpu_culling_enabled = true;
 	return true;
 }
 
+bool LoadStaticObjectsProgram()
+{
+	static_commands.program = 0;
+	if (!HasGLVersion(4, 3)) return false;
+
+	GLuint program;
+	if (!LoadSingleShaderProgram("object_static_vs.glsl", "object_fs.glsl", program, shader_programs[0])) return false;
+	shader_programs.push_back(program);
+	SetObjectMaterialUniforms(program);
+	glUseProgram(0);
+
+	static_commands.object_index_location = glGetAttribLocation(program, "object_index");
+	if (static_commands.object_index_location < 0) return false;
+	static_commands.program = program;
+	return true;
+}
+
+bool LoadImpostors()
+{
+	impostors_loaded = true;
+	GLuint bake_program, draw_program;
+	if (!LoadSingleShaderProgram("impostor_bake_vs.glsl", "impostor_bake_fs.glsl", bake_program, shader_programs[0])) return false;
+	shader_programs.push_back(bake_program);
+	SetObjectMaterialUniforms(bake_program);
+	if (!LoadSingleShaderProgram("impostor_vs.glsl", "impostor_fs.glsl", draw_program)) return false;
+	shader_programs.push_back(draw_program);
+	glUseProgram(0);
+
+	// animated models and the campfire plane change in time, their views can not be baked
+	std::vector<GLuint> model_ids;
+	for (GLuint i = 0; i < models.size() && model_ids.size() < MAX_IMPOSTOR_MODELS; i++)
+		if (i != fire_info.campfire_id && !models[i]->IsAnimated() && model_spheres[i].w > 0.0f)
+			model_ids.push_back(i);
+	return impostors.Bake(models, model_spheres, model_ids, bake_program, draw_program);
+}
+
 void LoadAnimatedObject() 
 {
 	anim_obj_info.model = new ModelContainer();
 	anim_obj_info.diffuse_texture = pgr::createTexture(anim_obj_info.diffuse_path);
 	anim_obj_info.specular_texture = pgr::createTexture(anim_obj_info.specular_path);
-	anim_obj_info.model->CreateModel("Resources/Models/duck.obj", shader_programs[0], 0, true, true);
+	anim_obj_info.model->CreateModel("Resources/Models/duck.obj", shader_programs[0], true, true);
 	anim_obj_info.model->SetMaterial(anim_obj_info.diffuse_texture, anim_obj_info.specular_texture, 32);
 	anim_obj_info.model->SetFogTexture(fog_texture);
 }
 
-void Draw(const DirectLight& direct_light, const PointLight& point_light, const SpotLight& spot_light, const Camera& camera, GLfloat win_width, GLfloat win_height, float dt)
+void Simulate(float dt)
 {
 	if (!data_loaded) return;
 
-	glm::mat4 viewMatrix;
-	viewMatrix = glm::lookAt(camera.position, camera.position + camera.direction, camera.camera_up);
+	ParallelFor((GLuint)models.size(), 16, [dt](GLuint begin, GLuint end) {
+		for (GLuint i = begin; i < end; i++)
+			models[i]->Update(dt);
+	});
+	anim_obj_info.model->Update(dt);
 
-	glm::mat4 projectionMatrix = glm::perspective(45.0f, win_width / win_height, 0.1f, 100.0f);
+	// animated object
+	scene.UpdateWorldMatrices();
+	if (scene.IsValid(anim_obj_info.parent_object))
+		anim_obj_info.way_center = scene.GetWorldPosition(anim_obj_info.parent_object) + anim_obj_info.way_offset;
 
-	
-	drawSkybox(viewMatrix, projectionMatrix);
+	float changed_time = anim_obj_info.time + (anim_obj_info.enabled ? dt : anim_obj_info.speed);
+	anim_obj_info.time = anim_obj_info.enabled ? changed_time : anim_obj_info.time;
 
-	for (GLuint i = 0; i < objects.size(); i++)
-	{
-		glm::mat4 modelMatrix;
-		modelMatrix = glm::translate(modelMatrix, objects[i].first.position);
-		modelMatrix = glm::rotate(modelMatrix, glm::radians(objects[i].first.rotation[3]), glm::vec3(objects[i].first.rotation));
-		modelMatrix = glm::scale(modelMatrix, objects[i].first.scale);
+	glm::vec3 new_anim_position = glm::vec3(glm::cos(changed_time) * 0.75f, 0.0f, glm::sin(changed_time) * glm::cos(changed_time) / 2) + anim_obj_info.way_center;
+	anim_obj_info.previous_position = anim_obj_info.last_position;
+	anim_obj_info.previous_direction = anim_obj_info.last_direction;
+	anim_obj_info.last_direction = glm::normalize(new_anim_position - anim_obj_info.last_position);
+	if (anim_obj_info.enabled) anim_obj_info.last_position = new_anim_position;
 
-		GLuint model_id = objects[i].second;
-		models[model_id]->Draw(modelMatrix, viewMatrix, projectionMatrix, direct_light, point_light, spot_light, camera, dt, fog_enabled);
-		//CHECK_GL_ERROR();
+	// banner
+	banner_info.previous_timer = banner_info.timer;
+	banner_info.timer += dt;
+	if (banner_info.timer >= banner_info.timeout) {
+		banner_info.timer = 0.0f;
+		banner_info.previous_timer = 0.0f;
 	}
 
-	DrawAnimatedObject(direct_light, point_light, spot_light, camera, projectionMatrix, viewMatrix, dt);
-
-	DrawBanner(projectionMatrix, viewMatrix, camera, dt, glm::vec3(16.6f, 8.3f, 34.85f), glm::vec3(2.0f, 8.0f, 1.0f));
-
-	DrawAnimTexture(projectionMatrix, viewMatrix, camera, UFO, 1, 1, 0, glm::vec3(16.3f, 8.3f, 34.25f), glm::vec3(4.0f, 8.0f, 4.0f));
-
-	if (fire_info.fire_enabled) {
+	// fire
+	if (fire_info.fire_enabled && scene.IsValid(fire_info.campfire_object)) {
 		fire_info.fire_timer += dt;
 		if (fire_info.fire_timer >= fire_info.fire_timeout) {
 			fire_info.fire_index++;
 			fire_info.fire_index %= 12;
 			fire_info.fire_timer = 0.0f;
 		}
+	}
+}
+
+glm::mat4 GetViewMatrix(const Camera& camera)
+{
+	return glm::lookAt(camera.position, camera.position + camera.direction, camera.camera_up);
+}
+
+glm::mat4 GetProjectionMatrix(GLfloat win_width, GLfloat win_height)
+{
+	return glm::perspective(CAMERA_FOV, win_width / win_height, 0.1f, 100.0f);
+}
+
+void RecordFrame(FrameCommands& frame, const DirectLight& direct_light, const PointLight& point_light, const SpotLight& spot_light, const Camera& camera, GLfloat win_width, GLfloat win_height, float alpha)
+{
+	if (!data_loaded) return;
+	PROFILE_SCOPE("RecordFrame");
+
+	frame.camera = camera;
+	frame.direct_light = direct_light;
+	frame.point_light = point_light;
+	frame.spot_light = spot_light;
+	frame.fog_enabled = fog_enabled;
+	frame.night_value = skybox.night_control_val;
+	frame.view_matrix = GetViewMatrix(camera);
+	frame.projection_matrix = GetProjectionMatrix(win_width, win_height);
+
+	{
+		PROFILE_SCOPE("UpdateWorldMatrices");
+		scene.UpdateWorldMatrices();
+	}
+	// parked camera sees the same static objects, only animated ones are recorded again.
+	// Culled on GPU, the list does not depend on the view at all
+	bool view_changed = static_cache.width != win_width || static_cache.height != win_height ||
+		static_cache.camera.position != camera.position || static_cache.camera.direction != camera.direction || static_cache.camera.camera_up != camera.camera_up;
+	if (static_cache.list == nullptr || static_cache.scene_version != scene.GetVersion() || (view_changed && !gpu_culling_enabled))
+		RecordStaticObjects(camera, frame.projection_matrix * frame.view_matrix, win_width, win_height);
+	frame.static_objects = static_cache.list;
+	frame.gpu_culling = gpu_culling_enabled;
+
+	// chunks which did not fit into this frame are streamed in by the next ones
+	terrain.Record(frame, camera.position, GetFrustum(frame.projection_matrix * frame.view_matrix), win_height / (2.0f * glm::tan(glm::radians(CAMERA_FOV / 2.0f))));
+	if (terrain.HasPendingChunks()) scene_changed = true;
+
+	const glm::mat4* world_matrices = scene.GetWorldMatrices();
+	const GLuint* model_ids = scene.GetModelIds();
+	for (GLuint i : static_cache.animated_objects)
+	{
+		DrawItem item;
+		item.world_matrix = world_matrices[i];
+		item.model_id = model_ids[i];
+		item.object_id = i + 1;
+		item.time = models[model_ids[i]]->GetTime();
+		frame.objects.push_back(item);
+	}
+
+	RecordAnimatedObject(frame, alpha);
+	RecordBanner(frame, alpha, glm::vec3(16.6f, 8.3f, 34.85f), glm::vec3(2.0f, 8.0f, 1.0f));
+	RecordAnimTexture(frame, UFO, 1, 1, 0, glm::vec3(16.3f, 8.3f, 34.25f), glm::vec3(4.0f, 8.0f, 4.0f));
+
+	if (fire_info.fire_enabled && scene.IsValid(fire_info.campfire_object)) {
 		glm::vec3 campfire_pos;
 		GetCampfireData(campfire_pos);
 		campfire_pos.y += 1.0f;
-		DrawAnimTexture(projectionMatrix, viewMatrix, camera, FIRE, 4, 4, fire_info.fire_index, campfire_pos, glm::vec3(1.0f, 1.0f, 1.0f));
+		RecordAnimTexture(frame, FIRE, 4, 4, fire_info.fire_index, campfire_pos, glm::vec3(1.0f, 1.0f, 1.0f));
 	}
 
-	DrawMessage(projectionMatrix, viewMatrix, camera, message);
-	return;
+	RecordMessage(frame, message);
+
+	// transparency does not depend on the order, so billboards with the same texture are drawn together
+	std::stable_sort(frame.billboards.begin(), frame.billboards.end(), [](const BillboardItem& a, const BillboardItem& b) {
+		return a.type < b.type;
+	});
+}
+
+void RecordStaticObjects(const Camera& camera, const glm::mat4& view_projection, GLfloat win_width, GLfloat win_height)
+{
+	PROFILE_SCOPE("RecordStaticObjects");
+	const glm::mat4* world_matrices = scene.GetWorldMatrices();
+	const GLuint* model_ids = scene.GetModelIds();
+	if (gpu_culling_enabled) {
+		// compute pass culls static objects, the list keeps all of them grouped by model
+		const GLuint* flags = scene.GetFlags();
+		visible_objects.clear();
+		for (GLuint i = 0; i < scene.Size(); i++)
+			if (flags[i] & OBJECT_VISIBLE) visible_objects.push_back(i);
+	}
+	else {
+		PROFILE_SCOPE("Culling");
+		Frustum frustum = GetFrustum(view_projection);
+		CullObjects(frustum, scene.Size(), world_matrices, model_ids, scene.GetFlags(), model_spheres.data(), visible_objects);
+		if (occlusion_culling_enabled)
+			occlusion_culler.Cull(view_projection, camera.position, world_matrices, model_ids, model_boxes.data(), visible_objects);
+	}
+	BuildSortKeys(visible_objects, world_matrices, model_ids, model_glass.data(), camera.position, 100.0f, draw_keys);
+	std::sort(draw_keys.begin(), draw_keys.end());
+
+	// frames which still use the previous list keep it alive
+	std::shared_ptr<StaticDrawList> list = std::make_shared<StaticDrawList>();
+	list->version = ++static_cache.last_version;
+	list->items.reserve(draw_keys.size());
+	static_cache.animated_objects.clear();
+	Frustum frustum = GetFrustum(view_projection);
+	float projection_scale = win_height / (2.0f * glm::tan(glm::radians(CAMERA_FOV / 2.0f)));
+	for (GLuint64 key : draw_keys)
+	{
+		GLuint i = (GLuint)(key & 0xFFFFFFFF);
+		if (models[model_ids[i]]->IsAnimated() || models[model_ids[i]]->IsGlass()) {
+			static_cache.animated_objects.push_back(i);
+			continue;
+		}
+		DrawItem item;
+		item.world_matrix = world_matrices[i];
+		item.model_id = model_ids[i];
+		item.object_id = i + 1;
+		item.time = 0.0f;
+		// distant object is drawn as one quad. Culled on GPU, the list does not depend on the view, so there are no impostors
+		if (impostors_enabled && !gpu_culling_enabled && impostors.HasImpostor(item.model_id)) {
+			glm::vec4 sphere = GetWorldSphere(item.world_matrix, model_spheres[item.model_id]);
+			float distance = glm::length(glm::vec3(sphere) - camera.position);
+			float threshold = impostor_distance > 0.0f ? impostor_distance : Impostors::GetImpostorDistance(sphere.w, projection_scale);
+			if (distance - sphere.w > threshold) {
+				list->impostors.push_back(item);
+				continue;
+			}
+		}
+		// culled on GPU, the list does not depend on the view, so whole models are drawn
+		const std::vector<MeshCluster>& clusters = models[item.model_id]->GetClusters();
+		if (!gpu_culling_enabled && !clusters.empty()) {
+			item.first_range = (GLuint)list->ranges.size();
+			item.ranges_count = CullMeshClusters(clusters, item.world_matrix, frustum, camera.position, list->ranges);
+			if (item.ranges_count == 0) continue;
+		}
+		list->items.push_back(item);
+	}
+
+	static_cache.list = list;
+	static_cache.camera = camera;
+	static_cache.width = win_width;
+	static_cache.height = win_height;
+	static_cache.scene_version = scene.GetVersion();
+}
+
+void UpdateStaticCommands(const StaticDrawList& list)
+{
+	bool indirect = static_commands.program != 0;
+	static_commands.version = list.version;
+	// storage buffer array is tightly packed, uniform block ranges have to be aligned
+	static_commands.block_stride = indirect ? sizeof(ObjectBlock) : stream_buffer.GetAlignedSize(sizeof(ObjectBlock));
+	static_commands.item_commands.assign(1, 0);
+	static_commands.counts.clear();
+	static_commands.offsets.clear();
+	static_commands.item_index_counts.clear();
+	static_commands.run_models.clear();
+	static_commands.run_commands.assign(1, 0);
+	static_commands.run_index_counts.clear();
+	if (list.items.empty()) return;
+
+	// every visible cluster range is one command, items without ranges draw the whole model
+	std::vector<GLubyte> blocks(list.items.size() * static_commands.block_stride);
+	std::vector<DrawElementsIndirectCommand> commands;
+	for (GLuint i = 0; i < list.items.size(); i++)
+	{
+		const DrawItem& item = list.items[i];
+		models[item.model_id]->WriteObjectBlock(*(ObjectBlock*)&blocks[i * static_commands.block_stride], item.world_matrix, item.time, item.object_id);
+		// items are sorted by model, so all commands of one model follow each other
+		if (static_commands.run_models.empty() || static_commands.run_models.back() != item.model_id) {
+			if (!static_commands.run_models.empty()) static_commands.run_commands.push_back((GLuint)commands.size());
+			static_commands.run_models.push_back(item.model_id);
+			static_commands.run_index_counts.push_back(0);
+		}
+		GLsizei index_count = 0;
+		for (GLuint range = 0; range < std::max(item.ranges_count, 1u); range++)
+		{
+			DrawElementsIndirectCommand command;
+			command.count = item.ranges_count > 0 ? list.ranges[item.first_range + range].index_count : models[item.model_id]->GetIndexCount();
+			command.instance_count = 1;
+			command.first_index = item.ranges_count > 0 ? list.ranges[item.first_range + range].first_index : 0;
+			command.base_vertex = 0;
+			command.base_instance = i;
+			commands.push_back(command);
+			static_commands.counts.push_back(command.count);
+			static_commands.offsets.push_back((const void*)(command.first_index * sizeof(GLuint)));
+			index_count += command.count;
+		}
+		static_commands.item_commands.push_back((GLuint)commands.size());
+		static_commands.item_index_counts.push_back(index_count);
+		static_commands.run_index_counts.back() += index_count;
+	}
+	static_commands.run_commands.push_back((GLuint)commands.size());
+
+	if (static_commands.block_buffer == 0) glGenBuffers(1, &static_commands.block_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, static_commands.block_buffer);
+	StatsBufferData(GL_UNIFORM_BUFFER, blocks.size(), blocks.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	if (!indirect) return;
+
+	if (static_commands.indirect_buffer == 0) glGenBuffers(1, &static_commands.indirect_buffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, static_commands.indirect_buffer);
+	StatsBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	if (static_commands.index_buffer == 0) glGenBuffers(1, &static_commands.index_buffer);
+	if (list.items.size() > static_commands.index_capacity) {
+		std::vector<GLuint> indices(list.items.size());
+		for (GLuint i = 0; i < indices.size(); i++) indices[i] = i;
+		glBindBuffer(GL_ARRAY_BUFFER, static_commands.index_buffer);
+		StatsBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		static_commands.index_capacity = (GLuint)indices.size();
+	}
+	for (GLuint model_id : static_commands.run_models)
+		models[model_id]->SetObjectIndexBuffer(static_commands.object_index_location, static_commands.index_buffer);
+}
+
+void DrawStaticObjects(const StaticDrawList& list)
+{
+	if (list.version != static_commands.version) UpdateStaticCommands(list);
+	if (list.items.empty()) return;
+
+	if (static_commands.program != 0) {
+		// one call draws all objects of one model, base instance of every command selects its object block
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, static_commands.indirect_buffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_DATA_BINDING, static_commands.block_buffer);
+		for (GLuint i = 0; i < static_commands.run_models.size(); i++)
+		{
+			ModelContainer* model = models[static_commands.run_models[i]];
+			GLuint first = static_commands.run_commands[i];
+			GLsizei draw_count = static_commands.run_commands[i + 1] - first;
+			model->Bind(static_commands.program);
+			model->MultiDrawIndirect(first * sizeof(DrawElementsIndirectCommand), draw_count, static_commands.run_index_counts[i]);
+		}
+		StatsBindVertexArray(0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		return;
+	}
+
+	// items are sorted by model, so the model state is bound once for all its objects
+	GLuint bound_model = 0xFFFFFFFF;
+	for (GLuint i = 0; i < list.items.size(); i++)
+	{
+		GLuint model_id = list.items[i].model_id;
+		glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_BLOCK_BINDING, static_commands.block_buffer, i * static_commands.block_stride, sizeof(ObjectBlock));
+		if (model_id != bound_model) {
+			models[model_id]->Bind();
+			bound_model = model_id;
+		}
+		GLuint first = static_commands.item_commands[i];
+		GLsizei draw_count = static_commands.item_commands[i + 1] - first;
+		models[model_id]->MultiDrawElements(&static_commands.counts[first], &static_commands.offsets[first], draw_count);
+	}
+	StatsBindVertexArray(0);
+}
+
+void ReleaseStaticCommands()
+{
+	if (static_commands.block_buffer != 0) glDeleteBuffers(1, &static_commands.block_buffer);
+	if (static_commands.indirect_buffer != 0) glDeleteBuffers(1, &static_commands.indirect_buffer);
+	if (static_commands.index_buffer != 0) glDeleteBuffers(1, &static_commands.index_buffer);
+	static_commands = StaticCommands();
+}
+
+bool WriteFrameBlocks(const FrameCommands& frame)
+{
+	GLuint objects_count = (GLuint)frame.objects.size() + (frame.anim_object_enabled ? 1 : 0);
+	// billboards are already grouped by texture, every group is split into batches of MAX_SPRITE_BATCH
+	frame_blocks.sprite_batches.clear();
+	for (GLuint i = 0; i < frame.billboards.size(); i++) {
+		if (i == 0 || frame.billboards[i].type != frame.billboards[i - 1].type || frame_blocks.sprite_batches.back().count == MAX_SPRITE_BATCH)
+			frame_blocks.sprite_batches.push_back({ i, 0 });
+		frame_blocks.sprite_batches.back().count++;
+	}
+	GLuint batches_count = (GLuint)frame_blocks.sprite_batches.size();
+	frame_blocks.object_stride = stream_buffer.GetAlignedSize(sizeof(ObjectBlock));
+	frame_blocks.sprite_batch_stride = stream_buffer.GetAlignedSize(sizeof(SpriteBlock) * MAX_SPRITE_BATCH);
+	GLsizeiptr required_size = stream_buffer.GetAlignedSize(sizeof(CameraBlock)) + stream_buffer.GetAlignedSize(sizeof(LightsBlock)) +
+		stream_buffer.GetAlignedSize(sizeof(BannerBlock)) + frame_blocks.object_stride * objects_count + frame_blocks.sprite_batch_stride * batches_count;
+	if (!stream_buffer.BeginFrame(required_size)) return false;
+	// buffer could be created with bigger alignment than the default one
+	frame_blocks.object_stride = stream_buffer.GetAlignedSize(sizeof(ObjectBlock));
+	frame_blocks.sprite_batch_stride = stream_buffer.GetAlignedSize(sizeof(SpriteBlock) * MAX_SPRITE_BATCH);
+
+	CameraBlock* camera = (CameraBlock*)stream_buffer.Allocate(sizeof(CameraBlock), frame_blocks.camera);
+	LightsBlock* lights = (LightsBlock*)stream_buffer.Allocate(sizeof(LightsBlock), frame_blocks.lights);
+	GLubyte* objects = (GLubyte*)stream_buffer.Allocate(frame_blocks.object_stride * objects_count, frame_blocks.objects);
+	BannerBlock* banner = (BannerBlock*)stream_buffer.Allocate(sizeof(BannerBlock), frame_blocks.banner);
+	GLubyte* sprites = (GLubyte*)stream_buffer.Allocate(frame_blocks.sprite_batch_stride * batches_count, frame_blocks.sprites);
+	if (camera == nullptr || lights == nullptr || banner == nullptr ||
+		(objects == nullptr && objects_count != 0) || (sprites == nullptr && batches_count != 0)) {
+		stream_buffer.EndWriting();
+		return false;
+	}
+
+	camera->projection_matrix = frame.projection_matrix;
+	camera->view_matrix = frame.view_matrix;
+	camera->view_position = frame.camera.position;
+	camera->fog = frame.fog_enabled;
+
+	lights->direct_light.ambient = frame.direct_light.ambient;
+	lights->direct_light.diffuse = frame.direct_light.diffuse;
+	lights->direct_light.specular = frame.direct_light.specular;
+	lights->direct_light.intensity = frame.direct_light.intensity;
+	lights->direct_light.direction = frame.direct_light.direction;
+	const PointLight* point_lights[] = { &frame.point_light, &frame.spot_light.point };
+	PointLightBlock* point_blocks[] = { &lights->point_light, &lights->spot_light.point };
+	for (GLuint i = 0; i < 2; i++) {
+		point_blocks[i]->ambient = point_lights[i]->ambient;
+		point_blocks[i]->diffuse = point_lights[i]->diffuse;
+		point_blocks[i]->specular = point_lights[i]->specular;
+		point_blocks[i]->intensity = point_lights[i]->intensity;
+		point_blocks[i]->position = point_lights[i]->position;
+		point_blocks[i]->linear = point_lights[i]->linear;
+		point_blocks[i]->quadratic = point_lights[i]->quadratic;
+	}
+	lights->spot_light.direction = frame.spot_light.direction;
+	lights->spot_light.cut_off = glm::cos(glm::radians(frame.spot_light.cut_off));
+
+	for (GLuint i = 0; i < frame.objects.size(); i++) {
+		const DrawItem& item = frame.objects[i];
+		models[item.model_id]->WriteObjectBlock(*(ObjectBlock*)(objects + i * frame_blocks.object_stride), item.world_matrix, item.time, item.object_id);
+	}
+	if (frame.anim_object_enabled)
+		anim_obj_info.model->WriteObjectBlock(*(ObjectBlock*)(objects + frame.objects.size() * frame_blocks.object_stride),
+			frame.anim_object.world_matrix, frame.anim_object.time, frame.anim_object.object_id);
+
+	banner->model_matrix = frame.banner_matrix;
+	banner->texture_matrix = frame.banner_texture_matrix;
+
+	for (GLuint batch = 0; batch < batches_count; batch++) {
+		SpriteBlock* batch_sprites = (SpriteBlock*)(sprites + batch * frame_blocks.sprite_batch_stride);
+		for (GLuint i = 0; i < frame_blocks.sprite_batches[batch].count; i++) {
+			const BillboardItem& item = frame.billboards[frame_blocks.sprite_batches[batch].first + i];
+			batch_sprites[i].model_matrix = item.model_matrix;
+			batch_sprites[i].size_x = item.size_x;
+			batch_sprites[i].size_y = item.size_y;
+			batch_sprites[i].index = item.index;
+		}
+	}
+
+	stream_buffer.EndWriting();
+	return true;
+}
+
+void AddScenePasses(RenderGraph& graph, const FrameCommands& frame, RenderResource window, GLsizei scene_width, GLsizei scene_height)
+{
+	RenderTargetDesc color_desc;
+	color_desc.width = scene_width;
+	color_desc.height = scene_height;
+	color_desc.format = GL_RGBA8;
+	color_desc.clear_value = glm::vec4(0.1f, 0.1f, 0.1f, 1.0f);
+	RenderTargetDesc id_desc = color_desc;
+	id_desc.format = GL_R32UI;
+	id_desc.clear_value = glm::vec4((float)NO_OBJECT_ID);
+	RenderTargetDesc depth_desc = color_desc;
+	depth_desc.format = GL_DEPTH24_STENCIL8;
+	depth_desc.clear_value = glm::vec4(1.0f);
+	RenderResource scene_color = graph.CreateTarget("SceneColor", color_desc);
+	RenderResource object_ids = graph.CreateTarget("ObjectIds", id_desc);
+	RenderResource scene_depth = graph.CreateTarget("SceneDepth", depth_desc);
+
+	PassState opaque_state;
+	opaque_state.polygon_mode = frame.polygon_mode;
+	PassState blended_state = opaque_state;
+	blended_state.blend = true;
+
+	// culling runs before all passes, it has no outputs in the graph
+	GLuint pass;
+	if (frame.gpu_culling) {
+		pass = graph.AddPass("GpuCulling", opaque_state, [&frame]() {
+			if (frame.static_objects != nullptr) gpu_culling.Update(*frame.static_objects, models, model_spheres);
+			gpu_culling.Cull(frame.projection_matrix * frame.view_matrix);
+		});
+		graph.SetSideEffect(pass);
+	}
+
+	pass = graph.AddPass("Skybox", opaque_state, [&frame]() {
+		drawSkybox(frame);
+	});
+	graph.AddColorOutput(pass, scene_color);
+	graph.SetDepthOutput(pass, scene_depth);
+
+	// object shader writes object IDs into the second output, graph attaches it only when somebody reads it
+	pass = graph.AddPass("Objects", blended_state, [&frame]() {
+		stream_buffer.BindUniformBlock(CAMERA_BLOCK_BINDING, frame_blocks.camera, sizeof(CameraBlock));
+		stream_buffer.BindUniformBlock(LIGHTS_BLOCK_BINDING, frame_blocks.lights, sizeof(LightsBlock));
+		if (frame.gpu_culling) gpu_culling.Draw(models);
+		else if (frame.static_objects != nullptr) {
+			DrawStaticObjects(*frame.static_objects);
+			impostors.Draw(*frame.static_objects, fog_texture);
+		}
+		// glass is drawn later by the transparent pass
+		for (GLuint i = 0; i < frame.objects.size(); i++)
+		{
+			if (models[frame.objects[i].model_id]->IsGlass()) continue;
+			stream_buffer.BindUniformBlock(DRAW_BLOCK_BINDING, frame_blocks.objects + i * frame_blocks.object_stride, sizeof(ObjectBlock));
+			models[frame.objects[i].model_id]->Draw();
+			//CHECK_GL_ERROR();
+		}
+		if (frame.anim_object_enabled && !anim_obj_info.model->IsGlass()) {
+			stream_buffer.BindUniformBlock(DRAW_BLOCK_BINDING, frame_blocks.objects + frame.objects.size() * frame_blocks.object_stride, sizeof(ObjectBlock));
+			anim_obj_info.model->Draw();
+		}
+		// terrain is drawn last, the objects already cover part of it in the depth buffer
+		terrain.Draw(frame);
+	});
+	graph.AddColorOutput(pass, scene_color);
+	graph.AddColorOutput(pass, object_ids);
+	graph.SetDepthOutput(pass, scene_depth);
+
+	// next frame tests static objects against the depth of this one
+	if (frame.gpu_culling) {
+		pass = graph.AddPass("DepthPyramid", opaque_state, [&graph, &frame, scene_depth, scene_width, scene_height]() {
+			gpu_culling.BuildDepthPyramid(graph.GetTexture(scene_depth), scene_width, scene_height, frame.projection_matrix * frame.view_matrix);
+		});
+		graph.AddInput(pass, scene_depth);
+		graph.SetSideEffect(pass);
+	}
+
+	PassState copy_state;
+	copy_state.depth_test = false;
+	copy_state.depth_write = false;
+
+	// banner and text are drawn at native resolution over the upscaled scene, depth is upscaled for them too
+	RenderResource output_color = scene_color;
+	RenderResource output_depth = scene_depth;
+	if (scene_width != frame.width || scene_height != frame.height) {
+		color_desc.width = depth_desc.width = frame.width;
+		color_desc.height = depth_desc.height = frame.height;
+		output_color = graph.CreateTarget("OutputColor", color_desc);
+		output_depth = graph.CreateTarget("OutputDepth", depth_desc);
+		pass = graph.AddPass("Upscale", copy_state, [&graph, &frame, scene_color, scene_depth, scene_width, scene_height]() {
+			graph.BindReadTarget(scene_color);
+			glBlitFramebuffer(0, 0, scene_width, scene_height, 0, 0, frame.width, frame.height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+			graph.BindReadTarget(scene_depth);
+			glBlitFramebuffer(0, 0, scene_width, scene_height, 0, 0, frame.width, frame.height, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+		});
+		graph.AddInput(pass, scene_color);
+		graph.AddInput(pass, scene_depth);
+		graph.AddColorOutput(pass, output_color);
+		graph.SetDepthOutput(pass, output_depth);
+	}
+
+	// weighted blended transparency: glass, banner and billboards are accumulated in any order and composited over the scene.
+	// Color channels add up premultiplied color and weight, alpha multiplies revealage
+	if (frame.banner_enabled || !frame.billboards.empty() || HasGlassObjects(frame)) {
+		RenderTargetDesc accumulation_desc = color_desc;
+		accumulation_desc.format = GL_RGBA16F;
+		accumulation_desc.clear_value = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		RenderTargetDesc weight_desc = color_desc;
+		weight_desc.format = GL_R16F;
+		weight_desc.clear_value = glm::vec4(0.0f);
+		RenderResource accumulation = graph.CreateTarget("TransparentAccumulation", accumulation_desc);
+		RenderResource weight = graph.CreateTarget("TransparentWeight", weight_desc);
+
+		PassState transparent_state = blended_state;
+		transparent_state.depth_write = false;
+		transparent_state.blend_src = GL_ONE;
+		transparent_state.blend_dst = GL_ONE;
+		transparent_state.blend_src_alpha = GL_ZERO;
+		transparent_state.blend_dst_alpha = GL_ONE_MINUS_SRC_ALPHA;
+		pass = graph.AddPass("Transparent", transparent_state, [&frame]() {
+			DrawGlassObjects(frame);
+			if (frame.banner_enabled) DrawBanner();
+			if (!frame.billboards.empty()) DrawAnimTextures(frame);
+		});
+		graph.AddColorOutput(pass, accumulation);
+		graph.AddColorOutput(pass, weight);
+		graph.SetDepthOutput(pass, output_depth);
+
+		PassState composite_state = copy_state;
+		composite_state.blend = true;
+		pass = graph.AddPass("TransparentComposite", composite_state, [&graph, accumulation, weight]() {
+			StatsUseProgram(transparency_composite.program);
+			glActiveTexture(GL_TEXTURE0);
+			StatsBindTexture(GL_TEXTURE_2D, graph.GetTexture(accumulation));
+			glActiveTexture(GL_TEXTURE1);
+			StatsBindTexture(GL_TEXTURE_2D, graph.GetTexture(weight));
+			glActiveTexture(GL_TEXTURE0);
+			StatsBindVertexArray(transparency_composite.vao);
+			StatsDrawArrays(GL_TRIANGLES, 0, 3);
+			StatsBindVertexArray(0);
+		});
+		graph.AddInput(pass, accumulation);
+		graph.AddInput(pass, weight);
+		graph.AddColorOutput(pass, output_color);
+	}
+
+	pass = graph.AddPass("Present", copy_state, [&graph, &frame, output_color]() {
+		graph.BindReadTarget(output_color);
+		glBlitFramebuffer(0, 0, frame.width, frame.height, 0, 0, frame.width, frame.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	});
+	graph.AddInput(pass, output_color);
+	graph.AddColorOutput(pass, window);
+
+	if (frame.pick_requested) {
+		// object IDs are at the scene resolution
+		GLint pick_x = frame.pick_x * scene_width / std::max(frame.width, 1);
+		GLint pick_y = frame.pick_y * scene_height / std::max(frame.height, 1);
+		pass = graph.AddPass("PickReadback", copy_state, [&graph, object_ids, pick_x, pick_y, scene_width, scene_height]() {
+			graph.BindReadTarget(object_ids);
+			RequestPick(pick_x, pick_y, scene_width, scene_height);
+		});
+		graph.AddInput(pass, object_ids);
+		graph.SetSideEffect(pass);
+	}
 }
 
-void drawSkybox(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) {
+void Draw(const FrameCommands& frame)
+{
+	if (!data_loaded) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		return;
+	}
+	// chunks streamed in by the frame are already resident, they are uploaded even if the frame is not drawn
+	terrain.Upload(frame);
+	if (!WriteFrameBlocks(frame)) {
+		std::cout << "failed to write uniform blocks of the frame" << std::endl;
+		return;
+	}
+
+	GLint window_framebuffer;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &window_framebuffer);
+	resolution_scaler.SetTargetFrameTime(frame.target_frame_time);
+	resolution_scaler.BeginFrame();
+	frame_graph.Reset();
+	RenderResource window = frame_graph.ImportFramebuffer("Window", window_framebuffer, frame.width, frame.height);
+	AddScenePasses(frame_graph, frame, window, resolution_scaler.GetScaledSize(frame.width), resolution_scaler.GetScaledSize(frame.height));
+	frame_graph.Execute();
+	resolution_scaler.EndFrame();
+
+	stream_buffer.EndFrame();
+}
 
-	glUseProgram(skybox.shader.GetProgram());
+void drawSkybox(const FrameCommands& frame) {
 
-	// compose transformations
-	glm::mat4 matrix = projectionMatrix * viewMatrix;
+	StatsUseProgram(skybox.shader.GetProgram());
 
 	// create view rotation matrix by using view matrix with cleared translation
-	glm::mat4 viewRotation = viewMatrix;
+	glm::mat4 viewRotation = frame.view_matrix;
 	viewRotation[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
 
 	// vertex shader will translate screen space coordinates (NDC) using inverse PV matrix
-	glm::mat4 inversePVmatrix = glm::inverse(projectionMatrix * viewRotation);
+	glm::mat4 inversePVmatrix = glm::inverse(frame.projection_matrix * viewRotation);
 
-	glUniformMatrix4fv(skybox.shader.GetUniformValue("inversePVmatrix"), 1, GL_FALSE, glm::value_ptr(inversePVmatrix));
-	glUniform1i(skybox.shader.GetUniformValue("skyboxSampler"), 0);
-	glUniform1i(skybox.shader.GetUniformValue("isFog"), fog_enabled);
-	glUniform1f(skybox.shader.GetUniformValue("night_control_val"), skybox.night_control_val);
+	StatsUniform(skybox.shader.GetUniformValue("inversePVmatrix"), inversePVmatrix);
+	StatsUniform(skybox.shader.GetUniformValue("skyboxSampler"), 0);
+	StatsUniform(skybox.shader.GetUniformValue("isFog"), frame.fog_enabled);
+	StatsUniform(skybox.shader.GetUniformValue("night_control_val"), frame.night_value);
 	
 
 	// draw "skybox" rendering 2 triangles covering the plane
-	glBindVertexArray(skybox.VAO);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, skybox.texture);
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, skybox.numTriangles + 2);
+	StatsBindVertexArray(skybox.VAO);
+	StatsBindTexture(GL_TEXTURE_CUBE_MAP, skybox.texture);
+	StatsDrawArrays(GL_TRIANGLE_STRIP, 0, skybox.numTriangles + 2);
 
-	glBindVertexArray(0);
-	glUseProgram(0);
+	StatsBindVertexArray(0);
+	StatsUseProgram(0);
 }
 
-void DrawAnimatedObject(const DirectLight& direct_light, const PointLight& point_light, const SpotLight& spot_light, const Camera& camera, const glm::mat4& projectionMatrix, const glm::mat4& viewMatrix, float dt)
+bool HasGlassObjects(const FrameCommands& frame)
 {
-	float changed_time = anim_obj_info.time + (anim_obj_info.enabled ? dt : anim_obj_info.speed);
-	anim_obj_info.time = anim_obj_info.enabled ? changed_time : anim_obj_info.time;
-
-	glm::vec3 new_anim_position = glm::vec3(glm::cos(changed_time) * 0.75f, 0.0f, glm::sin(changed_time) * glm::cos(changed_time) / 2) + anim_obj_info.way_center;
-	glm::vec3 new_anim_direction = glm::normalize(new_anim_position - anim_obj_info.last_position);
-	glm::mat4 modelMatrix = GetRotatedModelMatrix(-new_anim_direction, anim_obj_info.last_position, glm::vec3(0.125f));
+	if (frame.anim_object_enabled && anim_obj_info.model->IsGlass()) return true;
+	for (const DrawItem& item : frame.objects)
+		if (models[item.model_id]->IsGlass()) return true;
+	return false;
+}
 
-	if (anim_obj_info.enabled)
+void DrawGlassObjects(const FrameCommands& frame)
+{
+	stream_buffer.BindUniformBlock(CAMERA_BLOCK_BINDING, frame_blocks.camera, sizeof(CameraBlock));
+	stream_buffer.BindUniformBlock(LIGHTS_BLOCK_BINDING, frame_blocks.lights, sizeof(LightsBlock));
+	for (GLuint i = 0; i < frame.objects.size(); i++)
 	{
-		anim_obj_info.last_position = new_anim_position;
-		anim_obj_info.last_direction = new_anim_direction;
+		ModelContainer* model = models[frame.objects[i].model_id];
+		if (!model->IsGlass()) continue;
+		stream_buffer.BindUniformBlock(DRAW_BLOCK_BINDING, frame_blocks.objects + i * frame_blocks.object_stride, sizeof(ObjectBlock));
+		model->Bind(shader_programs[6]);
+		model->DrawElements();
+	}
+	if (frame.anim_object_enabled && anim_obj_info.model->IsGlass()) {
+		stream_buffer.BindUniformBlock(DRAW_BLOCK_BINDING, frame_blocks.objects + frame.objects.size() * frame_blocks.object_stride, sizeof(ObjectBlock));
+		anim_obj_info.model->Bind(shader_programs[6]);
+		anim_obj_info.model->DrawElements();
 	}
+	StatsBindVertexArray(0);
+}
 
-	anim_obj_info.model->Draw(modelMatrix, viewMatrix, projectionMatrix, direct_light, point_light, spot_light, camera, dt, fog_enabled);
+void RecordAnimatedObject(FrameCommands& frame, float alpha)
+{
+	glm::vec3 position, direction;
+	GetAnimObjectData(position, direction, alpha);
+	frame.anim_object.world_matrix = GetRotatedModelMatrix(-direction, position, glm::vec3(0.125f));
+	frame.anim_object.model_id = 0xFFFFFFFF;
+	frame.anim_object.object_id = NO_OBJECT_ID;
+	frame.anim_object.time = anim_obj_info.model->GetTime();
+	frame.anim_object_enabled = true;
 }
 
-void DrawBanner(const glm::mat4& projectionMatrix, const glm::mat4& viewMatrix, const Camera& camera, float dt, glm::vec3 position, glm::vec3 scale)
+void RecordBanner(FrameCommands& frame, float alpha, glm::vec3 position, glm::vec3 scale)
 {
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	banner_info.timer += dt;
-	if (banner_info.timer >= banner_info.timeout) {
-		banner_info.timer = 0.0f;
-	}
+	float timer = glm::mix(banner_info.previous_timer, banner_info.timer, alpha);
 
-	glm::mat4 modelMatrix = GetRotatedModelMatrix(glm::vec3(camera.direction.x, 0.0f, camera.direction.z), position, scale);
+	frame.banner_matrix = GetRotatedModelMatrix(glm::vec3(frame.camera.direction.x, 0.0f, frame.camera.direction.z), position, scale);
 
-	glm::vec3 banner_position_offset = glm::mix(glm::vec3(0.0f), banner_info.target_position_offset, banner_info.timer / banner_info.timeout);
-	glm::vec3 banner_current_scale = glm::mix(banner_info.scale, banner_info.target_scale, banner_info.timer / banner_info.timeout);
+	glm::vec3 banner_position_offset = glm::mix(glm::vec3(0.0f), banner_info.target_position_offset, timer / banner_info.timeout);
+	glm::vec3 banner_current_scale = glm::mix(banner_info.scale, banner_info.target_scale, timer / banner_info.timeout);
 
 	glm::mat4 texModelMatrix;
 	texModelMatrix = glm::translate(texModelMatrix, banner_position_offset);
 	texModelMatrix = glm::scale(texModelMatrix, banner_current_scale);
+	frame.banner_texture_matrix = texModelMatrix;
+	frame.banner_enabled = true;
+}
 
+void DrawBanner()
+{
 	banner_texture_plane.shader.UseProgram();
-	glUniformMatrix4fv(banner_texture_plane.shader.GetUniformValue("projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-	glUniformMatrix4fv(banner_texture_plane.shader.GetUniformValue("viewMatrix"), 1, GL_FALSE, glm::value_ptr(viewMatrix));
-	glUniformMatrix4fv(banner_texture_plane.shader.GetUniformValue("modelMatrix"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
-	glUniformMatrix4fv(banner_texture_plane.shader.GetUniformValue("texModelMatrix"), 1, GL_FALSE, glm::value_ptr(texModelMatrix));
-	glUniform3fv(banner_texture_plane.shader.GetUniformValue("viewPos"), 1, glm::value_ptr(camera.position));
-	glUniform1i(banner_texture_plane.shader.GetUniformValue("fog"), fog_enabled);
-	glUniform1i(banner_texture_plane.shader.GetUniformValue("tex"), 0);
-	glUniform1i(banner_texture_plane.shader.GetUniformValue("fog_tex"), 1);
+	stream_buffer.BindUniformBlock(DRAW_BLOCK_BINDING, frame_blocks.banner, sizeof(BannerBlock));
 
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, banner_texture);
+	StatsBindTexture(GL_TEXTURE_2D, banner_texture);
 	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, fog_texture);
+	StatsBindTexture(GL_TEXTURE_2D, fog_texture);
 
-	glBindVertexArray(banner_texture_plane.VAO);
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	StatsBindVertexArray(banner_texture_plane.VAO);
+	StatsDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	StatsBindVertexArray(0);
 }
 
-void DrawAnimTexture(const glm::mat4& projectionMatrix, const glm::mat4& viewMatrix, const Camera& camera, GLuint type, int size_x, int size_y, int index, glm::vec3 tex_coord, glm::vec3 tex_scale, bool enable_rotation)
+void RecordAnimTexture(FrameCommands& frame, GLuint type, int size_x, int size_y, int index, glm::vec3 tex_coord, glm::vec3 tex_scale, bool enable_rotation)
 {
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glm::mat4 modelMatrix;
+	BillboardItem item;
 	if (enable_rotation)
 	{
-		modelMatrix = GetRotatedModelMatrix(glm::vec3(camera.direction.x, 0.0f, camera.direction.z), tex_coord, tex_scale);
+		item.model_matrix = GetRotatedModelMatrix(glm::vec3(frame.camera.direction.x, 0.0f, frame.camera.direction.z), tex_coord, tex_scale);
 	}
 	else
 	{
-		modelMatrix = glm::translate(modelMatrix, tex_coord);
-		modelMatrix = glm::scale(modelMatrix, tex_scale);
+		item.model_matrix = glm::translate(glm::mat4(1.0f), tex_coord);
+		item.model_matrix = glm::scale(item.model_matrix, tex_scale);
 	}
+	item.type = type;
+	item.size_x = size_x;
+	item.size_y = size_y;
+	item.index = index;
+	frame.billboards.push_back(item);
+}
 
+void DrawAnimTextures(const FrameCommands& frame)
+{
 	anim_texture_plane.shader.UseProgram();
-	glUniformMatrix4fv(anim_texture_plane.shader.GetUniformValue("projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-	glUniformMatrix4fv(anim_texture_plane.shader.GetUniformValue("viewMatrix"), 1, GL_FALSE, glm::value_ptr(viewMatrix));
-	glUniformMatrix4fv(anim_texture_plane.shader.GetUniformValue("modelMatrix"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
-	glUniform3fv(anim_texture_plane.shader.GetUniformValue("viewPos"), 1, glm::value_ptr(camera.position));
-	glUniform1i(anim_texture_plane.shader.GetUniformValue("fog"), fog_enabled);
-	glUniform1i(anim_texture_plane.shader.GetUniformValue("size_x"), size_x);
-	glUniform1i(anim_texture_plane.shader.GetUniformValue("size_y"), size_y);
-	glUniform1i(anim_texture_plane.shader.GetUniformValue("index"), index);
-	glUniform1f(anim_texture_plane.shader.GetUniformValue("offset_x"), 1.0f / size_x);
-	glUniform1f(anim_texture_plane.shader.GetUniformValue("offset_y"), 1.0f / size_y);
-	glUniform1i(anim_texture_plane.shader.GetUniformValue("tex"), 0);
-	glUniform1i(anim_texture_plane.shader.GetUniformValue("fog_tex"), 1);
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, anim_textures[type]);
 	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, fog_texture);
+	StatsBindTexture(GL_TEXTURE_2D, fog_texture);
+	glActiveTexture(GL_TEXTURE0);
 
-	glBindVertexArray(anim_texture_plane.VAO);
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	StatsBindVertexArray(anim_texture_plane.VAO);
+	for (GLuint batch = 0; batch < frame_blocks.sprite_batches.size(); batch++) {
+		const FrameBlocks::SpriteBatch& sprite_batch = frame_blocks.sprite_batches[batch];
+		stream_buffer.BindUniformBlock(DRAW_BLOCK_BINDING, frame_blocks.sprites + batch * frame_blocks.sprite_batch_stride, sizeof(SpriteBlock) * MAX_SPRITE_BATCH);
+		StatsBindTexture(GL_TEXTURE_2D, anim_textures[frame.billboards[sprite_batch.first].type]);
+		StatsDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, sprite_batch.count);
+	}
+	StatsBindVertexArray(0);
 }
 
-void DrawMessage(const glm::mat4& projectionMatrix, const glm::mat4& viewMatrix, const Camera& camera, std::string mes)
+void RecordMessage(FrameCommands& frame, const std::string& mes)
 {
 	glm::vec3 position = glm::vec3(-2.0f, 1.0f, -2.0f);
 	glm::vec3 pos_offset = glm::vec3(0.5f, 0.0f, 0.0f);
 	glm::vec3 scale = glm::vec3(0.25f, 0.25f, 0.25f);
 	for (GLuint i = 0; i < mes.size(); i++) 
 	{
-		mes[i] = std::toupper(mes[i]);
-		if (mes[i] == ' ') {
+		char character = (char)std::toupper(mes[i]);
+		if (character == ' ') {
 			position += pos_offset;
 			continue;
 		}
-		if (mes[i] < 'A' || mes[i] > 'Z') continue;
-		int index = mes[i] - 'A';
+		if (character < 'A' || character > 'Z') continue;
+		int index = character - 'A';
 
-		DrawAnimTexture(projectionMatrix, viewMatrix, camera, CHARACTER, 13, 2, index, position, scale, false);
+		RecordAnimTexture(frame, CHARACTER, 13, 2, index, position, scale, false);
 		position += pos_offset;
 	}
 }
 
+void GetObjectFootprints(float min_height, float max_height, float max_size, std::vector<Collider2D>& footprints)
+{
+	footprints.clear();
+	scene.UpdateWorldMatrices();
+	const glm::mat4* world_matrices = scene.GetWorldMatrices();
+	const GLuint* model_ids = scene.GetModelIds();
+	const GLuint* object_flags = scene.GetFlags();
+	for (GLuint i = 0; i < scene.Size(); i++)
+	{
+		if ((object_flags[i] & OBJECT_VISIBLE) == 0) continue;
+		BoundingBox box = GetWorldBox(world_matrices[i], models[model_ids[i]]->GetBoundingBox());
+		// flat objects can be stepped over, objects above the head do not block and large objects are terrain
+		if (box.max.y < min_height || box.min.y > max_height) continue;
+		if (box.max.x - box.min.x > max_size || box.max.z - box.min.z > max_size) continue;
+
+		Collider2D footprint;
+		footprint.min = glm::vec2(box.min.x, box.min.z);
+		footprint.max = glm::vec2(box.max.x, box.max.z);
+		footprints.push_back(footprint);
+	}
+}
+
+bool RaycastScene(const Camera& camera, GLsizei win_width, GLsizei win_height, GLint x, GLint y, RayHit& hit)
+{
+	if (!data_loaded) return false;
+	Ray ray = GetPixelRay(GetViewMatrix(camera), GetProjectionMatrix((GLfloat)win_width, (GLfloat)win_height), x, y, win_width, win_height);
+	return scene_raycaster.Raycast(ray, 100.0f, hit);
+}
+
+PickAction GetPickAction(GLuint object_id)
+{
+	if (object_id == NO_OBJECT_ID || object_id > scene.Size()) return PICK_NOTHING;
+	return model_actions[scene.GetModelIds()[object_id - 1]];
+}
+
 void LoadFail(const std::string& message) 
 {
 	std::cout << "loading failed: " << message << std::endl;
 	ClearData();
 }
 
-void GetAnimObjectData(glm::vec3& position, glm::vec3& direction)
+void GetAnimObjectData(glm::vec3& position, glm::vec3& direction, float alpha)
 {
-	position = anim_obj_info.last_position;
-	direction = anim_obj_info.last_direction;
+	position = glm::mix(anim_obj_info.previous_position, anim_obj_info.last_position, alpha);
+	direction = glm::mix(anim_obj_info.previous_direction, anim_obj_info.last_direction, alpha);
+	if (glm::dot(direction, direction) > 0.0f) direction = glm::normalize(direction);
+	else direction = anim_obj_info.last_direction;
 }
 
 void GetCampfireData(glm::vec3& position)
 {
-	position = objects[fire_info.campfire_id].first.position;
+	if (!scene.IsValid(fire_info.campfire_object)) {
+		position = glm::vec3(0.0f);
+		return;
+	}
+	position = scene.GetWorldPosition(fire_info.campfire_object);
 }
 
-glm::mat4& GetRotatedModelMatrix(const glm::vec3& direction_from_target, const glm::vec3& position, const glm::vec3& scale) {
-	glm::mat4 texViewMatrix;
-	texViewMatrix = glm::lookAt(glm::vec3(0.0f), direction_from_target, glm::vec3(0.0f, 1.0f, 0.0f));
-
-	glm::mat4 billboardRotationMatrix = glm::mat4(
-		texViewMatrix[0],
-		texViewMatrix[1],
-		texViewMatrix[2],
-		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
-	);
-	// inverse view rotation
-	billboardRotationMatrix = glm::transpose(billboardRotationMatrix);
+glm::mat4 GetRotatedModelMatrix(const glm::vec3& direction_from_target, const glm::vec3& position, const glm::vec3& scale) {
+	// inverse of the lookAt rotation has basis vectors of the view as columns, so it is built directly:
+	// translate * scale * rotation
+	glm::vec3 forward = glm::normalize(direction_from_target);
+	glm::vec3 side = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+	glm::vec3 up = glm::cross(side, forward);
 
-	glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), position);
-	modelMatrix = glm::scale(modelMatrix, scale);
-	return modelMatrix * billboardRotationMatrix;
+	glm::mat4 modelMatrix;
+	modelMatrix[0] = glm::vec4(side * scale, 0.0f);
+	modelMatrix[1] = glm::vec4(up * scale, 0.0f);
+	modelMatrix[2] = glm::vec4(-forward * scale, 0.0f);
+	modelMatrix[3] = glm::vec4(position, 1.0f);
+	return modelMatrix;
 }
 
 void SetNightValue(float val) {
 	skybox.night_control_val = val;
 }
 
+void SwitchOcclusionCulling()
+{
+	SetOcclusionCulling(!occlusion_culling_enabled);
+	std::cout << (occlusion_culling_enabled ? "occlusion culling: on" : "occlusion culling: off") << std::endl;
+}
+
+void SetOcclusionCulling(bool enabled)
+{
+	occlusion_culling_enabled = enabled;
+	// static objects are culled again by the next frame
+	static_cache.list = nullptr;
+	scene_changed = true;
+}
+
+bool NeedsImpostors()
+{
+	return data_loaded && impostors_enabled && !impostors_loaded;
+}
+
+void SwitchImpostors()
+{
+	SetImpostors(!impostors_enabled, impostor_distance);
+	std::cout << (impostors_enabled ? "impostors: on" : "impostors: off") << std::endl;
+}
+
+void SetImpostors(bool enabled, float distance)
+{
+	impostors_enabled = enabled;
+	impostor_distance = distance;
+	// static objects are recorded again by the next frame
+	static_cache.list = nullptr;
+	scene_changed = true;
+}
+
 void SwitchFog() {
 	fog_enabled = !fog_enabled;
+	scene_changed = true;
 }
 
 bool SwitchCampfire()
 {
 	fire_info.fire_enabled = !fire_info.fire_enabled;
+	scene_changed = true;
 	return fire_info.fire_enabled;
 }
 
 void SwitchAnimObject()
 {
 	anim_obj_info.enabled = !anim_obj_info.enabled;
+	scene_changed = true;
+}
+
+bool TakeSceneChanged()
+{
+	bool changed = scene_changed;
+	scene_changed = false;
+	return changed;
 }
 
 void ClearData() 
 {
 	data_loaded = false;
+	impostors_loaded = false;
+	scene_changed = true;
 
 	// Clear models
 	for (GLuint i = 0; i < models.size(); i++) {
 		delete models[i];
 	}
 	models.clear();
+	model_spheres.clear();
+	model_boxes.clear();
+	model_glass.clear();
+	occlusion_culler.Clear();
+	impostors.Release();
+	model_actions.clear();
+	scene_raycaster.Clear();
+	stream_buffer.Release();
+	frame_graph.Release();
+	resolution_scaler.Release();
+	terrain.Release();
+	gpu_culling.Release();
+	gpu_culling_enabled = false;
+	ReleaseStaticCommands();
+	GLuint static_version = static_cache.last_version;
+	static_cache = StaticObjectsCache();
+	// versions keep growing, so the list recorded after reloading is never mistaken for the released one
+	static_cache.last_version = static_version;
 	
 	// Clear shaders
 	for (GLuint i = 0; i < shader_programs.size(); i++) {
@@ -755,7 +1783,11 @@ void ClearData()
 	}
 	specular_textures.clear();
 
-	objects.clear();
+	scene.Clear();
+	fire_info.campfire_id = 0xFFFFFFFF;
+	fire_info.campfire_object = ObjectHandle();
+	anim_obj_info.parent_model_id = 0xFFFFFFFF;
+	anim_obj_info.parent_object = ObjectHandle();
 	
 	glDeleteTextures(1, &fog_texture);
 
@@ -769,6 +1801,10 @@ void ClearData()
 	}
 	anim_textures.clear();
 
+	// Delete transparency composite data
+	glDeleteVertexArrays(1, &transparency_composite.vao);
+	transparency_composite = TransparencyComposite();
+
 	// Delete banner data
 	glDeleteVertexArrays(1, &banner_texture_plane.VAO);
 	glDeleteBuffers(1, &banner_texture_plane.VBO);
@@ -785,5 +1821,7 @@ void ClearData()
 	glDeleteTextures(1, &anim_obj_info.diffuse_texture);
 	glDeleteTextures(1, &anim_obj_info.specular_texture);
 
+	ReleasePicking();
+
 	return;
 }
\ No newline at end of file
@@ -11,17 +11,14 @@
 
 #include "pgr.h"
 #include "data_parser.h"
+#include "scene_snapshot.h"
 #include "ModelContainer.h"
 #include "ShaderContainer.h"
-
-/// <summary>
-/// Defines position, rotation and scale of any object
-/// </summary>
-struct Transform {
-	glm::vec3 position;
-	glm::vec4 rotation;
-	glm::vec3 scale;
-};
+#include "SceneStore.h"
+#include "frame_commands.h"
+#include "collision.h"
+#include "raycast.h"
+#include "render_graph.h"
 
 /// <summary>
 /// This struct allows to contain simple geometry(like plane) with custom shader
@@ -41,10 +38,20 @@ enum AnimTexType {
 	CHARACTER
 };
 
+/// <summary>
+/// Actions of the clicked objects
+/// </summary>
+enum PickAction {
+	PICK_NOTHING,
+	PICK_SWITCH_CAMPFIRE,
+	PICK_SWITCH_FOG,
+	PICK_SWITCH_ANIM_OBJECT
+};
+
 /// <summary>
 /// Loads all the data, needs to build the scene
 /// </summary>
-/// <param name="config_file_path">Path to the config file</param>
+/// <param name="config_file_path">Path to the config file or to the binary scene file</param>
 void LoadData(const std::string& config_file_path);
 /// <summary>
 /// Loads all shaders the program need
@@ -57,8 +64,23 @@ bool LoadShaders();
 /// <param name="vs_path">Path to the vertex shader</param>
 /// <param name="fs_path">Path to the fragment shader</param>
 /// <param name="program">Returned index of shader progam</param>
+/// <param name="attribute_program">Program whose attribute locations the new program takes, zero keeps the linker ones.
+/// Every program which draws VAOs of the models has to pass the object program, the VAOs were created with its locations</param>
+/// <param name="fs_library_path">Path to the file with functions declared by the fragment shader, null if there is none</param>
 /// <returns>Returns true if loading was successfu. Otherwise returns false</returns>
-bool LoadSingleShaderProgram(const char* vs_path, const char* fs_path, GLuint& program);
+bool LoadSingleShaderProgram(const char* vs_path, const char* fs_path, GLuint& program, GLuint attribute_program = 0, const char* fs_library_path = nullptr);
+/// <summary>
+/// Compiles shader from its file followed by the library file
+/// </summary>
+/// <param name="type">Type of the shader</param>
+/// <param name="path">Path to the shader, it declares the functions of the library</param>
+/// <param name="library_path">Path to the library with function definitions, without #version</param>
+/// <returns>Returns the shader or zero if compiling failed</returns>
+GLuint CreateShaderWithLibrary(GLenum type, const char* path, const char* library_path);
+/// <summary>
+/// Sets sampler units and material of the program which uses the object fragment shader
+/// </summary>
+void SetObjectMaterialUniforms(GLuint program);
 /// <summary>
 /// Loads all the data for rendering the skybox 
 /// </summary>
@@ -76,6 +98,10 @@ void LoadAnimTextures();
 /// </summary>
 void LoadBanner();
 /// <summary>
+/// Loads program and VAO which composite transparent passes over the scene
+/// </summary>
+void LoadTransparencyComposite();
+/// <summary>
 /// Loads simple model with custom shader
 /// </summary>
 /// <param name="model_geometry">Returned model</param>
@@ -86,16 +112,16 @@ void LoadGeometry(Geometry& model_geometry, float* verts, GLuint* indexes, GLuin
 /// <summary>
 /// Loads textures to buffer
 /// </summary>
-/// <param name="textures_data">Buffer of loaded textures paths</param>
+/// <param name="snapshot">Binary scene with textures paths</param>
 /// <param name="diffuse">If true saves testures to diffuse textures buffer. Otherwise saves them to specular textures buffer</param>
 /// <returns>Returns true if loading was successfu. Otherwise returns false</returns>
-bool LoadTextures(const std::vector<std::string>& textures_data, bool diffuse);
+bool LoadTextures(const SceneSnapshot& snapshot, bool diffuse);
 /// <summary>
 /// Loads models to buffer
 /// </summary>
-/// <param name="models_data">Buffer of paths to models and texture indeces</param>
+/// <param name="snapshot">Binary scene with paths to models and texture indeces</param>
 /// <returns>Returns true if loading was successfu. Otherwise returns false</returns>
-bool LoadModels(const std::vector<std::string>& models_data);
+bool LoadModels(const SceneSnapshot& snapshot);
 /// <summary>
 /// Load campfire
 /// </summary>
@@ -104,57 +130,147 @@ void LoadCampfire(ModelContainer** model);
 /// <summary>
 /// Loads all objects on the scene with their Transform
 /// </summary>
-/// <param name="objects_data">Buffer of object data</param>
+/// <param name="snapshot">Binary scene with arrays of object data</param>
 /// <returns>Returns true if loading was successfu. Otherwise returns false</returns>
-bool LoadObjects(const std::vector<std::string>& objects_data);
+bool LoadObjects(const SceneSnapshot& snapshot);
+/// <summary>
+/// Loads heightmap terrain which covers all loaded objects
+/// </summary>
+/// <returns>Returns true if loading was successful. Otherwise returns false</returns>
+bool LoadTerrain();
+/// <summary>
+/// Requests culling of the static objects by compute shaders. Takes effect with the next LoadData
+/// </summary>
+void SetGpuCulling(bool enabled);
+/// <summary>
+/// Creates instanced object program and compute programs of the GPU culling
+/// </summary>
+/// <returns>Returns true if the context supports GPU culling and loading was successful. Otherwise returns false</returns>
+bool LoadGpuCulling();
+/// <summary>
+/// Creates program which draws all static objects of one model with one glMultiDrawElementsIndirect call
+/// </summary>
+/// <returns>Returns true if the context supports it and loading was successful. Otherwise returns false</returns>
+bool LoadStaticObjectsProgram();
+/// <summary>
+/// Creates impostor programs and bakes views of the static models
+/// </summary>
+/// <returns>Returns true if loading was successful. Otherwise returns false</returns>
+bool LoadImpostors();
 /// <summary>
 /// Loads animated object
 /// </summary>
 void LoadAnimatedObject();
 /// <summary>
-/// Draws all objects on the scene
+/// Advances all animations (animated object, banner, fire, models) by one fixed simulation step
+/// </summary>
+/// <param name="dt">Simulation step in seconds</param>
+void Simulate(float dt);
+/// <summary>
+/// Returns view matrix of the camera
+/// </summary>
+glm::mat4 GetViewMatrix(const Camera& camera);
+/// <summary>
+/// Returns projection matrix of the scene
+/// </summary>
+/// <param name="win_width">Window width</param>
+/// <param name="win_height">Window height</param>
+glm::mat4 GetProjectionMatrix(GLfloat win_width, GLfloat win_height);
+/// <summary>
+/// Records everything visible in the frame: culls and sorts scene objects, computes matrices of animated
+/// object, banner and billboards. Does not use OpenGL
 /// </summary>
+/// <param name="frame">Returned frame. Has to be cleared before recording</param>
 /// <param name="direct_light">Direct light data</param>
 /// <param name="point_light">Point light data</param>
 /// <param name="slot_light">Spot light data</param>
 /// <param name="camera">Camera data</param>
 /// <param name="win_width">Window width</param>
 /// <param name="win_height">Window height</param>
-/// <param name="dt">Delta time</param>
-void Draw(const DirectLight& direct_light, const PointLight& point_light, const SpotLight& slot_light, const Camera& camera, GLfloat win_width, GLfloat win_height, float dt);
+/// <param name="alpha">Interpolation factor between the previous and the last simulation state (0.0f - 1.0f)</param>
+void RecordFrame(FrameCommands& frame, const DirectLight& direct_light, const PointLight& point_light, const SpotLight& slot_light, const Camera& camera, GLfloat win_width, GLfloat win_height, float alpha);
+/// <summary>
+/// Culls and sorts the scene and records new static draw list. Visible objects of animated models are
+/// remembered separately and recorded every frame. With GPU culling the list contains all static objects
+/// </summary>
+/// <param name="camera">Camera data</param>
+/// <param name="view_projection">Projection * view matrix of the camera</param>
+/// <param name="win_width">Window width</param>
+/// <param name="win_height">Window height</param>
+void RecordStaticObjects(const Camera& camera, const glm::mat4& view_projection, GLfloat win_width, GLfloat win_height);
+/// <summary>
+/// Writes object blocks and indirect commands of the static draw list into GPU buffers
+/// </summary>
+/// <param name="list">Static draw list of the frame</param>
+void UpdateStaticCommands(const StaticDrawList& list);
+/// <summary>
+/// Draws static objects, uploads them first if the list has changed. Camera and lights blocks have to be bound
+/// </summary>
+/// <param name="list">Static draw list of the frame</param>
+void DrawStaticObjects(const StaticDrawList& list);
+/// <summary>
+/// Deletes GPU buffers of the static draw list
+/// </summary>
+void ReleaseStaticCommands();
+/// <summary>
+/// Writes uniform blocks of the recorded frame into the stream buffer: camera, lights and blocks of all drawn
+/// objects, banner and billboards. Blocks are bound by the draw functions
+/// </summary>
+/// <param name="frame">Recorded frame</param>
+/// <returns>Returns true if all blocks were written. Otherwise returns false</returns>
+bool WriteFrameBlocks(const FrameCommands& frame);
+/// <summary>
+/// Declares passes of the scene: skybox, objects with object IDs, upscaling of the scene, banner and billboards accumulated
+/// as weighted blended transparency and composited over the scene, copy to the window and reading of the clicked object ID. Blocks of the frame have to be written by WriteFrameBlocks
+/// </summary>
+/// <param name="graph">Graph of the frame</param>
+/// <param name="frame">Recorded frame, has to live until the graph is executed</param>
+/// <param name="window">Imported framebuffer the scene is copied into</param>
+/// <param name="scene_width">Width of the skybox and objects targets, banner and billboards are drawn at the window width</param>
+/// <param name="scene_height">Height of the skybox and objects targets</param>
+void AddScenePasses(RenderGraph& graph, const FrameCommands& frame, RenderResource window, GLsizei scene_width, GLsizei scene_height);
+/// <summary>
+/// Draws recorded frame into the bound framebuffer. Reads only the frame and loaded data, so the simulation can run at the same time
+/// </summary>
+/// <param name="frame">Recorded frame</param>
+void Draw(const FrameCommands& frame);
 /// <summary>
 /// Draws skybox
 /// </summary>
-/// <param name="viewMatrix">Matrix of view</param>
-/// <param name="projectionMatrix">Matrix of projection</param>
-void drawSkybox(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+/// <param name="frame">Recorded frame</param>
+void drawSkybox(const FrameCommands& frame);
 /// <summary>
-/// Draws animated object
+/// Returns true if the frame has objects of glass models, including the animated object
 /// </summary>
-/// <param name="direct_light">Direct light data</param>
-/// <param name="point_light">Point light data</param>
-/// <param name="slot_light">Spot light data</param>
-/// <param name="camera">Camera data</param>
-/// <param name="viewMatrix">Matrix of view</param>
-/// <param name="projectionMatrix">Matrix of projection</param>
-/// <param name="dt">Delta time</param>
-void DrawAnimatedObject(const DirectLight& direct_light, const PointLight& point_light, const SpotLight& spot_light, const Camera& camera, const glm::mat4& projectionMatrix, const glm::mat4& viewMatrix, float dt);
+/// <param name="frame">Recorded frame</param>
+bool HasGlassObjects(const FrameCommands& frame);
 /// <summary>
-/// Draws banner
+/// Draws objects of glass models into the targets of the weighted blended transparency. Their blocks have to be written by WriteFrameBlocks
 /// </summary>
-/// <param name="projectionMatrix">Matrix of projection</param>
-/// <param name="viewMatrix">Matrix of view</param>
-/// <param name="camera">Camera data</param>
-/// <param name="dt">Delta time</param>
+/// <param name="frame">Recorded frame</param>
+void DrawGlassObjects(const FrameCommands& frame);
+/// <summary>
+/// Records animated object
+/// </summary>
+/// <param name="frame">Recorded frame</param>
+/// <param name="alpha">Interpolation factor between simulation states</param>
+void RecordAnimatedObject(FrameCommands& frame, float alpha);
+/// <summary>
+/// Records banner
+/// </summary>
+/// <param name="frame">Recorded frame, camera has to be already set</param>
+/// <param name="alpha">Interpolation factor between simulation states</param>
 /// <param name="position">Banner position</param>
 /// <param name="scale">Banner scale</param>
-void DrawBanner(const glm::mat4& projectionMatrix, const glm::mat4& viewMatrix, const Camera& camera, float dt, glm::vec3 position, glm::vec3 scale);
+void RecordBanner(FrameCommands& frame, float alpha, glm::vec3 position, glm::vec3 scale);
 /// <summary>
-/// Draws animated texture
+/// Draws banner, its block has to be written by WriteFrameBlocks
 /// </summary>
-/// <param name="projectionMatrix">Matrix of projection</param>
-/// <param name="viewMatrix">Matrix of view</param>
-/// <param name="camera">Camera data</param>
+void DrawBanner();
+/// <summary>
+/// Records animated texture
+/// </summary>
+/// <param name="frame">Recorded frame, camera has to be already set</param>
 /// <param name="type">Type(index) of animated texture in buffer</param>
 /// <param name="size_x">Number of columns in texture</param>
 /// <param name="size_y">Number of lines in texture</param>
@@ -162,15 +278,43 @@ void DrawBanner(const glm::mat4& projectionMatrix, const glm::mat4& viewMatrix,
 /// <param name="position">Position of texture on the scene</param>
 /// <param name="scale">Scale of texture</param>
 /// <param name="enable_rotation">If true texture will start to look ta the camera</param>
-void DrawAnimTexture(const glm::mat4& projectionMatrix, const glm::mat4& viewMatrix, const Camera& camera, GLuint type, int size_x, int size_y, int index, glm::vec3 position, glm::vec3 scale, bool enable_rotation = true);
+void RecordAnimTexture(FrameCommands& frame, GLuint type, int size_x, int size_y, int index, glm::vec3 position, glm::vec3 scale, bool enable_rotation = true);
 /// <summary>
-/// Draws text message on the scene
+/// Draws all animated textures, one instanced call for every batch of billboards with the same texture.
+/// Blocks of the batches have to be written by WriteFrameBlocks
 /// </summary>
-/// <param name="projectionMatrix">Matrix of projection</param>
-/// <param name="viewMatrix">Matrix of view</param>
-/// <param name="camera">Camera data</param>
+/// <param name="frame">Recorded frame</param>
+void DrawAnimTextures(const FrameCommands& frame);
+/// <summary>
+/// Records text message on the scene
+/// </summary>
+/// <param name="frame">Recorded frame</param>
 /// <param name="mes">Message which will be written on the scene</param>
-void DrawMessage(const glm::mat4& projectionMatrix, const glm::mat4& viewMatrix, const Camera& camera, std::string mes);
+void RecordMessage(FrameCommands& frame, const std::string& mes);
+/// <summary>
+/// Returns XZ footprints of the scene objects which can block the walking camera
+/// </summary>
+/// <param name="min_height">Objects lower than this height are skipped</param>
+/// <param name="max_height">Objects higher than this height are skipped</param>
+/// <param name="max_size">Objects larger than this size on X or Z are skipped (terrain)</param>
+/// <param name="footprints">Returned footprints</param>
+void GetObjectFootprints(float min_height, float max_height, float max_size, std::vector<Collider2D>& footprints);
+/// <summary>
+/// Finds the object under the pixel on CPU, without reading the framebuffer
+/// </summary>
+/// <param name="camera">Camera of the frame</param>
+/// <param name="win_width">Width of the window</param>
+/// <param name="win_height">Height of the window</param>
+/// <param name="x">Pixel x from the left</param>
+/// <param name="y">Pixel y from the bottom</param>
+/// <param name="hit">Returned hit, object is the index of the object in the scene</param>
+/// <returns>Returns true if an object is under the pixel</returns>
+bool RaycastScene(const Camera& camera, GLsizei win_width, GLsizei win_height, GLint x, GLint y, RayHit& hit);
+/// <summary>
+/// Returns what happens when the object is clicked
+/// </summary>
+/// <param name="object_id">Object ID from the ID buffer (index of the object in the scene + 1)</param>
+PickAction GetPickAction(GLuint object_id);
 /// <summary>
 /// Sends message to the console 
 /// </summary>
@@ -181,7 +325,8 @@ void LoadFail(const std::string& message);
 /// </summary>
 /// <param name="position">Returned position of animated object</param>
 /// <param name="direction">Returned moving diraction of animated object</param>
-void GetAnimObjectData(glm::vec3& position, glm::vec3& direction);
+/// <param name="alpha">Interpolation factor between the previous and the last simulation state</param>
+void GetAnimObjectData(glm::vec3& position, glm::vec3& direction, float alpha = 1.0f);
 /// <summary>
 /// Returns campfire position
 /// </summary>
@@ -194,7 +339,35 @@ void GetCampfireData(glm::vec3& position);
 /// <param name="position">Object world position</param>
 /// <param name="scale">Object scale</param>
 /// <returns>Returns model matrix</returns>
-glm::mat4& GetRotatedModelMatrix(const glm::vec3& direction, const glm::vec3& position, const glm::vec3& scale);
+glm::mat4 GetRotatedModelMatrix(const glm::vec3& direction, const glm::vec3& position, const glm::vec3& scale);
+/// <summary>
+/// Returns true if the model hides large parts of the scene and is rasterized by the occlusion culling
+/// </summary>
+/// <param name="model_path">Path of the model file</param>
+bool IsOccluderModel(const std::string& model_path);
+/// <summary>
+/// Enables culling of the static objects hidden behind occluders. Works only when the objects are culled on CPU
+/// </summary>
+void SetOcclusionCulling(bool enabled);
+/// <summary>
+/// Activate/diactivate occlusion culling
+/// </summary>
+void SwitchOcclusionCulling();
+/// <summary>
+/// Enables drawing of the distant static objects as impostors. Works only when the objects are culled on CPU
+/// </summary>
+/// <param name="enabled">True to draw impostors</param>
+/// <param name="distance">Distance from the camera beyond which objects become impostors. If zero, it depends on the size of the object on the screen</param>
+void SetImpostors(bool enabled, float distance = 0.0f);
+/// <summary>
+/// Activate/diactivate impostors
+/// </summary>
+void SwitchImpostors();
+/// <summary>
+/// Returns true if impostors are enabled, but views of the loaded models are not baked yet. Then LoadImpostors has to be
+/// called on the thread with GL context
+/// </summary>
+bool NeedsImpostors();
 /// <summary>
 /// Set night intensivity
 /// </summary>
@@ -213,6 +386,10 @@ bool SwitchCampfire();
 /// </summary>
 void SwitchAnimObject();
 /// <summary>
+/// Returns true once after fog, campfire or animated object was switched or the data was reloaded
+/// </summary>
+bool TakeSceneChanged();
+/// <summary>
 /// Clears all data
 /// </summary>
 void ClearData();
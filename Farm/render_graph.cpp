@@ -0,0 +1,478 @@
+#include <iostream>
+#include <algorithm>
+
+#include "render_graph.h"
+#include "profiler.h"
+
+static const GLuint NOT_IMPORTED = 0xFFFFFFFF;
+static const GLuint NO_RESOURCE = 0xFFFFFFFF;
+static const GLuint NOT_USED = 0xFFFFFFFF;
+/// <summary>
+/// Pooled targets and framebuffers unused for this number of frames are deleted
+/// </summary>
+static const GLuint POOL_KEEP_FRAMES = 120;
+
+/// <summary>
+/// Returns true for depth and depth-stencil formats
+/// </summary>
+static bool IsDepthFormat(GLenum format)
+{
+	return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F ||
+		format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+}
+
+/// <summary>
+/// Returns true for formats with stencil
+/// </summary>
+static bool HasStencil(GLenum format)
+{
+	return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+}
+
+/// <summary>
+/// Returns true for unsigned integer color formats
+/// </summary>
+static bool IsUnsignedFormat(GLenum format)
+{
+	return format == GL_R32UI || format == GL_RG32UI || format == GL_RGBA32UI || format == GL_R8UI || format == GL_R16UI;
+}
+
+/// <summary>
+/// Returns pixel format and type which are valid together with the internal format in glTexImage2D
+/// </summary>
+static void GetPixelFormat(GLenum internal_format, GLenum& format, GLenum& type)
+{
+	if (HasStencil(internal_format)) {
+		format = GL_DEPTH_STENCIL;
+		type = internal_format == GL_DEPTH24_STENCIL8 ? GL_UNSIGNED_INT_24_8 : GL_FLOAT_32_UNSIGNED_INT_24_8_REV;
+	}
+	else if (IsDepthFormat(internal_format)) {
+		format = GL_DEPTH_COMPONENT;
+		type = GL_FLOAT;
+	}
+	else if (IsUnsignedFormat(internal_format)) {
+		format = GL_RED_INTEGER;
+		type = GL_UNSIGNED_INT;
+	}
+	else {
+		format = GL_RGBA;
+		type = GL_FLOAT;
+	}
+}
+
+RenderResource RenderGraph::CreateTarget(const char* name, const RenderTargetDesc& desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	resource.desc.width = std::max(desc.width, 1);
+	resource.desc.height = std::max(desc.height, 1);
+	resource.framebuffer = NOT_IMPORTED;
+	resources.push_back(resource);
+	return (RenderResource)resources.size() - 1;
+}
+
+RenderResource RenderGraph::ImportFramebuffer(const char* name, GLuint framebuffer, GLsizei width, GLsizei height)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc.width = width;
+	resource.desc.height = height;
+	resource.framebuffer = framebuffer;
+	resources.push_back(resource);
+	return (RenderResource)resources.size() - 1;
+}
+
+GLuint RenderGraph::AddPass(const char* name, const PassState& state, const std::function<void()>& execute)
+{
+	Pass pass;
+	pass.name = name;
+	pass.state = state;
+	pass.execute = execute;
+	pass.depth_output = NO_RESOURCE;
+	pass.side_effect = false;
+	passes.push_back(pass);
+	return (GLuint)passes.size() - 1;
+}
+
+void RenderGraph::AddColorOutput(GLuint pass, RenderResource target)
+{
+	if (passes[pass].color_outputs.size() == MAX_PASS_COLOR_OUTPUTS) {
+		std::cout << "render pass " << passes[pass].name << " has too many color outputs" << std::endl;
+		return;
+	}
+	passes[pass].color_outputs.push_back(target);
+}
+
+void RenderGraph::SetDepthOutput(GLuint pass, RenderResource target)
+{
+	passes[pass].depth_output = target;
+}
+
+void RenderGraph::AddInput(GLuint pass, RenderResource resource)
+{
+	passes[pass].inputs.push_back(resource);
+}
+
+void RenderGraph::SetSideEffect(GLuint pass)
+{
+	passes[pass].side_effect = true;
+}
+
+void RenderGraph::CullPasses()
+{
+	for (Resource& resource : resources)
+		resource.needed = resource.framebuffer != NOT_IMPORTED;
+	for (Pass& pass : passes)
+		pass.needed = pass.side_effect;
+
+	// needed pass needs its inputs and its depth, needed resource needs all its writers
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (Pass& pass : passes)
+		{
+			bool writes_needed = false;
+			for (RenderResource output : pass.color_outputs)
+				writes_needed = writes_needed || resources[output].needed;
+			if (pass.depth_output != NO_RESOURCE) writes_needed = writes_needed || resources[pass.depth_output].needed;
+			if (writes_needed && !pass.needed) {
+				pass.needed = true;
+				changed = true;
+			}
+			if (!pass.needed) continue;
+
+			for (RenderResource input : pass.inputs) {
+				changed = changed || !resources[input].needed;
+				resources[input].needed = true;
+			}
+			if (pass.depth_output != NO_RESOURCE) {
+				changed = changed || !resources[pass.depth_output].needed;
+				resources[pass.depth_output].needed = true;
+			}
+		}
+	}
+}
+
+bool RenderGraph::SortPasses(std::vector<GLuint>& order) const
+{
+	// edges: writer -> next writer of the same resource, every writer -> every reader
+	GLuint count = (GLuint)passes.size();
+	std::vector<std::vector<GLuint>> next(count);
+	std::vector<GLuint> dependencies(count, 0);
+	std::vector<GLuint> last_writer(resources.size(), NOT_USED);
+	std::vector<std::vector<GLuint>> writers(resources.size());
+	for (GLuint i = 0; i < count; i++)
+	{
+		if (!passes[i].needed) continue;
+		std::vector<RenderResource> outputs = passes[i].color_outputs;
+		if (passes[i].depth_output != NO_RESOURCE) outputs.push_back(passes[i].depth_output);
+		for (RenderResource output : outputs) {
+			if (last_writer[output] != NOT_USED && last_writer[output] != i) {
+				next[last_writer[output]].push_back(i);
+				dependencies[i]++;
+			}
+			last_writer[output] = i;
+			writers[output].push_back(i);
+		}
+	}
+	for (GLuint i = 0; i < count; i++)
+	{
+		if (!passes[i].needed) continue;
+		for (RenderResource input : passes[i].inputs)
+			for (GLuint writer : writers[input]) {
+				if (writer == i) continue;
+				next[writer].push_back(i);
+				dependencies[i]++;
+			}
+	}
+
+	// passes which are ready run in the order they were declared
+	order.clear();
+	std::vector<GLuint> ready;
+	for (GLuint i = 0; i < count; i++)
+		if (passes[i].needed && dependencies[i] == 0) ready.push_back(i);
+	while (!ready.empty())
+	{
+		std::vector<GLuint>::iterator first = std::min_element(ready.begin(), ready.end());
+		GLuint pass = *first;
+		ready.erase(first);
+		order.push_back(pass);
+		for (GLuint dependent : next[pass])
+			if (--dependencies[dependent] == 0) ready.push_back(dependent);
+	}
+
+	GLuint needed_count = 0;
+	for (const Pass& pass : passes)
+		if (pass.needed) needed_count++;
+	return order.size() == needed_count;
+}
+
+GLuint RenderGraph::AcquireTarget(const RenderTargetDesc& desc)
+{
+	for (GLuint i = 0; i < pool.size(); i++)
+	{
+		PooledTarget& target = pool[i];
+		if (target.in_use || target.desc.format != desc.format || target.desc.width != desc.width || target.desc.height != desc.height) continue;
+		target.in_use = true;
+		target.unused_frames = 0;
+		return i;
+	}
+
+	PooledTarget target;
+	target.desc = desc;
+	target.in_use = true;
+	target.unused_frames = 0;
+	GLenum format, type;
+	GetPixelFormat(desc.format, format, type);
+	glGenTextures(1, &target.texture);
+	glBindTexture(GL_TEXTURE_2D, target.texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, desc.format, desc.width, desc.height, 0, format, type, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	pool.push_back(target);
+	return (GLuint)pool.size() - 1;
+}
+
+GLuint RenderGraph::GetFramebuffer(const GLuint* attachments, GLenum depth_format)
+{
+	for (CachedFramebuffer& cached : framebuffers)
+		if (std::equal(attachments, attachments + MAX_PASS_COLOR_OUTPUTS + 1, cached.attachments)) {
+			cached.unused_frames = 0;
+			return cached.framebuffer;
+		}
+
+	CachedFramebuffer cached;
+	std::copy(attachments, attachments + MAX_PASS_COLOR_OUTPUTS + 1, cached.attachments);
+	cached.unused_frames = 0;
+	glGenFramebuffers(1, &cached.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, cached.framebuffer);
+	for (GLuint i = 0; i < MAX_PASS_COLOR_OUTPUTS; i++)
+		if (attachments[i] != 0) glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, attachments[i], 0);
+	if (attachments[MAX_PASS_COLOR_OUTPUTS] != 0) {
+		GLenum attachment = HasStencil(depth_format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+		glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, attachments[MAX_PASS_COLOR_OUTPUTS], 0);
+	}
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "render graph framebuffer is not complete" << std::endl;
+	framebuffers.push_back(cached);
+	return cached.framebuffer;
+}
+
+void RenderGraph::BindPassOutputs(const Pass& pass, GLuint position)
+{
+	// pass which writes imported framebuffer draws directly into it
+	for (RenderResource output : pass.color_outputs)
+		if (resources[output].framebuffer != NOT_IMPORTED) {
+			glBindFramebuffer(GL_FRAMEBUFFER, resources[output].framebuffer);
+			glViewport(0, 0, resources[output].desc.width, resources[output].desc.height);
+			return;
+		}
+
+	GLuint attachments[MAX_PASS_COLOR_OUTPUTS + 1] = {};
+	GLenum draw_buffers[MAX_PASS_COLOR_OUTPUTS];
+	const RenderTargetDesc* size = nullptr;
+	for (GLuint i = 0; i < pass.color_outputs.size(); i++)
+	{
+		const Resource& resource = resources[pass.color_outputs[i]];
+		draw_buffers[i] = resource.needed ? GL_COLOR_ATTACHMENT0 + i : GL_NONE;
+		if (!resource.needed) continue;
+		attachments[i] = pool[resource.pooled].texture;
+		size = &resource.desc;
+	}
+	GLenum depth_format = GL_NONE;
+	if (pass.depth_output != NO_RESOURCE) {
+		const Resource& resource = resources[pass.depth_output];
+		attachments[MAX_PASS_COLOR_OUTPUTS] = pool[resource.pooled].texture;
+		depth_format = resource.desc.format;
+		size = &resource.desc;
+	}
+	if (size == nullptr) return;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, GetFramebuffer(attachments, depth_format));
+	glDrawBuffers((GLsizei)pass.color_outputs.size(), draw_buffers);
+	glViewport(0, 0, size->width, size->height);
+
+	// targets are cleared by the first pass which uses them, masks have to allow it
+	glDepthMask(GL_TRUE);
+	glStencilMask(0xFF);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	for (GLuint i = 0; i < pass.color_outputs.size(); i++)
+	{
+		const Resource& resource = resources[pass.color_outputs[i]];
+		if (!resource.needed || resource.first_use != position) continue;
+		if (IsUnsignedFormat(resource.desc.format)) {
+			GLuint value[4] = { (GLuint)resource.desc.clear_value.x, (GLuint)resource.desc.clear_value.y, (GLuint)resource.desc.clear_value.z, (GLuint)resource.desc.clear_value.w };
+			glClearBufferuiv(GL_COLOR, i, value);
+		}
+		else glClearBufferfv(GL_COLOR, i, &resource.desc.clear_value[0]);
+	}
+	if (pass.depth_output != NO_RESOURCE && resources[pass.depth_output].first_use == position) {
+		const Resource& resource = resources[pass.depth_output];
+		if (HasStencil(resource.desc.format)) glClearBufferfi(GL_DEPTH_STENCIL, 0, resource.desc.clear_value.x, 0);
+		else glClearBufferfv(GL_DEPTH, 0, &resource.desc.clear_value.x);
+	}
+}
+
+void RenderGraph::ApplyState(const PassState& state)
+{
+	if (state.depth_test) glEnable(GL_DEPTH_TEST);
+	else glDisable(GL_DEPTH_TEST);
+	glDepthMask(state.depth_write ? GL_TRUE : GL_FALSE);
+	glDepthFunc(state.depth_func);
+	if (state.blend) glEnable(GL_BLEND);
+	else glDisable(GL_BLEND);
+	glBlendFuncSeparate(state.blend_src, state.blend_dst, state.blend_src_alpha, state.blend_dst_alpha);
+	if (state.stencil_test) glEnable(GL_STENCIL_TEST);
+	else glDisable(GL_STENCIL_TEST);
+	if (state.cull_face) glEnable(GL_CULL_FACE);
+	else glDisable(GL_CULL_FACE);
+	glPolygonMode(GL_FRONT_AND_BACK, state.polygon_mode);
+}
+
+void RenderGraph::Execute()
+{
+	CullPasses();
+	std::vector<GLuint> order;
+	if (!SortPasses(order)) {
+		std::cout << "render graph has cyclic dependencies, passes are executed in the declared order" << std::endl;
+		order.clear();
+		for (GLuint i = 0; i < passes.size(); i++)
+			if (passes[i].needed) order.push_back(i);
+	}
+
+	// lifetimes of the transient targets in the execution order
+	for (Resource& resource : resources) {
+		resource.first_use = NOT_USED;
+		resource.last_use = 0;
+		resource.pooled = NOT_USED;
+	}
+	for (GLuint position = 0; position < order.size(); position++)
+	{
+		const Pass& pass = passes[order[position]];
+		std::vector<RenderResource> used = pass.inputs;
+		for (RenderResource output : pass.color_outputs)
+			if (resources[output].needed) used.push_back(output);
+		if (pass.depth_output != NO_RESOURCE) used.push_back(pass.depth_output);
+		for (RenderResource resource : used) {
+			resources[resource].first_use = std::min(resources[resource].first_use, position);
+			resources[resource].last_use = std::max(resources[resource].last_use, position);
+		}
+	}
+
+	GLint previous_framebuffer;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer);
+	for (GLuint position = 0; position < order.size(); position++)
+	{
+		const Pass& pass = passes[order[position]];
+		for (Resource& resource : resources)
+			if (resource.framebuffer == NOT_IMPORTED && resource.first_use == position)
+				resource.pooled = AcquireTarget(resource.desc);
+
+		BindPassOutputs(pass, position);
+		ApplyState(pass.state);
+		{
+			PROFILE_GPU_SCOPE(pass.name);
+			pass.execute();
+		}
+
+		// targets used for the last time go back to the pool and can be aliased by the next passes
+		for (Resource& resource : resources)
+			if (resource.framebuffer == NOT_IMPORTED && resource.first_use != NOT_USED && resource.last_use == position)
+				pool[resource.pooled].in_use = false;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+	executed_passes = (GLuint)order.size();
+	TrimPool();
+}
+
+void RenderGraph::TrimPool()
+{
+	for (GLuint i = 0; i < pool.size(); )
+	{
+		if (pool[i].in_use || ++pool[i].unused_frames < POOL_KEEP_FRAMES) {
+			pool[i].in_use = false;
+			i++;
+			continue;
+		}
+		// framebuffers which use the texture die with it
+		GLuint texture = pool[i].texture;
+		for (CachedFramebuffer& cached : framebuffers)
+			if (std::find(cached.attachments, cached.attachments + MAX_PASS_COLOR_OUTPUTS + 1, texture) != cached.attachments + MAX_PASS_COLOR_OUTPUTS + 1)
+				cached.unused_frames = POOL_KEEP_FRAMES;
+		glDeleteTextures(1, &texture);
+		pool.erase(pool.begin() + i);
+	}
+	for (GLuint i = 0; i < framebuffers.size(); )
+	{
+		if (++framebuffers[i].unused_frames < POOL_KEEP_FRAMES) {
+			i++;
+			continue;
+		}
+		glDeleteFramebuffers(1, &framebuffers[i].framebuffer);
+		framebuffers.erase(framebuffers.begin() + i);
+	}
+}
+
+void RenderGraph::Reset()
+{
+	resources.clear();
+	passes.clear();
+}
+
+void RenderGraph::Release()
+{
+	Reset();
+	for (PooledTarget& target : pool)
+		glDeleteTextures(1, &target.texture);
+	pool.clear();
+	for (CachedFramebuffer& cached : framebuffers)
+		glDeleteFramebuffers(1, &cached.framebuffer);
+	framebuffers.clear();
+	if (read_framebuffer != 0) glDeleteFramebuffers(1, &read_framebuffer);
+	read_framebuffer = 0;
+}
+
+GLuint RenderGraph::GetTexture(RenderResource resource) const
+{
+	if (resources[resource].pooled == NOT_USED) return 0;
+	return pool[resources[resource].pooled].texture;
+}
+
+void RenderGraph::BindReadTarget(RenderResource resource)
+{
+	if (resources[resource].framebuffer != NOT_IMPORTED) {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, resources[resource].framebuffer);
+		return;
+	}
+	if (read_framebuffer == 0) glGenFramebuffers(1, &read_framebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer);
+	// attachment of the other kind is detached, it may belong to the texture of the previous frame
+	GLenum format = resources[resource].desc.format;
+	if (IsDepthFormat(format)) {
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, HasStencil(format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, GetTexture(resource), 0);
+		glReadBuffer(GL_NONE);
+		return;
+	}
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, GetTexture(resource), 0);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+}
+
+GLuint RenderGraph::GetExecutedPassesCount() const
+{
+	return executed_passes;
+}
+
+GLuint RenderGraph::GetPooledTargetsCount() const
+{
+	return (GLuint)pool.size();
+}
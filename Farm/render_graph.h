@@ -0,0 +1,227 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       render_graph.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines frame graph: passes with declared inputs, outputs and GL state
+ *
+ * Every frame the passes are declared anew, then Execute orders them, skips passes whose
+ * results nobody uses and runs the rest. Writers of a resource run in the order they were
+ * declared, readers run after all writers. Transient targets live only inside the frame:
+ * they are taken from the pool at the first pass which uses them, cleared and given back
+ * after the last one, so targets with the same description and not overlapping lifetimes
+ * share one texture. Each pass starts with its own complete state, nothing leaks from
+ * the previous pass.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <vector>
+#include <functional>
+
+#include "pgr.h"
+
+/// <summary>
+/// Index of the resource in the graph
+/// </summary>
+typedef GLuint RenderResource;
+
+/// <summary>
+/// Maximum number of color outputs of one pass
+/// </summary>
+const GLuint MAX_PASS_COLOR_OUTPUTS = 4;
+
+/// <summary>
+/// Description of the transient render target
+/// </summary>
+struct RenderTargetDesc {
+	GLsizei width = 1;
+	GLsizei height = 1;
+	/// <summary>
+	/// Internal format: color (GL_RGBA8, GL_RGBA16F, GL_R32UI, ...) or depth (GL_DEPTH24_STENCIL8, GL_DEPTH_COMPONENT24, ...)
+	/// </summary>
+	GLenum format = GL_RGBA8;
+	/// <summary>
+	/// Value the target is cleared with before the first pass. Integer targets use x, depth targets use x as depth
+	/// </summary>
+	glm::vec4 clear_value = glm::vec4(0.0f);
+};
+
+/// <summary>
+/// Fixed function state of the pass. Everything is set before the pass is executed
+/// </summary>
+struct PassState {
+	bool depth_test = true;
+	bool depth_write = true;
+	GLenum depth_func = GL_LESS;
+	bool blend = false;
+	GLenum blend_src = GL_SRC_ALPHA;
+	GLenum blend_dst = GL_ONE_MINUS_SRC_ALPHA;
+	/// <summary>
+	/// Blend factors of the alpha channel, separate from the color ones
+	/// </summary>
+	GLenum blend_src_alpha = GL_SRC_ALPHA;
+	GLenum blend_dst_alpha = GL_ONE_MINUS_SRC_ALPHA;
+	bool stencil_test = false;
+	bool cull_face = false;
+	GLenum polygon_mode = GL_FILL;
+};
+
+class RenderGraph
+{
+public:
+	/// <summary>
+	/// Declares transient target of the frame
+	/// </summary>
+	/// <param name="name">Name of the target, for messages</param>
+	/// <param name="desc">Size, format and clear value</param>
+	RenderResource CreateTarget(const char* name, const RenderTargetDesc& desc);
+	/// <summary>
+	/// Declares framebuffer which lives outside of the graph, usually the window. Passes which write it are never skipped
+	/// </summary>
+	/// <param name="name">Name of the framebuffer, for messages</param>
+	/// <param name="framebuffer">GL framebuffer</param>
+	/// <param name="width">Width of the framebuffer</param>
+	/// <param name="height">Height of the framebuffer</param>
+	RenderResource ImportFramebuffer(const char* name, GLuint framebuffer, GLsizei width, GLsizei height);
+	/// <summary>
+	/// Declares pass
+	/// </summary>
+	/// <param name="name">Name of the pass. Has to be string literal, it is used as profiler scope</param>
+	/// <param name="state">GL state of the pass</param>
+	/// <param name="execute">Function which issues the draw calls. Framebuffer, viewport and state are already set</param>
+	/// <returns>Returns index of the pass</returns>
+	GLuint AddPass(const char* name, const PassState& state, const std::function<void()>& execute);
+	/// <summary>
+	/// Adds color output of the pass. Outputs are attached in the order they were added, so the order has to match
+	/// output locations of the shaders. Output which nobody reads is not attached and its writes are discarded
+	/// </summary>
+	void AddColorOutput(GLuint pass, RenderResource target);
+	/// <summary>
+	/// Sets depth (and stencil) target of the pass. Pass depends on the previous writers of the depth even if it does not write it
+	/// </summary>
+	void SetDepthOutput(GLuint pass, RenderResource target);
+	/// <summary>
+	/// Adds resource the pass reads: samples it or reads its pixels
+	/// </summary>
+	void AddInput(GLuint pass, RenderResource resource);
+	/// <summary>
+	/// Marks pass which does something besides writing its outputs, so it is never skipped
+	/// </summary>
+	void SetSideEffect(GLuint pass);
+	/// <summary>
+	/// Orders passes, skips unused ones, allocates transient targets and executes the passes
+	/// </summary>
+	void Execute();
+	/// <summary>
+	/// Forgets declared passes and resources. Pooled targets are kept for the next frames
+	/// </summary>
+	void Reset();
+	/// <summary>
+	/// Deletes pooled targets and framebuffers
+	/// </summary>
+	void Release();
+	/// <summary>
+	/// Returns texture of the transient target. Valid only inside the passes which use the target
+	/// </summary>
+	GLuint GetTexture(RenderResource resource) const;
+	/// <summary>
+	/// Binds framebuffer for reading the color or depth target (glReadPixels, glBlitFramebuffer). Valid only inside the passes which use the target
+	/// </summary>
+	void BindReadTarget(RenderResource resource);
+	/// <summary>
+	/// Returns number of passes executed by the last Execute
+	/// </summary>
+	GLuint GetExecutedPassesCount() const;
+	/// <summary>
+	/// Returns number of textures in the pool
+	/// </summary>
+	GLuint GetPooledTargetsCount() const;
+private:
+	struct Resource {
+		const char* name;
+		RenderTargetDesc desc;
+		/// <summary>
+		/// Imported framebuffer or 0xFFFFFFFF for transient target
+		/// </summary>
+		GLuint framebuffer;
+		/// <summary>
+		/// Index of the pooled texture during Execute
+		/// </summary>
+		GLuint pooled;
+		bool needed;
+		/// <summary>
+		/// First and last position in the execution order
+		/// </summary>
+		GLuint first_use;
+		GLuint last_use;
+	};
+	struct Pass {
+		const char* name;
+		PassState state;
+		std::function<void()> execute;
+		std::vector<RenderResource> color_outputs;
+		RenderResource depth_output;
+		std::vector<RenderResource> inputs;
+		bool side_effect;
+		bool needed;
+	};
+	struct PooledTarget {
+		RenderTargetDesc desc;
+		GLuint texture;
+		bool in_use;
+		GLuint unused_frames;
+	};
+	struct CachedFramebuffer {
+		/// <summary>
+		/// Textures of the color attachments (0 for none) and of the depth attachment
+		/// </summary>
+		GLuint attachments[MAX_PASS_COLOR_OUTPUTS + 1];
+		GLuint framebuffer;
+		GLuint unused_frames;
+	};
+
+	/// <summary>
+	/// Marks passes and resources which contribute to imported framebuffers or side effects
+	/// </summary>
+	void CullPasses();
+	/// <summary>
+	/// Returns needed passes ordered by their dependencies. Returns false if dependencies have a cycle
+	/// </summary>
+	bool SortPasses(std::vector<GLuint>& order) const;
+	/// <summary>
+	/// Takes free pooled texture with the same description or creates new one
+	/// </summary>
+	GLuint AcquireTarget(const RenderTargetDesc& desc);
+	/// <summary>
+	/// Binds framebuffer of the pass outputs and clears targets used for the first time
+	/// </summary>
+	void BindPassOutputs(const Pass& pass, GLuint position);
+	/// <summary>
+	/// Returns cached framebuffer with the attachments or creates new one
+	/// </summary>
+	/// <param name="attachments">Textures of the color attachments (0 for none) and of the depth attachment</param>
+	/// <param name="depth_format">Internal format of the depth texture</param>
+	GLuint GetFramebuffer(const GLuint* attachments, GLenum depth_format);
+	/// <summary>
+	/// Sets the complete state of the pass
+	/// </summary>
+	static void ApplyState(const PassState& state);
+	/// <summary>
+	/// Deletes pooled targets and framebuffers which were not used for a long time
+	/// </summary>
+	void TrimPool();
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<PooledTarget> pool;
+	std::vector<CachedFramebuffer> framebuffers;
+	/// <summary>
+	/// Framebuffer for reading transient targets
+	/// </summary>
+	GLuint read_framebuffer = 0;
+	GLuint executed_passes = 0;
+};
+
+#endif // !RENDER_GRAPH_H
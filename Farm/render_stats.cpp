@@ -0,0 +1,89 @@
+#include <iostream>
+#include <fstream>
+
+#include "render_stats.h"
+
+RenderStats frame_stats;
+
+static RenderStats last_frame_stats;
+/// <summary>
+/// Sums of counters since the last dump
+/// </summary>
+static RenderStats interval_stats;
+static GLuint interval_frames = 0;
+static GLuint dump_interval = 0;
+static std::string dump_path;
+static GLuint frame_number = 0;
+
+const RenderStats& GetRenderStats()
+{
+	return last_frame_stats;
+}
+
+void SetRenderStatsDump(GLuint interval, const std::string& csv_path)
+{
+	dump_interval = interval;
+	dump_path = csv_path;
+	interval_stats = RenderStats();
+	interval_frames = 0;
+
+	if (dump_interval != 0 && !dump_path.empty()) {
+		std::ofstream ofs(dump_path);
+		if (ofs.is_open())
+			ofs << "frame,draw_calls,triangles,program_binds,texture_binds,vao_binds,uniform_calls,bytes_uploaded\n";
+		else {
+			std::cout << "failed to open render stats file: " << dump_path << std::endl;
+			dump_interval = 0;
+		}
+	}
+}
+
+/// <summary>
+/// Writes average counters of the last interval
+/// </summary>
+static void DumpRenderStats()
+{
+	double frames = interval_frames;
+	if (dump_path.empty()) {
+		std::cout << "frame " << frame_number
+			<< ": draw calls " << interval_stats.draw_calls / frames
+			<< ", triangles " << interval_stats.triangles / frames
+			<< ", programs " << interval_stats.program_binds / frames
+			<< ", textures " << interval_stats.texture_binds / frames
+			<< ", VAOs " << interval_stats.vao_binds / frames
+			<< ", uniforms " << interval_stats.uniform_calls / frames
+			<< ", bytes " << interval_stats.bytes_uploaded / frames << std::endl;
+		return;
+	}
+
+	std::ofstream ofs(dump_path, std::ios::app);
+	ofs << frame_number << ","
+		<< interval_stats.draw_calls / frames << ","
+		<< interval_stats.triangles / frames << ","
+		<< interval_stats.program_binds / frames << ","
+		<< interval_stats.texture_binds / frames << ","
+		<< interval_stats.vao_binds / frames << ","
+		<< interval_stats.uniform_calls / frames << ","
+		<< interval_stats.bytes_uploaded / frames << "\n";
+}
+
+void RenderStatsEndFrame()
+{
+	frame_number++;
+	last_frame_stats = frame_stats;
+	frame_stats = RenderStats();
+	if (dump_interval == 0) return;
+
+	interval_stats.draw_calls += last_frame_stats.draw_calls;
+	interval_stats.triangles += last_frame_stats.triangles;
+	interval_stats.program_binds += last_frame_stats.program_binds;
+	interval_stats.texture_binds += last_frame_stats.texture_binds;
+	interval_stats.vao_binds += last_frame_stats.vao_binds;
+	interval_stats.uniform_calls += last_frame_stats.uniform_calls;
+	interval_stats.bytes_uploaded += last_frame_stats.bytes_uploaded;
+	if (++interval_frames < dump_interval) return;
+
+	DumpRenderStats();
+	interval_stats = RenderStats();
+	interval_frames = 0;
+}
@@ -0,0 +1,169 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       render_stats.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines counters of GL calls per frame and wrappers of the counted GL functions
+*/
+//----------------------------------------------------------------------------------------
+#ifndef RENDER_STATS
+#define RENDER_STATS
+
+#include <string>
+
+#include "pgr.h"
+
+/// <summary>
+/// Numbers of GL calls made during one frame
+/// </summary>
+struct RenderStats {
+	GLuint draw_calls = 0;
+	GLuint64 triangles = 0;
+	GLuint program_binds = 0;
+	GLuint texture_binds = 0;
+	GLuint vao_binds = 0;
+	GLuint uniform_calls = 0;
+	GLuint64 bytes_uploaded = 0;
+};
+
+/// <summary>
+/// Counters of the current frame. Wrappers below increment them
+/// </summary>
+extern RenderStats frame_stats;
+
+/// <summary>
+/// Returns counters of the last finished frame
+/// </summary>
+const RenderStats& GetRenderStats();
+/// <summary>
+/// Finishes the frame: saves its counters, resets counters of the next frame and dumps averages if it is time
+/// </summary>
+void RenderStatsEndFrame();
+/// <summary>
+/// Enables periodic dump of average counters
+/// </summary>
+/// <param name="interval">Number of frames between dumps. 0 disables dumping</param>
+/// <param name="csv_path">Path to the CSV file. Empty path means dumping to the console</param>
+void SetRenderStatsDump(GLuint interval, const std::string& csv_path = "");
+
+inline void StatsDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+{
+	glDrawElements(mode, count, type, indices);
+	frame_stats.draw_calls++;
+	if (mode == GL_TRIANGLES) frame_stats.triangles += count / 3;
+	else if (mode == GL_TRIANGLE_STRIP && count > 2) frame_stats.triangles += count - 2;
+}
+
+inline void StatsDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instance_count)
+{
+	glDrawElementsInstanced(mode, count, type, indices, instance_count);
+	frame_stats.draw_calls++;
+	if (mode == GL_TRIANGLES) frame_stats.triangles += (GLuint64)(count / 3) * instance_count;
+}
+
+inline void StatsDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei count)
+{
+	glDrawElementsIndirect(mode, type, indirect);
+	frame_stats.draw_calls++;
+	if (mode == GL_TRIANGLES) frame_stats.triangles += count / 3;
+}
+
+inline void StatsMultiDrawElements(GLenum mode, const GLsizei* counts, GLenum type, const void* const* indices, GLsizei draw_count)
+{
+	glMultiDrawElements(mode, counts, type, indices, draw_count);
+	frame_stats.draw_calls++;
+	if (mode == GL_TRIANGLES)
+		for (GLsizei i = 0; i < draw_count; i++) frame_stats.triangles += counts[i] / 3;
+}
+
+inline void StatsMultiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei draw_count, GLsizei count)
+{
+	glMultiDrawElementsIndirect(mode, type, indirect, draw_count, 0);
+	frame_stats.draw_calls++;
+	if (mode == GL_TRIANGLES) frame_stats.triangles += count / 3;
+}
+
+inline void StatsDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint base_vertex)
+{
+	glDrawElementsBaseVertex(mode, count, type, (void*)indices, base_vertex);
+	frame_stats.draw_calls++;
+	if (mode == GL_TRIANGLES) frame_stats.triangles += count / 3;
+}
+
+inline void StatsDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	glDrawArrays(mode, first, count);
+	frame_stats.draw_calls++;
+	if (mode == GL_TRIANGLES) frame_stats.triangles += count / 3;
+	else if (mode == GL_TRIANGLE_STRIP && count > 2) frame_stats.triangles += count - 2;
+}
+
+inline void StatsDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instance_count)
+{
+	glDrawArraysInstanced(mode, first, count, instance_count);
+	frame_stats.draw_calls++;
+	if (mode == GL_TRIANGLES) frame_stats.triangles += (GLuint64)(count / 3) * instance_count;
+	else if (mode == GL_TRIANGLE_STRIP && count > 2) frame_stats.triangles += (GLuint64)(count - 2) * instance_count;
+}
+
+inline void StatsUseProgram(GLuint program)
+{
+	glUseProgram(program);
+	frame_stats.program_binds++;
+}
+
+inline void StatsBindTexture(GLenum target, GLuint texture)
+{
+	glBindTexture(target, texture);
+	frame_stats.texture_binds++;
+}
+
+inline void StatsBindVertexArray(GLuint vao)
+{
+	glBindVertexArray(vao);
+	frame_stats.vao_binds++;
+}
+
+inline void StatsBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	glBufferData(target, size, data, usage);
+	if (data != nullptr) frame_stats.bytes_uploaded += size;
+}
+
+inline void StatsBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	glBufferSubData(target, offset, size, data);
+	frame_stats.bytes_uploaded += size;
+}
+
+inline void StatsUniform(GLint location, GLint value)
+{
+	glUniform1i(location, value);
+	frame_stats.uniform_calls++;
+}
+
+inline void StatsUniform(GLint location, GLuint value)
+{
+	glUniform1ui(location, value);
+	frame_stats.uniform_calls++;
+}
+
+inline void StatsUniform(GLint location, GLfloat value)
+{
+	glUniform1f(location, value);
+	frame_stats.uniform_calls++;
+}
+
+inline void StatsUniform(GLint location, const glm::vec3& value)
+{
+	glUniform3fv(location, 1, glm::value_ptr(value));
+	frame_stats.uniform_calls++;
+}
+
+inline void StatsUniform(GLint location, const glm::mat4& value)
+{
+	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+	frame_stats.uniform_calls++;
+}
+
+#endif // !RENDER_STATS
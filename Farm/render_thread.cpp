@@ -0,0 +1,146 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+#include "render_thread.h"
+#include "profiler.h"
+
+static const GLuint NO_FRAME = 0xFFFFFFFF;
+
+/// <summary>
+/// Double buffer of frames. Indices are changed under the mutex, frame data is used
+/// without it: recorded frame only by the main thread, executed frame only by the render thread
+/// </summary>
+static FrameCommands frames[2];
+static GLuint recording_index = NO_FRAME;
+static GLuint ready_index = NO_FRAME;
+static GLuint executing_index = NO_FRAME;
+
+static std::mutex queue_mutex;
+static std::condition_variable frame_submitted;
+static std::thread render_thread;
+static bool running = false;
+
+#ifdef _WIN32
+static HDC device_context = NULL;
+static HGLRC gl_context = NULL;
+#endif
+
+/// <summary>
+/// Makes GL context current on the calling thread or releases it
+/// </summary>
+/// <param name="current">True to make the context current, false to release it</param>
+static bool MakeContextCurrent(bool current)
+{
+#ifdef _WIN32
+	return wglMakeCurrent(current ? device_context : NULL, current ? gl_context : NULL) == TRUE;
+#else
+	(void)current;
+	return false;
+#endif
+}
+
+static void SwapWindowBuffers()
+{
+#ifdef _WIN32
+	SwapBuffers(device_context);
+#endif
+}
+
+static void RenderLoop(FrameExecuteFunc execute)
+{
+	PROFILE_SET_RENDER_THREAD();
+	MakeContextCurrent(true);
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(queue_mutex);
+			executing_index = NO_FRAME;
+			frame_submitted.wait(lock, [] { return ready_index != NO_FRAME || !running; });
+			if (ready_index == NO_FRAME) break;
+			executing_index = ready_index;
+			ready_index = NO_FRAME;
+		}
+
+		execute(frames[executing_index]);
+		SwapWindowBuffers();
+	}
+	// all GL commands have to be finished before the context is moved back
+	glFinish();
+	MakeContextCurrent(false);
+}
+
+bool StartRenderThread(FrameExecuteFunc execute)
+{
+	if (running) return true;
+#ifdef _WIN32
+	device_context = wglGetCurrentDC();
+	gl_context = wglGetCurrentContext();
+	if (device_context == NULL || gl_context == NULL) {
+		std::cout << "render thread: no current GL context" << std::endl;
+		return false;
+	}
+#else
+	std::cout << "render thread is not supported on this platform, drawing on the main thread" << std::endl;
+	return false;
+#endif
+
+	glFinish();
+	if (!MakeContextCurrent(false)) {
+		std::cout << "render thread: failed to release GL context" << std::endl;
+		return false;
+	}
+
+	recording_index = NO_FRAME;
+	ready_index = NO_FRAME;
+	executing_index = NO_FRAME;
+	running = true;
+	render_thread = std::thread(RenderLoop, execute);
+	return true;
+}
+
+void StopRenderThread()
+{
+	if (!running) return;
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		running = false;
+	}
+	frame_submitted.notify_one();
+	render_thread.join();
+	MakeContextCurrent(true);
+}
+
+bool IsRenderThreadRunning()
+{
+	return running;
+}
+
+FrameCommands* BeginFrameRecording()
+{
+	std::lock_guard<std::mutex> lock(queue_mutex);
+	// do not record faster than the render thread draws
+	if (ready_index != NO_FRAME) return nullptr;
+	// any frame which is not executed is free
+	recording_index = executing_index == 0 ? 1 : 0;
+	frames[recording_index].Clear();
+	return &frames[recording_index];
+}
+
+void SubmitFrame()
+{
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		ready_index = recording_index;
+		recording_index = NO_FRAME;
+	}
+	frame_submitted.notify_one();
+}
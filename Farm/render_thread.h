@@ -0,0 +1,49 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       render_thread.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines render thread which owns GL context and executes recorded frames
+ *
+ * Main thread records frames into a double buffer: while the render thread executes frame N,
+ * the main thread simulates and records frame N + 1. Recording of frame N + 2 waits until
+ * the render thread takes frame N + 1, so the main thread is never more than one frame ahead.
+ * GL context of the window is moved to the render thread, so while it runs the main thread
+ * must not call OpenGL. Moving of the context is implemented with WGL, on other platforms
+ * StartRenderThread fails and the program draws on the main thread.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef RENDER_THREAD
+#define RENDER_THREAD
+
+#include "frame_commands.h"
+
+/// <summary>
+/// Draws one recorded frame into the back buffer
+/// </summary>
+typedef void (*FrameExecuteFunc)(const FrameCommands& frame);
+
+/// <summary>
+/// Moves GL context of the current window to the new render thread
+/// </summary>
+/// <param name="execute">Function which draws one frame, called on the render thread</param>
+/// <returns>Returns true if the thread was started. Otherwise returns false and GL context stays on the calling thread</returns>
+bool StartRenderThread(FrameExecuteFunc execute);
+/// <summary>
+/// Finishes the frame being drawn, stops the render thread and makes GL context current on the calling thread again
+/// </summary>
+void StopRenderThread();
+/// <summary>
+/// Returns true if the render thread is running
+/// </summary>
+bool IsRenderThreadRunning();
+/// <summary>
+/// Returns free frame for recording or nullptr if the previous recorded frame was not taken by the render thread yet
+/// </summary>
+FrameCommands* BeginFrameRecording();
+/// <summary>
+/// Passes frame returned by BeginFrameRecording to the render thread
+/// </summary>
+void SubmitFrame();
+
+#endif // !RENDER_THREAD
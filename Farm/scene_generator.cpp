@@ -0,0 +1,239 @@
+#include <iostream>
+#include <random>
+#include <cmath>
+
+#include "scene_generator.h"
+#include "data_parser.h"
+
+/// <summary>
+/// Models of generated scene, in the same order as in models table
+/// </summary>
+enum GeneratorModel {
+	GEN_BUCKET,
+	GEN_CAMPFIRE,
+	GEN_CARROT,
+	GEN_CORN,
+	GEN_FENCE,
+	GEN_HOUSE,
+	GEN_PITCHFORK,
+	GEN_PUMPKIN,
+	GEN_STRAW,
+	GEN_TRACTOR,
+	GEN_TRAILER,
+	GEN_TROUGH,
+	GEN_WINDMILL
+};
+
+/// <summary>
+/// Fence length along its x axis
+/// </summary>
+static const float FENCE_LENGTH = 3.57f;
+/// <summary>
+/// Half size of the yard in the middle of the farm, fields are placed around it
+/// </summary>
+static const float YARD_HALF_SIZE = 20.0f;
+/// <summary>
+/// Every crop field is a square of FIELD_ROWS x FIELD_ROWS plants
+/// </summary>
+static const GLuint FIELD_ROWS = 32;
+static const float CORN_SPACING = 2.0f;
+static const float CARROT_SPACING = 0.6f;
+static const float FIELD_GAP = 6.0f;
+
+/// <summary>
+/// Random generator which gives the same numbers on every platform
+/// (std distributions are implementation defined, so they are not used)
+/// </summary>
+class GeneratorRandom
+{
+public:
+	GeneratorRandom(unsigned int seed) : engine(seed) {}
+	/// <summary>
+	/// Returns float from [0, 1)
+	/// </summary>
+	float Next() { return (engine() >> 8) * (1.0f / 16777216.0f); }
+	/// <summary>
+	/// Returns float from [min, max)
+	/// </summary>
+	float Range(float min, float max) { return min + (max - min) * Next(); }
+	/// <summary>
+	/// Returns integer from [0, count)
+	/// </summary>
+	GLuint Index(GLuint count) { return (GLuint)(Next() * count) % count; }
+private:
+	std::mt19937 engine;
+};
+
+/// <summary>
+/// Adds object to the scene description
+/// </summary>
+/// <returns>Returns index of the new object</returns>
+static GLuint AddObject(SceneDescription& scene, GLuint model_id, const glm::vec3& position, float angle, float scale, GLuint parent = NO_PARENT)
+{
+	scene.model_ids.push_back(model_id);
+	scene.positions.push_back(position);
+	scene.rotations.push_back(glm::vec4(0.0f, 1.0f, 0.0f, angle));
+	scene.scales.push_back(glm::vec3(scale));
+	scene.parents.push_back(parent);
+	return (GLuint)scene.model_ids.size() - 1;
+}
+
+static void AddModel(SceneDescription& scene, const char* path, GLuint diffuse_id, GLuint specular_id)
+{
+	ModelRecord model;
+	model.path = path;
+	model.diffuse_id = diffuse_id;
+	model.specular_id = specular_id;
+	scene.models.push_back(model);
+}
+
+/// <summary>
+/// Fills textures and models tables. Uses the same resources as ModelsData.txt
+/// </summary>
+static void AddResources(SceneDescription& scene)
+{
+	scene.diffuse_textures = {
+		"Resources/Textures/bucket_diffuse.png",
+		"Resources/Textures/campfire_diffuse.png",
+		"Resources/Textures/carrot_diffuse.png",
+		"Resources/Textures/corn_diffuse.png",
+		"Resources/Textures/wood_diffuse.png",
+		"Resources/Textures/house_diffuse.png",
+		"Resources/Textures/pitchfork_diffuse.png",
+		"Resources/Textures/pumpkin_diffuse.png",
+		"Resources/Textures/straw_diffuse.png",
+		"Resources/Textures/tractor_diffuse.png",
+		"Resources/Textures/trailer_diffuse.png",
+		"Resources/Textures/trough_diffuse.png",
+		"Resources/Textures/windmill_diffuse.png"
+	};
+	scene.specular_textures = {
+		"Resources/Textures/bucket_specular.png",
+		"Resources/Textures/house_specular.png",
+		"Resources/Textures/no_specular.png",
+		"Resources/Textures/pitchfork_specular.png",
+		"Resources/Textures/tractor_specular.png",
+		"Resources/Textures/trailer_specular.png",
+		"Resources/Textures/trough_specular.png",
+		"Resources/Textures/windmill_specular.png"
+	};
+	AddModel(scene, "Resources/Models/bucket.obj", 0, 0);
+	AddModel(scene, "Resources/Models/campfire.obj", 1, 2);
+	AddModel(scene, "Resources/Models/carrot.obj", 2, 2);
+	AddModel(scene, "Resources/Models/corn.obj", 3, 2);
+	AddModel(scene, "Resources/Models/fence.obj", 4, 2);
+	AddModel(scene, "Resources/Models/house.obj", 5, 1);
+	AddModel(scene, "Resources/Models/pitchfork.obj", 6, 3);
+	AddModel(scene, "Resources/Models/pumpkin.obj", 7, 2);
+	AddModel(scene, "Resources/Models/straw.obj", 8, 2);
+	AddModel(scene, "Resources/Models/tractor.obj", 9, 4);
+	AddModel(scene, "Resources/Models/trailer.obj", 10, 5);
+	AddModel(scene, "Resources/Models/trough.obj", 11, 6);
+	AddModel(scene, "Resources/Models/windmill.obj", 12, 7);
+}
+
+/// <summary>
+/// Returns cell of the square spiral around (0, 0) with given number. Cell (0, 0) is skipped
+/// </summary>
+static void GetSpiralCell(GLuint number, int& x, int& z)
+{
+	int ring = 1;
+	while ((GLuint)(8 * ring) <= number) {
+		number -= 8 * ring;
+		ring++;
+	}
+	int side = number / (2 * ring);
+	int offset = number % (2 * ring);
+	switch (side) {
+	case 0: x = -ring + offset; z = -ring; break;
+	case 1: x = ring; z = -ring + offset; break;
+	case 2: x = ring - offset; z = ring; break;
+	default: x = -ring; z = ring - offset; break;
+	}
+}
+
+/// <summary>
+/// Adds closed square ring of fences
+/// </summary>
+static void AddFenceRing(SceneDescription& scene, float half_size)
+{
+	GLuint fences_per_side = (GLuint)std::ceil(2.0f * half_size / FENCE_LENGTH);
+	float step = 2.0f * half_size / fences_per_side;
+	for (GLuint i = 0; i < fences_per_side; i++) {
+		float t = -half_size + (i + 0.5f) * step;
+		AddObject(scene, GEN_FENCE, glm::vec3(t, 0.0f, -half_size), 0.0f, 1.0f);
+		AddObject(scene, GEN_FENCE, glm::vec3(t, 0.0f, half_size), 0.0f, 1.0f);
+		AddObject(scene, GEN_FENCE, glm::vec3(-half_size, 0.0f, t), 90.0f, 1.0f);
+		AddObject(scene, GEN_FENCE, glm::vec3(half_size, 0.0f, t), 90.0f, 1.0f);
+	}
+}
+
+void GenerateScene(const GeneratorSettings& settings, SceneDescription& scene)
+{
+	GeneratorRandom random(settings.seed);
+	scene = SceneDescription();
+	AddResources(scene);
+
+	// farm yard
+	AddObject(scene, GEN_HOUSE, glm::vec3(0.0f, 0.0f, 7.0f), -90.0f, 1.0f);
+	AddObject(scene, GEN_WINDMILL, glm::vec3(12.0f, 0.0f, 9.5f), -135.0f, 1.0f);
+	AddObject(scene, GEN_CAMPFIRE, glm::vec3(3.43f, 0.0f, -11.92f), 0.0f, 1.0f);
+	AddObject(scene, GEN_TROUGH, glm::vec3(-4.48f, 0.0f, -13.0f), 0.0f, 1.0f);
+
+	// crop fields are placed on square spiral around the yard, corn and carrot fields alternate
+	GLuint plants_per_field = FIELD_ROWS * FIELD_ROWS;
+	GLuint fields = (settings.crops + plants_per_field - 1) / plants_per_field;
+	float cell_size = FIELD_ROWS * CORN_SPACING + FIELD_GAP;
+	float extent = YARD_HALF_SIZE;
+	GLuint crops_left = settings.crops;
+	for (GLuint field = 0; field < fields; field++)
+	{
+		int cell_x, cell_z;
+		GetSpiralCell(field, cell_x, cell_z);
+		glm::vec3 field_center = glm::vec3(cell_x * cell_size, 0.0f, cell_z * cell_size);
+		extent = std::fmax(extent, std::fmax(std::fabs(field_center.x), std::fabs(field_center.z)) + cell_size / 2.0f);
+
+		bool corn = field % 2 == 0;
+		GLuint model_id = corn ? GEN_CORN : GEN_CARROT;
+		float spacing = corn ? CORN_SPACING : CARROT_SPACING;
+		float field_half_size = (FIELD_ROWS - 1) * spacing / 2.0f;
+		for (GLuint i = 0; i < plants_per_field && crops_left > 0; i++, crops_left--) {
+			glm::vec3 position = field_center + glm::vec3(
+				(i % FIELD_ROWS) * spacing - field_half_size + random.Range(-0.15f, 0.15f) * spacing,
+				0.0f,
+				(i / FIELD_ROWS) * spacing - field_half_size + random.Range(-0.15f, 0.15f) * spacing);
+			AddObject(scene, model_id, position, random.Range(0.0f, 360.0f), random.Range(0.85f, 1.15f));
+		}
+	}
+
+	// first ring closes the yard, others go around all fields
+	for (GLuint i = 0; i < settings.fence_rings; i++)
+		AddFenceRing(scene, i == 0 ? YARD_HALF_SIZE : extent + FIELD_GAP * i);
+
+	// props are scattered over the whole farm, tractors pull trailers
+	const GeneratorModel prop_models[] = { GEN_BUCKET, GEN_PUMPKIN, GEN_STRAW, GEN_PITCHFORK, GEN_TROUGH, GEN_TRACTOR };
+	const GLuint prop_models_count = sizeof(prop_models) / sizeof(prop_models[0]);
+	for (GLuint i = 0; i < settings.props; i++) {
+		GeneratorModel model_id = prop_models[random.Index(prop_models_count)];
+		glm::vec3 position = glm::vec3(random.Range(-extent, extent), 0.0f, random.Range(-extent, extent));
+		GLuint object = AddObject(scene, model_id, position, random.Range(0.0f, 360.0f), 1.0f);
+		if (model_id == GEN_TRACTOR)
+			AddObject(scene, GEN_TRAILER, glm::vec3(-4.2f, 0.0f, 0.0f), 0.0f, 1.0f, object);
+	}
+
+	// lights
+	for (GLuint i = 0; i < settings.lights; i++) {
+		glm::vec3 position = glm::vec3(random.Range(-extent, extent), 0.0f, random.Range(-extent, extent));
+		AddObject(scene, GEN_CAMPFIRE, position, random.Range(0.0f, 360.0f), 1.0f);
+	}
+}
+
+bool GenerateSceneFile(const GeneratorSettings& settings, const std::string& path)
+{
+	SceneDescription scene;
+	GenerateScene(settings, scene);
+	std::cout << "generated objects: " << scene.model_ids.size() << std::endl;
+
+	if (GetSnapshotPath(path) == path) return WriteSceneSnapshot(path, scene);
+	return WriteSceneConfig(path, scene);
+}
@@ -0,0 +1,53 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       scene_generator.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines generator of big procedural farms for benchmarks
+*/
+//----------------------------------------------------------------------------------------
+#ifndef SCENE_GENERATOR
+#define SCENE_GENERATOR
+
+#include <string>
+
+#include "scene_snapshot.h"
+
+/// <summary>
+/// Parameters of generated scene. Scene depends only on these values, so the same seed always gives the same scene
+/// </summary>
+struct GeneratorSettings {
+	unsigned int seed = 1;
+	/// <summary>
+	/// Number of corn and carrot objects in crop fields
+	/// </summary>
+	GLuint crops = 10000;
+	/// <summary>
+	/// Number of fence rings around the farm
+	/// </summary>
+	GLuint fence_rings = 2;
+	/// <summary>
+	/// Number of scattered props (buckets, pumpkins, straw, tractors...)
+	/// </summary>
+	GLuint props = 200;
+	/// <summary>
+	/// Number of light sources. Lights are placed as campfires
+	/// </summary>
+	GLuint lights = 16;
+};
+
+/// <summary>
+/// Generates scene description
+/// </summary>
+/// <param name="settings">Parameters of the scene</param>
+/// <param name="scene">Returned scene description</param>
+void GenerateScene(const GeneratorSettings& settings, SceneDescription& scene);
+/// <summary>
+/// Generates scene and saves it. Files with ".scene" extension are saved as binary scene, others as configure file
+/// </summary>
+/// <param name="settings">Parameters of the scene</param>
+/// <param name="path">Path to the output file</param>
+/// <returns>Returns true if saving was succesful. Otherwise returns false</returns>
+bool GenerateSceneFile(const GeneratorSettings& settings, const std::string& path);
+
+#endif // !SCENE_GENERATOR
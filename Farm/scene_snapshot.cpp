@@ -0,0 +1,392 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "scene_snapshot.h"
+#include "data_parser.h"
+
+/// <summary>
+/// Binary scene layout. All offsets are counted from the beginning of the file, arrays are aligned to 16 bytes
+/// </summary>
+struct SnapshotHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t diffuse_count;
+	uint32_t specular_count;
+	uint32_t model_count;
+	uint32_t object_count;
+	uint32_t diffuse_table;
+	uint32_t specular_table;
+	uint32_t models_table;
+	uint32_t positions;
+	uint32_t rotations;
+	uint32_t scales;
+	uint32_t model_ids;
+	uint32_t parents;
+	uint32_t strings;
+	uint32_t strings_size;
+};
+
+/// <summary>
+/// One record of the models table. Path is an offset in the strings block
+/// </summary>
+struct SnapshotModel {
+	uint32_t path;
+	uint32_t diffuse_id;
+	uint32_t specular_id;
+};
+
+static const char SNAPSHOT_MAGIC[4] = { 'F', 'S', 'C', 'N' };
+static const uint32_t SNAPSHOT_VERSION = 2;
+static const char* SNAPSHOT_EXTENSION = ".scene";
+
+/// <summary>
+/// Appends raw data to the image and returns its offset
+/// </summary>
+static uint32_t AppendData(std::vector<char>& image, const void* data, size_t size)
+{
+	size_t offset = (image.size() + 15) & ~(size_t)15;
+	image.resize(offset + size);
+	if (size != 0) std::memcpy(&image[offset], data, size);
+	return (uint32_t)offset;
+}
+
+/// <summary>
+/// Appends string to the strings block and returns its offset in the block
+/// </summary>
+static uint32_t AppendString(std::vector<char>& strings, const std::string& str)
+{
+	uint32_t offset = (uint32_t)strings.size();
+	strings.insert(strings.end(), str.begin(), str.end());
+	strings.push_back('\0');
+	return offset;
+}
+
+void BuildSceneSnapshot(const SceneDescription& scene, std::vector<char>& image)
+{
+	SnapshotHeader header;
+	std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.diffuse_count = (uint32_t)scene.diffuse_textures.size();
+	header.specular_count = (uint32_t)scene.specular_textures.size();
+	header.model_count = (uint32_t)scene.models.size();
+	header.object_count = (uint32_t)scene.model_ids.size();
+
+	std::vector<char> strings;
+	std::vector<uint32_t> diffuse_table, specular_table;
+	std::vector<SnapshotModel> models_table;
+	for (GLuint i = 0; i < scene.diffuse_textures.size(); i++)
+		diffuse_table.push_back(AppendString(strings, scene.diffuse_textures[i]));
+	for (GLuint i = 0; i < scene.specular_textures.size(); i++)
+		specular_table.push_back(AppendString(strings, scene.specular_textures[i]));
+	for (GLuint i = 0; i < scene.models.size(); i++) {
+		SnapshotModel model;
+		model.path = AppendString(strings, scene.models[i].path);
+		model.diffuse_id = scene.models[i].diffuse_id;
+		model.specular_id = scene.models[i].specular_id;
+		models_table.push_back(model);
+	}
+
+	image.clear();
+	image.resize(sizeof(SnapshotHeader));
+	header.diffuse_table = AppendData(image, diffuse_table.data(), diffuse_table.size() * sizeof(uint32_t));
+	header.specular_table = AppendData(image, specular_table.data(), specular_table.size() * sizeof(uint32_t));
+	header.models_table = AppendData(image, models_table.data(), models_table.size() * sizeof(SnapshotModel));
+	header.positions = AppendData(image, scene.positions.data(), scene.positions.size() * sizeof(glm::vec3));
+	header.rotations = AppendData(image, scene.rotations.data(), scene.rotations.size() * sizeof(glm::vec4));
+	header.scales = AppendData(image, scene.scales.data(), scene.scales.size() * sizeof(glm::vec3));
+	header.model_ids = AppendData(image, scene.model_ids.data(), scene.model_ids.size() * sizeof(GLuint));
+	header.parents = AppendData(image, scene.parents.data(), scene.parents.size() * sizeof(GLuint));
+	header.strings = AppendData(image, strings.data(), strings.size());
+	header.strings_size = (uint32_t)strings.size();
+	std::memcpy(&image[0], &header, sizeof(header));
+}
+
+bool WriteSceneSnapshot(const std::string& path, const SceneDescription& scene)
+{
+	std::vector<char> image;
+	BuildSceneSnapshot(scene, image);
+
+	std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+	if (!ofs) {
+		std::cout << "failed to open binary scene for writing: " << path << std::endl;
+		return false;
+	}
+	ofs.write(image.data(), image.size());
+	if (!ofs) {
+		std::cout << "failed to write binary scene: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool ConvertConfigToSnapshot(const std::string& config_file_path, const std::string& snapshot_path)
+{
+	SceneDescription scene;
+	if (!ParseSceneConfig(config_file_path, scene)) {
+		std::cout << "failed to parse configure file: " << config_file_path << std::endl;
+		return false;
+	}
+	return WriteSceneSnapshot(snapshot_path, scene);
+}
+
+std::string GetSnapshotPath(const std::string& config_file_path)
+{
+	size_t dot = config_file_path.find_last_of('.');
+	size_t slash = config_file_path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return config_file_path + SNAPSHOT_EXTENSION;
+	return config_file_path.substr(0, dot) + SNAPSHOT_EXTENSION;
+}
+
+/// <summary>
+/// Returns true if file "path" exists and is not older than file "source_path"
+/// </summary>
+static bool IsUpToDate(const std::string& path, const std::string& source_path)
+{
+	struct stat file_info, source_info;
+	if (stat(path.c_str(), &file_info) != 0) return false;
+	if (stat(source_path.c_str(), &source_info) != 0) return true;
+	return file_info.st_mtime >= source_info.st_mtime;
+}
+
+bool OpenSceneSnapshot(const std::string& config_file_path, SceneSnapshot& snapshot)
+{
+	std::string snapshot_path = GetSnapshotPath(config_file_path);
+	if (snapshot_path == config_file_path) return snapshot.Open(snapshot_path);
+
+	if (IsUpToDate(snapshot_path, config_file_path) && snapshot.Open(snapshot_path)) return true;
+
+	std::cout << "building binary scene: " << snapshot_path << std::endl;
+	SceneDescription scene;
+	if (!ParseSceneConfig(config_file_path, scene)) {
+		std::cout << "failed to parse configure file: " << config_file_path << std::endl;
+		return false;
+	}
+	if (WriteSceneSnapshot(snapshot_path, scene) && snapshot.Open(snapshot_path)) return true;
+
+	// binary scene could not be saved, so it is used from memory
+	std::vector<char> image;
+	BuildSceneSnapshot(scene, image);
+	return snapshot.Open(image);
+}
+
+SceneSnapshot::SceneSnapshot() : data(nullptr), size(0), file_handle(nullptr), mapping_handle(nullptr) {}
+
+SceneSnapshot::~SceneSnapshot()
+{
+	Close();
+}
+
+bool SceneSnapshot::Open(const std::string& path)
+{
+	Close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		CloseHandle(file);
+		return false;
+	}
+	const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	file_handle = file;
+	mapping_handle = mapping;
+	data = (const char*)view;
+	size = (size_t)file_size.QuadPart;
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0) return false;
+	struct stat file_info;
+	if (fstat(file, &file_info) != 0 || file_info.st_size == 0) {
+		close(file);
+		return false;
+	}
+	void* view = mmap(NULL, file_info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (view == MAP_FAILED) return false;
+	mapping_handle = view;
+	data = (const char*)view;
+	size = (size_t)file_info.st_size;
+#endif
+	if (!Validate()) {
+		std::cout << "binary scene is corrupted or outdated: " << path << std::endl;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool SceneSnapshot::Open(std::vector<char>& image)
+{
+	Close();
+	owned_data.swap(image);
+	data = owned_data.data();
+	size = owned_data.size();
+	if (!Validate()) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void SceneSnapshot::Close()
+{
+#ifdef _WIN32
+	if (mapping_handle != nullptr) {
+		UnmapViewOfFile(data);
+		CloseHandle((HANDLE)mapping_handle);
+		CloseHandle((HANDLE)file_handle);
+	}
+#else
+	if (mapping_handle != nullptr) munmap(mapping_handle, size);
+#endif
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+	owned_data.clear();
+	data = nullptr;
+	size = 0;
+}
+
+bool SceneSnapshot::Validate()
+{
+	if (size < sizeof(SnapshotHeader)) return false;
+	const SnapshotHeader* header = (const SnapshotHeader*)data;
+	if (std::memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0) return false;
+	if (header->version != SNAPSHOT_VERSION) return false;
+
+	struct Block { uint32_t offset; uint64_t size; } blocks[] = {
+		{ header->diffuse_table, (uint64_t)header->diffuse_count * sizeof(uint32_t) },
+		{ header->specular_table, (uint64_t)header->specular_count * sizeof(uint32_t) },
+		{ header->models_table, (uint64_t)header->model_count * sizeof(SnapshotModel) },
+		{ header->positions, (uint64_t)header->object_count * sizeof(glm::vec3) },
+		{ header->rotations, (uint64_t)header->object_count * sizeof(glm::vec4) },
+		{ header->scales, (uint64_t)header->object_count * sizeof(glm::vec3) },
+		{ header->model_ids, (uint64_t)header->object_count * sizeof(GLuint) },
+		{ header->parents, (uint64_t)header->object_count * sizeof(GLuint) },
+		{ header->strings, header->strings_size }
+	};
+	for (const Block& block : blocks)
+		if ((block.offset & 3) != 0 || block.offset + block.size > size) return false;
+
+	// strings have to be terminated, otherwise reading the last path could run out of the file
+	if (header->strings_size == 0 || data[header->strings + header->strings_size - 1] != '\0') return false;
+	const uint32_t* diffuse_table = (const uint32_t*)(data + header->diffuse_table);
+	const uint32_t* specular_table = (const uint32_t*)(data + header->specular_table);
+	const SnapshotModel* models_table = (const SnapshotModel*)(data + header->models_table);
+	for (uint32_t i = 0; i < header->diffuse_count; i++)
+		if (diffuse_table[i] >= header->strings_size) return false;
+	for (uint32_t i = 0; i < header->specular_count; i++)
+		if (specular_table[i] >= header->strings_size) return false;
+	for (uint32_t i = 0; i < header->model_count; i++)
+		if (models_table[i].path >= header->strings_size ||
+			models_table[i].diffuse_id >= header->diffuse_count ||
+			models_table[i].specular_id >= header->specular_count) return false;
+	const GLuint* model_ids = (const GLuint*)(data + header->model_ids);
+	GLuint max_model_id = 0;
+	for (uint32_t i = 0; i < header->object_count; i++)
+		max_model_id = model_ids[i] > max_model_id ? model_ids[i] : max_model_id;
+	if (header->object_count != 0 && max_model_id >= header->model_count) return false;
+	const GLuint* parents = (const GLuint*)(data + header->parents);
+	for (uint32_t i = 0; i < header->object_count; i++)
+		if (parents[i] != NO_PARENT && parents[i] >= i) return false;
+	return true;
+}
+
+GLuint SceneSnapshot::GetDiffuseTexturesCount() const
+{
+	return ((const SnapshotHeader*)data)->diffuse_count;
+}
+
+GLuint SceneSnapshot::GetSpecularTexturesCount() const
+{
+	return ((const SnapshotHeader*)data)->specular_count;
+}
+
+GLuint SceneSnapshot::GetModelsCount() const
+{
+	return ((const SnapshotHeader*)data)->model_count;
+}
+
+GLuint SceneSnapshot::GetObjectsCount() const
+{
+	return ((const SnapshotHeader*)data)->object_count;
+}
+
+const char* SceneSnapshot::GetDiffuseTexturePath(GLuint index) const
+{
+	const SnapshotHeader* header = (const SnapshotHeader*)data;
+	return data + header->strings + ((const uint32_t*)(data + header->diffuse_table))[index];
+}
+
+const char* SceneSnapshot::GetSpecularTexturePath(GLuint index) const
+{
+	const SnapshotHeader* header = (const SnapshotHeader*)data;
+	return data + header->strings + ((const uint32_t*)(data + header->specular_table))[index];
+}
+
+const char* SceneSnapshot::GetModelPath(GLuint index) const
+{
+	const SnapshotHeader* header = (const SnapshotHeader*)data;
+	return data + header->strings + ((const SnapshotModel*)(data + header->models_table))[index].path;
+}
+
+GLuint SceneSnapshot::GetModelDiffuseId(GLuint index) const
+{
+	const SnapshotHeader* header = (const SnapshotHeader*)data;
+	return ((const SnapshotModel*)(data + header->models_table))[index].diffuse_id;
+}
+
+GLuint SceneSnapshot::GetModelSpecularId(GLuint index) const
+{
+	const SnapshotHeader* header = (const SnapshotHeader*)data;
+	return ((const SnapshotModel*)(data + header->models_table))[index].specular_id;
+}
+
+const glm::vec3* SceneSnapshot::GetPositions() const
+{
+	return (const glm::vec3*)(data + ((const SnapshotHeader*)data)->positions);
+}
+
+const glm::vec4* SceneSnapshot::GetRotations() const
+{
+	return (const glm::vec4*)(data + ((const SnapshotHeader*)data)->rotations);
+}
+
+const glm::vec3* SceneSnapshot::GetScales() const
+{
+	return (const glm::vec3*)(data + ((const SnapshotHeader*)data)->scales);
+}
+
+const GLuint* SceneSnapshot::GetModelIds() const
+{
+	return (const GLuint*)(data + ((const SnapshotHeader*)data)->model_ids);
+}
+
+const GLuint* SceneSnapshot::GetParents() const
+{
+	return (const GLuint*)(data + ((const SnapshotHeader*)data)->parents);
+}
@@ -0,0 +1,138 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       scene_snapshot.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines binary scene snapshot which can be loaded with one file mapping
+*/
+//----------------------------------------------------------------------------------------
+#ifndef SCENE_SNAPSHOT
+#define SCENE_SNAPSHOT
+
+#include <string>
+#include <vector>
+
+#include "pgr.h"
+#include "SceneStore.h"
+
+/// <summary>
+/// Defines one model of the scene: path to the model and indeces of its textures
+/// </summary>
+struct ModelRecord {
+	std::string path;
+	GLuint diffuse_id;
+	GLuint specular_id;
+};
+
+/// <summary>
+/// Contains all the data of the configure file. Objects are stored as separate arrays
+/// </summary>
+struct SceneDescription {
+	std::vector<std::string> diffuse_textures;
+	std::vector<std::string> specular_textures;
+	std::vector<ModelRecord> models;
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec4> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<GLuint> model_ids;
+	/// <summary>
+	/// Index of the parent object or NO_PARENT. Parent always stands before its children
+	/// </summary>
+	std::vector<GLuint> parents;
+};
+
+/// <summary>
+/// Read-only view of the binary scene file. All object arrays point directly to the mapped file
+/// </summary>
+class SceneSnapshot
+{
+public:
+	/// <summary>
+	/// Constructor
+	/// </summary>
+	SceneSnapshot();
+	/// Destructor
+	~SceneSnapshot();
+	/// <summary>
+	/// Snapshot owns the mapped view and file handles, a copy would release them twice
+	/// </summary>
+	SceneSnapshot(const SceneSnapshot&) = delete;
+	SceneSnapshot& operator=(const SceneSnapshot&) = delete;
+	/// <summary>
+	/// Maps binary scene file to the memory and checks its header
+	/// </summary>
+	/// <param name="path">Path to the binary scene file</param>
+	/// <returns>Returns true if opening was succesful. Otherwise returns false</returns>
+	bool Open(const std::string& path);
+	/// <summary>
+	/// Takes ownership of the binary scene image which is already in memory
+	/// </summary>
+	/// <param name="image">Binary scene image. Buffer will be emptied</param>
+	/// <returns>Returns true if image is valid. Otherwise returns false</returns>
+	bool Open(std::vector<char>& image);
+	/// <summary>
+	/// Unmaps the file
+	/// </summary>
+	void Close();
+
+	GLuint GetDiffuseTexturesCount() const;
+	GLuint GetSpecularTexturesCount() const;
+	GLuint GetModelsCount() const;
+	GLuint GetObjectsCount() const;
+	const char* GetDiffuseTexturePath(GLuint index) const;
+	const char* GetSpecularTexturePath(GLuint index) const;
+	const char* GetModelPath(GLuint index) const;
+	GLuint GetModelDiffuseId(GLuint index) const;
+	GLuint GetModelSpecularId(GLuint index) const;
+	const glm::vec3* GetPositions() const;
+	const glm::vec4* GetRotations() const;
+	const glm::vec3* GetScales() const;
+	const GLuint* GetModelIds() const;
+	const GLuint* GetParents() const;
+private:
+	/// <summary>
+	/// Checks header and all offsets of the mapped image
+	/// </summary>
+	bool Validate();
+
+	const char* data;
+	size_t size;
+	std::vector<char> owned_data;
+	void* file_handle;
+	void* mapping_handle;
+};
+
+/// <summary>
+/// Builds binary scene image from scene description
+/// </summary>
+/// <param name="scene">Scene description</param>
+/// <param name="image">Returned binary image</param>
+void BuildSceneSnapshot(const SceneDescription& scene, std::vector<char>& image);
+/// <summary>
+/// Writes binary scene file
+/// </summary>
+/// <param name="path">Path to the binary scene file</param>
+/// <param name="scene">Scene description</param>
+/// <returns>Returns true if writing was succesful. Otherwise returns false</returns>
+bool WriteSceneSnapshot(const std::string& path, const SceneDescription& scene);
+/// <summary>
+/// Converts text configure file to the binary scene file
+/// </summary>
+/// <param name="config_file_path">Path to the configure file</param>
+/// <param name="snapshot_path">Path to the binary scene file</param>
+/// <returns>Returns true if converting was succesful. Otherwise returns false</returns>
+bool ConvertConfigToSnapshot(const std::string& config_file_path, const std::string& snapshot_path);
+/// <summary>
+/// Returns path of the binary scene file which belongs to the configure file
+/// </summary>
+/// <param name="config_file_path">Path to the configure file</param>
+std::string GetSnapshotPath(const std::string& config_file_path);
+/// <summary>
+/// Opens binary scene of the configure file. Binary scene is rebuilt if it is missing or older than the configure file
+/// </summary>
+/// <param name="config_file_path">Path to the configure file or to the binary scene file</param>
+/// <param name="snapshot">Returned binary scene</param>
+/// <returns>Returns true if opening was succesful. Otherwise returns false</returns>
+bool OpenSceneSnapshot(const std::string& config_file_path, SceneSnapshot& snapshot);
+
+#endif // !SCENE_SNAPSHOT
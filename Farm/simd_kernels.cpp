@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <cmath>
+
+#include "simd_kernels.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define KERNELS_SSE
+#endif
+
+/// <summary>
+/// Number of spheres or boxes tested at once
+/// </summary>
+static const GLuint TEST_WIDTH = 8;
+
+/// <summary>
+/// Returns true if the sphere is outside of the plane. The same order of operations as in SIMD kernels,
+/// so both versions give the same results
+/// </summary>
+static bool IsOutside(const glm::vec4& plane, float x, float y, float z, float radius)
+{
+	return plane.x * x + plane.y * y + plane.z * z + plane.w < -radius;
+}
+
+void ComposeMatricesScalar(GLuint count, const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, glm::mat4* matrices)
+{
+	for (GLuint i = 0; i < count; i++) {
+		glm::mat4 matrix = glm::mat4_cast(rotations[i]);
+		matrix[0] *= scales[i].x;
+		matrix[1] *= scales[i].y;
+		matrix[2] *= scales[i].z;
+		matrix[3] = glm::vec4(positions[i], 1.0f);
+		matrices[i] = matrix;
+	}
+}
+
+#ifdef KERNELS_SSE
+/// <summary>
+/// Transposes four columns given as x, y, z, w of four matrices and stores them
+/// </summary>
+/// <param name="matrices">First of the four matrices</param>
+/// <param name="column">Index of the column</param>
+static void StoreColumns(glm::mat4* matrices, int column, __m128 x, __m128 y, __m128 z, __m128 w)
+{
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	_mm_storeu_ps(&matrices[0][column][0], x);
+	_mm_storeu_ps(&matrices[1][column][0], y);
+	_mm_storeu_ps(&matrices[2][column][0], z);
+	_mm_storeu_ps(&matrices[3][column][0], w);
+}
+#endif
+
+void ComposeMatrices(GLuint count, const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, glm::mat4* matrices)
+{
+	GLuint i = 0;
+#ifdef KERNELS_SSE
+	// the same formula as glm::mat4_cast, lanes are four objects
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= count; i += 4)
+	{
+		const glm::quat* q = rotations + i;
+		const glm::vec3* p = positions + i;
+		const glm::vec3* s = scales + i;
+		__m128 x = _mm_setr_ps(q[0].x, q[1].x, q[2].x, q[3].x);
+		__m128 y = _mm_setr_ps(q[0].y, q[1].y, q[2].y, q[3].y);
+		__m128 z = _mm_setr_ps(q[0].z, q[1].z, q[2].z, q[3].z);
+		__m128 w = _mm_setr_ps(q[0].w, q[1].w, q[2].w, q[3].w);
+		__m128 sx = _mm_setr_ps(s[0].x, s[1].x, s[2].x, s[3].x);
+		__m128 sy = _mm_setr_ps(s[0].y, s[1].y, s[2].y, s[3].y);
+		__m128 sz = _mm_setr_ps(s[0].z, s[1].z, s[2].z, s[3].z);
+
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		StoreColumns(matrices + i, 0,
+			_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+			_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+			_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx),
+			zero);
+		StoreColumns(matrices + i, 1,
+			_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+			_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+			_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy),
+			zero);
+		StoreColumns(matrices + i, 2,
+			_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+			_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+			_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+			zero);
+		StoreColumns(matrices + i, 3,
+			_mm_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x),
+			_mm_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y),
+			_mm_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z),
+			one);
+	}
+#endif
+	ComposeMatricesScalar(count - i, positions + i, rotations + i, scales + i, matrices + i);
+}
+
+GLuint TestSpheresScalar(const Frustum& frustum, GLuint count, const glm::vec4* spheres, GLuint* visible)
+{
+	GLuint visible_count = 0;
+	for (GLuint i = 0; i < count; i++) {
+		const glm::vec4& sphere = spheres[i];
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+			outside = IsOutside(frustum.planes[p], sphere.x, sphere.y, sphere.z, sphere.w);
+		if (!outside) visible[visible_count++] = i;
+	}
+	return visible_count;
+}
+
+GLuint TestBoxesScalar(const Frustum& frustum, GLuint count, const BoundingBox* boxes, GLuint* visible)
+{
+	GLuint visible_count = 0;
+	for (GLuint i = 0; i < count; i++) {
+		glm::vec3 center = (boxes[i].min + boxes[i].max) * 0.5f;
+		glm::vec3 extent = (boxes[i].max - boxes[i].min) * 0.5f;
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++) {
+			// box is projected on the plane normal, so it is tested like a sphere with this radius
+			const glm::vec4& plane = frustum.planes[p];
+			float radius = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+			outside = IsOutside(plane, center.x, center.y, center.z, radius);
+		}
+		if (!outside) visible[visible_count++] = i;
+	}
+	return visible_count;
+}
+
+#ifdef KERNELS_SSE
+/// <summary>
+/// Tests eight spheres given as arrays of coordinates and radii
+/// </summary>
+/// <returns>Returns bit mask of visible spheres</returns>
+static GLuint TestSpheres8(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius)
+{
+	GLuint mask = 0;
+	for (int half = 0; half < 2; half++) {
+		__m128 cx = _mm_loadu_ps(x + half * 4);
+		__m128 cy = _mm_loadu_ps(y + half * 4);
+		__m128 cz = _mm_loadu_ps(z + half * 4);
+		__m128 negative_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + half * 4));
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++) {
+			const glm::vec4& plane = frustum.planes[p];
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_set1_ps(plane.x), cx), _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+				_mm_mul_ps(_mm_set1_ps(plane.z), cz)), _mm_set1_ps(plane.w));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negative_radius));
+		}
+		mask |= (~(GLuint)_mm_movemask_ps(outside) & 0xF) << (half * 4);
+	}
+	return mask;
+}
+
+/// <summary>
+/// Tests eight boxes given as arrays of centers and half sizes
+/// </summary>
+/// <returns>Returns bit mask of visible boxes</returns>
+static GLuint TestBoxes8(const Frustum& frustum, const float (*center)[TEST_WIDTH], const float (*extent)[TEST_WIDTH])
+{
+	GLuint mask = 0;
+	for (int half = 0; half < 2; half++) {
+		__m128 cx = _mm_loadu_ps(center[0] + half * 4);
+		__m128 cy = _mm_loadu_ps(center[1] + half * 4);
+		__m128 cz = _mm_loadu_ps(center[2] + half * 4);
+		__m128 ex = _mm_loadu_ps(extent[0] + half * 4);
+		__m128 ey = _mm_loadu_ps(extent[1] + half * 4);
+		__m128 ez = _mm_loadu_ps(extent[2] + half * 4);
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++) {
+			const glm::vec4& plane = frustum.planes[p];
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_set1_ps(plane.x), cx), _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+				_mm_mul_ps(_mm_set1_ps(plane.z), cz)), _mm_set1_ps(plane.w));
+			__m128 radius = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), ex), _mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), ey)),
+				_mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), ez));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_sub_ps(_mm_setzero_ps(), radius)));
+		}
+		mask |= (~(GLuint)_mm_movemask_ps(outside) & 0xF) << (half * 4);
+	}
+	return mask;
+}
+
+/// <summary>
+/// Appends indices of set bits of the mask
+/// </summary>
+static GLuint AppendVisible(GLuint mask, GLuint first, GLuint* visible)
+{
+	GLuint visible_count = 0;
+	for (GLuint lane = 0; lane < TEST_WIDTH; lane++)
+		if (mask & (1 << lane)) visible[visible_count++] = first + lane;
+	return visible_count;
+}
+#endif
+
+GLuint TestSpheres(const Frustum& frustum, GLuint count, const glm::vec4* spheres, GLuint* visible)
+{
+#ifdef KERNELS_SSE
+	GLuint visible_count = 0;
+	for (GLuint first = 0; first < count; first += TEST_WIDTH)
+	{
+		// spheres are transposed into arrays of components, missing spheres of the last group are not visible
+		float x[TEST_WIDTH], y[TEST_WIDTH], z[TEST_WIDTH], radius[TEST_WIDTH];
+		GLuint lanes = std::min(TEST_WIDTH, count - first);
+		for (GLuint lane = 0; lane < TEST_WIDTH; lane++) {
+			const glm::vec4& sphere = spheres[first + std::min(lane, lanes - 1)];
+			x[lane] = sphere.x;
+			y[lane] = sphere.y;
+			z[lane] = sphere.z;
+			radius[lane] = sphere.w;
+		}
+		GLuint mask = TestSpheres8(frustum, x, y, z, radius) & ((1u << lanes) - 1);
+		visible_count += AppendVisible(mask, first, visible + visible_count);
+	}
+	return visible_count;
+#else
+	return TestSpheresScalar(frustum, count, spheres, visible);
+#endif
+}
+
+GLuint TestBoxes(const Frustum& frustum, GLuint count, const BoundingBox* boxes, GLuint* visible)
+{
+#ifdef KERNELS_SSE
+	GLuint visible_count = 0;
+	for (GLuint first = 0; first < count; first += TEST_WIDTH)
+	{
+		float center[3][TEST_WIDTH], extent[3][TEST_WIDTH];
+		GLuint lanes = std::min(TEST_WIDTH, count - first);
+		for (GLuint lane = 0; lane < TEST_WIDTH; lane++) {
+			const BoundingBox& box = boxes[first + std::min(lane, lanes - 1)];
+			for (int axis = 0; axis < 3; axis++) {
+				center[axis][lane] = (box.min[axis] + box.max[axis]) * 0.5f;
+				extent[axis][lane] = (box.max[axis] - box.min[axis]) * 0.5f;
+			}
+		}
+		GLuint mask = TestBoxes8(frustum, center, extent) & ((1u << lanes) - 1);
+		visible_count += AppendVisible(mask, first, visible + visible_count);
+	}
+	return visible_count;
+#else
+	return TestBoxesScalar(frustum, count, boxes, visible);
+#endif
+}
+
+const char* GetSimdName()
+{
+#if defined(KERNELS_SSE)
+	return "SSE";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,68 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       simd_kernels.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines batched SIMD kernels: composition of world matrices and frustum tests
+ *
+ * Matrices are composed four at a time with SSE. Frustum tests check eight spheres or boxes
+ * at a time in two SSE registers. Every kernel has scalar version, which is used on platforms without SSE and
+ * by the benchmark to check the results.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include "pgr.h"
+#include "culling.h"
+
+/// <summary>
+/// Radius of the sphere which is never visible. Used for objects which have to be skipped by the frustum test
+/// </summary>
+const float HIDDEN_SPHERE_RADIUS = -1e30f;
+
+/// <summary>
+/// Composes translate * rotate * scale matrices of the objects
+/// </summary>
+/// <param name="count">Number of objects</param>
+/// <param name="positions">Array of positions</param>
+/// <param name="rotations">Array of normalized rotations</param>
+/// <param name="scales">Array of scales</param>
+/// <param name="matrices">Returned matrices</param>
+void ComposeMatrices(GLuint count, const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, glm::mat4* matrices);
+/// <summary>
+/// Scalar version of ComposeMatrices
+/// </summary>
+void ComposeMatricesScalar(GLuint count, const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, glm::mat4* matrices);
+/// <summary>
+/// Tests spheres against the frustum
+/// </summary>
+/// <param name="frustum">View frustum</param>
+/// <param name="count">Number of spheres</param>
+/// <param name="spheres">Array of spheres (x, y, z - center, w - radius). Spheres with HIDDEN_SPHERE_RADIUS are never visible</param>
+/// <param name="visible">Returned indices of visible spheres in ascending order, has to have place for count indices</param>
+/// <returns>Returns number of visible spheres</returns>
+GLuint TestSpheres(const Frustum& frustum, GLuint count, const glm::vec4* spheres, GLuint* visible);
+/// <summary>
+/// Scalar version of TestSpheres
+/// </summary>
+GLuint TestSpheresScalar(const Frustum& frustum, GLuint count, const glm::vec4* spheres, GLuint* visible);
+/// <summary>
+/// Tests axis aligned boxes against the frustum
+/// </summary>
+/// <param name="frustum">View frustum</param>
+/// <param name="count">Number of boxes</param>
+/// <param name="boxes">Array of boxes</param>
+/// <param name="visible">Returned indices of visible boxes in ascending order, has to have place for count indices</param>
+/// <returns>Returns number of visible boxes</returns>
+GLuint TestBoxes(const Frustum& frustum, GLuint count, const BoundingBox* boxes, GLuint* visible);
+/// <summary>
+/// Scalar version of TestBoxes
+/// </summary>
+GLuint TestBoxesScalar(const Frustum& frustum, GLuint count, const BoundingBox* boxes, GLuint* visible);
+/// <summary>
+/// Returns name of the instruction set used by the kernels
+/// </summary>
+const char* GetSimdName();
+
+#endif // !SIMD_KERNELS_H
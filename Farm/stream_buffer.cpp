@@ -0,0 +1,150 @@
+#include <iostream>
+#include <algorithm>
+
+#include "stream_buffer.h"
+#include "gl_caps.h"
+#include "render_stats.h"
+
+/// <summary>
+/// Time of one wait for the fence in nanoseconds
+/// </summary>
+static const GLuint64 FENCE_WAIT_TIMEOUT = 1000000;
+
+bool StreamBuffer::Create(GLsizeiptr _frame_size)
+{
+	Release();
+
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment <= 0) alignment = 256;
+	frame_size = GetAlignedSize(_frame_size);
+	GLsizeiptr size = frame_size * STREAM_FRAMES_COUNT;
+	persistent = HasGLVersion(4, 4) || HasGLExtension("GL_ARB_buffer_storage");
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	if (persistent) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_UNIFORM_BUFFER, size, nullptr, flags);
+		persistent_data = (GLubyte*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+		if (persistent_data == nullptr) {
+			// driver has the extension but cannot map the storage, buffer is recreated for the fallback path
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			glDeleteBuffers(1, &buffer);
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+			persistent = false;
+		}
+	}
+	if (!persistent) glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	// storage which could not be allocated has no size
+	GLint allocated_size = 0;
+	glGetBufferParameteriv(GL_UNIFORM_BUFFER, GL_BUFFER_SIZE, &allocated_size);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	if (allocated_size != size) {
+		std::cout << "failed to create stream buffer of " << size << " bytes" << std::endl;
+		Release();
+		return false;
+	}
+	return true;
+}
+
+void StreamBuffer::Release()
+{
+	for (GLsync& fence : fences)
+		if (fence != 0) WaitFence(fence);
+	if (buffer != 0) {
+		if (persistent_data != nullptr || frame_data != nullptr) {
+			glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &buffer);
+	}
+	buffer = 0;
+	frame_size = 0;
+	persistent = false;
+	persistent_data = nullptr;
+	frame_data = nullptr;
+	frame = 0;
+	used = 0;
+}
+
+bool StreamBuffer::BeginFrame(GLsizeiptr required_size)
+{
+	if (required_size > frame_size && !Create(std::max(required_size, frame_size * 2))) return false;
+	if (buffer == 0) return false;
+
+	frame = (frame + 1) % STREAM_FRAMES_COUNT;
+	used = 0;
+	if (fences[frame] != 0) WaitFence(fences[frame]);
+
+	if (persistent) frame_data = persistent_data + frame * frame_size;
+	else {
+		// GPU has finished the region, so it can be mapped without synchronization
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		frame_data = (GLubyte*)glMapBufferRange(GL_UNIFORM_BUFFER, frame * frame_size, frame_size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+	return frame_data != nullptr;
+}
+
+void* StreamBuffer::Allocate(GLsizeiptr size, GLintptr& offset)
+{
+	GLsizeiptr aligned_size = GetAlignedSize(size);
+	if (frame_data == nullptr || used + aligned_size > frame_size) return nullptr;
+
+	void* data = frame_data + used;
+	offset = frame * frame_size + used;
+	used += aligned_size;
+	return data;
+}
+
+void StreamBuffer::EndWriting()
+{
+	if (frame_data == nullptr) return;
+	if (!persistent) {
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+	frame_data = nullptr;
+	frame_stats.bytes_uploaded += used;
+}
+
+void StreamBuffer::EndFrame()
+{
+	if (buffer == 0) return;
+	if (fences[frame] != 0) glDeleteSync(fences[frame]);
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void StreamBuffer::BindUniformBlock(GLuint binding, GLintptr offset, GLsizeiptr size) const
+{
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+}
+
+GLsizeiptr StreamBuffer::GetAlignedSize(GLsizeiptr size) const
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+bool StreamBuffer::IsPersistent() const
+{
+	return persistent;
+}
+
+void StreamBuffer::WaitFence(GLsync& fence)
+{
+	// the first wait flushes commands, so the fence is signaled even if nothing else flushes them
+	GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	while (true)
+	{
+		GLenum status = glClientWaitSync(fence, flags, FENCE_WAIT_TIMEOUT);
+		if (status != GL_TIMEOUT_EXPIRED) break;
+		flags = 0;
+	}
+	glDeleteSync(fence);
+	fence = 0;
+}
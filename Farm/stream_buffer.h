@@ -0,0 +1,101 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       stream_buffer.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines ring buffer for data which is written anew every frame
+ *
+ * Buffer is split into STREAM_FRAMES_COUNT regions, every frame writes into the next one.
+ * Region is reused only after the fence of the frame which used it last is signaled, so
+ * CPU never writes the data GPU is still reading and never waits for the last frame.
+ * With GL 4.4 or ARB_buffer_storage the buffer is mapped once with persistent coherent
+ * mapping and writing costs nothing but memcpy. Otherwise every frame maps its region
+ * unsynchronized, which is still one driver call per frame instead of one per uniform.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include "pgr.h"
+
+/// <summary>
+/// Number of frames which can use the buffer at the same time
+/// </summary>
+const GLuint STREAM_FRAMES_COUNT = 3;
+
+class StreamBuffer
+{
+public:
+	/// <summary>
+	/// Creates the buffer. Needs current GL context
+	/// </summary>
+	/// <param name="frame_size">Size of one frame region in bytes</param>
+	/// <returns>Returns true if the buffer was created. Otherwise returns false</returns>
+	bool Create(GLsizeiptr frame_size);
+	/// <summary>
+	/// Deletes the buffer and its fences
+	/// </summary>
+	void Release();
+	/// <summary>
+	/// Starts writing into the next region. Waits if GPU still reads it and grows the buffer if the region is too small
+	/// </summary>
+	/// <param name="required_size">Number of bytes the frame is going to allocate, including alignment</param>
+	/// <returns>Returns true if the region can be written. Otherwise returns false</returns>
+	bool BeginFrame(GLsizeiptr required_size);
+	/// <summary>
+	/// Allocates aligned block in the current region
+	/// </summary>
+	/// <param name="size">Size of the block in bytes</param>
+	/// <param name="offset">Returned offset of the block from the start of the buffer</param>
+	/// <returns>Returns pointer for writing the block or nullptr if the region is full</returns>
+	void* Allocate(GLsizeiptr size, GLintptr& offset);
+	/// <summary>
+	/// Makes written data visible to GPU. Blocks can be bound only after this call
+	/// </summary>
+	void EndWriting();
+	/// <summary>
+	/// Puts fence after the commands which use the current region
+	/// </summary>
+	void EndFrame();
+	/// <summary>
+	/// Binds block of the buffer to the uniform block binding point
+	/// </summary>
+	/// <param name="binding">Binding point</param>
+	/// <param name="offset">Offset of the block returned by Allocate</param>
+	/// <param name="size">Size of the block in bytes</param>
+	void BindUniformBlock(GLuint binding, GLintptr offset, GLsizeiptr size) const;
+	/// <summary>
+	/// Returns size of the block rounded up to the alignment of the buffer offsets
+	/// </summary>
+	GLsizeiptr GetAlignedSize(GLsizeiptr size) const;
+	/// <summary>
+	/// Returns true if the buffer is mapped persistently
+	/// </summary>
+	bool IsPersistent() const;
+private:
+	/// <summary>
+	/// Waits until GPU has finished commands before the fence and deletes it
+	/// </summary>
+	static void WaitFence(GLsync& fence);
+
+	GLuint buffer = 0;
+	GLsizeiptr frame_size = 0;
+	/// <summary>
+	/// Alignment of uniform buffer offsets
+	/// </summary>
+	GLint alignment = 256;
+	bool persistent = false;
+	/// <summary>
+	/// Start of the whole buffer when it is mapped persistently
+	/// </summary>
+	GLubyte* persistent_data = nullptr;
+	/// <summary>
+	/// Start of the current region, nullptr outside of BeginFrame - EndWriting
+	/// </summary>
+	GLubyte* frame_data = nullptr;
+	GLuint frame = 0;
+	GLsizeiptr used = 0;
+	GLsync fences[STREAM_FRAMES_COUNT] = {};
+};
+
+#endif // !STREAM_BUFFER_H
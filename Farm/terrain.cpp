@@ -0,0 +1,417 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cctype>
+#include <cstddef>
+
+#include "terrain.h"
+#include "simd_kernels.h"
+#include "job_system.h"
+#include "render_stats.h"
+#include "profiler.h"
+
+static const GLuint NO_SLOT = 0xFFFFFFFF;
+/// <summary>
+/// Chunks are released only when they are this many stream radii away, so chunks on the border are not streamed in and out
+/// </summary>
+static const float EVICT_FACTOR = 1.25f;
+
+/// <summary>
+/// Reads next number of PGM header, skips whitespace and comments
+/// </summary>
+static bool ReadPgmNumber(std::istream& is, int& value)
+{
+	while (is) {
+		int c = is.peek();
+		if (c == '#') {
+			std::string comment;
+			std::getline(is, comment);
+		}
+		else if (std::isspace(c)) is.get();
+		else break;
+	}
+	return (bool)(is >> value);
+}
+
+bool Terrain::LoadHeightmap(const TerrainSettings& settings)
+{
+	std::ifstream ifs(settings.heightmap_path, std::ios::binary);
+	std::string magic;
+	int max_value = 0;
+	if (!ifs.is_open() || !(ifs >> magic) || (magic != "P2" && magic != "P5") ||
+		!ReadPgmNumber(ifs, heightmap_width) || !ReadPgmNumber(ifs, heightmap_height) || !ReadPgmNumber(ifs, max_value) ||
+		heightmap_width < 2 || heightmap_height < 2 || max_value <= 0 || max_value > 65535) {
+		std::cout << "failed to read heightmap header: " << settings.heightmap_path << std::endl;
+		return false;
+	}
+
+	heights.resize(heightmap_width * heightmap_height);
+	// binary samples start after exactly one whitespace character
+	if (magic == "P5") ifs.get();
+	for (float& height : heights)
+	{
+		int value = 0;
+		if (magic == "P2") ifs >> value;
+		else if (max_value < 256) value = ifs.get();
+		else {
+			int high = ifs.get();
+			value = (high << 8) | ifs.get();
+		}
+		if (!ifs) {
+			std::cout << "heightmap is too short: " << settings.heightmap_path << std::endl;
+			return false;
+		}
+		height = settings.height_offset + settings.height_scale * value / max_value;
+	}
+	return true;
+}
+
+bool Terrain::Load(const TerrainSettings& _settings, const glm::vec2& area_min, const glm::vec2& area_max, GLuint _program, GLuint _fog_texture)
+{
+	Release();
+	settings = _settings;
+	if (!LoadHeightmap(settings)) return false;
+
+	// chunk grid is aligned to the heightmap samples and covers both the heightmap and the area
+	heightmap_origin = -0.5f * settings.spacing * glm::vec2(heightmap_width - 1, heightmap_height - 1);
+	glm::vec2 heightmap_end = -heightmap_origin;
+	float chunk_size = TERRAIN_CHUNK_QUADS * settings.spacing;
+	first_chunk_x = (int)std::floor((std::min(area_min.x, heightmap_origin.x) - heightmap_origin.x) / chunk_size);
+	first_chunk_z = (int)std::floor((std::min(area_min.y, heightmap_origin.y) - heightmap_origin.y) / chunk_size);
+	chunks_x = (GLuint)std::max((int)std::ceil((std::max(area_max.x, heightmap_end.x) - heightmap_origin.x) / chunk_size) - first_chunk_x, 1);
+	chunks_z = (GLuint)std::max((int)std::ceil((std::max(area_max.y, heightmap_end.y) - heightmap_origin.y) / chunk_size) - first_chunk_z, 1);
+	Chunk empty_chunk = {};
+	empty_chunk.slot = NO_SLOT;
+	chunks.assign(chunks_x * chunks_z, empty_chunk);
+
+	// pool has place for every chunk which can be streamed at once
+	GLuint reach = (GLuint)std::ceil(settings.stream_radius * EVICT_FACTOR / chunk_size) + 1;
+	GLuint slots_count = std::min((2 * reach) * (2 * reach), (GLuint)chunks.size());
+	for (GLuint i = slots_count; i-- > 0; ) free_slots.push_back(i);
+
+	program = _program;
+	fog_texture = _fog_texture;
+	diffuse_texture = pgr::createTexture(settings.diffuse_path);
+	specular_texture = pgr::createTexture(settings.specular_path);
+	if (diffuse_texture == 0 || specular_texture == 0) {
+		std::cout << "failed to load terrain textures" << std::endl;
+		Release();
+		return false;
+	}
+
+	std::vector<GLushort> indices;
+	BuildIndices(indices);
+
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glGenBuffers(1, &vertex_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	GLsizeiptr pool_size = slots_count * TERRAIN_CHUNK_VERTICES * sizeof(TerrainVertex);
+	StatsBufferData(GL_ARRAY_BUFFER, pool_size, nullptr, GL_DYNAMIC_DRAW);
+	// vertex pool is the only big allocation, its size tells if it failed
+	GLint allocated_size = 0;
+	glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &allocated_size);
+	glGenBuffers(1, &index_buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+	StatsBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+
+	GLint attrib_location = glGetAttribLocation(program, "position");
+	glVertexAttribPointer(attrib_location, 3, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), (void*)offsetof(TerrainVertex, position));
+	glEnableVertexAttribArray(attrib_location);
+	attrib_location = glGetAttribLocation(program, "normal");
+	glVertexAttribPointer(attrib_location, 3, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), (void*)offsetof(TerrainVertex, normal));
+	glEnableVertexAttribArray(attrib_location);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glUseProgram(program);
+	glUniform1f(glGetUniformLocation(program, "texture_size"), settings.texture_size);
+	glUseProgram(0);
+
+	if (allocated_size != pool_size) {
+		std::cout << "failed to create terrain buffers for " << slots_count << " chunks" << std::endl;
+		Release();
+		return false;
+	}
+	std::cout << "terrain: " << chunks_x << "x" << chunks_z << " chunks, " << slots_count << " streamed at once" << std::endl;
+	return true;
+}
+
+void Terrain::BuildIndices(std::vector<GLushort>& indices)
+{
+	const GLuint side = TERRAIN_CHUNK_QUADS + 1;
+	for (GLuint level = 0; level < TERRAIN_LEVELS_COUNT; level++)
+	{
+		GLuint step = 1 << level;
+		for (GLuint mask = 0; mask < TERRAIN_STITCH_VARIANTS; mask++)
+		{
+			index_ranges[level][mask].offset = indices.size() * sizeof(GLushort);
+			// odd vertices of the stitched edge are moved to the previous even vertex, so the edge
+			// matches the coarser neighbour and triangles which lose their area are skipped
+			auto vertex = [mask, step, side](GLuint x, GLuint z) -> GLushort {
+				if ((x / step) % 2 == 1) {
+					if (((mask & TERRAIN_STITCH_NORTH) && z == 0) || ((mask & TERRAIN_STITCH_SOUTH) && z == TERRAIN_CHUNK_QUADS)) x -= step;
+				}
+				if ((z / step) % 2 == 1) {
+					if (((mask & TERRAIN_STITCH_WEST) && x == 0) || ((mask & TERRAIN_STITCH_EAST) && x == TERRAIN_CHUNK_QUADS)) z -= step;
+				}
+				return (GLushort)(z * side + x);
+			};
+			for (GLuint z = 0; z < TERRAIN_CHUNK_QUADS; z += step)
+				for (GLuint x = 0; x < TERRAIN_CHUNK_QUADS; x += step)
+				{
+					GLushort corners[4] = { vertex(x, z), vertex(x, z + step), vertex(x + step, z + step), vertex(x + step, z) };
+					const GLuint triangles[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+					for (const GLuint* triangle : triangles)
+					{
+						GLushort a = corners[triangle[0]], b = corners[triangle[1]], c = corners[triangle[2]];
+						if (a == b || b == c || a == c) continue;
+						indices.push_back(a);
+						indices.push_back(b);
+						indices.push_back(c);
+					}
+				}
+			index_ranges[level][mask].count = (GLsizei)(indices.size() - index_ranges[level][mask].offset / sizeof(GLushort));
+		}
+	}
+}
+
+float Terrain::GetSample(int x, int z) const
+{
+	x = ((x % heightmap_width) + heightmap_width) % heightmap_width;
+	z = ((z % heightmap_height) + heightmap_height) % heightmap_height;
+	return heights[z * heightmap_width + x];
+}
+
+void Terrain::GenerateChunk(GLuint chunk, TerrainVertex* vertices)
+{
+	const GLuint side = TERRAIN_CHUNK_QUADS + 1;
+	int base_x = (first_chunk_x + (int)(chunk % chunks_x)) * (int)TERRAIN_CHUNK_QUADS;
+	int base_z = (first_chunk_z + (int)(chunk / chunks_x)) * (int)TERRAIN_CHUNK_QUADS;
+	Chunk& data = chunks[chunk];
+	data.box.min = glm::vec3(1e30f);
+	data.box.max = glm::vec3(-1e30f);
+	for (GLuint z = 0; z < side; z++)
+		for (GLuint x = 0; x < side; x++)
+		{
+			int sample_x = base_x + (int)x;
+			int sample_z = base_z + (int)z;
+			TerrainVertex& vertex = vertices[z * side + x];
+			vertex.position = glm::vec3(heightmap_origin.x + sample_x * settings.spacing, GetSample(sample_x, sample_z), heightmap_origin.y + sample_z * settings.spacing);
+			vertex.normal = glm::normalize(glm::vec3(
+				GetSample(sample_x - 1, sample_z) - GetSample(sample_x + 1, sample_z),
+				2.0f * settings.spacing,
+				GetSample(sample_x, sample_z - 1) - GetSample(sample_x, sample_z + 1)));
+			data.box.min = glm::min(data.box.min, vertex.position);
+			data.box.max = glm::max(data.box.max, vertex.position);
+		}
+
+	// error of the level is the largest distance between the skipped vertices and the coarse surface
+	data.errors[0] = 0.0f;
+	for (GLuint level = 1; level < TERRAIN_LEVELS_COUNT; level++)
+	{
+		GLuint step = 1 << level;
+		float error = data.errors[level - 1];
+		for (GLuint z = 0; z < side; z++)
+			for (GLuint x = 0; x < side; x++)
+			{
+				GLuint x0 = std::min(x / step * step, TERRAIN_CHUNK_QUADS - step);
+				GLuint z0 = std::min(z / step * step, TERRAIN_CHUNK_QUADS - step);
+				float tx = (float)(x - x0) / step;
+				float tz = (float)(z - z0) / step;
+				float north = glm::mix(vertices[z0 * side + x0].position.y, vertices[z0 * side + x0 + step].position.y, tx);
+				float south = glm::mix(vertices[(z0 + step) * side + x0].position.y, vertices[(z0 + step) * side + x0 + step].position.y, tx);
+				error = std::max(error, std::abs(vertices[z * side + x].position.y - glm::mix(north, south, tz)));
+			}
+		data.errors[level] = error;
+	}
+}
+
+float Terrain::GetChunkDistance(GLuint chunk_x, GLuint chunk_z, const glm::vec3& position) const
+{
+	float chunk_size = TERRAIN_CHUNK_QUADS * settings.spacing;
+	glm::vec2 min = heightmap_origin + chunk_size * glm::vec2(first_chunk_x + (int)chunk_x, first_chunk_z + (int)chunk_z);
+	glm::vec2 point = glm::vec2(position.x, position.z);
+	glm::vec2 offset = glm::max(glm::max(min - point, point - min - glm::vec2(chunk_size)), glm::vec2(0.0f));
+	return glm::length(offset);
+}
+
+void Terrain::Record(FrameCommands& frame, const glm::vec3& camera_position, const Frustum& frustum, float projection_scale)
+{
+	if (chunks.empty()) return;
+	PROFILE_SCOPE("Terrain");
+
+	// chunks far behind the stream radius give their slots back
+	for (GLuint i = 0; i < resident.size(); )
+	{
+		GLuint chunk = resident[i];
+		if (GetChunkDistance(chunk % chunks_x, chunk / chunks_x, camera_position) <= settings.stream_radius * EVICT_FACTOR) {
+			i++;
+			continue;
+		}
+		free_slots.push_back(chunks[chunk].slot);
+		chunks[chunk].slot = NO_SLOT;
+		resident[i] = resident.back();
+		resident.pop_back();
+	}
+
+	// chunks which came into the stream radius, the nearest ones are streamed in first
+	float chunk_size = TERRAIN_CHUNK_QUADS * settings.spacing;
+	int min_x = std::max((int)std::floor((camera_position.x - settings.stream_radius - heightmap_origin.x) / chunk_size) - first_chunk_x, 0);
+	int min_z = std::max((int)std::floor((camera_position.z - settings.stream_radius - heightmap_origin.y) / chunk_size) - first_chunk_z, 0);
+	int max_x = std::min((int)std::floor((camera_position.x + settings.stream_radius - heightmap_origin.x) / chunk_size) - first_chunk_x, (int)chunks_x - 1);
+	int max_z = std::min((int)std::floor((camera_position.z + settings.stream_radius - heightmap_origin.y) / chunk_size) - first_chunk_z, (int)chunks_z - 1);
+	streamed_in.clear();
+	for (int z = min_z; z <= max_z; z++)
+		for (int x = min_x; x <= max_x; x++)
+		{
+			GLuint chunk = z * chunks_x + x;
+			if (chunks[chunk].slot == NO_SLOT && GetChunkDistance(x, z, camera_position) <= settings.stream_radius)
+				streamed_in.push_back(chunk);
+		}
+	std::sort(streamed_in.begin(), streamed_in.end(), [this, &camera_position](GLuint a, GLuint b) {
+		return GetChunkDistance(a % chunks_x, a / chunks_x, camera_position) < GetChunkDistance(b % chunks_x, b / chunks_x, camera_position);
+	});
+	GLuint uploads = std::min((GLuint)streamed_in.size(), std::min(settings.max_uploads_per_frame, (GLuint)free_slots.size()));
+	pending_count = (GLuint)streamed_in.size() - uploads;
+
+	GLuint first_upload = (GLuint)frame.terrain_upload_slots.size();
+	frame.terrain_vertices.resize((first_upload + uploads) * TERRAIN_CHUNK_VERTICES);
+	for (GLuint i = 0; i < uploads; i++)
+	{
+		GLuint chunk = streamed_in[i];
+		chunks[chunk].slot = free_slots.back();
+		free_slots.pop_back();
+		resident.push_back(chunk);
+		frame.terrain_upload_slots.push_back(chunks[chunk].slot);
+	}
+	TerrainVertex* upload_vertices = &frame.terrain_vertices[first_upload * TERRAIN_CHUNK_VERTICES];
+	ParallelFor(uploads, 1, [this, upload_vertices](GLuint begin, GLuint end) {
+		for (GLuint i = begin; i < end; i++)
+			GenerateChunk(streamed_in[i], upload_vertices + i * TERRAIN_CHUNK_VERTICES);
+	});
+
+	// coarsest level whose error is smaller than allowed number of pixels at the distance of the chunk
+	for (GLuint chunk : resident)
+	{
+		Chunk& data = chunks[chunk];
+		glm::vec3 offset = glm::max(glm::max(data.box.min - camera_position, camera_position - data.box.max), glm::vec3(0.0f));
+		float distance = std::max(glm::length(offset), settings.spacing);
+		data.level = 0;
+		while (data.level + 1 < TERRAIN_LEVELS_COUNT && data.errors[data.level + 1] * projection_scale <= settings.pixel_error * distance)
+			data.level++;
+	}
+	LimitLevelDifference();
+
+	resident_boxes.resize(resident.size());
+	visible.resize(resident.size());
+	for (GLuint i = 0; i < resident.size(); i++)
+		resident_boxes[i] = chunks[resident[i]].box;
+	GLuint visible_count = TestBoxes(frustum, (GLuint)resident.size(), resident_boxes.data(), visible.data());
+
+	for (GLuint i = 0; i < visible_count; i++)
+	{
+		GLuint chunk = resident[visible[i]];
+		GLuint x = chunk % chunks_x;
+		GLuint z = chunk / chunks_x;
+		GLuint level = chunks[chunk].level;
+		// neighbours which are not streamed in are beyond the far plane
+		auto coarser = [this, level](GLuint neighbour) {
+			return chunks[neighbour].slot != NO_SLOT && chunks[neighbour].level > level;
+		};
+		TerrainChunkDraw draw;
+		draw.slot = chunks[chunk].slot;
+		draw.level = level;
+		draw.stitch_mask = 0;
+		if (z > 0 && coarser(chunk - chunks_x)) draw.stitch_mask |= TERRAIN_STITCH_NORTH;
+		if (z + 1 < chunks_z && coarser(chunk + chunks_x)) draw.stitch_mask |= TERRAIN_STITCH_SOUTH;
+		if (x > 0 && coarser(chunk - 1)) draw.stitch_mask |= TERRAIN_STITCH_WEST;
+		if (x + 1 < chunks_x && coarser(chunk + 1)) draw.stitch_mask |= TERRAIN_STITCH_EAST;
+		frame.terrain_chunks.push_back(draw);
+	}
+}
+
+void Terrain::LimitLevelDifference()
+{
+	// every pass lowers levels which are too coarse for their neighbours, the difference spreads by one chunk per pass
+	for (GLuint pass = 0; pass < TERRAIN_LEVELS_COUNT; pass++)
+	{
+		bool changed = false;
+		for (GLuint chunk : resident)
+		{
+			GLuint x = chunk % chunks_x;
+			GLuint z = chunk / chunks_x;
+			GLuint neighbours[4] = {
+				z > 0 ? chunk - chunks_x : NO_SLOT,
+				z + 1 < chunks_z ? chunk + chunks_x : NO_SLOT,
+				x > 0 ? chunk - 1 : NO_SLOT,
+				x + 1 < chunks_x ? chunk + 1 : NO_SLOT
+			};
+			for (GLuint neighbour : neighbours)
+			{
+				if (neighbour == NO_SLOT || chunks[neighbour].slot == NO_SLOT) continue;
+				if (chunks[chunk].level > chunks[neighbour].level + 1) {
+					chunks[chunk].level = chunks[neighbour].level + 1;
+					changed = true;
+				}
+			}
+		}
+		if (!changed) break;
+	}
+}
+
+void Terrain::Upload(const FrameCommands& frame)
+{
+	if (vao == 0 || frame.terrain_upload_slots.empty()) return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	const GLsizeiptr chunk_bytes = TERRAIN_CHUNK_VERTICES * sizeof(TerrainVertex);
+	for (GLuint i = 0; i < frame.terrain_upload_slots.size(); i++)
+		StatsBufferSubData(GL_ARRAY_BUFFER, frame.terrain_upload_slots[i] * chunk_bytes, chunk_bytes, &frame.terrain_vertices[i * TERRAIN_CHUNK_VERTICES]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Terrain::Draw(const FrameCommands& frame)
+{
+	if (vao == 0 || frame.terrain_chunks.empty()) return;
+
+	StatsUseProgram(program);
+	glActiveTexture(GL_TEXTURE0);
+	StatsBindTexture(GL_TEXTURE_2D, diffuse_texture);
+	glActiveTexture(GL_TEXTURE1);
+	StatsBindTexture(GL_TEXTURE_2D, specular_texture);
+	glActiveTexture(GL_TEXTURE2);
+	StatsBindTexture(GL_TEXTURE_2D, fog_texture);
+
+	StatsBindVertexArray(vao);
+	for (const TerrainChunkDraw& chunk : frame.terrain_chunks)
+	{
+		const IndexRange& range = index_ranges[chunk.level][chunk.stitch_mask];
+		StatsDrawElementsBaseVertex(GL_TRIANGLES, range.count, GL_UNSIGNED_SHORT, (const void*)range.offset, chunk.slot * TERRAIN_CHUNK_VERTICES);
+	}
+	StatsBindVertexArray(0);
+}
+
+bool Terrain::HasPendingChunks() const
+{
+	return pending_count > 0;
+}
+
+void Terrain::Release()
+{
+	if (vao != 0) glDeleteVertexArrays(1, &vao);
+	if (vertex_buffer != 0) glDeleteBuffers(1, &vertex_buffer);
+	if (index_buffer != 0) glDeleteBuffers(1, &index_buffer);
+	if (diffuse_texture != 0) glDeleteTextures(1, &diffuse_texture);
+	if (specular_texture != 0) glDeleteTextures(1, &specular_texture);
+	vao = vertex_buffer = index_buffer = 0;
+	diffuse_texture = specular_texture = 0;
+
+	heights.clear();
+	chunks.clear();
+	resident.clear();
+	free_slots.clear();
+	pending_count = 0;
+	chunks_x = chunks_z = 0;
+}
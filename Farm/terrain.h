@@ -0,0 +1,207 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       terrain.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines heightfield terrain drawn as chunks with geomipmapping
+ *
+ * Heightmap covers the area around the scene objects, outside of the map it repeats. Area is
+ * split into square chunks of TERRAIN_CHUNK_QUADS quads. Only chunks around the camera have
+ * their vertices in the vertex pool: chunks which come into the stream radius are generated
+ * on the main thread and uploaded by the frame, chunks which leave it give their slot back.
+ * Every visible chunk is drawn with the coarsest level whose height error is smaller than
+ * TerrainSettings::pixel_error pixels on the screen. Neighbouring chunks differ by one level
+ * at most, and the finer chunk draws its edge with the vertices of the coarser one, so there
+ * are no cracks between them. All levels share one index buffer.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <string>
+#include <vector>
+
+#include "pgr.h"
+#include "culling.h"
+#include "frame_commands.h"
+
+/// <summary>
+/// Number of quads along the side of one chunk on the finest level
+/// </summary>
+const GLuint TERRAIN_CHUNK_QUADS = 32;
+const GLuint TERRAIN_CHUNK_VERTICES = (TERRAIN_CHUNK_QUADS + 1) * (TERRAIN_CHUNK_QUADS + 1);
+/// <summary>
+/// Number of levels of detail, level L uses every 2^L-th vertex
+/// </summary>
+const GLuint TERRAIN_LEVELS_COUNT = 6;
+/// <summary>
+/// Edges of the chunk, z grows to the south
+/// </summary>
+const GLuint TERRAIN_STITCH_NORTH = 1;
+const GLuint TERRAIN_STITCH_SOUTH = 2;
+const GLuint TERRAIN_STITCH_WEST = 4;
+const GLuint TERRAIN_STITCH_EAST = 8;
+const GLuint TERRAIN_STITCH_VARIANTS = 16;
+
+/// <summary>
+/// Parameters of the terrain
+/// </summary>
+struct TerrainSettings {
+	/// <summary>
+	/// Grayscale PGM image (P2 or P5, 8 or 16 bits), rows go along z
+	/// </summary>
+	std::string heightmap_path = "Resources/Textures/terrain_height.pgm";
+	std::string diffuse_path = "Resources/Textures/terrain_diffuse.png";
+	std::string specular_path = "Resources/Textures/no_specular.png";
+	/// <summary>
+	/// Distance between two heightmap samples in metres. Center of the heightmap is at the origin
+	/// </summary>
+	float spacing = 0.625f;
+	/// <summary>
+	/// Height is height_offset + height_scale * sample / max sample value
+	/// </summary>
+	float height_offset = -1.0f;
+	float height_scale = 16.0f;
+	/// <summary>
+	/// Side of the area covered by one repetition of the diffuse texture in metres
+	/// </summary>
+	float texture_size = 80.0f;
+	/// <summary>
+	/// Chunks closer to the camera than this distance are kept in the vertex pool
+	/// </summary>
+	float stream_radius = 120.0f;
+	/// <summary>
+	/// Maximum number of chunks generated and uploaded by one frame
+	/// </summary>
+	GLuint max_uploads_per_frame = 16;
+	/// <summary>
+	/// Allowed height error of the chosen level in pixels
+	/// </summary>
+	float pixel_error = 2.0f;
+};
+
+class Terrain
+{
+public:
+	/// <summary>
+	/// Loads heightmap and textures and creates vertex pool and index buffer. Needs current GL context
+	/// </summary>
+	/// <param name="settings">Parameters of the terrain</param>
+	/// <param name="area_min">Corner of the area which has to be covered (x, z). Area always contains the heightmap</param>
+	/// <param name="area_max">Opposite corner of the area</param>
+	/// <param name="program">Terrain shader program</param>
+	/// <param name="fog_texture">Texture of the fog</param>
+	/// <returns>Returns true if loading was succesful. Otherwise returns false</returns>
+	bool Load(const TerrainSettings& settings, const glm::vec2& area_min, const glm::vec2& area_max, GLuint program, GLuint fog_texture);
+	/// <summary>
+	/// Streams chunks around the camera, chooses their levels and records visible ones. Called on the main thread
+	/// </summary>
+	/// <param name="frame">Recorded frame, receives uploaded chunks and chunks to draw</param>
+	/// <param name="camera_position">Position of the camera</param>
+	/// <param name="frustum">View frustum</param>
+	/// <param name="projection_scale">Height of the viewport divided by 2 * tan(fov / 2), converts size at distance 1 to pixels</param>
+	void Record(FrameCommands& frame, const glm::vec3& camera_position, const Frustum& frustum, float projection_scale);
+	/// <summary>
+	/// Uploads chunks streamed in by the frame. Record already made them resident, so it has to be called for every
+	/// recorded frame, also for the frame which is not drawn. Called on the thread which owns GL context
+	/// </summary>
+	void Upload(const FrameCommands& frame);
+	/// <summary>
+	/// Draws chunks of the frame, they have to be uploaded by Upload. Called on the thread which owns GL context
+	/// </summary>
+	void Draw(const FrameCommands& frame);
+	/// <summary>
+	/// Returns true if some chunks in the stream radius are still waiting for upload
+	/// </summary>
+	bool HasPendingChunks() const;
+	/// <summary>
+	/// Deletes GL objects and forgets all chunks
+	/// </summary>
+	void Release();
+private:
+	struct Chunk {
+		/// <summary>
+		/// Slot in the vertex pool or NO_SLOT if the chunk is not streamed in
+		/// </summary>
+		GLuint slot;
+		GLuint level;
+		BoundingBox box;
+		/// <summary>
+		/// Maximum height error of every level
+		/// </summary>
+		float errors[TERRAIN_LEVELS_COUNT];
+	};
+	struct IndexRange {
+		GLintptr offset;
+		GLsizei count;
+	};
+
+	/// <summary>
+	/// Reads heightmap image
+	/// </summary>
+	bool LoadHeightmap(const TerrainSettings& settings);
+	/// <summary>
+	/// Returns height of the sample, coordinates repeat outside of the heightmap
+	/// </summary>
+	float GetSample(int x, int z) const;
+	/// <summary>
+	/// Writes vertices of the chunk and computes its box and level errors
+	/// </summary>
+	void GenerateChunk(GLuint chunk, TerrainVertex* vertices);
+	/// <summary>
+	/// Creates indices of all levels and stitching variants
+	/// </summary>
+	void BuildIndices(std::vector<GLushort>& indices);
+	/// <summary>
+	/// Returns distance from the point to the chunk area in xz plane
+	/// </summary>
+	float GetChunkDistance(GLuint chunk_x, GLuint chunk_z, const glm::vec3& position) const;
+	/// <summary>
+	/// Makes levels of neighbouring streamed chunks differ by one at most
+	/// </summary>
+	void LimitLevelDifference();
+
+	TerrainSettings settings;
+	std::vector<float> heights;
+	int heightmap_width = 0;
+	int heightmap_height = 0;
+	/// <summary>
+	/// World position of the sample (0, 0)
+	/// </summary>
+	glm::vec2 heightmap_origin;
+	/// <summary>
+	/// Chunk grid: first chunk in heightmap samples (divided by TERRAIN_CHUNK_QUADS) and number of chunks
+	/// </summary>
+	int first_chunk_x = 0;
+	int first_chunk_z = 0;
+	GLuint chunks_x = 0;
+	GLuint chunks_z = 0;
+	std::vector<Chunk> chunks;
+	/// <summary>
+	/// Streamed chunks and free slots of the vertex pool
+	/// </summary>
+	std::vector<GLuint> resident;
+	std::vector<GLuint> free_slots;
+	/// <summary>
+	/// Chunks in the stream radius which did not fit into the last frame
+	/// </summary>
+	GLuint pending_count = 0;
+	/// <summary>
+	/// Reused arrays of Record
+	/// </summary>
+	std::vector<GLuint> streamed_in;
+	std::vector<BoundingBox> resident_boxes;
+	std::vector<GLuint> visible;
+
+	// GL objects, used only by the thread which owns GL context
+	GLuint program = 0;
+	GLuint vao = 0;
+	GLuint vertex_buffer = 0;
+	GLuint index_buffer = 0;
+	GLuint diffuse_texture = 0;
+	GLuint specular_texture = 0;
+	GLuint fog_texture = 0;
+	IndexRange index_ranges[TERRAIN_LEVELS_COUNT][TERRAIN_STITCH_VARIANTS];
+};
+
+#endif // !TERRAIN_H
@@ -0,0 +1,34 @@
+#version 330 core
+
+in vec3 position;
+in vec3 normal;
+
+out vec3 Normal;
+out vec3 FragPos;
+out vec2 TexCoords;
+out vec2 FogTexCoords;
+flat out uint ObjectId;
+
+layout(std140) uniform CameraBlock {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 viewPos;
+    bool fog;
+};
+
+// side of the area covered by one repetition of the texture
+uniform float texture_size;
+
+void main() {
+    // terrain vertices are already in world space
+    gl_Position = projectionMatrix * viewMatrix * vec4(position, 1.0f);
+    vec3 ndcSpacePos;
+    if (gl_Position.w != 0)
+        ndcSpacePos = gl_Position.xyz / gl_Position.w;
+    FogTexCoords = (ndcSpacePos.xy + 1.0f) / 2.0f;
+    FragPos = position;
+    Normal = normal;
+    TexCoords = position.xz / texture_size + 0.5f;
+    // terrain cannot be picked
+    ObjectId = 0u;
+};
@@ -0,0 +1,17 @@
+#version 330 core
+
+// average color of the transparent fragments, alpha is their total coverage
+out vec4 color;
+
+uniform sampler2D accumulation_texture;
+uniform sampler2D weight_texture;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 accumulation = texelFetch(accumulation_texture, pixel, 0);
+    // product of (1 - alpha) of all fragments, 1 where nothing transparent was drawn
+    float revealage = accumulation.a;
+    if (revealage >= 1.0f) discard;
+    float weight = texelFetch(weight_texture, pixel, 0).r;
+    color = vec4(min(accumulation.rgb / max(weight, 1e-5f), vec3(1.0f)), 1.0f - revealage);
+};
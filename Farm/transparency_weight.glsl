@@ -0,0 +1,9 @@
+// Weighted blended transparency. Fragment writes premultiplied color * weight with alpha for revealage
+// into the accumulation target, and alpha * weight into the weight target. Appended to the fragment
+// shaders of all transparent programs, so they all use the same weight
+
+// nearer and more opaque fragments get bigger part of the average color. Range of the weight
+// keeps the sums of thousands of overlapping fragments inside half floats
+float GetWeight(float alpha, float distance) {
+    return alpha * clamp(0.1f / (1e-5f + pow(distance / 5.0f, 2.0f) + pow(distance / 200.0f, 6.0f)), 1e-4f, 30.0f);
+}
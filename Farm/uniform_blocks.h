@@ -0,0 +1,143 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file       uniform_blocks.h
+ * \author     Plotnikau Pavel
+ * \date       2026/10/18
+ * \brief      Defines std140 uniform blocks of the shaders, their binding points and indirect draw commands
+ *
+ * Structures mirror blocks declared in the shaders byte to byte: vec3 takes 16 bytes
+ * unless a scalar follows it, structures and matrices start at 16 bytes. Blocks are written
+ * into the stream buffer and bound with glBindBufferRange instead of setting every uniform.
+*/
+//----------------------------------------------------------------------------------------
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include "pgr.h"
+
+/// <summary>
+/// Binding points of the uniform blocks, the same in all shader programs
+/// </summary>
+enum UniformBlockBinding {
+	CAMERA_BLOCK_BINDING = 0,
+	LIGHTS_BLOCK_BINDING = 1,
+	/// <summary>
+	/// Block of one draw call: ObjectBlock, BannerBlock or SpriteBlock
+	/// </summary>
+	DRAW_BLOCK_BINDING = 2
+};
+
+/// <summary>
+/// Camera and fog, shared by all programs of the frame
+/// </summary>
+struct CameraBlock {
+	glm::mat4 projection_matrix;
+	glm::mat4 view_matrix;
+	glm::vec3 view_position;
+	GLint fog;
+};
+
+struct DirectLightBlock {
+	glm::vec3 ambient;
+	float padding0;
+	glm::vec3 diffuse;
+	float padding1;
+	glm::vec3 specular;
+	float intensity;
+	glm::vec3 direction;
+	float padding2;
+};
+
+struct PointLightBlock {
+	glm::vec3 ambient;
+	float padding0;
+	glm::vec3 diffuse;
+	float padding1;
+	glm::vec3 specular;
+	float intensity;
+	glm::vec3 position;
+	float linear;
+	float quadratic;
+	float padding2[3];
+};
+
+struct SpotLightBlock {
+	PointLightBlock point;
+	glm::vec3 direction;
+	/// <summary>
+	/// Cosine of the cut off angle
+	/// </summary>
+	float cut_off;
+};
+
+/// <summary>
+/// Lights of the frame, used by the object program
+/// </summary>
+struct LightsBlock {
+	DirectLightBlock direct_light;
+	PointLightBlock point_light;
+	SpotLightBlock spot_light;
+};
+
+/// <summary>
+/// One object drawn by the object program
+/// </summary>
+struct ObjectBlock {
+	glm::mat4 model_matrix;
+	/// <summary>
+	/// Transposed inverse of the model matrix, so vertex shader does not invert it for every vertex
+	/// </summary>
+	glm::mat4 normal_matrix;
+	GLuint object_id;
+	GLint transform_model;
+	float change_val;
+	float padding;
+};
+
+/// <summary>
+/// Banner drawn by the banner program
+/// </summary>
+struct BannerBlock {
+	glm::mat4 model_matrix;
+	glm::mat4 texture_matrix;
+};
+
+/// <summary>
+/// One quad with animated texture (sprite or character of the text) drawn by the animated texture program.
+/// The program reads an array of MAX_SPRITE_BATCH blocks, one for every instance
+/// </summary>
+struct SpriteBlock {
+	glm::mat4 model_matrix;
+	GLint size_x;
+	GLint size_y;
+	GLint index;
+	GLint padding;
+};
+
+/// <summary>
+/// Number of sprites in one SpriteBlock array, drawn by one instanced call. Fixed in anim_texture_vs.glsl,
+/// the array fits into 16 KB guaranteed for GL_MAX_UNIFORM_BLOCK_SIZE
+/// </summary>
+const GLuint MAX_SPRITE_BATCH = 128;
+
+/// <summary>
+/// Command of glDrawElementsIndirect as it is stored in GL_DRAW_INDIRECT_BUFFER
+/// </summary>
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instance_count;
+	GLuint first_index;
+	GLint base_vertex;
+	GLuint base_instance;
+};
+
+static_assert(sizeof(CameraBlock) == 144, "CameraBlock does not match std140 layout");
+static_assert(sizeof(DirectLightBlock) == 64, "DirectLightBlock does not match std140 layout");
+static_assert(sizeof(PointLightBlock) == 80, "PointLightBlock does not match std140 layout");
+static_assert(sizeof(SpotLightBlock) == 96, "SpotLightBlock does not match std140 layout");
+static_assert(sizeof(LightsBlock) == 240, "LightsBlock does not match std140 layout");
+static_assert(sizeof(ObjectBlock) == 144, "ObjectBlock does not match std140 layout");
+static_assert(sizeof(BannerBlock) == 128, "BannerBlock does not match std140 layout");
+static_assert(sizeof(SpriteBlock) == 80, "SpriteBlock does not match std140 layout");
+
+#endif // !UNIFORM_BLOCKS_H